@@ -381,6 +381,9 @@
 		#ifdef __AVX2__
 			#define KLAYGE_AVX2_SUPPORT
 		#endif	
+		#ifdef __AVX512F__
+			#define KLAYGE_AVX512_SUPPORT
+		#endif
 	#elif defined(KLAYGE_COMPILER_GCC) || defined(KLAYGE_COMPILER_CLANG)
 		#ifdef __SSE3__
 			#define KLAYGE_SSE3_SUPPORT
@@ -400,6 +403,9 @@
 		#ifdef __AVX2__
 			#define KLAYGE_AVX2_SUPPORT
 		#endif
+		#ifdef __AVX512F__
+			#define KLAYGE_AVX512_SUPPORT
+		#endif
 	#endif
 #elif defined KLAYGE_CPU_X86
 	#if defined(KLAYGE_COMPILER_MSVC)
@@ -418,6 +424,9 @@
 			#ifdef __AVX2__
 				#define KLAYGE_AVX2_SUPPORT
 			#endif
+			#ifdef __AVX512F__
+				#define KLAYGE_AVX512_SUPPORT
+			#endif
 		#endif
 	#elif defined(KLAYGE_COMPILER_GCC) || defined(KLAYGE_COMPILER_CLANG)
 		#ifdef __MMX__
@@ -447,6 +456,9 @@
 		#ifdef __AVX2__
 			#define KLAYGE_AVX2_SUPPORT
 		#endif
+		#ifdef __AVX512F__
+			#define KLAYGE_AVX512_SUPPORT
+		#endif
 	#endif
 #elif defined KLAYGE_CPU_ARM
 	#if defined(KLAYGE_COMPILER_MSVC)
@@ -459,6 +471,26 @@
 #elif defined KLAYGE_CPU_ARM64
 #endif
 
+// Defines MACROs for wider ISAs that can be picked at runtime. A function tagged with
+// KLAYGE_TARGET_AVX2 or KLAYGE_TARGET_AVX512 is compiled for that ISA without changing the
+// global compile options, so it can only be called after CPUInfo reports the feature.
+#if defined(KLAYGE_CPU_X86) || defined(KLAYGE_CPU_X64)
+	#if defined(KLAYGE_COMPILER_MSVC)
+		#define KLAYGE_DISPATCH_AVX2_SUPPORT
+		#define KLAYGE_TARGET_AVX2
+		#if _MSC_VER >= 1911
+			#define KLAYGE_DISPATCH_AVX512_SUPPORT
+			#define KLAYGE_TARGET_AVX512
+		#endif
+	#elif defined(KLAYGE_COMPILER_GCC) || (defined(KLAYGE_COMPILER_CLANG) && !defined(KLAYGE_PLATFORM_IOS) \
+			&& ((defined(__APPLE__) && (CLANG_VERSION >= 80)) || (!defined(__APPLE__) && (CLANG_VERSION >= 38))))
+		#define KLAYGE_DISPATCH_AVX2_SUPPORT
+		#define KLAYGE_TARGET_AVX2 __attribute__((target("avx2,fma,f16c")))
+		#define KLAYGE_DISPATCH_AVX512_SUPPORT
+		#define KLAYGE_TARGET_AVX512 __attribute__((target("avx512f,avx2,fma,f16c")))
+	#endif
+#endif
+
 #if defined(KLAYGE_COMPILER_MSVC) || defined(KLAYGE_COMPILER_GCC) || defined(KLAYGE_COMPILER_CLANG)
 	#define KLAYGE_HAS_STRUCT_PACK
 #endif
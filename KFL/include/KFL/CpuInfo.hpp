@@ -61,7 +61,8 @@ namespace KlayGE
 			CF_LZCNT = 1UL << 16,
 			CF_AVX2 = 1UL << 17,
 			CF_FMA4 = 1UL << 18,
-			CF_F16C = 1UL << 19
+			CF_F16C = 1UL << 19,
+			CF_AVX512F = 1UL << 20
 		};
 
 	public:
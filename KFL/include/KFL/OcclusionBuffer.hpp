@@ -0,0 +1,132 @@
+/**
+ * @file OcclusionBuffer.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KFL, a subproject of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+
+#ifndef _KFL_OCCLUSIONBUFFER_HPP
+#define _KFL_OCCLUSIONBUFFER_HPP
+
+#pragma once
+
+#include <KFL/PreDeclare.hpp>
+#include <KFL/Math.hpp>
+
+#include <vector>
+
+namespace KlayGE
+{
+	// A low resolution depth buffer for software occlusion culling. Occluder triangles are rasterized on the CPU,
+	// and bounding boxes are tested against it to find out the objects hidden behind them.
+	//
+	// The buffer is split into 8x4 pixel tiles. Each tile keeps the depth of its pixels and the farthest of them,
+	// so most of the boxes are accepted or rejected by the tiles alone. A triangle covers a pixel if it covers the
+	// pixel center. Depth is z / w of the projection, from 0 on the near plane to 1 on the far plane.
+	class OcclusionBuffer
+	{
+	public:
+		static uint32_t const TILE_WIDTH = 8;
+		static uint32_t const TILE_HEIGHT = 4;
+
+	public:
+		// The size is rounded up to whole tiles
+		OcclusionBuffer(uint32_t width, uint32_t height);
+
+		uint32_t Width() const
+		{
+			return width_;
+		}
+		uint32_t Height() const
+		{
+			return height_;
+		}
+
+		// Resets the depth to the far plane and drops the occluders
+		void Clear();
+
+		// Transforms triangles into the screen and keeps them for Rasterize(). Triangles crossing the near plane
+		// are dropped, so the buffer never gets nearer than the real occluders.
+		void AddOccluder(float3 const * positions, uint32_t const * indices, uint32_t num_indices,
+			float4x4 const & mvp);
+		// The 12 triangles of a box
+		void AddOccluder(AABBox const & aabb, float4x4 const & mvp);
+		uint32_t NumOccluderTriangles() const
+		{
+			return static_cast<uint32_t>(tris_.size());
+		}
+
+		// Rasterizes the occluders added since the last Clear(). The parallel version splits the buffer into rows of
+		// tiles, so the threads never write the same pixel.
+		void Rasterize();
+		void Rasterize(thread_pool& tp);
+
+		// False if a world space box is completely hidden behind the occluders. Boxes crossing the near plane are
+		// always visible. Safe to call from multiple threads once rasterized.
+		bool IsVisible(AABBox const & aabb, float4x4 const & view_proj) const;
+
+		float Depth(uint32_t x, uint32_t y) const;
+
+	private:
+		struct Triangle
+		{
+			// Screen space edge functions, a * x + b * y + c >= 0 inside
+			float a[3];
+			float b[3];
+			float c[3];
+			// Depth plane, z = z0 + dzdx * x + dzdy * y
+			float z0;
+			float dzdx;
+			float dzdy;
+			float min_z;
+			// Covered pixels, inclusive
+			int32_t min_x;
+			int32_t min_y;
+			int32_t max_x;
+			int32_t max_y;
+		};
+
+		void AddTriangle(float4 const & v0, float4 const & v1, float4 const & v2);
+		void RasterizeTileRows(uint32_t begin_row, uint32_t end_row);
+		void RasterizeTriangle(Triangle const & tri, uint32_t tile_x, uint32_t tile_y);
+
+	private:
+		uint32_t width_;
+		uint32_t height_;
+		uint32_t tiles_x_;
+		uint32_t tiles_y_;
+
+		// Pixels are grouped by tiles, each tile has TILE_WIDTH * TILE_HEIGHT continuous floats
+		std::vector<float> depth_;
+		std::vector<float> tile_max_depth_;
+
+		std::vector<Triangle> tris_;
+		std::vector<float4> clip_pos_;
+	};
+}
+
+#endif		// _KFL_OCCLUSIONBUFFER_HPP
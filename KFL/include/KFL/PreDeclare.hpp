@@ -124,6 +124,9 @@ namespace KlayGE
 	class OBBox_T;
 	typedef OBBox_T<float> OBBox;
 	typedef std::shared_ptr<OBBox> OBBoxPtr;
+
+	class OcclusionBuffer;
+	typedef std::shared_ptr<OcclusionBuffer> OcclusionBufferPtr;
 }
 
 #endif			// _KFL_PREDECLARE_HPP
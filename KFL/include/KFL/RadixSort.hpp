@@ -0,0 +1,51 @@
+/**
+ * @file RadixSort.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KFL, a subproject of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+
+#ifndef _KFL_RADIXSORT_HPP
+#define _KFL_RADIXSORT_HPP
+
+#pragma once
+
+#include <KFL/PreDeclare.hpp>
+
+namespace KlayGE
+{
+	// Stable LSD radix sort of 64-bit keys along with 32-bit values, 8 bits per pass. The passes where all the keys
+	// have the same digit are skipped, so keys only using a few bits sort in a few passes. tmp_keys and tmp_values
+	// are scratch buffers of num elements. The result is always in keys and values.
+	void RadixSort(uint64_t* keys, uint32_t* values, size_t num, uint64_t* tmp_keys, uint32_t* tmp_values);
+	// The same, with the histograms and the scatters of each pass split over the thread pool. Falls back to the
+	// single threaded version for small inputs.
+	void RadixSort(uint64_t* keys, uint32_t* values, size_t num, uint64_t* tmp_keys, uint32_t* tmp_values,
+		thread_pool& tp);
+}
+
+#endif		// _KFL_RADIXSORT_HPP
@@ -0,0 +1,154 @@
+/**
+ * @file SIMDBatch.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KFL, a subproject of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef _KFL_SIMDBATCH_HPP
+#define _KFL_SIMDBATCH_HPP
+
+#pragma once
+
+#include <KFL/PreDeclare.hpp>
+#include <KFL/Math.hpp>
+
+namespace KlayGE
+{
+	// Instruction sets the batch kernels could run on, from the narrowest to the widest
+	enum SIMDInstructionSet
+	{
+		SIMDIS_Scalar = 0,
+		SIMDIS_SSE2,
+		SIMDIS_AVX2,
+		SIMDIS_AVX512
+	};
+
+	// Batch kernels work on structure-of-arrays streams. Unlike SIMDMathLib, which is fixed to
+	// 128-bit at compile time, the instruction set is picked at runtime from CPUInfo, so one binary
+	// runs 512-bit or 256-bit code on new CPUs and still runs on old ones.
+	namespace SIMDBatchLib
+	{
+		// The widest instruction set supported by both the CPU and the compiler
+		SIMDInstructionSet MaxInstructionSet();
+		// The instruction set used by the kernels. Default to MaxInstructionSet().
+		SIMDInstructionSet ActiveInstructionSet();
+		// Force the kernels to a narrower instruction set. Clamped to MaxInstructionSet().
+		void ActiveInstructionSet(SIMDInstructionSet is);
+		// Number of floats processed per iteration with the active instruction set
+		uint32_t BatchWidth();
+		char const * InstructionSetName(SIMDInstructionSet is);
+
+		// Transforms points by a matrix, with perspective divide. In-place is allowed.
+		void TransformCoords(float* out_x, float* out_y, float* out_z,
+			float const * x, float const * y, float const * z, size_t num,
+			float4x4 const & mat);
+		// Transforms directions by the 3x3 part of a matrix. In-place is allowed.
+		void TransformNormals(float* out_x, float* out_y, float* out_z,
+			float const * x, float const * y, float const * z, size_t num,
+			float4x4 const & mat);
+		// Computes the bounding box of points. num must be greater than 0.
+		void ComputeBounds(float3& min_pt, float3& max_pt,
+			float const * x, float const * y, float const * z, size_t num);
+		// out[i] = lhs[lhs_indices[i]] * rhs[i], one matrix per iteration with the rows in registers. For
+		// hierarchies, lhs is the array of parent matrices. out could be rhs, or lhs if the indices don't
+		// point into the output range.
+		void MultiplyMatrices(float4x4* out, float4x4 const * lhs, uint32_t const * lhs_indices,
+			float4x4 const * rhs, size_t num);
+
+		// World-space axis aligned boxes as SoA streams of centers and half extents
+		struct AABBoxSoA
+		{
+			float const * center_x;
+			float const * center_y;
+			float const * center_z;
+			float const * extent_x;
+			float const * extent_y;
+			float const * extent_z;
+		};
+
+		// Mask of all 6 frustum planes, the initial value of plane_masks
+		uint8_t const ALL_FRUSTUM_PLANES = 0x3F;
+
+		// Intersects num boxes with a frustum, 4, 8 or 16 boxes per iteration depending on the instruction set.
+		// Returns the number of visible boxes.
+		//   visible_bits: (num + 31) / 32 words. Bit i is set if box i is not BO_No.
+		//   overlaps: Optional. Per-box result.
+		//   plane_masks: Optional, in/out. Per-box mask of the planes that need to be tested. The bits of the
+		//     planes a visible box is fully inside are cleared, so the children of a node can start from
+		//     the mask of their parent. Untouched for invisible boxes.
+		//   last_planes: Optional, in/out. Per-box index of the plane that rejected the box last time. It is
+		//     tested first, because an invisible box is likely to be rejected by the same plane next frame.
+		//     Initialize to 0.
+		uint32_t IntersectAABBFrustum(uint32_t* visible_bits, BoundOverlap* overlaps,
+			uint8_t* plane_masks, uint8_t* last_planes,
+			AABBoxSoA const & boxes, size_t num, Frustum const & frustum);
+		// Intersects num boxes with num_frusta frusta in one pass, each group of boxes is loaded once for all the
+		// frusta. visible_bits has num_frusta bitsets of (num + 31) / 32 words, one after another. Bit i of the
+		// bitset f is set if box i is not outside of frustum f. inside_bits, if not null, has the same layout, with
+		// the bits of the boxes fully inside, so visible but not inside is BO_Partial. Returns the number of boxes
+		// visible in any frustum. A frustum plane of (0, 0, 0, 1) never rejects, for culling against less than 6 planes.
+		uint32_t IntersectAABBFrusta(uint32_t* visible_bits, uint32_t* inside_bits, AABBoxSoA const & boxes, size_t num,
+			Frustum const * frusta, size_t num_frusta);
+		// Intersects num boxes with a sphere, such as the range of a point light. Returns the number of boxes touching it.
+		uint32_t IntersectAABBSphere(uint32_t* visible_bits, AABBoxSoA const & boxes, size_t num, Sphere const & sphere);
+		// Intersects num boxes with a cone of a unit direction, the cosine of a half angle below 90 degrees and a
+		// height, such as the volume of a spot light. The bounding spheres of the boxes are tested, so the result is
+		// conservative. Returns the number of boxes touching it.
+		uint32_t IntersectAABBCone(uint32_t* visible_bits, AABBoxSoA const & boxes, size_t num,
+			float3 const & apex, float3 const & direction, float cos_half_angle, float height);
+		// Signed distance from a plane to the nearest point of each box, or the view depth of the nearest
+		// corner with the z column of a view matrix as the plane. The plane doesn't need to be normalized.
+		void AABBPlaneDistance(float* out, AABBoxSoA const & boxes, size_t num, Plane const & plane);
+
+		// Converts floats to halves, with F16C on AVX2 and up. Rounds to nearest even, overflows to infinity
+		// and keeps denormals, bit-exact with half(float) on every instruction set.
+		void FloatToHalf(half* output, float const * input, size_t num);
+		// Converts halves to floats. Exact, including denormals.
+		void HalfToFloat(float* output, half const * input, size_t num);
+
+		// Simplex noise over SoA coordinates, 4, 8 or 16 points per iteration. The lattice points are hashed with
+		// integer arithmetic instead of the permutation table, so there is no gather. The pattern differs from
+		// MathLib::SimplexNoise, the range and the frequency are the same. In-place is allowed.
+		void SimplexNoise(float* out, float const * x, float const * y, size_t num);
+		void SimplexNoise(float* out, float const * x, float const * y, float const * z, size_t num);
+		void SimplexFBm(float* out, float const * x, float const * y, size_t num,
+			int octaves, float lacunarity = 2, float gain = 0.5f);
+		void SimplexFBm(float* out, float const * x, float const * y, float const * z, size_t num,
+			int octaves, float lacunarity = 2, float gain = 0.5f);
+		// The same blending as MathLib::SimplexNoise::tileable_fBm, wraps at (w, h).
+		void SimplexTileableFBm(float* out, float const * x, float const * y, size_t num, float w, float h,
+			int octaves, float lacunarity = 2, float gain = 0.5f);
+
+		// Fills a width x height image with 2D fBm, sampled at the texel centers offset by (offset_x, offset_y) texels.
+		// The image covers [0, frequency) of the noise in both directions, and wraps around if tileable. Rows are
+		// generated in tiles on the thread pool.
+		void SimplexFBmImage(float* out, uint32_t width, uint32_t height, float offset_x, float offset_y,
+			float frequency, bool tileable, int octaves, float lacunarity, float gain, thread_pool& tp);
+	}
+}
+
+#endif		// _KFL_SIMDBATCH_HPP
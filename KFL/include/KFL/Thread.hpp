@@ -627,9 +627,18 @@ namespace KlayGE
 			data_->num_max_cached_threads(num);
 		}
 
+		// True on a thread of any thread pool. A task waiting for other tasks of the pool should do their work
+		//  inline there, the pool could be busy with the tasks waiting.
+		static bool in_pool_thread();
+
 	private:
 		std::shared_ptr<thread_pool_common_data_t> data_;
 	};
+
+	// Splits [0, num) into tiles of tile_size and calls func(begin, end) on each of them. The calling thread and
+	// up to one thread per hardware thread from the pool pull tiles until all are done.
+	void parallel_for_tiles(thread_pool& tp, size_t num, size_t tile_size,
+		std::function<void(size_t, size_t)> const & func);
 }
 
 #endif		// _KFL_THREAD_HPP
@@ -122,6 +122,14 @@ namespace
 
 		// In EBX of type 7
 		CFM_AVX2		= 1UL << 5,
+		CFM_AVX512F		= 1UL << 16,
+
+		// In XCR0
+		XCR0_SSE		= 1UL << 1,		// XMM state
+		XCR0_AVX		= 1UL << 2,		// YMM state
+		XCR0_OPMASK		= 1UL << 5,		// AVX-512 opmask state
+		XCR0_ZMM_HI256	= 1UL << 6,		// Upper 256 bits of ZMM0-ZMM15
+		XCR0_HI16_ZMM	= 1UL << 7,		// ZMM16-ZMM31
 
 		// In EAX of type 4. Intel only.
 		CFM_NC_Intel                = 0xFC000000,
@@ -290,9 +298,10 @@ namespace
 			return edx_;
 		}
 
-		void Call(uint32_t fn)
+		void Call(uint32_t fn, uint32_t sub_fn = 0)
 		{
 			eax_ = fn;
+			ecx_ = sub_fn;
 			get_cpuid(&eax_, &ebx_, &ecx_, &edx_);
 		}
 
@@ -303,6 +312,27 @@ namespace
 		uint32_t edx_;
 	};
 
+	// Returns the low 32 bits of XCR0, the register states enabled by the OS.
+	uint32_t get_xcr0()
+	{
+#if defined(KLAYGE_COMPILER_MSVC)
+		return static_cast<uint32_t>(_xgetbv(0));
+#elif (defined(KLAYGE_COMPILER_GCC) || defined(KLAYGE_COMPILER_CLANG)) && !defined(KLAYGE_PLATFORM_IOS)
+		uint32_t xcr0_lo;
+		uint32_t xcr0_hi;
+		__asm__
+		(
+			"xgetbv"
+			: "=a" (xcr0_lo), "=d" (xcr0_hi)
+			: "c" (0)
+		);
+		KFL_UNUSED(xcr0_hi);
+		return xcr0_lo;
+#else
+		return 0;
+#endif
+	}
+
 	char const GenuineIntel[] = "GenuineIntel";
 	char const AuthenticAMD[] = "AuthenticAMD";
 #endif
@@ -334,10 +364,22 @@ namespace KlayGE
 		bool is_intel = (&GenuineIntel[0] == cpu_string_);
 		bool is_amd = (&AuthenticAMD[0] == cpu_string_);
 
+		// AVX and wider ISAs are usable only if the OS saves the extended registers on context switch
+		bool os_avx = false;
+		bool os_avx512 = false;
+
 		if (max_std_fn >= 1)
 		{
 			cpuid.Call(1);
 
+			if (cpuid.Ecx() & CFM_OSXSAVE)
+			{
+				uint32_t const xcr0 = get_xcr0();
+				os_avx = ((xcr0 & (XCR0_SSE | XCR0_AVX)) == (XCR0_SSE | XCR0_AVX));
+				os_avx512 = os_avx
+					&& ((xcr0 & (XCR0_OPMASK | XCR0_ZMM_HI256 | XCR0_HI16_ZMM)) == (XCR0_OPMASK | XCR0_ZMM_HI256 | XCR0_HI16_ZMM));
+			}
+
 			feature_mask_ |= cpuid.Edx() & CFM_MMX ? CF_MMX : 0;
 			feature_mask_ |= cpuid.Edx() & CFM_SSE ? CF_SSE : 0;
 			feature_mask_ |= cpuid.Edx() & CFM_SSE2 ? CF_SSE2 : 0;
@@ -346,18 +388,19 @@ namespace KlayGE
 			feature_mask_ |= cpuid.Ecx() & CFM_SSSE3 ? CF_SSSE3 : 0;
 			feature_mask_ |= cpuid.Ecx() & CFM_SSE41 ? CF_SSE41 : 0;
 			feature_mask_ |= cpuid.Ecx() & CFM_SSE42 ? CF_SSE42 : 0;
-			feature_mask_ |= (cpuid.Ecx() & CFM_OSXSAVE) && (cpuid.Ecx() & CFM_FMA3 ? CF_FMA3 : 0);
+			feature_mask_ |= os_avx && (cpuid.Ecx() & CFM_FMA3) ? CF_FMA3 : 0;
 			feature_mask_ |= cpuid.Ecx() & CFM_MOVBE ? CF_MOVBE : 0;
 			feature_mask_ |= cpuid.Ecx() & CFM_POPCNT ? CF_POPCNT : 0;
 			feature_mask_ |= cpuid.Ecx() & CFM_AES ? CF_AES : 0;
-			feature_mask_ |= (cpuid.Ecx() & CFM_OSXSAVE) && (cpuid.Ecx() & CFM_AVX) ? CF_AVX : 0;
-			feature_mask_ |= (cpuid.Ecx() & CFM_OSXSAVE) && (cpuid.Ecx() & CFM_F16C ? CF_F16C : 0);
+			feature_mask_ |= os_avx && (cpuid.Ecx() & CFM_AVX) ? CF_AVX : 0;
+			feature_mask_ |= os_avx && (cpuid.Ecx() & CFM_F16C) ? CF_F16C : 0;
 
 			if (max_std_fn >= 7)
 			{
-				cpuid.Call(7);
+				cpuid.Call(7, 0);
 
-				feature_mask_ |= cpuid.Ebx() & CFM_AVX2 ? CF_AVX2 : 0;
+				feature_mask_ |= os_avx && (cpuid.Ebx() & CFM_AVX2) ? CF_AVX2 : 0;
+				feature_mask_ |= os_avx512 && (cpuid.Ebx() & CFM_AVX512F) ? CF_AVX512F : 0;
 			}
 		}
 
@@ -375,7 +418,7 @@ namespace KlayGE
 					feature_mask_ |= cpuid.Ecx() & CFM_MisalignedSSE_AMD ? CF_MisalignedSSE : 0;
 				}
 				feature_mask_ |= cpuid.Edx() & CFM_X64 ? CF_X64 : 0;
-				feature_mask_ |= (cpuid.Ecx() & CFM_OSXSAVE) && (cpuid.Ecx() & CFM_FMA4 ? CF_FMA4 : 0);
+				feature_mask_ |= os_avx && (cpuid.Ecx() & CFM_FMA4) ? CF_FMA4 : 0;
 			}
 
 			if (max_ext_fn >= 0x80000004)
@@ -0,0 +1,181 @@
+/**
+ * @file RadixSort.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KFL, a subproject of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+
+#include <KFL/KFL.hpp>
+#include <KFL/Thread.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <KFL/RadixSort.hpp>
+
+namespace
+{
+	using namespace KlayGE;
+
+	uint32_t const RADIX_BITS = 8;
+	uint32_t const RADIX_SIZE = 1UL << RADIX_BITS;
+	uint32_t const NUM_PASSES = 64 / RADIX_BITS;
+
+	// Below this, splitting the passes costs more than it saves
+	size_t const MIN_ELEMENTS_PER_CHUNK = 16384;
+
+	uint32_t Digit(uint64_t key, uint32_t pass)
+	{
+		return static_cast<uint32_t>(key >> (pass * RADIX_BITS)) & (RADIX_SIZE - 1);
+	}
+
+	void RadixSortChunks(uint64_t* keys, uint32_t* values, size_t num, uint64_t* tmp_keys, uint32_t* tmp_values,
+		size_t num_chunks, thread_pool* tp)
+	{
+		if (num < 2)
+		{
+			return;
+		}
+
+		size_t const chunk_size = (num + num_chunks - 1) / num_chunks;
+		auto for_each_chunk = [tp, num, chunk_size](std::function<void(size_t, size_t)> const & func)
+			{
+				if (tp)
+				{
+					parallel_for_tiles(*tp, num, chunk_size, func);
+				}
+				else
+				{
+					func(0, num);
+				}
+			};
+
+		// The digit counts over all the keys decide the passes to skip
+		std::vector<uint32_t> chunk_hists(num_chunks * NUM_PASSES * RADIX_SIZE, 0);
+		for_each_chunk([keys, chunk_size, &chunk_hists](size_t begin, size_t end)
+			{
+				uint32_t* hist = &chunk_hists[begin / chunk_size * NUM_PASSES * RADIX_SIZE];
+				for (size_t i = begin; i < end; ++ i)
+				{
+					uint64_t const key = keys[i];
+					for (uint32_t pass = 0; pass < NUM_PASSES; ++ pass)
+					{
+						++ hist[pass * RADIX_SIZE + Digit(key, pass)];
+					}
+				}
+			});
+		std::vector<uint32_t> total_hist(chunk_hists.begin(), chunk_hists.begin() + NUM_PASSES * RADIX_SIZE);
+		for (size_t c = 1; c < num_chunks; ++ c)
+		{
+			for (uint32_t i = 0; i < NUM_PASSES * RADIX_SIZE; ++ i)
+			{
+				total_hist[i] += chunk_hists[c * NUM_PASSES * RADIX_SIZE + i];
+			}
+		}
+
+		std::vector<uint32_t> offsets(num_chunks * RADIX_SIZE);
+		uint64_t* src_keys = keys;
+		uint32_t* src_values = values;
+		uint64_t* dst_keys = tmp_keys;
+		uint32_t* dst_values = tmp_values;
+		for (uint32_t pass = 0; pass < NUM_PASSES; ++ pass)
+		{
+			uint32_t const * hist = &total_hist[pass * RADIX_SIZE];
+			if (std::find(hist, hist + RADIX_SIZE, static_cast<uint32_t>(num)) != hist + RADIX_SIZE)
+			{
+				continue;
+			}
+
+			std::fill(offsets.begin(), offsets.end(), 0);
+			for_each_chunk([src_keys, pass, chunk_size, &offsets](size_t begin, size_t end)
+				{
+					uint32_t* chunk_offsets = &offsets[begin / chunk_size * RADIX_SIZE];
+					for (size_t i = begin; i < end; ++ i)
+					{
+						++ chunk_offsets[Digit(src_keys[i], pass)];
+					}
+				});
+
+			// Digit major, chunk minor, so the order inside a digit is kept
+			uint32_t sum = 0;
+			for (uint32_t d = 0; d < RADIX_SIZE; ++ d)
+			{
+				for (size_t c = 0; c < num_chunks; ++ c)
+				{
+					uint32_t const count = offsets[c * RADIX_SIZE + d];
+					offsets[c * RADIX_SIZE + d] = sum;
+					sum += count;
+				}
+			}
+
+			for_each_chunk([src_keys, src_values, dst_keys, dst_values, pass, chunk_size, &offsets](size_t begin, size_t end)
+				{
+					uint32_t* chunk_offsets = &offsets[begin / chunk_size * RADIX_SIZE];
+					for (size_t i = begin; i < end; ++ i)
+					{
+						uint32_t const dst = chunk_offsets[Digit(src_keys[i], pass)] ++;
+						dst_keys[dst] = src_keys[i];
+						dst_values[dst] = src_values[i];
+					}
+				});
+
+			std::swap(src_keys, dst_keys);
+			std::swap(src_values, dst_values);
+		}
+
+		if (src_keys != keys)
+		{
+			memcpy(keys, src_keys, num * sizeof(keys[0]));
+			memcpy(values, src_values, num * sizeof(values[0]));
+		}
+	}
+}
+
+namespace KlayGE
+{
+	void RadixSort(uint64_t* keys, uint32_t* values, size_t num, uint64_t* tmp_keys, uint32_t* tmp_values)
+	{
+		RadixSortChunks(keys, values, num, tmp_keys, tmp_values, 1, nullptr);
+	}
+
+	void RadixSort(uint64_t* keys, uint32_t* values, size_t num, uint64_t* tmp_keys, uint32_t* tmp_values,
+		thread_pool& tp)
+	{
+		size_t const num_threads = std::max(std::thread::hardware_concurrency(), 1U);
+		size_t const num_chunks = std::min(num_threads, num / MIN_ELEMENTS_PER_CHUNK);
+		if (num_chunks > 1)
+		{
+			RadixSortChunks(keys, values, num, tmp_keys, tmp_values, num_chunks, &tp);
+		}
+		else
+		{
+			RadixSort(keys, values, num, tmp_keys, tmp_values);
+		}
+	}
+}
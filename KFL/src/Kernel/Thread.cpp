@@ -32,6 +32,14 @@
 
 #include <KFL/Thread.hpp>
 
+#include <algorithm>
+#include <atomic>
+
+namespace
+{
+	thread_local bool pool_thread = false;
+}
+
 namespace KlayGE
 {
 	thread_pool::thread_pool_join_info::thread_pool_join_info()
@@ -97,6 +105,8 @@ namespace KlayGE
 	//  in the pool, enqueues itself again in the queue.
 	void thread_pool::thread_pool_common_data_t::wait_function::operator()()
 	{
+		pool_thread = true;
+
 		for (;;)
 		{
 			{
@@ -248,4 +258,52 @@ namespace KlayGE
 	{
 		data_->kill_all();
 	}
+
+
+	bool thread_pool::in_pool_thread()
+	{
+		return pool_thread;
+	}
+
+	void parallel_for_tiles(thread_pool& tp, size_t num, size_t tile_size,
+		std::function<void(size_t, size_t)> const & func)
+	{
+		BOOST_ASSERT(tile_size > 0);
+
+		size_t const num_tiles = (num + tile_size - 1) / tile_size;
+		if (0 == num_tiles)
+		{
+			return;
+		}
+
+		std::atomic<size_t> next_tile(0);
+		auto worker = [num, tile_size, num_tiles, &next_tile, &func]()
+			{
+				for (;;)
+				{
+					size_t const tile = next_tile.fetch_add(1);
+					if (tile >= num_tiles)
+					{
+						break;
+					}
+
+					size_t const begin = tile * tile_size;
+					func(begin, std::min(begin + tile_size, num));
+				}
+			};
+
+		size_t const num_threads = std::max(std::thread::hardware_concurrency(), 1U);
+		std::vector<joiner<void>> joiners;
+		for (size_t i = 1; i < std::min(num_threads, num_tiles); ++ i)
+		{
+			joiners.push_back(tp(worker));
+		}
+
+		worker();
+
+		for (auto& j : joiners)
+		{
+			j();
+		}
+	}
 }
@@ -34,110 +34,78 @@
 
 namespace KlayGE
 {
+	// Rounds to nearest even, the same as F16C. So SIMDBatchLib::FloatToHalf gives the same bits on every instruction set.
 	half::half(float f) KLAYGE_NOEXCEPT
 	{
 		union FNI
 		{
 			float f;
-			int32_t i;
+			uint32_t u;
 		} fni;
 		fni.f = f;
-		int32_t i = fni.i;
 
-		int32_t s = (i >> 16) & 0x00008000;
-		int32_t e = ((i >> 23) & 0x000000FF) - (127 - 15);
-		int32_t m = i & 0x007FFFFF;
+		uint32_t const sign = fni.u & 0x80000000U;
+		fni.u ^= sign;
 
-		if (e <= 0)
+		uint32_t ret;
+		if (fni.u >= ((127 + 16) << 23))
 		{
-			if (e < -10)
-			{
-				value_ = 0;
-			}
-			else
-			{
-				m = (m | 0x00800000) >> (1 - e);
-
-				if (m &  0x00001000)
-				{
-					m += 0x00002000;
-				}
-
-				value_ = static_cast<uint16_t>(s | (m >> 13));
-			}
+			// Overflow to infinity. NaN -- becomes quiet, preserve the high significand bits
+			ret = (fni.u > 0x7F800000U) ? (0x7E00 | ((fni.u >> 13) & 0x03FF)) : 0x7C00;
+		}
+		else if (fni.u < ((127 - 14) << 23))
+		{
+			// Denormalized number or zero. Adding 0.5 aligns the 10 significand bits to the bottom,
+			// and the FPU rounds them to nearest even.
+			FNI magic;
+			magic.u = (127 - 1) << 23;
+			fni.f += magic.f;
+			ret = fni.u - magic.u;
 		}
 		else
 		{
-			if (0xFF - (127 - 15) == e)
-			{
-				e = 31;
-			}
-			else
-			{
-				if (m & 0x00001000)
-				{
-					m += 0x00002000;
-
-					if (m & 0x00800000)
-					{
-						m = 0;		// overflow in significand,
-						e += 1;		// adjust exponent
-					}
-				}
-			}
-
-			value_ = static_cast<uint16_t>(s | (e << 10) | (m >> 13));
+			// Normalized number. Rebias the exponent and round to nearest even. A carry out of the
+			// significand goes to the exponent, up to infinity.
+			uint32_t const mant_odd = (fni.u >> 13) & 1;
+			fni.u -= (127 - 15) << 23;
+			fni.u += 0x0FFF + mant_odd;
+			ret = fni.u >> 13;
 		}
+
+		value_ = static_cast<uint16_t>(ret | (sign >> 16));
 	}
 
 	half::operator float() const KLAYGE_NOEXCEPT
 	{
-		int32_t ret;
+		union INF
+		{
+			uint32_t u;
+			float f;
+		} inf;
 
-		int32_t s = ((value_ & 0x8000) >> 15) << 31;
-		int32_t e = (value_ & 0x7C00) >> 10;
-		int32_t m = value_ & 0x03FF;
+		inf.u = (value_ & 0x7FFFU) << 13;
+		uint32_t const e = inf.u & (0x1FU << 23);
+		inf.u += (127 - 15) << 23;
 
-		if (0 == e)
+		if ((0x1FU << 23) == e)
 		{
-			if (m != 0)
+			// Infinity or NaN
+			inf.u += (128 - 16) << 23;
+			if (inf.u & 0x007FFFFF)
 			{
-				// Denormalized number -- renormalize it
-
-				while (!(m & 0x00000400))
-				{
-					m <<= 1;
-					e -= 1;
-				}
-
-				e += 1;
-				m &= ~0x00000400;
+				inf.u |= 0x00400000;
 			}
 		}
-		else
+		else if (0 == e)
 		{
-			if (31 == e)
-			{
-				if (m != 0)
-				{
-					// Nan -- preserve sign and significand bits
-					e = 0xFF - (127 - 15);
-				}
-			}
+			// Denormalized number or zero -- renormalize it
+			INF magic;
+			magic.u = (127 - 14) << 23;
+			inf.u += 1 << 23;
+			inf.f -= magic.f;
 		}
 
-		// Normalized number
-		e += 127 - 15;
-		m <<= 13;
-
-		ret = s | (e << 23) | m;
-
-		union INF
-		{
-			int32_t i;
-			float f;
-		} inf;
-		inf.i = ret;
+		inf.u |= (value_ & 0x8000U) << 16;
 		return inf.f;
 	}
 
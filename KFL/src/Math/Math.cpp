@@ -33,10 +33,174 @@
 
 #include <KFL/Math.hpp>
 
+#if defined(KLAYGE_SSE_SUPPORT)
+#include <emmintrin.h>
+#define KLAYGE_MATH_FLOAT_SIMD
+#elif defined(KLAYGE_NEON_SUPPORT)
+#include <arm_neon.h>
+#define KLAYGE_MATH_FLOAT_SIMD
+#endif
+
+namespace
+{
+	using namespace KlayGE;
+
+	// Thin wrappers over 4-float registers, used by the float specializations of the hot
+	// matrix and (dual) quaternion functions. Quaternions are in xyzw layout.
+#if defined(KLAYGE_SSE_SUPPORT)
+	typedef __m128 Float4V;
+
+	inline Float4V LoadFloat4V(float const * p)
+	{
+		return _mm_loadu_ps(p);
+	}
+
+	inline void StoreFloat4V(float* p, Float4V v)
+	{
+		_mm_storeu_ps(p, v);
+	}
+
+	inline Float4V AddFloat4V(Float4V lhs, Float4V rhs)
+	{
+		return _mm_add_ps(lhs, rhs);
+	}
+
+	inline Float4V ScaleFloat4V(Float4V v, float s)
+	{
+		return _mm_mul_ps(v, _mm_set1_ps(s));
+	}
+
+	// Returns acc + v * s
+	inline Float4V MulAddFloat4V(Float4V acc, Float4V v, float s)
+	{
+		return _mm_add_ps(acc, _mm_mul_ps(v, _mm_set1_ps(s)));
+	}
+
+	inline float DotFloat4V(Float4V lhs, Float4V rhs)
+	{
+		Float4V v = _mm_mul_ps(lhs, rhs);
+		v = _mm_add_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+		v = _mm_add_ss(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+		return _mm_cvtss_f32(v);
+	}
+
+	inline Float4V ConjugateQuatV(Float4V q)
+	{
+		return _mm_mul_ps(q, _mm_set_ps(1, -1, -1, -1));
+	}
+
+	inline Float4V MulQuatV(Float4V lhs, Float4V rhs)
+	{
+		Float4V const wzyx = _mm_mul_ps(_mm_shuffle_ps(rhs, rhs, _MM_SHUFFLE(0, 1, 2, 3)), _mm_set_ps(-1, -1, 1, 1));
+		Float4V const zwxy = _mm_mul_ps(_mm_shuffle_ps(rhs, rhs, _MM_SHUFFLE(1, 0, 3, 2)), _mm_set_ps(-1, 1, 1, -1));
+		Float4V const yxwz = _mm_mul_ps(_mm_shuffle_ps(rhs, rhs, _MM_SHUFFLE(2, 3, 0, 1)), _mm_set_ps(-1, 1, -1, 1));
+
+		Float4V ret = _mm_mul_ps(_mm_shuffle_ps(lhs, lhs, _MM_SHUFFLE(3, 3, 3, 3)), rhs);
+		ret = _mm_add_ps(ret, _mm_mul_ps(_mm_shuffle_ps(lhs, lhs, _MM_SHUFFLE(0, 0, 0, 0)), wzyx));
+		ret = _mm_add_ps(ret, _mm_mul_ps(_mm_shuffle_ps(lhs, lhs, _MM_SHUFFLE(1, 1, 1, 1)), zwxy));
+		ret = _mm_add_ps(ret, _mm_mul_ps(_mm_shuffle_ps(lhs, lhs, _MM_SHUFFLE(2, 2, 2, 2)), yxwz));
+		return ret;
+	}
+#elif defined(KLAYGE_NEON_SUPPORT)
+	typedef float32x4_t Float4V;
+
+	inline Float4V LoadFloat4V(float const * p)
+	{
+		return vld1q_f32(p);
+	}
+
+	inline void StoreFloat4V(float* p, Float4V v)
+	{
+		vst1q_f32(p, v);
+	}
+
+	inline Float4V AddFloat4V(Float4V lhs, Float4V rhs)
+	{
+		return vaddq_f32(lhs, rhs);
+	}
+
+	inline Float4V ScaleFloat4V(Float4V v, float s)
+	{
+		return vmulq_n_f32(v, s);
+	}
+
+	inline Float4V MulAddFloat4V(Float4V acc, Float4V v, float s)
+	{
+		return vmlaq_n_f32(acc, v, s);
+	}
+
+	inline float DotFloat4V(Float4V lhs, Float4V rhs)
+	{
+		Float4V const v = vmulq_f32(lhs, rhs);
+		float32x2_t const r = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+		return vget_lane_f32(vpadd_f32(r, r), 0);
+	}
+
+	inline Float4V ConjugateQuatV(Float4V q)
+	{
+		float const sign[] = { -1, -1, -1, 1 };
+		return vmulq_f32(q, vld1q_f32(sign));
+	}
+
+	inline Float4V MulQuatV(Float4V lhs, Float4V rhs)
+	{
+		float const sign_wzyx[] = { 1, 1, -1, -1 };
+		float const sign_zwxy[] = { -1, 1, 1, -1 };
+		float const sign_yxwz[] = { 1, -1, 1, -1 };
+
+		Float4V const zwxy = vcombine_f32(vget_high_f32(rhs), vget_low_f32(rhs));
+		Float4V const wzyx = vrev64q_f32(zwxy);
+		Float4V const yxwz = vrev64q_f32(rhs);
+
+		Float4V ret = vmulq_n_f32(rhs, vgetq_lane_f32(lhs, 3));
+		ret = vmlaq_n_f32(ret, vmulq_f32(wzyx, vld1q_f32(sign_wzyx)), vgetq_lane_f32(lhs, 0));
+		ret = vmlaq_n_f32(ret, vmulq_f32(zwxy, vld1q_f32(sign_zwxy)), vgetq_lane_f32(lhs, 1));
+		ret = vmlaq_n_f32(ret, vmulq_f32(yxwz, vld1q_f32(sign_yxwz)), vgetq_lane_f32(lhs, 2));
+		return ret;
+	}
+#endif
+
+#ifdef KLAYGE_MATH_FLOAT_SIMD
+	inline Float4V LoadQuatV(Quaternion const & q)
+	{
+		return LoadFloat4V(&q[0]);
+	}
+
+	inline Quaternion StoreQuatV(Float4V v)
+	{
+		Quaternion ret;
+		StoreFloat4V(&ret[0], v);
+		return ret;
+	}
+#endif
+}
+
 namespace KlayGE
 {
 	namespace MathLib
 	{
+		// float specializations with SSE/NEON. They have to be declared before any use in this file.
+#ifdef KLAYGE_MATH_FLOAT_SIMD
+		template <>
+		float4x4 mul(float4x4 const & lhs, float4x4 const & rhs) KLAYGE_NOEXCEPT;
+		template <>
+		Quaternion mul(Quaternion const & lhs, Quaternion const & rhs) KLAYGE_NOEXCEPT;
+		template <>
+		Quaternion mul_real(Quaternion const & lhs_real, Quaternion const & rhs_real) KLAYGE_NOEXCEPT;
+		template <>
+		Quaternion mul_dual(Quaternion const & lhs_real, Quaternion const & lhs_dual,
+			Quaternion const & rhs_real, Quaternion const & rhs_dual) KLAYGE_NOEXCEPT;
+		template <>
+		std::pair<Quaternion, Quaternion> sclerp(Quaternion const & lhs_real, Quaternion const & lhs_dual,
+			Quaternion const & rhs_real, Quaternion const & rhs_dual, float s) KLAYGE_NOEXCEPT;
+#endif
+#if defined(KLAYGE_SSE_SUPPORT)
+		template <>
+		float4x4 to_matrix(Quaternion const & quat) KLAYGE_NOEXCEPT;
+		template <>
+		void decompose(float3& scale, Quaternion& rot, float3& trans, float4x4 const & rhs) KLAYGE_NOEXCEPT;
+#endif
+
 		template int1 abs(int1 const & x) KLAYGE_NOEXCEPT;
 		template int2 abs(int2 const & x) KLAYGE_NOEXCEPT;
 		template int3 abs(int3 const & x) KLAYGE_NOEXCEPT;
@@ -756,7 +920,29 @@ namespace KlayGE
 		// 4D Matrix
 		///////////////////////////////////////////////////////////////////////////////
 
+#ifdef KLAYGE_MATH_FLOAT_SIMD
+		template <>
+		float4x4 mul(float4x4 const & lhs, float4x4 const & rhs) KLAYGE_NOEXCEPT
+		{
+			Float4V const rhs_row0 = LoadFloat4V(&rhs(0, 0));
+			Float4V const rhs_row1 = LoadFloat4V(&rhs(1, 0));
+			Float4V const rhs_row2 = LoadFloat4V(&rhs(2, 0));
+			Float4V const rhs_row3 = LoadFloat4V(&rhs(3, 0));
+
+			float4x4 ret;
+			for (size_t i = 0; i < 4; ++ i)
+			{
+				Float4V row = ScaleFloat4V(rhs_row0, lhs(i, 0));
+				row = MulAddFloat4V(row, rhs_row1, lhs(i, 1));
+				row = MulAddFloat4V(row, rhs_row2, lhs(i, 2));
+				row = MulAddFloat4V(row, rhs_row3, lhs(i, 3));
+				StoreFloat4V(&ret(i, 0), row);
+			}
+			return ret;
+		}
+#else
 		template float4x4 mul(float4x4 const & lhs, float4x4 const & rhs) KLAYGE_NOEXCEPT;
+#endif
 
 		template <typename T>
 		Matrix4_T<T> mul(Matrix4_T<T> const & lhs, Matrix4_T<T> const & rhs) KLAYGE_NOEXCEPT
@@ -1109,7 +1295,46 @@ namespace KlayGE
 				P.d() * v.x(),		P.d() * v.y(),		P.d() * v.z(),		P.d() * v.w() + d);
 		}
 
+#if defined(KLAYGE_SSE_SUPPORT)
+		template <>
+		float4x4 to_matrix(Quaternion const & quat) KLAYGE_NOEXCEPT
+		{
+			__m128 const q = LoadQuatV(quat);
+			__m128 const q2 = _mm_add_ps(q, q);
+
+			// (1 - yy2 - zz2, 1 - xx2 - zz2, 1 - xx2 - yy2, 0)
+			__m128 const sq2 = _mm_mul_ps(q, q2);
+			__m128 diag = _mm_sub_ps(_mm_set_ps(0, 1, 1, 1), _mm_shuffle_ps(sq2, sq2, _MM_SHUFFLE(3, 0, 0, 1)));
+			diag = _mm_sub_ps(diag, _mm_shuffle_ps(sq2, sq2, _MM_SHUFFLE(3, 1, 2, 2)));
+			diag = _mm_and_ps(diag, _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1)));
+
+			// (xz2, xy2, yz2, *) +- (wy2, wz2, wx2, *)
+			__m128 const cross = _mm_mul_ps(_mm_shuffle_ps(q, q, _MM_SHUFFLE(3, 1, 0, 0)),
+				_mm_shuffle_ps(q2, q2, _MM_SHUFFLE(3, 2, 1, 2)));
+			__m128 const wq2 = _mm_mul_ps(_mm_shuffle_ps(q, q, _MM_SHUFFLE(3, 3, 3, 3)),
+				_mm_shuffle_ps(q2, q2, _MM_SHUFFLE(3, 0, 2, 1)));
+			__m128 const sum = _mm_add_ps(cross, wq2);
+			__m128 const dif = _mm_sub_ps(cross, wq2);
+
+			// (xy2 + wz2, xz2 - wy2, xy2 - wz2, yz2 + wx2)
+			__m128 t0 = _mm_shuffle_ps(sum, dif, _MM_SHUFFLE(1, 0, 2, 1));
+			t0 = _mm_shuffle_ps(t0, t0, _MM_SHUFFLE(1, 3, 2, 0));
+			// (xz2 + wy2, yz2 - wx2, xz2 + wy2, yz2 - wx2)
+			__m128 t1 = _mm_shuffle_ps(sum, dif, _MM_SHUFFLE(2, 2, 0, 0));
+			t1 = _mm_shuffle_ps(t1, t1, _MM_SHUFFLE(2, 0, 2, 0));
+
+			float4x4 ret;
+			__m128 row = _mm_shuffle_ps(diag, t0, _MM_SHUFFLE(1, 0, 3, 0));
+			_mm_storeu_ps(&ret(0, 0), _mm_shuffle_ps(row, row, _MM_SHUFFLE(1, 3, 2, 0)));
+			row = _mm_shuffle_ps(diag, t0, _MM_SHUFFLE(3, 2, 3, 1));
+			_mm_storeu_ps(&ret(1, 0), _mm_shuffle_ps(row, row, _MM_SHUFFLE(1, 3, 0, 2)));
+			_mm_storeu_ps(&ret(2, 0), _mm_shuffle_ps(t1, diag, _MM_SHUFFLE(3, 2, 1, 0)));
+			_mm_storeu_ps(&ret(3, 0), _mm_set_ps(1, 0, 0, 0));
+			return ret;
+		}
+#else
 		template float4x4 to_matrix(Quaternion const & quat) KLAYGE_NOEXCEPT;
+#endif
 
 		template <typename T>
 		Matrix4_T<T> to_matrix(Quaternion_T<T> const & quat) KLAYGE_NOEXCEPT
@@ -1175,7 +1400,39 @@ namespace KlayGE
 			return ret;
 		}
 
+#if defined(KLAYGE_SSE_SUPPORT)
+		template <>
+		void decompose(float3& scale, Quaternion& rot, float3& trans, float4x4 const & rhs) KLAYGE_NOEXCEPT
+		{
+			__m128 const row0 = _mm_loadu_ps(&rhs(0, 0));
+			__m128 const row1 = _mm_loadu_ps(&rhs(1, 0));
+			__m128 const row2 = _mm_loadu_ps(&rhs(2, 0));
+
+			// Lengths of the 3 axes in one register
+			__m128 sq0 = _mm_mul_ps(row0, row0);
+			__m128 sq1 = _mm_mul_ps(row1, row1);
+			__m128 sq2 = _mm_mul_ps(row2, row2);
+			__m128 sq3 = _mm_setzero_ps();
+			_MM_TRANSPOSE4_PS(sq0, sq1, sq2, sq3);
+			__m128 const scale_v = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(sq0, sq1), sq2));
+
+			float4 s;
+			_mm_storeu_ps(&s[0], scale_v);
+			scale = float3(s.x(), s.y(), s.z());
+
+			trans = float3(rhs(3, 0), rhs(3, 1), rhs(3, 2));
+
+			__m128 const mask_xyz = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+			float4x4 rot_mat;
+			_mm_storeu_ps(&rot_mat(0, 0), _mm_and_ps(_mm_div_ps(row0, _mm_shuffle_ps(scale_v, scale_v, _MM_SHUFFLE(0, 0, 0, 0))), mask_xyz));
+			_mm_storeu_ps(&rot_mat(1, 0), _mm_and_ps(_mm_div_ps(row1, _mm_shuffle_ps(scale_v, scale_v, _MM_SHUFFLE(1, 1, 1, 1))), mask_xyz));
+			_mm_storeu_ps(&rot_mat(2, 0), _mm_and_ps(_mm_div_ps(row2, _mm_shuffle_ps(scale_v, scale_v, _MM_SHUFFLE(2, 2, 2, 2))), mask_xyz));
+			_mm_storeu_ps(&rot_mat(3, 0), _mm_set_ps(1, 0, 0, 0));
+			rot = to_quaternion(rot_mat);
+		}
+#else
 		template void decompose(float3& scale, Quaternion& rot, float3& trans, float4x4 const & rhs) KLAYGE_NOEXCEPT;
+#endif
 
 		template <typename T>
 		void decompose(Vector_T<T, 3>& scale, Quaternion_T<T>& rot, Vector_T<T, 3>& trans, Matrix4_T<T> const & rhs) KLAYGE_NOEXCEPT
@@ -1430,7 +1687,15 @@ namespace KlayGE
 			return Quaternion(-rhs.x() * inv, -rhs.y() * inv, -rhs.z() * inv, rhs.w() * inv);
 		}
 
+#ifdef KLAYGE_MATH_FLOAT_SIMD
+		template <>
+		Quaternion mul(Quaternion const & lhs, Quaternion const & rhs) KLAYGE_NOEXCEPT
+		{
+			return StoreQuatV(MulQuatV(LoadQuatV(lhs), LoadQuatV(rhs)));
+		}
+#else
 		template Quaternion mul(Quaternion const & lhs, Quaternion const & rhs) KLAYGE_NOEXCEPT;
+#endif
 
 		template <typename T>
 		Quaternion_T<T> mul(Quaternion_T<T> const & lhs, Quaternion_T<T> const & rhs) KLAYGE_NOEXCEPT
@@ -3142,7 +3407,15 @@ namespace KlayGE
 			return std::make_pair(inv_sqr_len_0 * conj.first, inv_sqr_len_0 * conj.second + inv_sqr_len_e * conj.first);
 		}
 
+#ifdef KLAYGE_MATH_FLOAT_SIMD
+		template <>
+		Quaternion mul_real(Quaternion const & lhs_real, Quaternion const & rhs_real) KLAYGE_NOEXCEPT
+		{
+			return StoreQuatV(MulQuatV(LoadQuatV(lhs_real), LoadQuatV(rhs_real)));
+		}
+#else
 		template Quaternion mul_real(Quaternion const & lhs_real, Quaternion const & rhs_real) KLAYGE_NOEXCEPT;
+#endif
 
 		template <typename T>
 		Quaternion_T<T> mul_real(Quaternion_T<T> const & lhs_real, Quaternion_T<T> const & rhs_real) KLAYGE_NOEXCEPT
@@ -3150,8 +3423,18 @@ namespace KlayGE
 			return lhs_real * rhs_real;
 		}
 
+#ifdef KLAYGE_MATH_FLOAT_SIMD
+		template <>
+		Quaternion mul_dual(Quaternion const & lhs_real, Quaternion const & lhs_dual,
+			Quaternion const & rhs_real, Quaternion const & rhs_dual) KLAYGE_NOEXCEPT
+		{
+			return StoreQuatV(AddFloat4V(MulQuatV(LoadQuatV(lhs_real), LoadQuatV(rhs_dual)),
+				MulQuatV(LoadQuatV(lhs_dual), LoadQuatV(rhs_real))));
+		}
+#else
 		template Quaternion mul_dual(Quaternion const & lhs_real, Quaternion const & lhs_dual,
 			Quaternion const & rhs_real, Quaternion const & rhs_dual) KLAYGE_NOEXCEPT;
+#endif
 
 		template <typename T>
 		Quaternion_T<T> mul_dual(Quaternion_T<T> const & lhs_real, Quaternion_T<T> const & lhs_dual,
@@ -3224,8 +3507,52 @@ namespace KlayGE
 		}
 
 
+#ifdef KLAYGE_MATH_FLOAT_SIMD
+		template <>
+		std::pair<Quaternion, Quaternion> sclerp(Quaternion const & lhs_real, Quaternion const & lhs_dual,
+			Quaternion const & rhs_real, Quaternion const & rhs_dual, float s) KLAYGE_NOEXCEPT
+		{
+			Float4V const lr = LoadQuatV(lhs_real);
+			Float4V const ld = LoadQuatV(lhs_dual);
+			Float4V rr = LoadQuatV(rhs_real);
+			Float4V rd = LoadQuatV(rhs_dual);
+
+			// Make sure dot product is >= 0
+			if (DotFloat4V(lr, rr) < 0)
+			{
+				rr = ScaleFloat4V(rr, -1);
+				rd = ScaleFloat4V(rd, -1);
+			}
+
+			// Inverse of lhs
+			float const sqr_len_0 = DotFloat4V(lr, lr);
+			float const sqr_len_e = 2.0f * DotFloat4V(lr, ld);
+			float const inv_sqr_len_0 = 1.0f / sqr_len_0;
+			float const inv_sqr_len_e = -sqr_len_e / (sqr_len_0 * sqr_len_0);
+			Float4V const conj_r = ConjugateQuatV(lr);
+			Float4V const inv_r = ScaleFloat4V(conj_r, inv_sqr_len_0);
+			Float4V const inv_d = MulAddFloat4V(ScaleFloat4V(ConjugateQuatV(ld), inv_sqr_len_0), conj_r, inv_sqr_len_e);
+
+			Float4V const dif_d = AddFloat4V(MulQuatV(inv_r, rd), MulQuatV(inv_d, rr));
+			Float4V const dif_r = MulQuatV(inv_r, rr);
+
+			float angle, pitch;
+			float3 direction, moment;
+			udq_to_screw(angle, pitch, direction, moment, StoreQuatV(dif_r), StoreQuatV(dif_d));
+
+			angle *= s;
+			pitch *= s;
+			std::pair<Quaternion, Quaternion> const screw_dq = udq_from_screw(angle, pitch, direction, moment);
+			Float4V const sr = LoadQuatV(screw_dq.first);
+			Float4V const sd = LoadQuatV(screw_dq.second);
+
+			return std::make_pair(StoreQuatV(MulQuatV(lr, sr)),
+				StoreQuatV(AddFloat4V(MulQuatV(lr, sd), MulQuatV(ld, sr))));
+		}
+#else
 		template std::pair<Quaternion, Quaternion> sclerp(Quaternion const & lhs_real, Quaternion const & lhs_dual,
 			Quaternion const & rhs_real, Quaternion const & rhs_dual, float s) KLAYGE_NOEXCEPT;
+#endif
 
 		template <typename T>
 		std::pair<Quaternion_T<T>, Quaternion_T<T>> sclerp(Quaternion_T<T> const & lhs_real, Quaternion_T<T> const & lhs_dual,
@@ -0,0 +1,377 @@
+/**
+ * @file OcclusionBuffer.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KFL, a subproject of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+
+#include <KFL/KFL.hpp>
+#include <KFL/Thread.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <boost/assert.hpp>
+#if defined(KLAYGE_SSE2_SUPPORT)
+#include <emmintrin.h>
+#endif
+
+#include <KFL/OcclusionBuffer.hpp>
+
+namespace
+{
+	uint16_t const BOX_INDICES[] =
+	{
+		0, 1, 3, 0, 3, 2,
+		4, 6, 7, 4, 7, 5,
+		0, 4, 5, 0, 5, 1,
+		2, 3, 7, 2, 7, 6,
+		0, 2, 6, 0, 6, 4,
+		1, 5, 7, 1, 7, 3
+	};
+}
+
+namespace KlayGE
+{
+	OcclusionBuffer::OcclusionBuffer(uint32_t width, uint32_t height)
+	{
+		BOOST_ASSERT((width > 0) && (height > 0));
+
+		tiles_x_ = (width + TILE_WIDTH - 1) / TILE_WIDTH;
+		tiles_y_ = (height + TILE_HEIGHT - 1) / TILE_HEIGHT;
+		width_ = tiles_x_ * TILE_WIDTH;
+		height_ = tiles_y_ * TILE_HEIGHT;
+
+		depth_.resize(width_ * height_);
+		tile_max_depth_.resize(tiles_x_ * tiles_y_);
+		this->Clear();
+	}
+
+	void OcclusionBuffer::Clear()
+	{
+		std::fill(depth_.begin(), depth_.end(), 1.0f);
+		std::fill(tile_max_depth_.begin(), tile_max_depth_.end(), 1.0f);
+		tris_.clear();
+	}
+
+	void OcclusionBuffer::AddOccluder(float3 const * positions, uint32_t const * indices, uint32_t num_indices,
+		float4x4 const & mvp)
+	{
+		BOOST_ASSERT(num_indices % 3 == 0);
+
+		if (num_indices > 0)
+		{
+			uint32_t const num_vertices = *std::max_element(indices, indices + num_indices) + 1;
+			clip_pos_.resize(num_vertices);
+			for (uint32_t i = 0; i < num_vertices; ++ i)
+			{
+				clip_pos_[i] = MathLib::transform(positions[i], mvp);
+			}
+
+			for (uint32_t i = 0; i < num_indices; i += 3)
+			{
+				this->AddTriangle(clip_pos_[indices[i + 0]], clip_pos_[indices[i + 1]], clip_pos_[indices[i + 2]]);
+			}
+		}
+	}
+
+	void OcclusionBuffer::AddOccluder(AABBox const & aabb, float4x4 const & mvp)
+	{
+		float4 corners[8];
+		for (uint32_t i = 0; i < 8; ++ i)
+		{
+			corners[i] = MathLib::transform(aabb.Corner(i), mvp);
+		}
+
+		for (size_t i = 0; i < sizeof(BOX_INDICES) / sizeof(BOX_INDICES[0]); i += 3)
+		{
+			this->AddTriangle(corners[BOX_INDICES[i + 0]], corners[BOX_INDICES[i + 1]], corners[BOX_INDICES[i + 2]]);
+		}
+	}
+
+	void OcclusionBuffer::AddTriangle(float4 const & v0, float4 const & v1, float4 const & v2)
+	{
+		// Dropped instead of clipped. Leaving a hole is safe, making up an occluder is not.
+		if ((v0.z() < 0) || (v1.z() < 0) || (v2.z() < 0)
+			|| (v0.w() <= 0) || (v1.w() <= 0) || (v2.w() <= 0))
+		{
+			return;
+		}
+
+		float4 const * clip[] = { &v0, &v1, &v2 };
+		float sx[3];
+		float sy[3];
+		float sz[3];
+		for (int i = 0; i < 3; ++ i)
+		{
+			float const inv_w = 1 / clip[i]->w();
+			sx[i] = (clip[i]->x() * inv_w * 0.5f + 0.5f) * width_;
+			sy[i] = (0.5f - clip[i]->y() * inv_w * 0.5f) * height_;
+			sz[i] = clip[i]->z() * inv_w;
+		}
+
+		float area = (sx[1] - sx[0]) * (sy[2] - sy[0]) - (sx[2] - sx[0]) * (sy[1] - sy[0]);
+		if (std::abs(area) < 1e-6f)
+		{
+			return;
+		}
+		if (area < 0)
+		{
+			// Both faces are drawn, so flip the back faces to get positive edge functions
+			std::swap(sx[1], sx[2]);
+			std::swap(sy[1], sy[2]);
+			std::swap(sz[1], sz[2]);
+			area = -area;
+		}
+
+		Triangle tri;
+
+		float const min_sx = std::min(std::min(sx[0], sx[1]), sx[2]);
+		float const max_sx = std::max(std::max(sx[0], sx[1]), sx[2]);
+		float const min_sy = std::min(std::min(sy[0], sy[1]), sy[2]);
+		float const max_sy = std::max(std::max(sy[0], sy[1]), sy[2]);
+		// The pixels whose centers are in the bounding box
+		tri.min_x = std::max(static_cast<int32_t>(std::ceil(min_sx - 0.5f)), 0);
+		tri.min_y = std::max(static_cast<int32_t>(std::ceil(min_sy - 0.5f)), 0);
+		tri.max_x = std::min(static_cast<int32_t>(std::floor(max_sx - 0.5f)), static_cast<int32_t>(width_) - 1);
+		tri.max_y = std::min(static_cast<int32_t>(std::floor(max_sy - 0.5f)), static_cast<int32_t>(height_) - 1);
+		if ((tri.min_x > tri.max_x) || (tri.min_y > tri.max_y))
+		{
+			return;
+		}
+
+		for (int i = 0; i < 3; ++ i)
+		{
+			int const j = (i + 1) % 3;
+			tri.a[i] = sy[i] - sy[j];
+			tri.b[i] = sx[j] - sx[i];
+			tri.c[i] = -(tri.a[i] * sx[i] + tri.b[i] * sy[i]);
+		}
+
+		float const inv_area = 1 / area;
+		tri.dzdx = ((sz[1] - sz[0]) * (sy[2] - sy[0]) - (sz[2] - sz[0]) * (sy[1] - sy[0])) * inv_area;
+		tri.dzdy = ((sz[2] - sz[0]) * (sx[1] - sx[0]) - (sz[1] - sz[0]) * (sx[2] - sx[0])) * inv_area;
+		tri.z0 = sz[0] - tri.dzdx * sx[0] - tri.dzdy * sy[0];
+		tri.min_z = std::min(std::min(sz[0], sz[1]), sz[2]);
+
+		tris_.push_back(tri);
+	}
+
+	void OcclusionBuffer::Rasterize()
+	{
+		this->RasterizeTileRows(0, tiles_y_);
+	}
+
+	void OcclusionBuffer::Rasterize(thread_pool& tp)
+	{
+		parallel_for_tiles(tp, tiles_y_, 1,
+			[this](size_t begin, size_t end)
+			{
+				this->RasterizeTileRows(static_cast<uint32_t>(begin), static_cast<uint32_t>(end));
+			});
+	}
+
+	void OcclusionBuffer::RasterizeTileRows(uint32_t begin_row, uint32_t end_row)
+	{
+		for (auto const & tri : tris_)
+		{
+			uint32_t const tile_y_begin = std::max(static_cast<uint32_t>(tri.min_y) / TILE_HEIGHT, begin_row);
+			uint32_t const tile_y_end = std::min(static_cast<uint32_t>(tri.max_y) / TILE_HEIGHT + 1, end_row);
+			uint32_t const tile_x_begin = static_cast<uint32_t>(tri.min_x) / TILE_WIDTH;
+			uint32_t const tile_x_end = static_cast<uint32_t>(tri.max_x) / TILE_WIDTH + 1;
+			for (uint32_t ty = tile_y_begin; ty < tile_y_end; ++ ty)
+			{
+				for (uint32_t tx = tile_x_begin; tx < tile_x_end; ++ tx)
+				{
+					this->RasterizeTriangle(tri, tx, ty);
+				}
+			}
+		}
+	}
+
+	void OcclusionBuffer::RasterizeTriangle(Triangle const & tri, uint32_t tile_x, uint32_t tile_y)
+	{
+		uint32_t const tile = tile_y * tiles_x_ + tile_x;
+		if (tri.min_z >= tile_max_depth_[tile])
+		{
+			// Behind every pixel of the tile
+			return;
+		}
+
+		float* depth = &depth_[tile * TILE_WIDTH * TILE_HEIGHT];
+		float const x0 = tile_x * TILE_WIDTH + 0.5f;
+		float const y0 = tile_y * TILE_HEIGHT + 0.5f;
+
+#if defined(KLAYGE_SSE2_SUPPORT)
+		__m128 const zero = _mm_setzero_ps();
+		__m128 a[3];
+		__m128 b[3];
+		__m128 c[3];
+		for (int i = 0; i < 3; ++ i)
+		{
+			a[i] = _mm_set1_ps(tri.a[i]);
+			b[i] = _mm_set1_ps(tri.b[i]);
+			c[i] = _mm_set1_ps(tri.c[i]);
+		}
+		__m128 const z0 = _mm_set1_ps(tri.z0);
+		__m128 const dzdx = _mm_set1_ps(tri.dzdx);
+		__m128 const dzdy = _mm_set1_ps(tri.dzdy);
+
+		__m128 const xs[] = { _mm_setr_ps(x0 + 0, x0 + 1, x0 + 2, x0 + 3), _mm_setr_ps(x0 + 4, x0 + 5, x0 + 6, x0 + 7) };
+		__m128 max_depth = zero;
+		for (uint32_t row = 0; row < TILE_HEIGHT; ++ row)
+		{
+			__m128 const y = _mm_set1_ps(y0 + row);
+			for (int half = 0; half < 2; ++ half)
+			{
+				__m128 const x = xs[half];
+
+				// Coverage mask of 4 pixels
+				__m128 mask = _mm_cmpge_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(a[0], x), _mm_mul_ps(b[0], y)), c[0]), zero);
+				mask = _mm_and_ps(mask,
+					_mm_cmpge_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(a[1], x), _mm_mul_ps(b[1], y)), c[1]), zero));
+				mask = _mm_and_ps(mask,
+					_mm_cmpge_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(a[2], x), _mm_mul_ps(b[2], y)), c[2]), zero));
+
+				float* p = depth + row * TILE_WIDTH + half * 4;
+				__m128 d = _mm_loadu_ps(p);
+				if (_mm_movemask_ps(mask) != 0)
+				{
+					__m128 const z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dzdx, x), _mm_mul_ps(dzdy, y)), z0);
+					d = _mm_or_ps(_mm_and_ps(mask, _mm_min_ps(d, z)), _mm_andnot_ps(mask, d));
+					_mm_storeu_ps(p, d);
+				}
+				max_depth = _mm_max_ps(max_depth, d);
+			}
+		}
+
+		max_depth = _mm_max_ps(max_depth, _mm_shuffle_ps(max_depth, max_depth, _MM_SHUFFLE(1, 0, 3, 2)));
+		max_depth = _mm_max_ps(max_depth, _mm_shuffle_ps(max_depth, max_depth, _MM_SHUFFLE(2, 3, 0, 1)));
+		tile_max_depth_[tile] = _mm_cvtss_f32(max_depth);
+#else
+		float max_depth = 0;
+		for (uint32_t row = 0; row < TILE_HEIGHT; ++ row)
+		{
+			float const y = y0 + row;
+			for (uint32_t col = 0; col < TILE_WIDTH; ++ col)
+			{
+				float const x = x0 + col;
+				float& d = depth[row * TILE_WIDTH + col];
+				if ((tri.a[0] * x + tri.b[0] * y + tri.c[0] >= 0)
+					&& (tri.a[1] * x + tri.b[1] * y + tri.c[1] >= 0)
+					&& (tri.a[2] * x + tri.b[2] * y + tri.c[2] >= 0))
+				{
+					d = std::min(d, tri.dzdx * x + tri.dzdy * y + tri.z0);
+				}
+				max_depth = std::max(max_depth, d);
+			}
+		}
+		tile_max_depth_[tile] = max_depth;
+#endif
+	}
+
+	bool OcclusionBuffer::IsVisible(AABBox const & aabb, float4x4 const & view_proj) const
+	{
+		float min_sx = std::numeric_limits<float>::max();
+		float max_sx = -std::numeric_limits<float>::max();
+		float min_sy = std::numeric_limits<float>::max();
+		float max_sy = -std::numeric_limits<float>::max();
+		float min_sz = std::numeric_limits<float>::max();
+		for (uint32_t i = 0; i < 8; ++ i)
+		{
+			float4 const p = MathLib::transform(aabb.Corner(i), view_proj);
+			if ((p.z() < 0) || (p.w() <= 0))
+			{
+				return true;
+			}
+
+			float const inv_w = 1 / p.w();
+			float const sx = (p.x() * inv_w * 0.5f + 0.5f) * width_;
+			float const sy = (0.5f - p.y() * inv_w * 0.5f) * height_;
+			min_sx = std::min(min_sx, sx);
+			max_sx = std::max(max_sx, sx);
+			min_sy = std::min(min_sy, sy);
+			max_sy = std::max(max_sy, sy);
+			min_sz = std::min(min_sz, p.z() * inv_w);
+		}
+
+		// Every pixel the box touches
+		int32_t const x_begin = std::max(static_cast<int32_t>(std::floor(min_sx)), 0);
+		int32_t const y_begin = std::max(static_cast<int32_t>(std::floor(min_sy)), 0);
+		int32_t const x_end = std::min(static_cast<int32_t>(std::floor(max_sx)) + 1, static_cast<int32_t>(width_));
+		int32_t const y_end = std::min(static_cast<int32_t>(std::floor(max_sy)) + 1, static_cast<int32_t>(height_));
+		if ((x_begin >= x_end) || (y_begin >= y_end))
+		{
+			// Out of the screen. Leave it to the frustum culling.
+			return true;
+		}
+
+		for (uint32_t ty = y_begin / TILE_HEIGHT; ty <= (y_end - 1) / TILE_HEIGHT; ++ ty)
+		{
+			for (uint32_t tx = x_begin / TILE_WIDTH; tx <= (x_end - 1) / TILE_WIDTH; ++ tx)
+			{
+				uint32_t const tile = ty * tiles_x_ + tx;
+				if (min_sz <= tile_max_depth_[tile])
+				{
+					uint32_t const px_begin = std::max<uint32_t>(x_begin, tx * TILE_WIDTH);
+					uint32_t const px_end = std::min<uint32_t>(x_end, (tx + 1) * TILE_WIDTH);
+					uint32_t const py_begin = std::max<uint32_t>(y_begin, ty * TILE_HEIGHT);
+					uint32_t const py_end = std::min<uint32_t>(y_end, (ty + 1) * TILE_HEIGHT);
+					if ((px_end - px_begin == TILE_WIDTH) && (py_end - py_begin == TILE_HEIGHT))
+					{
+						// The farthest pixel of the tile is in the box
+						return true;
+					}
+
+					float const * depth = &depth_[tile * TILE_WIDTH * TILE_HEIGHT];
+					for (uint32_t y = py_begin; y < py_end; ++ y)
+					{
+						for (uint32_t x = px_begin; x < px_end; ++ x)
+						{
+							if (min_sz <= depth[(y - ty * TILE_HEIGHT) * TILE_WIDTH + (x - tx * TILE_WIDTH)])
+							{
+								return true;
+							}
+						}
+					}
+				}
+			}
+		}
+
+		return false;
+	}
+
+	float OcclusionBuffer::Depth(uint32_t x, uint32_t y) const
+	{
+		BOOST_ASSERT((x < width_) && (y < height_));
+
+		uint32_t const tx = x / TILE_WIDTH;
+		uint32_t const ty = y / TILE_HEIGHT;
+		return depth_[(ty * tiles_x_ + tx) * TILE_WIDTH * TILE_HEIGHT
+			+ (y - ty * TILE_HEIGHT) * TILE_WIDTH + (x - tx * TILE_WIDTH)];
+	}
+}
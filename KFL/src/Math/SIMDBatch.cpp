@@ -0,0 +1,745 @@
+/**
+ * @file SIMDBatch.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KFL, a subproject of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KFL/KFL.hpp>
+#include <KFL/CpuInfo.hpp>
+
+#include <atomic>
+#if defined(KLAYGE_CPU_X86) || defined(KLAYGE_CPU_X64)
+#include <immintrin.h>
+#endif
+
+#include <KFL/SIMDBatch.hpp>
+
+namespace
+{
+	using namespace KlayGE;
+
+	SIMDInstructionSet DetectInstructionSet()
+	{
+		SIMDInstructionSet ret = SIMDIS_Scalar;
+#if defined(KLAYGE_SSE2_SUPPORT)
+		ret = SIMDIS_SSE2;
+#endif
+
+#if defined(KLAYGE_DISPATCH_AVX2_SUPPORT) || defined(KLAYGE_DISPATCH_AVX512_SUPPORT)
+		CPUInfo cpu;
+#endif
+#ifdef KLAYGE_DISPATCH_AVX2_SUPPORT
+		if (cpu.IsFeatureSupport(CPUInfo::CF_AVX2) && cpu.IsFeatureSupport(CPUInfo::CF_FMA3)
+			&& cpu.IsFeatureSupport(CPUInfo::CF_F16C))
+		{
+			ret = SIMDIS_AVX2;
+		}
+#endif
+#ifdef KLAYGE_DISPATCH_AVX512_SUPPORT
+		if ((SIMDIS_AVX2 == ret) && cpu.IsFeatureSupport(CPUInfo::CF_AVX512F))
+		{
+			ret = SIMDIS_AVX512;
+		}
+#endif
+
+		return ret;
+	}
+
+	std::atomic<int>& ActiveInstructionSetStorage()
+	{
+		static std::atomic<int> active(SIMDBatchLib::MaxInstructionSet());
+		return active;
+	}
+
+
+	// TransformCoords
+	///////////////////////////////////////////////////////////////////////////////
+	void TransformCoordsScalar(float* out_x, float* out_y, float* out_z,
+		float const * x, float const * y, float const * z, size_t num, float const * m)
+	{
+		for (size_t i = 0; i < num; ++ i)
+		{
+			float const vx = x[i];
+			float const vy = y[i];
+			float const vz = z[i];
+			float const rx = vx * m[0] + vy * m[4] + vz * m[8] + m[12];
+			float const ry = vx * m[1] + vy * m[5] + vz * m[9] + m[13];
+			float const rz = vx * m[2] + vy * m[6] + vz * m[10] + m[14];
+			float const rw = vx * m[3] + vy * m[7] + vz * m[11] + m[15];
+			float const inv_w = 1 / rw;
+			out_x[i] = rx * inv_w;
+			out_y[i] = ry * inv_w;
+			out_z[i] = rz * inv_w;
+		}
+	}
+
+#if defined(KLAYGE_SSE2_SUPPORT)
+	void TransformCoordsSSE2(float* out_x, float* out_y, float* out_z,
+		float const * x, float const * y, float const * z, size_t num, float const * m)
+	{
+		__m128 mv[16];
+		for (int i = 0; i < 16; ++ i)
+		{
+			mv[i] = _mm_set1_ps(m[i]);
+		}
+
+		size_t const num_vec = num & ~static_cast<size_t>(3);
+		for (size_t i = 0; i < num_vec; i += 4)
+		{
+			__m128 const vx = _mm_loadu_ps(x + i);
+			__m128 const vy = _mm_loadu_ps(y + i);
+			__m128 const vz = _mm_loadu_ps(z + i);
+			__m128 const rx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, mv[0]), _mm_mul_ps(vy, mv[4])),
+				_mm_add_ps(_mm_mul_ps(vz, mv[8]), mv[12]));
+			__m128 const ry = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, mv[1]), _mm_mul_ps(vy, mv[5])),
+				_mm_add_ps(_mm_mul_ps(vz, mv[9]), mv[13]));
+			__m128 const rz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, mv[2]), _mm_mul_ps(vy, mv[6])),
+				_mm_add_ps(_mm_mul_ps(vz, mv[10]), mv[14]));
+			__m128 const rw = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, mv[3]), _mm_mul_ps(vy, mv[7])),
+				_mm_add_ps(_mm_mul_ps(vz, mv[11]), mv[15]));
+			_mm_storeu_ps(out_x + i, _mm_div_ps(rx, rw));
+			_mm_storeu_ps(out_y + i, _mm_div_ps(ry, rw));
+			_mm_storeu_ps(out_z + i, _mm_div_ps(rz, rw));
+		}
+
+		TransformCoordsScalar(out_x + num_vec, out_y + num_vec, out_z + num_vec,
+			x + num_vec, y + num_vec, z + num_vec, num - num_vec, m);
+	}
+#endif
+
+#ifdef KLAYGE_DISPATCH_AVX2_SUPPORT
+	KLAYGE_TARGET_AVX2 void TransformCoordsAVX2(float* out_x, float* out_y, float* out_z,
+		float const * x, float const * y, float const * z, size_t num, float const * m)
+	{
+		__m256 mv[16];
+		for (int i = 0; i < 16; ++ i)
+		{
+			mv[i] = _mm256_set1_ps(m[i]);
+		}
+
+		size_t const num_vec = num & ~static_cast<size_t>(7);
+		for (size_t i = 0; i < num_vec; i += 8)
+		{
+			__m256 const vx = _mm256_loadu_ps(x + i);
+			__m256 const vy = _mm256_loadu_ps(y + i);
+			__m256 const vz = _mm256_loadu_ps(z + i);
+			__m256 const rx = _mm256_fmadd_ps(vx, mv[0], _mm256_fmadd_ps(vy, mv[4], _mm256_fmadd_ps(vz, mv[8], mv[12])));
+			__m256 const ry = _mm256_fmadd_ps(vx, mv[1], _mm256_fmadd_ps(vy, mv[5], _mm256_fmadd_ps(vz, mv[9], mv[13])));
+			__m256 const rz = _mm256_fmadd_ps(vx, mv[2], _mm256_fmadd_ps(vy, mv[6], _mm256_fmadd_ps(vz, mv[10], mv[14])));
+			__m256 const rw = _mm256_fmadd_ps(vx, mv[3], _mm256_fmadd_ps(vy, mv[7], _mm256_fmadd_ps(vz, mv[11], mv[15])));
+			_mm256_storeu_ps(out_x + i, _mm256_div_ps(rx, rw));
+			_mm256_storeu_ps(out_y + i, _mm256_div_ps(ry, rw));
+			_mm256_storeu_ps(out_z + i, _mm256_div_ps(rz, rw));
+		}
+
+		TransformCoordsScalar(out_x + num_vec, out_y + num_vec, out_z + num_vec,
+			x + num_vec, y + num_vec, z + num_vec, num - num_vec, m);
+	}
+#endif
+
+#ifdef KLAYGE_DISPATCH_AVX512_SUPPORT
+	KLAYGE_TARGET_AVX512 void TransformCoordsAVX512(float* out_x, float* out_y, float* out_z,
+		float const * x, float const * y, float const * z, size_t num, float const * m)
+	{
+		__m512 mv[16];
+		for (int i = 0; i < 16; ++ i)
+		{
+			mv[i] = _mm512_set1_ps(m[i]);
+		}
+
+		// The tail is handled by masked loads and stores instead of a scalar loop
+		for (size_t i = 0; i < num; i += 16)
+		{
+			size_t const rest = num - i;
+			__mmask16 const mask = (rest >= 16) ? static_cast<__mmask16>(0xFFFF)
+				: static_cast<__mmask16>((1U << rest) - 1);
+
+			__m512 const vx = _mm512_maskz_loadu_ps(mask, x + i);
+			__m512 const vy = _mm512_maskz_loadu_ps(mask, y + i);
+			__m512 const vz = _mm512_maskz_loadu_ps(mask, z + i);
+			__m512 const rx = _mm512_fmadd_ps(vx, mv[0], _mm512_fmadd_ps(vy, mv[4], _mm512_fmadd_ps(vz, mv[8], mv[12])));
+			__m512 const ry = _mm512_fmadd_ps(vx, mv[1], _mm512_fmadd_ps(vy, mv[5], _mm512_fmadd_ps(vz, mv[9], mv[13])));
+			__m512 const rz = _mm512_fmadd_ps(vx, mv[2], _mm512_fmadd_ps(vy, mv[6], _mm512_fmadd_ps(vz, mv[10], mv[14])));
+			__m512 const rw = _mm512_fmadd_ps(vx, mv[3], _mm512_fmadd_ps(vy, mv[7], _mm512_fmadd_ps(vz, mv[11], mv[15])));
+			_mm512_mask_storeu_ps(out_x + i, mask, _mm512_div_ps(rx, rw));
+			_mm512_mask_storeu_ps(out_y + i, mask, _mm512_div_ps(ry, rw));
+			_mm512_mask_storeu_ps(out_z + i, mask, _mm512_div_ps(rz, rw));
+		}
+	}
+#endif
+
+
+	// TransformNormals
+	///////////////////////////////////////////////////////////////////////////////
+	void TransformNormalsScalar(float* out_x, float* out_y, float* out_z,
+		float const * x, float const * y, float const * z, size_t num, float const * m)
+	{
+		for (size_t i = 0; i < num; ++ i)
+		{
+			float const vx = x[i];
+			float const vy = y[i];
+			float const vz = z[i];
+			out_x[i] = vx * m[0] + vy * m[4] + vz * m[8];
+			out_y[i] = vx * m[1] + vy * m[5] + vz * m[9];
+			out_z[i] = vx * m[2] + vy * m[6] + vz * m[10];
+		}
+	}
+
+#if defined(KLAYGE_SSE2_SUPPORT)
+	void TransformNormalsSSE2(float* out_x, float* out_y, float* out_z,
+		float const * x, float const * y, float const * z, size_t num, float const * m)
+	{
+		__m128 const m0 = _mm_set1_ps(m[0]);
+		__m128 const m1 = _mm_set1_ps(m[1]);
+		__m128 const m2 = _mm_set1_ps(m[2]);
+		__m128 const m4 = _mm_set1_ps(m[4]);
+		__m128 const m5 = _mm_set1_ps(m[5]);
+		__m128 const m6 = _mm_set1_ps(m[6]);
+		__m128 const m8 = _mm_set1_ps(m[8]);
+		__m128 const m9 = _mm_set1_ps(m[9]);
+		__m128 const m10 = _mm_set1_ps(m[10]);
+
+		size_t const num_vec = num & ~static_cast<size_t>(3);
+		for (size_t i = 0; i < num_vec; i += 4)
+		{
+			__m128 const vx = _mm_loadu_ps(x + i);
+			__m128 const vy = _mm_loadu_ps(y + i);
+			__m128 const vz = _mm_loadu_ps(z + i);
+			_mm_storeu_ps(out_x + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, m0), _mm_mul_ps(vy, m4)), _mm_mul_ps(vz, m8)));
+			_mm_storeu_ps(out_y + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, m1), _mm_mul_ps(vy, m5)), _mm_mul_ps(vz, m9)));
+			_mm_storeu_ps(out_z + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, m2), _mm_mul_ps(vy, m6)), _mm_mul_ps(vz, m10)));
+		}
+
+		TransformNormalsScalar(out_x + num_vec, out_y + num_vec, out_z + num_vec,
+			x + num_vec, y + num_vec, z + num_vec, num - num_vec, m);
+	}
+#endif
+
+#ifdef KLAYGE_DISPATCH_AVX2_SUPPORT
+	KLAYGE_TARGET_AVX2 void TransformNormalsAVX2(float* out_x, float* out_y, float* out_z,
+		float const * x, float const * y, float const * z, size_t num, float const * m)
+	{
+		__m256 const m0 = _mm256_set1_ps(m[0]);
+		__m256 const m1 = _mm256_set1_ps(m[1]);
+		__m256 const m2 = _mm256_set1_ps(m[2]);
+		__m256 const m4 = _mm256_set1_ps(m[4]);
+		__m256 const m5 = _mm256_set1_ps(m[5]);
+		__m256 const m6 = _mm256_set1_ps(m[6]);
+		__m256 const m8 = _mm256_set1_ps(m[8]);
+		__m256 const m9 = _mm256_set1_ps(m[9]);
+		__m256 const m10 = _mm256_set1_ps(m[10]);
+
+		size_t const num_vec = num & ~static_cast<size_t>(7);
+		for (size_t i = 0; i < num_vec; i += 8)
+		{
+			__m256 const vx = _mm256_loadu_ps(x + i);
+			__m256 const vy = _mm256_loadu_ps(y + i);
+			__m256 const vz = _mm256_loadu_ps(z + i);
+			_mm256_storeu_ps(out_x + i, _mm256_fmadd_ps(vx, m0, _mm256_fmadd_ps(vy, m4, _mm256_mul_ps(vz, m8))));
+			_mm256_storeu_ps(out_y + i, _mm256_fmadd_ps(vx, m1, _mm256_fmadd_ps(vy, m5, _mm256_mul_ps(vz, m9))));
+			_mm256_storeu_ps(out_z + i, _mm256_fmadd_ps(vx, m2, _mm256_fmadd_ps(vy, m6, _mm256_mul_ps(vz, m10))));
+		}
+
+		TransformNormalsScalar(out_x + num_vec, out_y + num_vec, out_z + num_vec,
+			x + num_vec, y + num_vec, z + num_vec, num - num_vec, m);
+	}
+#endif
+
+#ifdef KLAYGE_DISPATCH_AVX512_SUPPORT
+	KLAYGE_TARGET_AVX512 void TransformNormalsAVX512(float* out_x, float* out_y, float* out_z,
+		float const * x, float const * y, float const * z, size_t num, float const * m)
+	{
+		__m512 const m0 = _mm512_set1_ps(m[0]);
+		__m512 const m1 = _mm512_set1_ps(m[1]);
+		__m512 const m2 = _mm512_set1_ps(m[2]);
+		__m512 const m4 = _mm512_set1_ps(m[4]);
+		__m512 const m5 = _mm512_set1_ps(m[5]);
+		__m512 const m6 = _mm512_set1_ps(m[6]);
+		__m512 const m8 = _mm512_set1_ps(m[8]);
+		__m512 const m9 = _mm512_set1_ps(m[9]);
+		__m512 const m10 = _mm512_set1_ps(m[10]);
+
+		for (size_t i = 0; i < num; i += 16)
+		{
+			size_t const rest = num - i;
+			__mmask16 const mask = (rest >= 16) ? static_cast<__mmask16>(0xFFFF)
+				: static_cast<__mmask16>((1U << rest) - 1);
+
+			__m512 const vx = _mm512_maskz_loadu_ps(mask, x + i);
+			__m512 const vy = _mm512_maskz_loadu_ps(mask, y + i);
+			__m512 const vz = _mm512_maskz_loadu_ps(mask, z + i);
+			_mm512_mask_storeu_ps(out_x + i, mask, _mm512_fmadd_ps(vx, m0, _mm512_fmadd_ps(vy, m4, _mm512_mul_ps(vz, m8))));
+			_mm512_mask_storeu_ps(out_y + i, mask, _mm512_fmadd_ps(vx, m1, _mm512_fmadd_ps(vy, m5, _mm512_mul_ps(vz, m9))));
+			_mm512_mask_storeu_ps(out_z + i, mask, _mm512_fmadd_ps(vx, m2, _mm512_fmadd_ps(vy, m6, _mm512_mul_ps(vz, m10))));
+		}
+	}
+#endif
+
+
+	// ComputeBounds
+	///////////////////////////////////////////////////////////////////////////////
+	void ComputeBoundsScalar(float* min_pt, float* max_pt,
+		float const * x, float const * y, float const * z, size_t num)
+	{
+		for (size_t i = 0; i < num; ++ i)
+		{
+			min_pt[0] = std::min(min_pt[0], x[i]);
+			min_pt[1] = std::min(min_pt[1], y[i]);
+			min_pt[2] = std::min(min_pt[2], z[i]);
+			max_pt[0] = std::max(max_pt[0], x[i]);
+			max_pt[1] = std::max(max_pt[1], y[i]);
+			max_pt[2] = std::max(max_pt[2], z[i]);
+		}
+	}
+
+#if defined(KLAYGE_SSE2_SUPPORT)
+	float HorizontalMinSSE2(__m128 v)
+	{
+		v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+		v = _mm_min_ss(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+		return _mm_cvtss_f32(v);
+	}
+
+	float HorizontalMaxSSE2(__m128 v)
+	{
+		v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+		v = _mm_max_ss(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+		return _mm_cvtss_f32(v);
+	}
+
+	void ComputeBoundsSSE2(float* min_pt, float* max_pt,
+		float const * x, float const * y, float const * z, size_t num)
+	{
+		size_t const num_vec = num & ~static_cast<size_t>(3);
+		if (num_vec > 0)
+		{
+			__m128 min_x = _mm_set1_ps(min_pt[0]);
+			__m128 min_y = _mm_set1_ps(min_pt[1]);
+			__m128 min_z = _mm_set1_ps(min_pt[2]);
+			__m128 max_x = _mm_set1_ps(max_pt[0]);
+			__m128 max_y = _mm_set1_ps(max_pt[1]);
+			__m128 max_z = _mm_set1_ps(max_pt[2]);
+			for (size_t i = 0; i < num_vec; i += 4)
+			{
+				__m128 const vx = _mm_loadu_ps(x + i);
+				__m128 const vy = _mm_loadu_ps(y + i);
+				__m128 const vz = _mm_loadu_ps(z + i);
+				min_x = _mm_min_ps(min_x, vx);
+				min_y = _mm_min_ps(min_y, vy);
+				min_z = _mm_min_ps(min_z, vz);
+				max_x = _mm_max_ps(max_x, vx);
+				max_y = _mm_max_ps(max_y, vy);
+				max_z = _mm_max_ps(max_z, vz);
+			}
+			min_pt[0] = HorizontalMinSSE2(min_x);
+			min_pt[1] = HorizontalMinSSE2(min_y);
+			min_pt[2] = HorizontalMinSSE2(min_z);
+			max_pt[0] = HorizontalMaxSSE2(max_x);
+			max_pt[1] = HorizontalMaxSSE2(max_y);
+			max_pt[2] = HorizontalMaxSSE2(max_z);
+		}
+
+		ComputeBoundsScalar(min_pt, max_pt, x + num_vec, y + num_vec, z + num_vec, num - num_vec);
+	}
+#endif
+
+#ifdef KLAYGE_DISPATCH_AVX2_SUPPORT
+	KLAYGE_TARGET_AVX2 float HorizontalMinAVX2(__m256 v)
+	{
+		__m128 r = _mm_min_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+		r = _mm_min_ps(r, _mm_shuffle_ps(r, r, _MM_SHUFFLE(1, 0, 3, 2)));
+		r = _mm_min_ss(r, _mm_shuffle_ps(r, r, _MM_SHUFFLE(2, 3, 0, 1)));
+		return _mm_cvtss_f32(r);
+	}
+
+	KLAYGE_TARGET_AVX2 float HorizontalMaxAVX2(__m256 v)
+	{
+		__m128 r = _mm_max_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+		r = _mm_max_ps(r, _mm_shuffle_ps(r, r, _MM_SHUFFLE(1, 0, 3, 2)));
+		r = _mm_max_ss(r, _mm_shuffle_ps(r, r, _MM_SHUFFLE(2, 3, 0, 1)));
+		return _mm_cvtss_f32(r);
+	}
+
+	KLAYGE_TARGET_AVX2 void ComputeBoundsAVX2(float* min_pt, float* max_pt,
+		float const * x, float const * y, float const * z, size_t num)
+	{
+		size_t const num_vec = num & ~static_cast<size_t>(7);
+		if (num_vec > 0)
+		{
+			__m256 min_x = _mm256_set1_ps(min_pt[0]);
+			__m256 min_y = _mm256_set1_ps(min_pt[1]);
+			__m256 min_z = _mm256_set1_ps(min_pt[2]);
+			__m256 max_x = _mm256_set1_ps(max_pt[0]);
+			__m256 max_y = _mm256_set1_ps(max_pt[1]);
+			__m256 max_z = _mm256_set1_ps(max_pt[2]);
+			for (size_t i = 0; i < num_vec; i += 8)
+			{
+				__m256 const vx = _mm256_loadu_ps(x + i);
+				__m256 const vy = _mm256_loadu_ps(y + i);
+				__m256 const vz = _mm256_loadu_ps(z + i);
+				min_x = _mm256_min_ps(min_x, vx);
+				min_y = _mm256_min_ps(min_y, vy);
+				min_z = _mm256_min_ps(min_z, vz);
+				max_x = _mm256_max_ps(max_x, vx);
+				max_y = _mm256_max_ps(max_y, vy);
+				max_z = _mm256_max_ps(max_z, vz);
+			}
+			min_pt[0] = HorizontalMinAVX2(min_x);
+			min_pt[1] = HorizontalMinAVX2(min_y);
+			min_pt[2] = HorizontalMinAVX2(min_z);
+			max_pt[0] = HorizontalMaxAVX2(max_x);
+			max_pt[1] = HorizontalMaxAVX2(max_y);
+			max_pt[2] = HorizontalMaxAVX2(max_z);
+		}
+
+		ComputeBoundsScalar(min_pt, max_pt, x + num_vec, y + num_vec, z + num_vec, num - num_vec);
+	}
+#endif
+
+#ifdef KLAYGE_DISPATCH_AVX512_SUPPORT
+	KLAYGE_TARGET_AVX512 void ComputeBoundsAVX512(float* min_pt, float* max_pt,
+		float const * x, float const * y, float const * z, size_t num)
+	{
+		__m512 min_x = _mm512_set1_ps(min_pt[0]);
+		__m512 min_y = _mm512_set1_ps(min_pt[1]);
+		__m512 min_z = _mm512_set1_ps(min_pt[2]);
+		__m512 max_x = _mm512_set1_ps(max_pt[0]);
+		__m512 max_y = _mm512_set1_ps(max_pt[1]);
+		__m512 max_z = _mm512_set1_ps(max_pt[2]);
+		for (size_t i = 0; i < num; i += 16)
+		{
+			size_t const rest = num - i;
+			__mmask16 const mask = (rest >= 16) ? static_cast<__mmask16>(0xFFFF)
+				: static_cast<__mmask16>((1U << rest) - 1);
+
+			// Masked lanes keep the accumulated value
+			min_x = _mm512_mask_min_ps(min_x, mask, min_x, _mm512_maskz_loadu_ps(mask, x + i));
+			min_y = _mm512_mask_min_ps(min_y, mask, min_y, _mm512_maskz_loadu_ps(mask, y + i));
+			min_z = _mm512_mask_min_ps(min_z, mask, min_z, _mm512_maskz_loadu_ps(mask, z + i));
+			max_x = _mm512_mask_max_ps(max_x, mask, max_x, _mm512_maskz_loadu_ps(mask, x + i));
+			max_y = _mm512_mask_max_ps(max_y, mask, max_y, _mm512_maskz_loadu_ps(mask, y + i));
+			max_z = _mm512_mask_max_ps(max_z, mask, max_z, _mm512_maskz_loadu_ps(mask, z + i));
+		}
+
+		// Reduced once per call, spilling to memory is cheaper than the lane shuffles
+		float mins[3][16];
+		float maxs[3][16];
+		_mm512_storeu_ps(mins[0], min_x);
+		_mm512_storeu_ps(mins[1], min_y);
+		_mm512_storeu_ps(mins[2], min_z);
+		_mm512_storeu_ps(maxs[0], max_x);
+		_mm512_storeu_ps(maxs[1], max_y);
+		_mm512_storeu_ps(maxs[2], max_z);
+		for (int c = 0; c < 3; ++ c)
+		{
+			min_pt[c] = *std::min_element(mins[c], mins[c] + 16);
+			max_pt[c] = *std::max_element(maxs[c], maxs[c] + 16);
+		}
+	}
+#endif
+
+
+	// MultiplyMatrices
+	///////////////////////////////////////////////////////////////////////////////
+	void MultiplyMatricesScalar(float4x4* out, float4x4 const * lhs, uint32_t const * lhs_indices,
+		float4x4 const * rhs, size_t num)
+	{
+		for (size_t i = 0; i < num; ++ i)
+		{
+			out[i] = lhs[lhs_indices[i]] * rhs[i];
+		}
+	}
+
+#if defined(KLAYGE_SSE2_SUPPORT)
+	void MultiplyMatricesSSE2(float4x4* out, float4x4 const * lhs, uint32_t const * lhs_indices,
+		float4x4 const * rhs, size_t num)
+	{
+		for (size_t i = 0; i < num; ++ i)
+		{
+			float const * a = &lhs[lhs_indices[i]][0];
+			float const * b = &rhs[i][0];
+			__m128 const b0 = _mm_loadu_ps(b + 0);
+			__m128 const b1 = _mm_loadu_ps(b + 4);
+			__m128 const b2 = _mm_loadu_ps(b + 8);
+			__m128 const b3 = _mm_loadu_ps(b + 12);
+
+			// Each row of the result is a combination of the rows of rhs
+			__m128 r[4];
+			for (int j = 0; j < 4; ++ j)
+			{
+				r[j] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[j * 4 + 0]), b0), _mm_mul_ps(_mm_set1_ps(a[j * 4 + 1]), b1)),
+					_mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[j * 4 + 2]), b2), _mm_mul_ps(_mm_set1_ps(a[j * 4 + 3]), b3)));
+			}
+
+			float* o = &out[i][0];
+			for (int j = 0; j < 4; ++ j)
+			{
+				_mm_storeu_ps(o + j * 4, r[j]);
+			}
+		}
+	}
+#endif
+
+#ifdef KLAYGE_DISPATCH_AVX2_SUPPORT
+	KLAYGE_TARGET_AVX2 void MultiplyMatricesAVX2(float4x4* out, float4x4 const * lhs, uint32_t const * lhs_indices,
+		float4x4 const * rhs, size_t num)
+	{
+		for (size_t i = 0; i < num; ++ i)
+		{
+			float const * a = &lhs[lhs_indices[i]][0];
+			float const * b = &rhs[i][0];
+
+			// Two rows per register. The rows of rhs are duplicated to both halves, and the elements of lhs are
+			// broadcasted within the halves.
+			__m256 const a01 = _mm256_loadu_ps(a + 0);
+			__m256 const a23 = _mm256_loadu_ps(a + 8);
+			__m256 const b0 = _mm256_broadcast_ps(reinterpret_cast<__m128 const *>(b + 0));
+			__m256 const b1 = _mm256_broadcast_ps(reinterpret_cast<__m128 const *>(b + 4));
+			__m256 const b2 = _mm256_broadcast_ps(reinterpret_cast<__m128 const *>(b + 8));
+			__m256 const b3 = _mm256_broadcast_ps(reinterpret_cast<__m128 const *>(b + 12));
+
+			__m256 r01 = _mm256_mul_ps(_mm256_permute_ps(a01, 0x00), b0);
+			r01 = _mm256_fmadd_ps(_mm256_permute_ps(a01, 0x55), b1, r01);
+			r01 = _mm256_fmadd_ps(_mm256_permute_ps(a01, 0xAA), b2, r01);
+			r01 = _mm256_fmadd_ps(_mm256_permute_ps(a01, 0xFF), b3, r01);
+			__m256 r23 = _mm256_mul_ps(_mm256_permute_ps(a23, 0x00), b0);
+			r23 = _mm256_fmadd_ps(_mm256_permute_ps(a23, 0x55), b1, r23);
+			r23 = _mm256_fmadd_ps(_mm256_permute_ps(a23, 0xAA), b2, r23);
+			r23 = _mm256_fmadd_ps(_mm256_permute_ps(a23, 0xFF), b3, r23);
+
+			float* o = &out[i][0];
+			_mm256_storeu_ps(o + 0, r01);
+			_mm256_storeu_ps(o + 8, r23);
+		}
+	}
+#endif
+
+#ifdef KLAYGE_DISPATCH_AVX512_SUPPORT
+	KLAYGE_TARGET_AVX512 void MultiplyMatricesAVX512(float4x4* out, float4x4 const * lhs, uint32_t const * lhs_indices,
+		float4x4 const * rhs, size_t num)
+	{
+		__mmask16 const all = static_cast<__mmask16>(0xFFFF);
+		for (size_t i = 0; i < num; ++ i)
+		{
+			float const * b = &rhs[i][0];
+
+			// The whole matrix in one register, the same scheme as AVX2 with 4 rows
+			__m512 const a = _mm512_maskz_loadu_ps(all, &lhs[lhs_indices[i]][0]);
+			__m512 const b0 = _mm512_maskz_broadcast_f32x4(all, _mm_loadu_ps(b + 0));
+			__m512 const b1 = _mm512_maskz_broadcast_f32x4(all, _mm_loadu_ps(b + 4));
+			__m512 const b2 = _mm512_maskz_broadcast_f32x4(all, _mm_loadu_ps(b + 8));
+			__m512 const b3 = _mm512_maskz_broadcast_f32x4(all, _mm_loadu_ps(b + 12));
+
+			__m512 r = _mm512_mul_ps(_mm512_maskz_permute_ps(all, a, 0x00), b0);
+			r = _mm512_fmadd_ps(_mm512_maskz_permute_ps(all, a, 0x55), b1, r);
+			r = _mm512_fmadd_ps(_mm512_maskz_permute_ps(all, a, 0xAA), b2, r);
+			r = _mm512_fmadd_ps(_mm512_maskz_permute_ps(all, a, 0xFF), b3, r);
+
+			_mm512_storeu_ps(&out[i][0], r);
+		}
+	}
+#endif
+}
+
+namespace KlayGE
+{
+	namespace SIMDBatchLib
+	{
+		SIMDInstructionSet MaxInstructionSet()
+		{
+			static SIMDInstructionSet const max_is = DetectInstructionSet();
+			return max_is;
+		}
+
+		SIMDInstructionSet ActiveInstructionSet()
+		{
+			return static_cast<SIMDInstructionSet>(ActiveInstructionSetStorage().load(std::memory_order_relaxed));
+		}
+
+		void ActiveInstructionSet(SIMDInstructionSet is)
+		{
+			ActiveInstructionSetStorage().store(std::min(is, MaxInstructionSet()), std::memory_order_relaxed);
+		}
+
+		uint32_t BatchWidth()
+		{
+			switch (ActiveInstructionSet())
+			{
+			case SIMDIS_AVX512:
+				return 16;
+
+			case SIMDIS_AVX2:
+				return 8;
+
+			case SIMDIS_SSE2:
+				return 4;
+
+			default:
+				return 1;
+			}
+		}
+
+		char const * InstructionSetName(SIMDInstructionSet is)
+		{
+			switch (is)
+			{
+			case SIMDIS_AVX512:
+				return "AVX-512";
+
+			case SIMDIS_AVX2:
+				return "AVX2";
+
+			case SIMDIS_SSE2:
+				return "SSE2";
+
+			default:
+				return "Scalar";
+			}
+		}
+
+		void TransformCoords(float* out_x, float* out_y, float* out_z,
+			float const * x, float const * y, float const * z, size_t num,
+			float4x4 const & mat)
+		{
+			switch (ActiveInstructionSet())
+			{
+#ifdef KLAYGE_DISPATCH_AVX512_SUPPORT
+			case SIMDIS_AVX512:
+				TransformCoordsAVX512(out_x, out_y, out_z, x, y, z, num, &mat[0]);
+				break;
+#endif
+
+#ifdef KLAYGE_DISPATCH_AVX2_SUPPORT
+			case SIMDIS_AVX2:
+				TransformCoordsAVX2(out_x, out_y, out_z, x, y, z, num, &mat[0]);
+				break;
+#endif
+
+#if defined(KLAYGE_SSE2_SUPPORT)
+			case SIMDIS_SSE2:
+				TransformCoordsSSE2(out_x, out_y, out_z, x, y, z, num, &mat[0]);
+				break;
+#endif
+
+			default:
+				TransformCoordsScalar(out_x, out_y, out_z, x, y, z, num, &mat[0]);
+				break;
+			}
+		}
+
+		void TransformNormals(float* out_x, float* out_y, float* out_z,
+			float const * x, float const * y, float const * z, size_t num,
+			float4x4 const & mat)
+		{
+			switch (ActiveInstructionSet())
+			{
+#ifdef KLAYGE_DISPATCH_AVX512_SUPPORT
+			case SIMDIS_AVX512:
+				TransformNormalsAVX512(out_x, out_y, out_z, x, y, z, num, &mat[0]);
+				break;
+#endif
+
+#ifdef KLAYGE_DISPATCH_AVX2_SUPPORT
+			case SIMDIS_AVX2:
+				TransformNormalsAVX2(out_x, out_y, out_z, x, y, z, num, &mat[0]);
+				break;
+#endif
+
+#if defined(KLAYGE_SSE2_SUPPORT)
+			case SIMDIS_SSE2:
+				TransformNormalsSSE2(out_x, out_y, out_z, x, y, z, num, &mat[0]);
+				break;
+#endif
+
+			default:
+				TransformNormalsScalar(out_x, out_y, out_z, x, y, z, num, &mat[0]);
+				break;
+			}
+		}
+
+		void ComputeBounds(float3& min_pt, float3& max_pt,
+			float const * x, float const * y, float const * z, size_t num)
+		{
+			BOOST_ASSERT(num > 0);
+
+			min_pt = max_pt = float3(x[0], y[0], z[0]);
+			switch (ActiveInstructionSet())
+			{
+#ifdef KLAYGE_DISPATCH_AVX512_SUPPORT
+			case SIMDIS_AVX512:
+				ComputeBoundsAVX512(&min_pt[0], &max_pt[0], x, y, z, num);
+				break;
+#endif
+
+#ifdef KLAYGE_DISPATCH_AVX2_SUPPORT
+			case SIMDIS_AVX2:
+				ComputeBoundsAVX2(&min_pt[0], &max_pt[0], x, y, z, num);
+				break;
+#endif
+
+#if defined(KLAYGE_SSE2_SUPPORT)
+			case SIMDIS_SSE2:
+				ComputeBoundsSSE2(&min_pt[0], &max_pt[0], x, y, z, num);
+				break;
+#endif
+
+			default:
+				ComputeBoundsScalar(&min_pt[0], &max_pt[0], x, y, z, num);
+				break;
+			}
+		}
+
+		void MultiplyMatrices(float4x4* out, float4x4 const * lhs, uint32_t const * lhs_indices,
+			float4x4 const * rhs, size_t num)
+		{
+			switch (ActiveInstructionSet())
+			{
+#ifdef KLAYGE_DISPATCH_AVX512_SUPPORT
+			case SIMDIS_AVX512:
+				MultiplyMatricesAVX512(out, lhs, lhs_indices, rhs, num);
+				break;
+#endif
+
+#ifdef KLAYGE_DISPATCH_AVX2_SUPPORT
+			case SIMDIS_AVX2:
+				MultiplyMatricesAVX2(out, lhs, lhs_indices, rhs, num);
+				break;
+#endif
+
+#if defined(KLAYGE_SSE2_SUPPORT)
+			case SIMDIS_SSE2:
+				MultiplyMatricesSSE2(out, lhs, lhs_indices, rhs, num);
+				break;
+#endif
+
+			default:
+				MultiplyMatricesScalar(out, lhs, lhs_indices, rhs, num);
+				break;
+			}
+		}
+	}
+}
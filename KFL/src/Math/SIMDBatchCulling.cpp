@@ -0,0 +1,1243 @@
+/**
+ * @file SIMDBatchCulling.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KFL, a subproject of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KFL/KFL.hpp>
+#include <KFL/Frustum.hpp>
+#include <KFL/Sphere.hpp>
+
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#if defined(KLAYGE_CPU_X86) || defined(KLAYGE_CPU_X64)
+#include <immintrin.h>
+#endif
+
+#include <KFL/SIMDBatch.hpp>
+
+namespace
+{
+	using namespace KlayGE;
+
+	int const NUM_PLANES = 6;
+
+	// Frustum planes in SoA. Padded to 16 so that a whole component fits in one register for
+	// the in-register lookup of the coherency planes.
+	struct FrustumPlanesSoA
+	{
+		float a[16];
+		float b[16];
+		float c[16];
+		float d[16];
+		float abs_a[16];
+		float abs_b[16];
+		float abs_c[16];
+	};
+
+	void BuildPlanes(FrustumPlanesSoA& planes, Frustum const & frustum)
+	{
+		memset(&planes, 0, sizeof(planes));
+		for (int p = 0; p < NUM_PLANES; ++ p)
+		{
+			Plane const & plane = frustum.FrustumPlane(p);
+			planes.a[p] = plane.a();
+			planes.b[p] = plane.b();
+			planes.c[p] = plane.c();
+			planes.d[p] = plane.d();
+			planes.abs_a[p] = MathLib::abs(plane.a());
+			planes.abs_b[p] = MathLib::abs(plane.b());
+			planes.abs_c[p] = MathLib::abs(plane.c());
+		}
+	}
+
+	uint32_t CountBits(uint32_t v)
+	{
+		uint32_t count = 0;
+		for (; v != 0; v &= v - 1)
+		{
+			++ count;
+		}
+		return count;
+	}
+
+	struct CullingOutput
+	{
+		uint32_t* visible_bits;
+		BoundOverlap* overlaps;
+		uint8_t* plane_masks;
+		uint8_t* last_planes;
+	};
+
+	// Writes the per-box outputs of a group of boxes. out_bits and partial_bits have 1 bit per lane.
+	uint32_t StoreGroupResults(CullingOutput const & output, size_t first, uint32_t lanes,
+		uint32_t out_bits, uint32_t partial_bits, int32_t const * new_masks, int32_t const * new_last_planes)
+	{
+		uint32_t const lane_mask = (lanes >= 32) ? 0xFFFFFFFFU : ((1U << lanes) - 1);
+		uint32_t const visible = ~out_bits & lane_mask;
+		output.visible_bits[first / 32] |= visible << (first & 31);
+
+		if (output.overlaps)
+		{
+			for (uint32_t l = 0; l < lanes; ++ l)
+			{
+				output.overlaps[first + l] = (out_bits & (1U << l)) ? BO_No
+					: ((partial_bits & (1U << l)) ? BO_Partial : BO_Yes);
+			}
+		}
+		if (output.plane_masks)
+		{
+			for (uint32_t l = 0; l < lanes; ++ l)
+			{
+				if (visible & (1U << l))
+				{
+					output.plane_masks[first + l] = static_cast<uint8_t>(new_masks[l]);
+				}
+			}
+		}
+		if (output.last_planes)
+		{
+			for (uint32_t l = 0; l < lanes; ++ l)
+			{
+				output.last_planes[first + l] = static_cast<uint8_t>(new_last_planes[l]);
+			}
+		}
+
+		return CountBits(visible);
+	}
+
+	uint32_t IntersectAABBFrustumScalar(CullingOutput const & output, SIMDBatchLib::AABBoxSoA const & boxes,
+		size_t begin, size_t end, FrustumPlanesSoA const & planes)
+	{
+		uint32_t count = 0;
+		for (size_t i = begin; i < end; ++ i)
+		{
+			float const cx = boxes.center_x[i];
+			float const cy = boxes.center_y[i];
+			float const cz = boxes.center_z[i];
+			float const ex = boxes.extent_x[i];
+			float const ey = boxes.extent_y[i];
+			float const ez = boxes.extent_z[i];
+
+			int32_t mask = output.plane_masks ? output.plane_masks[i] : SIMDBatchLib::ALL_FRUSTUM_PLANES;
+			int32_t last_plane = output.last_planes ? output.last_planes[i] : 0;
+
+			bool outside = false;
+			bool partial = false;
+			if (output.last_planes)
+			{
+				int const p = last_plane;
+				float const dist = planes.a[p] * cx + planes.b[p] * cy + planes.c[p] * cz + planes.d[p];
+				float const r = planes.abs_a[p] * ex + planes.abs_b[p] * ey + planes.abs_c[p] * ez;
+				outside = (dist + r < 0);
+			}
+			if (!outside)
+			{
+				for (int p = 0; p < NUM_PLANES; ++ p)
+				{
+					if (mask & (1 << p))
+					{
+						float const dist = planes.a[p] * cx + planes.b[p] * cy + planes.c[p] * cz + planes.d[p];
+						float const r = planes.abs_a[p] * ex + planes.abs_b[p] * ey + planes.abs_c[p] * ez;
+						if (dist + r < 0)
+						{
+							outside = true;
+							last_plane = p;
+							break;
+						}
+						if (dist - r < 0)
+						{
+							partial = true;
+						}
+						else
+						{
+							mask &= ~(1 << p);
+						}
+					}
+				}
+			}
+
+			count += StoreGroupResults(output, i, 1, outside ? 1 : 0, partial ? 1 : 0, &mask, &last_plane);
+		}
+		return count;
+	}
+
+#if defined(KLAYGE_SSE2_SUPPORT)
+	uint32_t IntersectAABBFrustumSSE2(CullingOutput const & output, SIMDBatchLib::AABBoxSoA const & boxes,
+		size_t num, FrustumPlanesSoA const & planes)
+	{
+		__m128 const zero = _mm_setzero_ps();
+
+		uint32_t count = 0;
+		size_t const num_vec = num & ~static_cast<size_t>(3);
+		for (size_t i = 0; i < num_vec; i += 4)
+		{
+			__m128 const cx = _mm_loadu_ps(boxes.center_x + i);
+			__m128 const cy = _mm_loadu_ps(boxes.center_y + i);
+			__m128 const cz = _mm_loadu_ps(boxes.center_z + i);
+			__m128 const ex = _mm_loadu_ps(boxes.extent_x + i);
+			__m128 const ey = _mm_loadu_ps(boxes.extent_y + i);
+			__m128 const ez = _mm_loadu_ps(boxes.extent_z + i);
+
+			__m128i mask;
+			if (output.plane_masks)
+			{
+				uint8_t const * pm = output.plane_masks + i;
+				mask = _mm_set_epi32(pm[3], pm[2], pm[1], pm[0]);
+			}
+			else
+			{
+				mask = _mm_set1_epi32(SIMDBatchLib::ALL_FRUSTUM_PLANES);
+			}
+
+			__m128 outside = zero;
+			__m128 partial = zero;
+			__m128i last_plane = _mm_setzero_si128();
+			if (output.last_planes)
+			{
+				uint8_t const * lp = output.last_planes + i;
+				last_plane = _mm_set_epi32(lp[3], lp[2], lp[1], lp[0]);
+
+				// No in-register permute in SSE2, look up the planes with scalar loads
+				__m128 const pa = _mm_set_ps(planes.a[lp[3]], planes.a[lp[2]], planes.a[lp[1]], planes.a[lp[0]]);
+				__m128 const pb = _mm_set_ps(planes.b[lp[3]], planes.b[lp[2]], planes.b[lp[1]], planes.b[lp[0]]);
+				__m128 const pc = _mm_set_ps(planes.c[lp[3]], planes.c[lp[2]], planes.c[lp[1]], planes.c[lp[0]]);
+				__m128 const pd = _mm_set_ps(planes.d[lp[3]], planes.d[lp[2]], planes.d[lp[1]], planes.d[lp[0]]);
+				__m128 const dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(pa, cx), _mm_mul_ps(pb, cy)),
+					_mm_add_ps(_mm_mul_ps(pc, cz), pd));
+				__m128 const abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+				__m128 const r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_and_ps(pa, abs_mask), ex), _mm_mul_ps(_mm_and_ps(pb, abs_mask), ey)),
+					_mm_mul_ps(_mm_and_ps(pc, abs_mask), ez));
+				outside = _mm_cmplt_ps(_mm_add_ps(dist, r), zero);
+			}
+
+			if (_mm_movemask_ps(outside) != 0xF)
+			{
+				for (int p = 0; p < NUM_PLANES; ++ p)
+				{
+					__m128i const bit = _mm_set1_epi32(1 << p);
+					__m128 const active = _mm_andnot_ps(outside, _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(mask, bit), bit)));
+					if (0 == _mm_movemask_ps(active))
+					{
+						continue;
+					}
+
+					__m128 const dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes.a[p]), cx), _mm_mul_ps(_mm_set1_ps(planes.b[p]), cy)),
+						_mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes.c[p]), cz), _mm_set1_ps(planes.d[p])));
+					__m128 const r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes.abs_a[p]), ex), _mm_mul_ps(_mm_set1_ps(planes.abs_b[p]), ey)),
+						_mm_mul_ps(_mm_set1_ps(planes.abs_c[p]), ez));
+					__m128 const out_p = _mm_and_ps(active, _mm_cmplt_ps(_mm_add_ps(dist, r), zero));
+					__m128 const partial_p = _mm_and_ps(active, _mm_cmplt_ps(_mm_sub_ps(dist, r), zero));
+					__m128 const inside_p = _mm_andnot_ps(partial_p, active);
+
+					__m128i const out_pi = _mm_castps_si128(out_p);
+					last_plane = _mm_or_si128(_mm_and_si128(out_pi, _mm_set1_epi32(p)), _mm_andnot_si128(out_pi, last_plane));
+					mask = _mm_andnot_si128(_mm_and_si128(_mm_castps_si128(inside_p), bit), mask);
+					outside = _mm_or_ps(outside, out_p);
+					partial = _mm_or_ps(partial, partial_p);
+
+					if (_mm_movemask_ps(outside) == 0xF)
+					{
+						break;
+					}
+				}
+			}
+
+			int32_t new_masks[4];
+			int32_t new_last_planes[4];
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(new_masks), mask);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(new_last_planes), last_plane);
+			count += StoreGroupResults(output, i, 4, _mm_movemask_ps(outside), _mm_movemask_ps(partial),
+				new_masks, new_last_planes);
+		}
+
+		return count + IntersectAABBFrustumScalar(output, boxes, num_vec, num, planes);
+	}
+#endif
+
+#ifdef KLAYGE_DISPATCH_AVX2_SUPPORT
+	KLAYGE_TARGET_AVX2 uint32_t IntersectAABBFrustumAVX2(CullingOutput const & output, SIMDBatchLib::AABBoxSoA const & boxes,
+		size_t num, FrustumPlanesSoA const & planes)
+	{
+		__m256 const zero = _mm256_setzero_ps();
+
+		// Only 8 of the 16 entries are needed for the in-register lookup of the 6 planes
+		__m256 const all_a = _mm256_loadu_ps(planes.a);
+		__m256 const all_b = _mm256_loadu_ps(planes.b);
+		__m256 const all_c = _mm256_loadu_ps(planes.c);
+		__m256 const all_d = _mm256_loadu_ps(planes.d);
+		__m256 const all_abs_a = _mm256_loadu_ps(planes.abs_a);
+		__m256 const all_abs_b = _mm256_loadu_ps(planes.abs_b);
+		__m256 const all_abs_c = _mm256_loadu_ps(planes.abs_c);
+
+		uint32_t count = 0;
+		size_t const num_vec = num & ~static_cast<size_t>(7);
+		for (size_t i = 0; i < num_vec; i += 8)
+		{
+			__m256 const cx = _mm256_loadu_ps(boxes.center_x + i);
+			__m256 const cy = _mm256_loadu_ps(boxes.center_y + i);
+			__m256 const cz = _mm256_loadu_ps(boxes.center_z + i);
+			__m256 const ex = _mm256_loadu_ps(boxes.extent_x + i);
+			__m256 const ey = _mm256_loadu_ps(boxes.extent_y + i);
+			__m256 const ez = _mm256_loadu_ps(boxes.extent_z + i);
+
+			__m256i mask;
+			if (output.plane_masks)
+			{
+				mask = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<__m128i const *>(output.plane_masks + i)));
+			}
+			else
+			{
+				mask = _mm256_set1_epi32(SIMDBatchLib::ALL_FRUSTUM_PLANES);
+			}
+
+			__m256 outside = zero;
+			__m256 partial = zero;
+			__m256i last_plane = _mm256_setzero_si256();
+			if (output.last_planes)
+			{
+				last_plane = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<__m128i const *>(output.last_planes + i)));
+
+				__m256 const dist = _mm256_fmadd_ps(_mm256_permutevar8x32_ps(all_a, last_plane), cx,
+					_mm256_fmadd_ps(_mm256_permutevar8x32_ps(all_b, last_plane), cy,
+						_mm256_fmadd_ps(_mm256_permutevar8x32_ps(all_c, last_plane), cz, _mm256_permutevar8x32_ps(all_d, last_plane))));
+				__m256 const r = _mm256_fmadd_ps(_mm256_permutevar8x32_ps(all_abs_a, last_plane), ex,
+					_mm256_fmadd_ps(_mm256_permutevar8x32_ps(all_abs_b, last_plane), ey,
+						_mm256_mul_ps(_mm256_permutevar8x32_ps(all_abs_c, last_plane), ez)));
+				outside = _mm256_cmp_ps(_mm256_add_ps(dist, r), zero, _CMP_LT_OQ);
+			}
+
+			if (_mm256_movemask_ps(outside) != 0xFF)
+			{
+				for (int p = 0; p < NUM_PLANES; ++ p)
+				{
+					__m256i const bit = _mm256_set1_epi32(1 << p);
+					__m256 const active = _mm256_andnot_ps(outside,
+						_mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(mask, bit), bit)));
+					if (0 == _mm256_movemask_ps(active))
+					{
+						continue;
+					}
+
+					__m256 const dist = _mm256_fmadd_ps(_mm256_set1_ps(planes.a[p]), cx,
+						_mm256_fmadd_ps(_mm256_set1_ps(planes.b[p]), cy,
+							_mm256_fmadd_ps(_mm256_set1_ps(planes.c[p]), cz, _mm256_set1_ps(planes.d[p]))));
+					__m256 const r = _mm256_fmadd_ps(_mm256_set1_ps(planes.abs_a[p]), ex,
+						_mm256_fmadd_ps(_mm256_set1_ps(planes.abs_b[p]), ey, _mm256_mul_ps(_mm256_set1_ps(planes.abs_c[p]), ez)));
+					__m256 const out_p = _mm256_and_ps(active, _mm256_cmp_ps(_mm256_add_ps(dist, r), zero, _CMP_LT_OQ));
+					__m256 const partial_p = _mm256_and_ps(active, _mm256_cmp_ps(_mm256_sub_ps(dist, r), zero, _CMP_LT_OQ));
+					__m256 const inside_p = _mm256_andnot_ps(partial_p, active);
+
+					last_plane = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(last_plane),
+						_mm256_castsi256_ps(_mm256_set1_epi32(p)), out_p));
+					mask = _mm256_andnot_si256(_mm256_and_si256(_mm256_castps_si256(inside_p), bit), mask);
+					outside = _mm256_or_ps(outside, out_p);
+					partial = _mm256_or_ps(partial, partial_p);
+
+					if (_mm256_movemask_ps(outside) == 0xFF)
+					{
+						break;
+					}
+				}
+			}
+
+			int32_t new_masks[8];
+			int32_t new_last_planes[8];
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(new_masks), mask);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(new_last_planes), last_plane);
+			count += StoreGroupResults(output, i, 8, _mm256_movemask_ps(outside), _mm256_movemask_ps(partial),
+				new_masks, new_last_planes);
+		}
+
+		return count + IntersectAABBFrustumScalar(output, boxes, num_vec, num, planes);
+	}
+#endif
+
+#ifdef KLAYGE_DISPATCH_AVX512_SUPPORT
+	KLAYGE_TARGET_AVX512 uint32_t IntersectAABBFrustumAVX512(CullingOutput const & output, SIMDBatchLib::AABBoxSoA const & boxes,
+		size_t num, FrustumPlanesSoA const & planes)
+	{
+		__m512 const zero = _mm512_setzero_ps();
+
+		__m512 const all_a = _mm512_loadu_ps(planes.a);
+		__m512 const all_b = _mm512_loadu_ps(planes.b);
+		__m512 const all_c = _mm512_loadu_ps(planes.c);
+		__m512 const all_d = _mm512_loadu_ps(planes.d);
+		__m512 const all_abs_a = _mm512_loadu_ps(planes.abs_a);
+		__m512 const all_abs_b = _mm512_loadu_ps(planes.abs_b);
+		__m512 const all_abs_c = _mm512_loadu_ps(planes.abs_c);
+		// The unmasked forms of the permute and the zero extension trip -Wmaybe-uninitialized in
+		// GCC's headers. The zero-masking forms with all lanes enabled generate the same code.
+		__mmask16 const all_lanes = 0xFFFF;
+
+		uint32_t count = 0;
+		size_t const num_vec = num & ~static_cast<size_t>(15);
+		for (size_t i = 0; i < num_vec; i += 16)
+		{
+			__m512 const cx = _mm512_loadu_ps(boxes.center_x + i);
+			__m512 const cy = _mm512_loadu_ps(boxes.center_y + i);
+			__m512 const cz = _mm512_loadu_ps(boxes.center_z + i);
+			__m512 const ex = _mm512_loadu_ps(boxes.extent_x + i);
+			__m512 const ey = _mm512_loadu_ps(boxes.extent_y + i);
+			__m512 const ez = _mm512_loadu_ps(boxes.extent_z + i);
+
+			__m512i mask;
+			if (output.plane_masks)
+			{
+				mask = _mm512_maskz_cvtepu8_epi32(all_lanes, _mm_loadu_si128(reinterpret_cast<__m128i const *>(output.plane_masks + i)));
+			}
+			else
+			{
+				mask = _mm512_set1_epi32(SIMDBatchLib::ALL_FRUSTUM_PLANES);
+			}
+
+			__mmask16 outside = 0;
+			__mmask16 partial = 0;
+			__m512i last_plane = _mm512_setzero_si512();
+			if (output.last_planes)
+			{
+				last_plane = _mm512_maskz_cvtepu8_epi32(all_lanes, _mm_loadu_si128(reinterpret_cast<__m128i const *>(output.last_planes + i)));
+
+				__m512 const pa = _mm512_maskz_permutexvar_ps(all_lanes, last_plane, all_a);
+				__m512 const pb = _mm512_maskz_permutexvar_ps(all_lanes, last_plane, all_b);
+				__m512 const pc = _mm512_maskz_permutexvar_ps(all_lanes, last_plane, all_c);
+				__m512 const pd = _mm512_maskz_permutexvar_ps(all_lanes, last_plane, all_d);
+				__m512 const dist = _mm512_fmadd_ps(pa, cx, _mm512_fmadd_ps(pb, cy, _mm512_fmadd_ps(pc, cz, pd)));
+				__m512 const r = _mm512_fmadd_ps(_mm512_maskz_permutexvar_ps(all_lanes, last_plane, all_abs_a), ex,
+					_mm512_fmadd_ps(_mm512_maskz_permutexvar_ps(all_lanes, last_plane, all_abs_b), ey,
+						_mm512_mul_ps(_mm512_maskz_permutexvar_ps(all_lanes, last_plane, all_abs_c), ez)));
+				outside = _mm512_cmp_ps_mask(_mm512_add_ps(dist, r), zero, _CMP_LT_OQ);
+			}
+
+			if (outside != 0xFFFF)
+			{
+				for (int p = 0; p < NUM_PLANES; ++ p)
+				{
+					__m512i const bit = _mm512_set1_epi32(1 << p);
+					__mmask16 const active = _mm512_test_epi32_mask(mask, bit) & static_cast<__mmask16>(~outside);
+					if (0 == active)
+					{
+						continue;
+					}
+
+					__m512 const dist = _mm512_fmadd_ps(_mm512_set1_ps(planes.a[p]), cx,
+						_mm512_fmadd_ps(_mm512_set1_ps(planes.b[p]), cy,
+							_mm512_fmadd_ps(_mm512_set1_ps(planes.c[p]), cz, _mm512_set1_ps(planes.d[p]))));
+					__m512 const r = _mm512_fmadd_ps(_mm512_set1_ps(planes.abs_a[p]), ex,
+						_mm512_fmadd_ps(_mm512_set1_ps(planes.abs_b[p]), ey, _mm512_mul_ps(_mm512_set1_ps(planes.abs_c[p]), ez)));
+					__mmask16 const out_p = _mm512_mask_cmp_ps_mask(active, _mm512_add_ps(dist, r), zero, _CMP_LT_OQ);
+					__mmask16 const partial_p = _mm512_mask_cmp_ps_mask(active, _mm512_sub_ps(dist, r), zero, _CMP_LT_OQ);
+					__mmask16 const inside_p = active & static_cast<__mmask16>(~partial_p);
+
+					last_plane = _mm512_mask_mov_epi32(last_plane, out_p, _mm512_set1_epi32(p));
+					mask = _mm512_mask_andnot_epi32(mask, inside_p, bit, mask);
+					outside |= out_p;
+					partial |= partial_p;
+
+					if (outside == 0xFFFF)
+					{
+						break;
+					}
+				}
+			}
+
+			int32_t new_masks[16];
+			int32_t new_last_planes[16];
+			_mm512_storeu_si512(new_masks, mask);
+			_mm512_storeu_si512(new_last_planes, last_plane);
+			count += StoreGroupResults(output, i, 16, outside, partial, new_masks, new_last_planes);
+		}
+
+		return count + IntersectAABBFrustumScalar(output, boxes, num_vec, num, planes);
+	}
+#endif
+
+
+	// IntersectAABBFrusta
+	///////////////////////////////////////////////////////////////////////////////
+	// A group of boxes is loaded once and tested against all the frusta. The bits of frustum f are at
+	// visible_bits + f * num_words, and the same in inside_bits if it's not null.
+	uint32_t IntersectAABBFrustaScalar(uint32_t* visible_bits, uint32_t* inside_bits, size_t num_words,
+		SIMDBatchLib::AABBoxSoA const & boxes, size_t begin, size_t end, FrustumPlanesSoA const * planes, size_t num_frusta)
+	{
+		uint32_t count = 0;
+		for (size_t i = begin; i < end; ++ i)
+		{
+			float const cx = boxes.center_x[i];
+			float const cy = boxes.center_y[i];
+			float const cz = boxes.center_z[i];
+			float const ex = boxes.extent_x[i];
+			float const ey = boxes.extent_y[i];
+			float const ez = boxes.extent_z[i];
+
+			bool any_visible = false;
+			for (size_t f = 0; f < num_frusta; ++ f)
+			{
+				FrustumPlanesSoA const & fp = planes[f];
+				bool outside = false;
+				bool crossing = false;
+				for (int p = 0; p < NUM_PLANES; ++ p)
+				{
+					float const dist = fp.a[p] * cx + fp.b[p] * cy + fp.c[p] * cz + fp.d[p];
+					float const r = fp.abs_a[p] * ex + fp.abs_b[p] * ey + fp.abs_c[p] * ez;
+					if (dist + r < 0)
+					{
+						outside = true;
+						break;
+					}
+					if (dist - r < 0)
+					{
+						crossing = true;
+					}
+				}
+				if (!outside)
+				{
+					visible_bits[f * num_words + i / 32] |= 1UL << (i & 31);
+					if (inside_bits && !crossing)
+					{
+						inside_bits[f * num_words + i / 32] |= 1UL << (i & 31);
+					}
+					any_visible = true;
+				}
+			}
+			if (any_visible)
+			{
+				++ count;
+			}
+		}
+		return count;
+	}
+
+#if defined(KLAYGE_SSE2_SUPPORT)
+	uint32_t IntersectAABBFrustaSSE2(uint32_t* visible_bits, uint32_t* inside_bits, size_t num_words,
+		SIMDBatchLib::AABBoxSoA const & boxes, size_t num, FrustumPlanesSoA const * planes, size_t num_frusta)
+	{
+		__m128 const zero = _mm_setzero_ps();
+
+		uint32_t count = 0;
+		size_t const num_vec = num & ~static_cast<size_t>(3);
+		for (size_t i = 0; i < num_vec; i += 4)
+		{
+			__m128 const cx = _mm_loadu_ps(boxes.center_x + i);
+			__m128 const cy = _mm_loadu_ps(boxes.center_y + i);
+			__m128 const cz = _mm_loadu_ps(boxes.center_z + i);
+			__m128 const ex = _mm_loadu_ps(boxes.extent_x + i);
+			__m128 const ey = _mm_loadu_ps(boxes.extent_y + i);
+			__m128 const ez = _mm_loadu_ps(boxes.extent_z + i);
+
+			uint32_t any_visible = 0;
+			for (size_t f = 0; f < num_frusta; ++ f)
+			{
+				FrustumPlanesSoA const & fp = planes[f];
+				__m128 outside = zero;
+				__m128 crossing = zero;
+				for (int p = 0; p < NUM_PLANES; ++ p)
+				{
+					__m128 const dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(fp.a[p]), cx), _mm_mul_ps(_mm_set1_ps(fp.b[p]), cy)),
+						_mm_add_ps(_mm_mul_ps(_mm_set1_ps(fp.c[p]), cz), _mm_set1_ps(fp.d[p])));
+					__m128 const r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(fp.abs_a[p]), ex), _mm_mul_ps(_mm_set1_ps(fp.abs_b[p]), ey)),
+						_mm_mul_ps(_mm_set1_ps(fp.abs_c[p]), ez));
+					outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(dist, r), zero));
+					crossing = _mm_or_ps(crossing, _mm_cmplt_ps(_mm_sub_ps(dist, r), zero));
+					if (_mm_movemask_ps(outside) == 0xF)
+					{
+						break;
+					}
+				}
+
+				uint32_t const visible = ~_mm_movemask_ps(outside) & 0xF;
+				visible_bits[f * num_words + i / 32] |= visible << (i & 31);
+				if (inside_bits)
+				{
+					inside_bits[f * num_words + i / 32] |= (~_mm_movemask_ps(crossing) & 0xF) << (i & 31);
+				}
+				any_visible |= visible;
+			}
+			count += CountBits(any_visible);
+		}
+
+		return count + IntersectAABBFrustaScalar(visible_bits, inside_bits, num_words, boxes, num_vec, num, planes, num_frusta);
+	}
+#endif
+
+#ifdef KLAYGE_DISPATCH_AVX2_SUPPORT
+	KLAYGE_TARGET_AVX2 uint32_t IntersectAABBFrustaAVX2(uint32_t* visible_bits, uint32_t* inside_bits, size_t num_words,
+		SIMDBatchLib::AABBoxSoA const & boxes, size_t num, FrustumPlanesSoA const * planes, size_t num_frusta)
+	{
+		__m256 const zero = _mm256_setzero_ps();
+
+		uint32_t count = 0;
+		size_t const num_vec = num & ~static_cast<size_t>(7);
+		for (size_t i = 0; i < num_vec; i += 8)
+		{
+			__m256 const cx = _mm256_loadu_ps(boxes.center_x + i);
+			__m256 const cy = _mm256_loadu_ps(boxes.center_y + i);
+			__m256 const cz = _mm256_loadu_ps(boxes.center_z + i);
+			__m256 const ex = _mm256_loadu_ps(boxes.extent_x + i);
+			__m256 const ey = _mm256_loadu_ps(boxes.extent_y + i);
+			__m256 const ez = _mm256_loadu_ps(boxes.extent_z + i);
+
+			uint32_t any_visible = 0;
+			for (size_t f = 0; f < num_frusta; ++ f)
+			{
+				FrustumPlanesSoA const & fp = planes[f];
+				__m256 outside = zero;
+				__m256 crossing = zero;
+				for (int p = 0; p < NUM_PLANES; ++ p)
+				{
+					__m256 const dist = _mm256_fmadd_ps(_mm256_set1_ps(fp.a[p]), cx,
+						_mm256_fmadd_ps(_mm256_set1_ps(fp.b[p]), cy,
+							_mm256_fmadd_ps(_mm256_set1_ps(fp.c[p]), cz, _mm256_set1_ps(fp.d[p]))));
+					__m256 const r = _mm256_fmadd_ps(_mm256_set1_ps(fp.abs_a[p]), ex,
+						_mm256_fmadd_ps(_mm256_set1_ps(fp.abs_b[p]), ey, _mm256_mul_ps(_mm256_set1_ps(fp.abs_c[p]), ez)));
+					outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(dist, r), zero, _CMP_LT_OQ));
+					crossing = _mm256_or_ps(crossing, _mm256_cmp_ps(_mm256_sub_ps(dist, r), zero, _CMP_LT_OQ));
+					if (_mm256_movemask_ps(outside) == 0xFF)
+					{
+						break;
+					}
+				}
+
+				uint32_t const visible = ~_mm256_movemask_ps(outside) & 0xFF;
+				visible_bits[f * num_words + i / 32] |= visible << (i & 31);
+				if (inside_bits)
+				{
+					inside_bits[f * num_words + i / 32] |= (~_mm256_movemask_ps(crossing) & 0xFF) << (i & 31);
+				}
+				any_visible |= visible;
+			}
+			count += CountBits(any_visible);
+		}
+
+		return count + IntersectAABBFrustaScalar(visible_bits, inside_bits, num_words, boxes, num_vec, num, planes, num_frusta);
+	}
+#endif
+
+#ifdef KLAYGE_DISPATCH_AVX512_SUPPORT
+	KLAYGE_TARGET_AVX512 uint32_t IntersectAABBFrustaAVX512(uint32_t* visible_bits, uint32_t* inside_bits, size_t num_words,
+		SIMDBatchLib::AABBoxSoA const & boxes, size_t num, FrustumPlanesSoA const * planes, size_t num_frusta)
+	{
+		__m512 const zero = _mm512_setzero_ps();
+
+		uint32_t count = 0;
+		size_t const num_vec = num & ~static_cast<size_t>(15);
+		for (size_t i = 0; i < num_vec; i += 16)
+		{
+			__m512 const cx = _mm512_loadu_ps(boxes.center_x + i);
+			__m512 const cy = _mm512_loadu_ps(boxes.center_y + i);
+			__m512 const cz = _mm512_loadu_ps(boxes.center_z + i);
+			__m512 const ex = _mm512_loadu_ps(boxes.extent_x + i);
+			__m512 const ey = _mm512_loadu_ps(boxes.extent_y + i);
+			__m512 const ez = _mm512_loadu_ps(boxes.extent_z + i);
+
+			uint32_t any_visible = 0;
+			for (size_t f = 0; f < num_frusta; ++ f)
+			{
+				FrustumPlanesSoA const & fp = planes[f];
+				__mmask16 outside = 0;
+				__mmask16 crossing = 0;
+				for (int p = 0; p < NUM_PLANES; ++ p)
+				{
+					__m512 const dist = _mm512_fmadd_ps(_mm512_set1_ps(fp.a[p]), cx,
+						_mm512_fmadd_ps(_mm512_set1_ps(fp.b[p]), cy,
+							_mm512_fmadd_ps(_mm512_set1_ps(fp.c[p]), cz, _mm512_set1_ps(fp.d[p]))));
+					__m512 const r = _mm512_fmadd_ps(_mm512_set1_ps(fp.abs_a[p]), ex,
+						_mm512_fmadd_ps(_mm512_set1_ps(fp.abs_b[p]), ey, _mm512_mul_ps(_mm512_set1_ps(fp.abs_c[p]), ez)));
+					outside |= _mm512_cmp_ps_mask(_mm512_add_ps(dist, r), zero, _CMP_LT_OQ);
+					crossing |= _mm512_cmp_ps_mask(_mm512_sub_ps(dist, r), zero, _CMP_LT_OQ);
+					if (outside == 0xFFFF)
+					{
+						break;
+					}
+				}
+
+				uint32_t const visible = static_cast<uint16_t>(~outside);
+				visible_bits[f * num_words + i / 32] |= visible << (i & 31);
+				if (inside_bits)
+				{
+					inside_bits[f * num_words + i / 32] |= static_cast<uint32_t>(static_cast<uint16_t>(~crossing)) << (i & 31);
+				}
+				any_visible |= visible;
+			}
+			count += CountBits(any_visible);
+		}
+
+		return count + IntersectAABBFrustaScalar(visible_bits, inside_bits, num_words, boxes, num_vec, num, planes, num_frusta);
+	}
+#endif
+
+
+	// IntersectAABBSphere
+	///////////////////////////////////////////////////////////////////////////////
+	// The squared distance from the sphere center to the nearest point of the box against the squared radius
+	uint32_t IntersectAABBSphereScalar(uint32_t* visible_bits, SIMDBatchLib::AABBoxSoA const & boxes,
+		size_t begin, size_t end, float const * sphere)
+	{
+		uint32_t count = 0;
+		for (size_t i = begin; i < end; ++ i)
+		{
+			float const dx = std::max(MathLib::abs(boxes.center_x[i] - sphere[0]) - boxes.extent_x[i], 0.0f);
+			float const dy = std::max(MathLib::abs(boxes.center_y[i] - sphere[1]) - boxes.extent_y[i], 0.0f);
+			float const dz = std::max(MathLib::abs(boxes.center_z[i] - sphere[2]) - boxes.extent_z[i], 0.0f);
+			if (dx * dx + dy * dy + dz * dz <= sphere[3] * sphere[3])
+			{
+				visible_bits[i / 32] |= 1UL << (i & 31);
+				++ count;
+			}
+		}
+		return count;
+	}
+
+#if defined(KLAYGE_SSE2_SUPPORT)
+	uint32_t IntersectAABBSphereSSE2(uint32_t* visible_bits, SIMDBatchLib::AABBoxSoA const & boxes,
+		size_t num, float const * sphere)
+	{
+		__m128 const zero = _mm_setzero_ps();
+		__m128 const sign_mask = _mm_set1_ps(-0.0f);
+		__m128 const sx = _mm_set1_ps(sphere[0]);
+		__m128 const sy = _mm_set1_ps(sphere[1]);
+		__m128 const sz = _mm_set1_ps(sphere[2]);
+		__m128 const sr2 = _mm_set1_ps(sphere[3] * sphere[3]);
+
+		uint32_t count = 0;
+		size_t const num_vec = num & ~static_cast<size_t>(3);
+		for (size_t i = 0; i < num_vec; i += 4)
+		{
+			__m128 const dx = _mm_max_ps(_mm_sub_ps(_mm_andnot_ps(sign_mask, _mm_sub_ps(_mm_loadu_ps(boxes.center_x + i), sx)),
+				_mm_loadu_ps(boxes.extent_x + i)), zero);
+			__m128 const dy = _mm_max_ps(_mm_sub_ps(_mm_andnot_ps(sign_mask, _mm_sub_ps(_mm_loadu_ps(boxes.center_y + i), sy)),
+				_mm_loadu_ps(boxes.extent_y + i)), zero);
+			__m128 const dz = _mm_max_ps(_mm_sub_ps(_mm_andnot_ps(sign_mask, _mm_sub_ps(_mm_loadu_ps(boxes.center_z + i), sz)),
+				_mm_loadu_ps(boxes.extent_z + i)), zero);
+			__m128 const dist2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+			uint32_t const visible = _mm_movemask_ps(_mm_cmple_ps(dist2, sr2));
+			visible_bits[i / 32] |= visible << (i & 31);
+			count += CountBits(visible);
+		}
+
+		return count + IntersectAABBSphereScalar(visible_bits, boxes, num_vec, num, sphere);
+	}
+#endif
+
+#ifdef KLAYGE_DISPATCH_AVX2_SUPPORT
+	KLAYGE_TARGET_AVX2 uint32_t IntersectAABBSphereAVX2(uint32_t* visible_bits, SIMDBatchLib::AABBoxSoA const & boxes,
+		size_t num, float const * sphere)
+	{
+		__m256 const zero = _mm256_setzero_ps();
+		__m256 const sign_mask = _mm256_set1_ps(-0.0f);
+		__m256 const sx = _mm256_set1_ps(sphere[0]);
+		__m256 const sy = _mm256_set1_ps(sphere[1]);
+		__m256 const sz = _mm256_set1_ps(sphere[2]);
+		__m256 const sr2 = _mm256_set1_ps(sphere[3] * sphere[3]);
+
+		uint32_t count = 0;
+		size_t const num_vec = num & ~static_cast<size_t>(7);
+		for (size_t i = 0; i < num_vec; i += 8)
+		{
+			__m256 const dx = _mm256_max_ps(_mm256_sub_ps(_mm256_andnot_ps(sign_mask,
+				_mm256_sub_ps(_mm256_loadu_ps(boxes.center_x + i), sx)), _mm256_loadu_ps(boxes.extent_x + i)), zero);
+			__m256 const dy = _mm256_max_ps(_mm256_sub_ps(_mm256_andnot_ps(sign_mask,
+				_mm256_sub_ps(_mm256_loadu_ps(boxes.center_y + i), sy)), _mm256_loadu_ps(boxes.extent_y + i)), zero);
+			__m256 const dz = _mm256_max_ps(_mm256_sub_ps(_mm256_andnot_ps(sign_mask,
+				_mm256_sub_ps(_mm256_loadu_ps(boxes.center_z + i), sz)), _mm256_loadu_ps(boxes.extent_z + i)), zero);
+			__m256 const dist2 = _mm256_fmadd_ps(dx, dx, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dz, dz)));
+
+			uint32_t const visible = _mm256_movemask_ps(_mm256_cmp_ps(dist2, sr2, _CMP_LE_OQ));
+			visible_bits[i / 32] |= visible << (i & 31);
+			count += CountBits(visible);
+		}
+
+		return count + IntersectAABBSphereScalar(visible_bits, boxes, num_vec, num, sphere);
+	}
+#endif
+
+#ifdef KLAYGE_DISPATCH_AVX512_SUPPORT
+	KLAYGE_TARGET_AVX512 uint32_t IntersectAABBSphereAVX512(uint32_t* visible_bits, SIMDBatchLib::AABBoxSoA const & boxes,
+		size_t num, float const * sphere)
+	{
+		__mmask16 const all_lanes = 0xFFFF;
+		__m512 const zero = _mm512_setzero_ps();
+		__m512 const sx = _mm512_set1_ps(sphere[0]);
+		__m512 const sy = _mm512_set1_ps(sphere[1]);
+		__m512 const sz = _mm512_set1_ps(sphere[2]);
+		__m512 const sr2 = _mm512_set1_ps(sphere[3] * sphere[3]);
+
+		uint32_t count = 0;
+		size_t const num_vec = num & ~static_cast<size_t>(15);
+		for (size_t i = 0; i < num_vec; i += 16)
+		{
+			__m512 const dx = _mm512_maskz_max_ps(all_lanes, _mm512_sub_ps(_mm512_abs_ps(_mm512_sub_ps(_mm512_loadu_ps(boxes.center_x + i), sx)),
+				_mm512_loadu_ps(boxes.extent_x + i)), zero);
+			__m512 const dy = _mm512_maskz_max_ps(all_lanes, _mm512_sub_ps(_mm512_abs_ps(_mm512_sub_ps(_mm512_loadu_ps(boxes.center_y + i), sy)),
+				_mm512_loadu_ps(boxes.extent_y + i)), zero);
+			__m512 const dz = _mm512_maskz_max_ps(all_lanes, _mm512_sub_ps(_mm512_abs_ps(_mm512_sub_ps(_mm512_loadu_ps(boxes.center_z + i), sz)),
+				_mm512_loadu_ps(boxes.extent_z + i)), zero);
+			__m512 const dist2 = _mm512_fmadd_ps(dx, dx, _mm512_fmadd_ps(dy, dy, _mm512_mul_ps(dz, dz)));
+
+			uint32_t const visible = _mm512_cmp_ps_mask(dist2, sr2, _CMP_LE_OQ);
+			visible_bits[i / 32] |= visible << (i & 31);
+			count += CountBits(visible);
+		}
+
+		return count + IntersectAABBSphereScalar(visible_bits, boxes, num_vec, num, sphere);
+	}
+#endif
+
+
+	// IntersectAABBCone
+	///////////////////////////////////////////////////////////////////////////////
+	// The bounding spheres of the boxes are tested against the cone. A sphere is outside if it's behind the apex,
+	// beyond the base, or farther than its radius from the side.
+	//   cone: apex xyz, direction xyz, cos and sin of the half angle, height
+	uint32_t IntersectAABBConeScalar(uint32_t* visible_bits, SIMDBatchLib::AABBoxSoA const & boxes,
+		size_t begin, size_t end, float const * cone)
+	{
+		uint32_t count = 0;
+		for (size_t i = begin; i < end; ++ i)
+		{
+			float const vx = boxes.center_x[i] - cone[0];
+			float const vy = boxes.center_y[i] - cone[1];
+			float const vz = boxes.center_z[i] - cone[2];
+			float const ex = boxes.extent_x[i];
+			float const ey = boxes.extent_y[i];
+			float const ez = boxes.extent_z[i];
+			float const radius = std::sqrt(ex * ex + ey * ey + ez * ez);
+
+			float const along = vx * cone[3] + vy * cone[4] + vz * cone[5];
+			float const across = std::sqrt(std::max(vx * vx + vy * vy + vz * vz - along * along, 0.0f));
+			float const side_dist = cone[6] * across - cone[7] * along;
+			if ((side_dist <= radius) && (along <= cone[8] + radius) && (along >= -radius))
+			{
+				visible_bits[i / 32] |= 1UL << (i & 31);
+				++ count;
+			}
+		}
+		return count;
+	}
+
+#if defined(KLAYGE_SSE2_SUPPORT)
+	uint32_t IntersectAABBConeSSE2(uint32_t* visible_bits, SIMDBatchLib::AABBoxSoA const & boxes,
+		size_t num, float const * cone)
+	{
+		__m128 const zero = _mm_setzero_ps();
+		__m128 const ax = _mm_set1_ps(cone[0]);
+		__m128 const ay = _mm_set1_ps(cone[1]);
+		__m128 const az = _mm_set1_ps(cone[2]);
+		__m128 const dx = _mm_set1_ps(cone[3]);
+		__m128 const dy = _mm_set1_ps(cone[4]);
+		__m128 const dz = _mm_set1_ps(cone[5]);
+		__m128 const cos_angle = _mm_set1_ps(cone[6]);
+		__m128 const sin_angle = _mm_set1_ps(cone[7]);
+		__m128 const height = _mm_set1_ps(cone[8]);
+
+		uint32_t count = 0;
+		size_t const num_vec = num & ~static_cast<size_t>(3);
+		for (size_t i = 0; i < num_vec; i += 4)
+		{
+			__m128 const vx = _mm_sub_ps(_mm_loadu_ps(boxes.center_x + i), ax);
+			__m128 const vy = _mm_sub_ps(_mm_loadu_ps(boxes.center_y + i), ay);
+			__m128 const vz = _mm_sub_ps(_mm_loadu_ps(boxes.center_z + i), az);
+			__m128 const ex = _mm_loadu_ps(boxes.extent_x + i);
+			__m128 const ey = _mm_loadu_ps(boxes.extent_y + i);
+			__m128 const ez = _mm_loadu_ps(boxes.extent_z + i);
+			__m128 const radius = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, ex), _mm_mul_ps(ey, ey)), _mm_mul_ps(ez, ez)));
+
+			__m128 const along = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, dx), _mm_mul_ps(vy, dy)), _mm_mul_ps(vz, dz));
+			__m128 const len2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz));
+			__m128 const across = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(len2, _mm_mul_ps(along, along)), zero));
+			__m128 const side_dist = _mm_sub_ps(_mm_mul_ps(cos_angle, across), _mm_mul_ps(sin_angle, along));
+
+			__m128 inside = _mm_cmple_ps(side_dist, radius);
+			inside = _mm_and_ps(inside, _mm_cmple_ps(along, _mm_add_ps(height, radius)));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(along, _mm_sub_ps(zero, radius)));
+
+			uint32_t const visible = _mm_movemask_ps(inside);
+			visible_bits[i / 32] |= visible << (i & 31);
+			count += CountBits(visible);
+		}
+
+		return count + IntersectAABBConeScalar(visible_bits, boxes, num_vec, num, cone);
+	}
+#endif
+
+#ifdef KLAYGE_DISPATCH_AVX2_SUPPORT
+	KLAYGE_TARGET_AVX2 uint32_t IntersectAABBConeAVX2(uint32_t* visible_bits, SIMDBatchLib::AABBoxSoA const & boxes,
+		size_t num, float const * cone)
+	{
+		__m256 const zero = _mm256_setzero_ps();
+		__m256 const ax = _mm256_set1_ps(cone[0]);
+		__m256 const ay = _mm256_set1_ps(cone[1]);
+		__m256 const az = _mm256_set1_ps(cone[2]);
+		__m256 const dx = _mm256_set1_ps(cone[3]);
+		__m256 const dy = _mm256_set1_ps(cone[4]);
+		__m256 const dz = _mm256_set1_ps(cone[5]);
+		__m256 const cos_angle = _mm256_set1_ps(cone[6]);
+		__m256 const sin_angle = _mm256_set1_ps(cone[7]);
+		__m256 const height = _mm256_set1_ps(cone[8]);
+
+		uint32_t count = 0;
+		size_t const num_vec = num & ~static_cast<size_t>(7);
+		for (size_t i = 0; i < num_vec; i += 8)
+		{
+			__m256 const vx = _mm256_sub_ps(_mm256_loadu_ps(boxes.center_x + i), ax);
+			__m256 const vy = _mm256_sub_ps(_mm256_loadu_ps(boxes.center_y + i), ay);
+			__m256 const vz = _mm256_sub_ps(_mm256_loadu_ps(boxes.center_z + i), az);
+			__m256 const ex = _mm256_loadu_ps(boxes.extent_x + i);
+			__m256 const ey = _mm256_loadu_ps(boxes.extent_y + i);
+			__m256 const ez = _mm256_loadu_ps(boxes.extent_z + i);
+			__m256 const radius = _mm256_sqrt_ps(_mm256_fmadd_ps(ex, ex, _mm256_fmadd_ps(ey, ey, _mm256_mul_ps(ez, ez))));
+
+			__m256 const along = _mm256_fmadd_ps(vx, dx, _mm256_fmadd_ps(vy, dy, _mm256_mul_ps(vz, dz)));
+			__m256 const len2 = _mm256_fmadd_ps(vx, vx, _mm256_fmadd_ps(vy, vy, _mm256_mul_ps(vz, vz)));
+			__m256 const across = _mm256_sqrt_ps(_mm256_max_ps(_mm256_fnmadd_ps(along, along, len2), zero));
+			__m256 const side_dist = _mm256_fmsub_ps(cos_angle, across, _mm256_mul_ps(sin_angle, along));
+
+			__m256 inside = _mm256_cmp_ps(side_dist, radius, _CMP_LE_OQ);
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(along, _mm256_add_ps(height, radius), _CMP_LE_OQ));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(along, _mm256_sub_ps(zero, radius), _CMP_GE_OQ));
+
+			uint32_t const visible = _mm256_movemask_ps(inside);
+			visible_bits[i / 32] |= visible << (i & 31);
+			count += CountBits(visible);
+		}
+
+		return count + IntersectAABBConeScalar(visible_bits, boxes, num_vec, num, cone);
+	}
+#endif
+
+#ifdef KLAYGE_DISPATCH_AVX512_SUPPORT
+	KLAYGE_TARGET_AVX512 uint32_t IntersectAABBConeAVX512(uint32_t* visible_bits, SIMDBatchLib::AABBoxSoA const & boxes,
+		size_t num, float const * cone)
+	{
+		__mmask16 const all_lanes = 0xFFFF;
+		__m512 const zero = _mm512_setzero_ps();
+		__m512 const ax = _mm512_set1_ps(cone[0]);
+		__m512 const ay = _mm512_set1_ps(cone[1]);
+		__m512 const az = _mm512_set1_ps(cone[2]);
+		__m512 const dx = _mm512_set1_ps(cone[3]);
+		__m512 const dy = _mm512_set1_ps(cone[4]);
+		__m512 const dz = _mm512_set1_ps(cone[5]);
+		__m512 const cos_angle = _mm512_set1_ps(cone[6]);
+		__m512 const sin_angle = _mm512_set1_ps(cone[7]);
+		__m512 const height = _mm512_set1_ps(cone[8]);
+
+		uint32_t count = 0;
+		size_t const num_vec = num & ~static_cast<size_t>(15);
+		for (size_t i = 0; i < num_vec; i += 16)
+		{
+			__m512 const vx = _mm512_sub_ps(_mm512_loadu_ps(boxes.center_x + i), ax);
+			__m512 const vy = _mm512_sub_ps(_mm512_loadu_ps(boxes.center_y + i), ay);
+			__m512 const vz = _mm512_sub_ps(_mm512_loadu_ps(boxes.center_z + i), az);
+			__m512 const ex = _mm512_loadu_ps(boxes.extent_x + i);
+			__m512 const ey = _mm512_loadu_ps(boxes.extent_y + i);
+			__m512 const ez = _mm512_loadu_ps(boxes.extent_z + i);
+			__m512 const radius = _mm512_maskz_sqrt_ps(all_lanes, _mm512_fmadd_ps(ex, ex, _mm512_fmadd_ps(ey, ey, _mm512_mul_ps(ez, ez))));
+
+			__m512 const along = _mm512_fmadd_ps(vx, dx, _mm512_fmadd_ps(vy, dy, _mm512_mul_ps(vz, dz)));
+			__m512 const len2 = _mm512_fmadd_ps(vx, vx, _mm512_fmadd_ps(vy, vy, _mm512_mul_ps(vz, vz)));
+			__m512 const across = _mm512_maskz_sqrt_ps(all_lanes, _mm512_maskz_max_ps(all_lanes, _mm512_fnmadd_ps(along, along, len2), zero));
+			__m512 const side_dist = _mm512_fmsub_ps(cos_angle, across, _mm512_mul_ps(sin_angle, along));
+
+			__mmask16 inside = _mm512_cmp_ps_mask(side_dist, radius, _CMP_LE_OQ);
+			inside &= _mm512_cmp_ps_mask(along, _mm512_add_ps(height, radius), _CMP_LE_OQ);
+			inside &= _mm512_cmp_ps_mask(along, _mm512_sub_ps(zero, radius), _CMP_GE_OQ);
+
+			uint32_t const visible = inside;
+			visible_bits[i / 32] |= visible << (i & 31);
+			count += CountBits(visible);
+		}
+
+		return count + IntersectAABBConeScalar(visible_bits, boxes, num_vec, num, cone);
+	}
+#endif
+
+	// AABBPlaneDistance
+	///////////////////////////////////////////////////////////////////////////////
+	void AABBPlaneDistanceScalar(float* out, SIMDBatchLib::AABBoxSoA const & boxes, size_t begin, size_t end,
+		float const * plane, float const * abs_plane)
+	{
+		for (size_t i = begin; i < end; ++ i)
+		{
+			out[i] = plane[0] * boxes.center_x[i] + plane[1] * boxes.center_y[i] + plane[2] * boxes.center_z[i] + plane[3]
+				- (abs_plane[0] * boxes.extent_x[i] + abs_plane[1] * boxes.extent_y[i] + abs_plane[2] * boxes.extent_z[i]);
+		}
+	}
+
+#if defined(KLAYGE_SSE2_SUPPORT)
+	void AABBPlaneDistanceSSE2(float* out, SIMDBatchLib::AABBoxSoA const & boxes, size_t num,
+		float const * plane, float const * abs_plane)
+	{
+		__m128 const pa = _mm_set1_ps(plane[0]);
+		__m128 const pb = _mm_set1_ps(plane[1]);
+		__m128 const pc = _mm_set1_ps(plane[2]);
+		__m128 const pd = _mm_set1_ps(plane[3]);
+		__m128 const abs_pa = _mm_set1_ps(abs_plane[0]);
+		__m128 const abs_pb = _mm_set1_ps(abs_plane[1]);
+		__m128 const abs_pc = _mm_set1_ps(abs_plane[2]);
+
+		size_t const num_vec = num & ~static_cast<size_t>(3);
+		for (size_t i = 0; i < num_vec; i += 4)
+		{
+			__m128 const dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(pa, _mm_loadu_ps(boxes.center_x + i)),
+				_mm_mul_ps(pb, _mm_loadu_ps(boxes.center_y + i))),
+				_mm_add_ps(_mm_mul_ps(pc, _mm_loadu_ps(boxes.center_z + i)), pd));
+			__m128 const r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(abs_pa, _mm_loadu_ps(boxes.extent_x + i)),
+				_mm_mul_ps(abs_pb, _mm_loadu_ps(boxes.extent_y + i))),
+				_mm_mul_ps(abs_pc, _mm_loadu_ps(boxes.extent_z + i)));
+			_mm_storeu_ps(out + i, _mm_sub_ps(dist, r));
+		}
+
+		AABBPlaneDistanceScalar(out, boxes, num_vec, num, plane, abs_plane);
+	}
+#endif
+
+#ifdef KLAYGE_DISPATCH_AVX2_SUPPORT
+	KLAYGE_TARGET_AVX2 void AABBPlaneDistanceAVX2(float* out, SIMDBatchLib::AABBoxSoA const & boxes, size_t num,
+		float const * plane, float const * abs_plane)
+	{
+		__m256 const pa = _mm256_set1_ps(plane[0]);
+		__m256 const pb = _mm256_set1_ps(plane[1]);
+		__m256 const pc = _mm256_set1_ps(plane[2]);
+		__m256 const pd = _mm256_set1_ps(plane[3]);
+		__m256 const abs_pa = _mm256_set1_ps(abs_plane[0]);
+		__m256 const abs_pb = _mm256_set1_ps(abs_plane[1]);
+		__m256 const abs_pc = _mm256_set1_ps(abs_plane[2]);
+
+		size_t const num_vec = num & ~static_cast<size_t>(7);
+		for (size_t i = 0; i < num_vec; i += 8)
+		{
+			__m256 const dist = _mm256_fmadd_ps(pa, _mm256_loadu_ps(boxes.center_x + i),
+				_mm256_fmadd_ps(pb, _mm256_loadu_ps(boxes.center_y + i),
+					_mm256_fmadd_ps(pc, _mm256_loadu_ps(boxes.center_z + i), pd)));
+			__m256 const r = _mm256_fmadd_ps(abs_pa, _mm256_loadu_ps(boxes.extent_x + i),
+				_mm256_fmadd_ps(abs_pb, _mm256_loadu_ps(boxes.extent_y + i),
+					_mm256_mul_ps(abs_pc, _mm256_loadu_ps(boxes.extent_z + i))));
+			_mm256_storeu_ps(out + i, _mm256_sub_ps(dist, r));
+		}
+
+		AABBPlaneDistanceScalar(out, boxes, num_vec, num, plane, abs_plane);
+	}
+#endif
+
+#ifdef KLAYGE_DISPATCH_AVX512_SUPPORT
+	KLAYGE_TARGET_AVX512 void AABBPlaneDistanceAVX512(float* out, SIMDBatchLib::AABBoxSoA const & boxes, size_t num,
+		float const * plane, float const * abs_plane)
+	{
+		__m512 const pa = _mm512_set1_ps(plane[0]);
+		__m512 const pb = _mm512_set1_ps(plane[1]);
+		__m512 const pc = _mm512_set1_ps(plane[2]);
+		__m512 const pd = _mm512_set1_ps(plane[3]);
+		__m512 const abs_pa = _mm512_set1_ps(abs_plane[0]);
+		__m512 const abs_pb = _mm512_set1_ps(abs_plane[1]);
+		__m512 const abs_pc = _mm512_set1_ps(abs_plane[2]);
+
+		size_t const num_vec = num & ~static_cast<size_t>(15);
+		for (size_t i = 0; i < num_vec; i += 16)
+		{
+			__m512 const dist = _mm512_fmadd_ps(pa, _mm512_loadu_ps(boxes.center_x + i),
+				_mm512_fmadd_ps(pb, _mm512_loadu_ps(boxes.center_y + i),
+					_mm512_fmadd_ps(pc, _mm512_loadu_ps(boxes.center_z + i), pd)));
+			__m512 const r = _mm512_fmadd_ps(abs_pa, _mm512_loadu_ps(boxes.extent_x + i),
+				_mm512_fmadd_ps(abs_pb, _mm512_loadu_ps(boxes.extent_y + i),
+					_mm512_mul_ps(abs_pc, _mm512_loadu_ps(boxes.extent_z + i))));
+			_mm512_storeu_ps(out + i, _mm512_sub_ps(dist, r));
+		}
+
+		AABBPlaneDistanceScalar(out, boxes, num_vec, num, plane, abs_plane);
+	}
+#endif
+}
+
+namespace KlayGE
+{
+	namespace SIMDBatchLib
+	{
+		uint32_t IntersectAABBFrustum(uint32_t* visible_bits, BoundOverlap* overlaps,
+			uint8_t* plane_masks, uint8_t* last_planes,
+			AABBoxSoA const & boxes, size_t num, Frustum const & frustum)
+		{
+			memset(visible_bits, 0, (num + 31) / 32 * sizeof(visible_bits[0]));
+
+			FrustumPlanesSoA planes;
+			BuildPlanes(planes, frustum);
+
+			CullingOutput const output = { visible_bits, overlaps, plane_masks, last_planes };
+
+			switch (ActiveInstructionSet())
+			{
+#ifdef KLAYGE_DISPATCH_AVX512_SUPPORT
+			case SIMDIS_AVX512:
+				return IntersectAABBFrustumAVX512(output, boxes, num, planes);
+#endif
+
+#ifdef KLAYGE_DISPATCH_AVX2_SUPPORT
+			case SIMDIS_AVX2:
+				return IntersectAABBFrustumAVX2(output, boxes, num, planes);
+#endif
+
+#if defined(KLAYGE_SSE2_SUPPORT)
+			case SIMDIS_SSE2:
+				return IntersectAABBFrustumSSE2(output, boxes, num, planes);
+#endif
+
+			default:
+				return IntersectAABBFrustumScalar(output, boxes, 0, num, planes);
+			}
+		}
+
+		uint32_t IntersectAABBFrusta(uint32_t* visible_bits, uint32_t* inside_bits, AABBoxSoA const & boxes, size_t num,
+			Frustum const * frusta, size_t num_frusta)
+		{
+			size_t const num_words = (num + 31) / 32;
+			memset(visible_bits, 0, num_words * num_frusta * sizeof(visible_bits[0]));
+			if (inside_bits)
+			{
+				memset(inside_bits, 0, num_words * num_frusta * sizeof(inside_bits[0]));
+			}
+
+			std::vector<FrustumPlanesSoA> planes(num_frusta);
+			for (size_t f = 0; f < num_frusta; ++ f)
+			{
+				BuildPlanes(planes[f], frusta[f]);
+			}
+
+			switch (ActiveInstructionSet())
+			{
+#ifdef KLAYGE_DISPATCH_AVX512_SUPPORT
+			case SIMDIS_AVX512:
+				return IntersectAABBFrustaAVX512(visible_bits, inside_bits, num_words, boxes, num, planes.data(), num_frusta);
+#endif
+
+#ifdef KLAYGE_DISPATCH_AVX2_SUPPORT
+			case SIMDIS_AVX2:
+				return IntersectAABBFrustaAVX2(visible_bits, inside_bits, num_words, boxes, num, planes.data(), num_frusta);
+#endif
+
+#if defined(KLAYGE_SSE2_SUPPORT)
+			case SIMDIS_SSE2:
+				return IntersectAABBFrustaSSE2(visible_bits, inside_bits, num_words, boxes, num, planes.data(), num_frusta);
+#endif
+
+			default:
+				return IntersectAABBFrustaScalar(visible_bits, inside_bits, num_words, boxes, 0, num, planes.data(), num_frusta);
+			}
+		}
+
+		uint32_t IntersectAABBSphere(uint32_t* visible_bits, AABBoxSoA const & boxes, size_t num, Sphere const & sphere)
+		{
+			memset(visible_bits, 0, (num + 31) / 32 * sizeof(visible_bits[0]));
+
+			float const s[] = { sphere.Center().x(), sphere.Center().y(), sphere.Center().z(), sphere.Radius() };
+
+			switch (ActiveInstructionSet())
+			{
+#ifdef KLAYGE_DISPATCH_AVX512_SUPPORT
+			case SIMDIS_AVX512:
+				return IntersectAABBSphereAVX512(visible_bits, boxes, num, s);
+#endif
+
+#ifdef KLAYGE_DISPATCH_AVX2_SUPPORT
+			case SIMDIS_AVX2:
+				return IntersectAABBSphereAVX2(visible_bits, boxes, num, s);
+#endif
+
+#if defined(KLAYGE_SSE2_SUPPORT)
+			case SIMDIS_SSE2:
+				return IntersectAABBSphereSSE2(visible_bits, boxes, num, s);
+#endif
+
+			default:
+				return IntersectAABBSphereScalar(visible_bits, boxes, 0, num, s);
+			}
+		}
+
+		uint32_t IntersectAABBCone(uint32_t* visible_bits, AABBoxSoA const & boxes, size_t num,
+			float3 const & apex, float3 const & direction, float cos_half_angle, float height)
+		{
+			memset(visible_bits, 0, (num + 31) / 32 * sizeof(visible_bits[0]));
+
+			float const sin_half_angle = std::sqrt(std::max(1 - cos_half_angle * cos_half_angle, 0.0f));
+			float const c[] = { apex.x(), apex.y(), apex.z(), direction.x(), direction.y(), direction.z(),
+				cos_half_angle, sin_half_angle, height };
+
+			switch (ActiveInstructionSet())
+			{
+#ifdef KLAYGE_DISPATCH_AVX512_SUPPORT
+			case SIMDIS_AVX512:
+				return IntersectAABBConeAVX512(visible_bits, boxes, num, c);
+#endif
+
+#ifdef KLAYGE_DISPATCH_AVX2_SUPPORT
+			case SIMDIS_AVX2:
+				return IntersectAABBConeAVX2(visible_bits, boxes, num, c);
+#endif
+
+#if defined(KLAYGE_SSE2_SUPPORT)
+			case SIMDIS_SSE2:
+				return IntersectAABBConeSSE2(visible_bits, boxes, num, c);
+#endif
+
+			default:
+				return IntersectAABBConeScalar(visible_bits, boxes, 0, num, c);
+			}
+		}
+
+		void AABBPlaneDistance(float* out, AABBoxSoA const & boxes, size_t num, Plane const & plane)
+		{
+			float const p[] = { plane.a(), plane.b(), plane.c(), plane.d() };
+			float const abs_p[] = { MathLib::abs(plane.a()), MathLib::abs(plane.b()), MathLib::abs(plane.c()) };
+
+			switch (ActiveInstructionSet())
+			{
+#ifdef KLAYGE_DISPATCH_AVX512_SUPPORT
+			case SIMDIS_AVX512:
+				AABBPlaneDistanceAVX512(out, boxes, num, p, abs_p);
+				break;
+#endif
+
+#ifdef KLAYGE_DISPATCH_AVX2_SUPPORT
+			case SIMDIS_AVX2:
+				AABBPlaneDistanceAVX2(out, boxes, num, p, abs_p);
+				break;
+#endif
+
+#if defined(KLAYGE_SSE2_SUPPORT)
+			case SIMDIS_SSE2:
+				AABBPlaneDistanceSSE2(out, boxes, num, p, abs_p);
+				break;
+#endif
+
+			default:
+				AABBPlaneDistanceScalar(out, boxes, 0, num, p, abs_p);
+				break;
+			}
+		}
+	}
+}
@@ -0,0 +1,267 @@
+/**
+ * @file SIMDBatchHalf.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KFL, a subproject of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+
+#include <KFL/KFL.hpp>
+#include <KFL/Half.hpp>
+
+#if defined(KLAYGE_CPU_X86) || defined(KLAYGE_CPU_X64)
+#include <immintrin.h>
+#endif
+
+#include <KFL/SIMDBatch.hpp>
+
+namespace
+{
+	using namespace KlayGE;
+
+	static_assert(sizeof(half) == sizeof(uint16_t), "half must be 16-bit.");
+
+	void FloatToHalfScalar(half* output, float const * input, size_t num)
+	{
+		for (size_t i = 0; i < num; ++ i)
+		{
+			output[i] = half(input[i]);
+		}
+	}
+
+	void HalfToFloatScalar(float* output, half const * input, size_t num)
+	{
+		for (size_t i = 0; i < num; ++ i)
+		{
+			output[i] = input[i];
+		}
+	}
+
+#if defined(KLAYGE_SSE2_SUPPORT)
+	// The same bit manipulations as half::half(float), 4 lanes at a time
+	__m128i FloatToHalf4SSE2(__m128 f)
+	{
+		__m128i const u = _mm_castps_si128(f);
+		__m128i const sign = _mm_and_si128(u, _mm_set1_epi32(0x80000000));
+		__m128i const a = _mm_xor_si128(u, sign);
+
+		// After removing the sign, signed comparisons are fine
+		__m128i const is_inf_nan = _mm_cmpgt_epi32(a, _mm_set1_epi32(((127 + 16) << 23) - 1));
+		__m128i const is_nan = _mm_cmpgt_epi32(a, _mm_set1_epi32(0x7F800000));
+		__m128i const is_denorm = _mm_cmplt_epi32(a, _mm_set1_epi32((127 - 14) << 23));
+
+		__m128i const nan_payload = _mm_and_si128(is_nan,
+			_mm_or_si128(_mm_set1_epi32(0x0200), _mm_and_si128(_mm_srli_epi32(a, 13), _mm_set1_epi32(0x03FF))));
+		__m128i const inf_nan = _mm_or_si128(_mm_set1_epi32(0x7C00), nan_payload);
+
+		__m128i const magic = _mm_set1_epi32((127 - 1) << 23);
+		__m128i const denorm = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(magic))), magic);
+
+		__m128i const mant_odd = _mm_and_si128(_mm_srli_epi32(a, 13), _mm_set1_epi32(1));
+		__m128i norm = _mm_sub_epi32(a, _mm_set1_epi32((127 - 15) << 23));
+		norm = _mm_add_epi32(norm, _mm_add_epi32(_mm_set1_epi32(0x0FFF), mant_odd));
+		norm = _mm_srli_epi32(norm, 13);
+
+		__m128i ret = _mm_or_si128(_mm_and_si128(is_denorm, denorm), _mm_andnot_si128(is_denorm, norm));
+		ret = _mm_or_si128(_mm_and_si128(is_inf_nan, inf_nan), _mm_andnot_si128(is_inf_nan, ret));
+		return _mm_or_si128(ret, _mm_srli_epi32(sign, 16));
+	}
+
+	__m128 HalfToFloat4SSE2(__m128i h)
+	{
+		__m128i const exp_mask = _mm_set1_epi32(0x1F << 23);
+		__m128i u = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x7FFF)), 13);
+		__m128i const e = _mm_and_si128(u, exp_mask);
+		u = _mm_add_epi32(u, _mm_set1_epi32((127 - 15) << 23));
+
+		__m128i const is_inf_nan = _mm_cmpeq_epi32(e, exp_mask);
+		__m128i const is_denorm = _mm_cmpeq_epi32(e, _mm_setzero_si128());
+
+		u = _mm_add_epi32(u, _mm_and_si128(is_inf_nan, _mm_set1_epi32((128 - 16) << 23)));
+		__m128i const is_nan = _mm_andnot_si128(_mm_cmpeq_epi32(_mm_and_si128(u, _mm_set1_epi32(0x007FFFFF)), _mm_setzero_si128()),
+			is_inf_nan);
+		u = _mm_or_si128(u, _mm_and_si128(is_nan, _mm_set1_epi32(0x00400000)));
+
+		__m128 const magic = _mm_castsi128_ps(_mm_set1_epi32((127 - 14) << 23));
+		__m128i const denorm = _mm_castps_si128(_mm_sub_ps(_mm_castsi128_ps(_mm_add_epi32(u, _mm_set1_epi32(1 << 23))), magic));
+		u = _mm_or_si128(_mm_and_si128(is_denorm, denorm), _mm_andnot_si128(is_denorm, u));
+
+		u = _mm_or_si128(u, _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x8000)), 16));
+		return _mm_castsi128_ps(u);
+	}
+
+	void FloatToHalfSSE2(half* output, float const * input, size_t num)
+	{
+		size_t const num_vec = num & ~static_cast<size_t>(7);
+		for (size_t i = 0; i < num_vec; i += 8)
+		{
+			__m128i lo = FloatToHalf4SSE2(_mm_loadu_ps(input + i + 0));
+			__m128i hi = FloatToHalf4SSE2(_mm_loadu_ps(input + i + 4));
+			// No _mm_packus_epi32 in SSE2. Sign extend the 16-bit values so the signed saturation keeps them.
+			lo = _mm_srai_epi32(_mm_slli_epi32(lo, 16), 16);
+			hi = _mm_srai_epi32(_mm_slli_epi32(hi, 16), 16);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), _mm_packs_epi32(lo, hi));
+		}
+
+		FloatToHalfScalar(output + num_vec, input + num_vec, num - num_vec);
+	}
+
+	void HalfToFloatSSE2(float* output, half const * input, size_t num)
+	{
+		__m128i const zero = _mm_setzero_si128();
+
+		size_t const num_vec = num & ~static_cast<size_t>(7);
+		for (size_t i = 0; i < num_vec; i += 8)
+		{
+			__m128i const h = _mm_loadu_si128(reinterpret_cast<__m128i const *>(input + i));
+			_mm_storeu_ps(output + i + 0, HalfToFloat4SSE2(_mm_unpacklo_epi16(h, zero)));
+			_mm_storeu_ps(output + i + 4, HalfToFloat4SSE2(_mm_unpackhi_epi16(h, zero)));
+		}
+
+		HalfToFloatScalar(output + num_vec, input + num_vec, num - num_vec);
+	}
+#endif
+
+#ifdef KLAYGE_DISPATCH_AVX2_SUPPORT
+	KLAYGE_TARGET_AVX2 void FloatToHalfAVX2(half* output, float const * input, size_t num)
+	{
+		size_t const num_vec = num & ~static_cast<size_t>(7);
+		for (size_t i = 0; i < num_vec; i += 8)
+		{
+			__m128i const h = _mm256_cvtps_ph(_mm256_loadu_ps(input + i), _MM_FROUND_TO_NEAREST_INT);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), h);
+		}
+
+		FloatToHalfScalar(output + num_vec, input + num_vec, num - num_vec);
+	}
+
+	KLAYGE_TARGET_AVX2 void HalfToFloatAVX2(float* output, half const * input, size_t num)
+	{
+		size_t const num_vec = num & ~static_cast<size_t>(7);
+		for (size_t i = 0; i < num_vec; i += 8)
+		{
+			__m128i const h = _mm_loadu_si128(reinterpret_cast<__m128i const *>(input + i));
+			_mm256_storeu_ps(output + i, _mm256_cvtph_ps(h));
+		}
+
+		HalfToFloatScalar(output + num_vec, input + num_vec, num - num_vec);
+	}
+#endif
+
+#ifdef KLAYGE_DISPATCH_AVX512_SUPPORT
+	// Masked 16-bit stores need AVX-512BW, so the tails stay scalar
+	KLAYGE_TARGET_AVX512 void FloatToHalfAVX512(half* output, float const * input, size_t num)
+	{
+		// The unmasked forms trip -Wmaybe-uninitialized in GCC's headers
+		__mmask16 const all_lanes = 0xFFFF;
+
+		size_t const num_vec = num & ~static_cast<size_t>(15);
+		for (size_t i = 0; i < num_vec; i += 16)
+		{
+			__m256i const h = _mm512_maskz_cvtps_ph(all_lanes, _mm512_loadu_ps(input + i), _MM_FROUND_TO_NEAREST_INT);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(output + i), h);
+		}
+
+		FloatToHalfScalar(output + num_vec, input + num_vec, num - num_vec);
+	}
+
+	KLAYGE_TARGET_AVX512 void HalfToFloatAVX512(float* output, half const * input, size_t num)
+	{
+		__mmask16 const all_lanes = 0xFFFF;
+
+		size_t const num_vec = num & ~static_cast<size_t>(15);
+		for (size_t i = 0; i < num_vec; i += 16)
+		{
+			__m256i const h = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(input + i));
+			_mm512_storeu_ps(output + i, _mm512_maskz_cvtph_ps(all_lanes, h));
+		}
+
+		HalfToFloatScalar(output + num_vec, input + num_vec, num - num_vec);
+	}
+#endif
+}
+
+namespace KlayGE
+{
+	namespace SIMDBatchLib
+	{
+		void FloatToHalf(half* output, float const * input, size_t num)
+		{
+			switch (ActiveInstructionSet())
+			{
+#ifdef KLAYGE_DISPATCH_AVX512_SUPPORT
+			case SIMDIS_AVX512:
+				FloatToHalfAVX512(output, input, num);
+				break;
+#endif
+
+#ifdef KLAYGE_DISPATCH_AVX2_SUPPORT
+			case SIMDIS_AVX2:
+				FloatToHalfAVX2(output, input, num);
+				break;
+#endif
+
+#if defined(KLAYGE_SSE2_SUPPORT)
+			case SIMDIS_SSE2:
+				FloatToHalfSSE2(output, input, num);
+				break;
+#endif
+
+			default:
+				FloatToHalfScalar(output, input, num);
+				break;
+			}
+		}
+
+		void HalfToFloat(float* output, half const * input, size_t num)
+		{
+			switch (ActiveInstructionSet())
+			{
+#ifdef KLAYGE_DISPATCH_AVX512_SUPPORT
+			case SIMDIS_AVX512:
+				HalfToFloatAVX512(output, input, num);
+				break;
+#endif
+
+#ifdef KLAYGE_DISPATCH_AVX2_SUPPORT
+			case SIMDIS_AVX2:
+				HalfToFloatAVX2(output, input, num);
+				break;
+#endif
+
+#if defined(KLAYGE_SSE2_SUPPORT)
+			case SIMDIS_SSE2:
+				HalfToFloatSSE2(output, input, num);
+				break;
+#endif
+
+			default:
+				HalfToFloatScalar(output, input, num);
+				break;
+			}
+		}
+	}
+}
@@ -0,0 +1,922 @@
+/**
+ * @file SIMDBatchNoise.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KFL, a subproject of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+
+#include <KFL/KFL.hpp>
+#include <KFL/Thread.hpp>
+
+#include <algorithm>
+#include <cmath>
+#if defined(KLAYGE_CPU_X86) || defined(KLAYGE_CPU_X64)
+#include <immintrin.h>
+#endif
+
+#include <KFL/SIMDBatch.hpp>
+
+namespace
+{
+	using namespace KlayGE;
+
+	float const F2 = 0.366025403784f;	// (sqrt(3) - 1) / 2
+	float const G2 = 0.211324865405f;	// (3 - sqrt(3)) / 6
+	float const F3 = 1 / 3.0f;
+	float const G3 = 1 / 6.0f;
+
+	// Multipliers of the lattice hash
+	uint32_t const HASH_I = 0x8DA6B343U;
+	uint32_t const HASH_J = 0xD8163841U;
+	uint32_t const HASH_K = 0xCB1AB31FU;
+	uint32_t const HASH_MIX = 0x7FEB352DU;
+
+	// Number of points the fBm and tileable functions process per octave. Small enough to stay in L1.
+	size_t const NOISE_CHUNK = 256;
+	uint32_t const NOISE_IMAGE_TILE_ROWS = 16;
+
+	// Scalar reference. The SIMD paths do the same operations in the same order.
+	///////////////////////////////////////////////////////////////////////////////
+
+	uint32_t HashLattice(int32_t i, int32_t j, int32_t k)
+	{
+		uint32_t h = (static_cast<uint32_t>(i) * HASH_I) ^ (static_cast<uint32_t>(j) * HASH_J)
+			^ (static_cast<uint32_t>(k) * HASH_K);
+		h ^= h >> 16;
+		h *= HASH_MIX;
+		h ^= h >> 15;
+		return h;
+	}
+
+	// The 12 gradients of MathLib::SimplexNoise, picked with the branchless form of improved Perlin noise
+	float Grad(uint32_t h, float x, float y, float z)
+	{
+		uint32_t const g = h >> 28;
+		float const u = (g < 8) ? x : y;
+		float const v = (g < 4) ? y : ((12 == (g & 13)) ? x : z);
+		return ((g & 1) ? -u : u) + ((g & 2) ? -v : v);
+	}
+
+	float Noise2Scalar(float x, float y)
+	{
+		float const s = (x + y) * F2;
+		float const fi = std::floor(x + s);
+		float const fj = std::floor(y + s);
+		float const t = (fi + fj) * G2;
+		float const x0 = x - (fi - t);
+		float const y0 = y - (fj - t);
+
+		float const fi1 = (x0 > y0) ? 1.0f : 0.0f;
+		float const fj1 = 1 - fi1;
+
+		float const x1 = (x0 - fi1) + G2;
+		float const y1 = (y0 - fj1) + G2;
+		float const x2 = x0 + (2 * G2 - 1);
+		float const y2 = y0 + (2 * G2 - 1);
+
+		int32_t const ii = static_cast<int32_t>(fi);
+		int32_t const jj = static_cast<int32_t>(fj);
+		int32_t const i1 = static_cast<int32_t>(fi1);
+		int32_t const j1 = static_cast<int32_t>(fj1);
+
+		float t0 = std::max((0.5f - x0 * x0) - y0 * y0, 0.0f);
+		float t1 = std::max((0.5f - x1 * x1) - y1 * y1, 0.0f);
+		float t2 = std::max((0.5f - x2 * x2) - y2 * y2, 0.0f);
+		t0 *= t0;
+		t1 *= t1;
+		t2 *= t2;
+		float const n0 = t0 * t0 * Grad(HashLattice(ii, jj, 0), x0, y0, 0);
+		float const n1 = t1 * t1 * Grad(HashLattice(ii + i1, jj + j1, 0), x1, y1, 0);
+		float const n2 = t2 * t2 * Grad(HashLattice(ii + 1, jj + 1, 0), x2, y2, 0);
+
+		return 70 * ((n0 + n1) + n2);
+	}
+
+	float Noise3Scalar(float x, float y, float z)
+	{
+		float const s = ((x + y) + z) * F3;
+		float const fi = std::floor(x + s);
+		float const fj = std::floor(y + s);
+		float const fk = std::floor(z + s);
+		float const t = ((fi + fj) + fk) * G3;
+		float const x0 = x - (fi - t);
+		float const y0 = y - (fj - t);
+		float const z0 = z - (fk - t);
+
+		// Branchless form of the order table in MathLib::SimplexNoise
+		bool const x_ge_y = (x0 >= y0);
+		bool const y_ge_z = (y0 >= z0);
+		bool const x_ge_z = (x0 >= z0);
+		int32_t const i1 = x_ge_y && x_ge_z;
+		int32_t const j1 = !x_ge_y && y_ge_z;
+		int32_t const k1 = !x_ge_z && !y_ge_z;
+		int32_t const i2 = x_ge_y || x_ge_z;
+		int32_t const j2 = !x_ge_y || y_ge_z;
+		int32_t const k2 = !(x_ge_z && y_ge_z);
+
+		float const x1 = (x0 - i1) + G3;
+		float const y1 = (y0 - j1) + G3;
+		float const z1 = (z0 - k1) + G3;
+		float const x2 = (x0 - i2) + 2 * G3;
+		float const y2 = (y0 - j2) + 2 * G3;
+		float const z2 = (z0 - k2) + 2 * G3;
+		float const x3 = x0 + (3 * G3 - 1);
+		float const y3 = y0 + (3 * G3 - 1);
+		float const z3 = z0 + (3 * G3 - 1);
+
+		int32_t const ii = static_cast<int32_t>(fi);
+		int32_t const jj = static_cast<int32_t>(fj);
+		int32_t const kk = static_cast<int32_t>(fk);
+
+		float t0 = std::max(((0.6f - x0 * x0) - y0 * y0) - z0 * z0, 0.0f);
+		float t1 = std::max(((0.6f - x1 * x1) - y1 * y1) - z1 * z1, 0.0f);
+		float t2 = std::max(((0.6f - x2 * x2) - y2 * y2) - z2 * z2, 0.0f);
+		float t3 = std::max(((0.6f - x3 * x3) - y3 * y3) - z3 * z3, 0.0f);
+		t0 *= t0;
+		t1 *= t1;
+		t2 *= t2;
+		t3 *= t3;
+		float const n0 = t0 * t0 * Grad(HashLattice(ii, jj, kk), x0, y0, z0);
+		float const n1 = t1 * t1 * Grad(HashLattice(ii + i1, jj + j1, kk + k1), x1, y1, z1);
+		float const n2 = t2 * t2 * Grad(HashLattice(ii + i2, jj + j2, kk + k2), x2, y2, z2);
+		float const n3 = t3 * t3 * Grad(HashLattice(ii + 1, jj + 1, kk + 1), x3, y3, z3);
+
+		return 32 * (((n0 + n1) + n2) + n3);
+	}
+
+	void Noise2Scalar(float* out, float const * x, float const * y, size_t num)
+	{
+		for (size_t i = 0; i < num; ++ i)
+		{
+			out[i] = Noise2Scalar(x[i], y[i]);
+		}
+	}
+
+	void Noise3Scalar(float* out, float const * x, float const * y, float const * z, size_t num)
+	{
+		for (size_t i = 0; i < num; ++ i)
+		{
+			out[i] = Noise3Scalar(x[i], y[i], z[i]);
+		}
+	}
+
+#if defined(KLAYGE_SSE2_SUPPORT)
+	// SSE2
+	///////////////////////////////////////////////////////////////////////////////
+
+	// No _mm_floor_ps before SSE4.1. Fine for |v| < 2^31, where the lattice coordinates are anyway.
+	__m128 FloorSSE2(__m128 v)
+	{
+		__m128 const t = _mm_cvtepi32_ps(_mm_cvttps_epi32(v));
+		return _mm_sub_ps(t, _mm_and_ps(_mm_cmplt_ps(v, t), _mm_set1_ps(1)));
+	}
+
+	// No _mm_mullo_epi32 before SSE4.1
+	__m128i MulLoSSE2(__m128i a, __m128i b)
+	{
+		__m128i const even = _mm_mul_epu32(a, b);
+		__m128i const odd = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+		return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+	}
+
+	__m128i MixHashSSE2(__m128i h)
+	{
+		h = _mm_xor_si128(h, _mm_srli_epi32(h, 16));
+		h = MulLoSSE2(h, _mm_set1_epi32(HASH_MIX));
+		return _mm_xor_si128(h, _mm_srli_epi32(h, 15));
+	}
+
+	__m128i HashLatticeSSE2(__m128i i, __m128i j)
+	{
+		return MixHashSSE2(_mm_xor_si128(MulLoSSE2(i, _mm_set1_epi32(HASH_I)), MulLoSSE2(j, _mm_set1_epi32(HASH_J))));
+	}
+
+	__m128i HashLatticeSSE2(__m128i i, __m128i j, __m128i k)
+	{
+		return MixHashSSE2(_mm_xor_si128(_mm_xor_si128(MulLoSSE2(i, _mm_set1_epi32(HASH_I)), MulLoSSE2(j, _mm_set1_epi32(HASH_J))),
+			MulLoSSE2(k, _mm_set1_epi32(HASH_K))));
+	}
+
+	__m128 SelectSSE2(__m128 mask, __m128 a, __m128 b)
+	{
+		return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+	}
+
+	__m128 GradSSE2(__m128i h, __m128 x, __m128 y, __m128 z)
+	{
+		__m128i const g = _mm_srli_epi32(h, 28);
+		__m128 const lt8 = _mm_castsi128_ps(_mm_cmplt_epi32(g, _mm_set1_epi32(8)));
+		__m128 const lt4 = _mm_castsi128_ps(_mm_cmplt_epi32(g, _mm_set1_epi32(4)));
+		__m128 const eq12_14 = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(g, _mm_set1_epi32(13)), _mm_set1_epi32(12)));
+		__m128 const u = SelectSSE2(lt8, x, y);
+		__m128 const v = SelectSSE2(lt4, y, SelectSSE2(eq12_14, x, z));
+		__m128 const u_sign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(g, _mm_set1_epi32(1)), 31));
+		__m128 const v_sign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(g, _mm_set1_epi32(2)), 30));
+		return _mm_add_ps(_mm_xor_ps(u, u_sign), _mm_xor_ps(v, v_sign));
+	}
+
+	__m128 CornerSSE2(__m128 r2, __m128 grad)
+	{
+		__m128 t = _mm_max_ps(r2, _mm_setzero_ps());
+		t = _mm_mul_ps(t, t);
+		return _mm_mul_ps(_mm_mul_ps(t, t), grad);
+	}
+
+	__m128 Noise2SSE2(__m128 x, __m128 y)
+	{
+		__m128 const s = _mm_mul_ps(_mm_add_ps(x, y), _mm_set1_ps(F2));
+		__m128 const fi = FloorSSE2(_mm_add_ps(x, s));
+		__m128 const fj = FloorSSE2(_mm_add_ps(y, s));
+		__m128 const t = _mm_mul_ps(_mm_add_ps(fi, fj), _mm_set1_ps(G2));
+		__m128 const x0 = _mm_sub_ps(x, _mm_sub_ps(fi, t));
+		__m128 const y0 = _mm_sub_ps(y, _mm_sub_ps(fj, t));
+
+		__m128 const one = _mm_set1_ps(1);
+		__m128 const i1_mask = _mm_cmpgt_ps(x0, y0);
+		__m128 const fi1 = _mm_and_ps(i1_mask, one);
+		__m128 const fj1 = _mm_sub_ps(one, fi1);
+
+		__m128 const x1 = _mm_add_ps(_mm_sub_ps(x0, fi1), _mm_set1_ps(G2));
+		__m128 const y1 = _mm_add_ps(_mm_sub_ps(y0, fj1), _mm_set1_ps(G2));
+		__m128 const x2 = _mm_add_ps(x0, _mm_set1_ps(2 * G2 - 1));
+		__m128 const y2 = _mm_add_ps(y0, _mm_set1_ps(2 * G2 - 1));
+
+		__m128i const ii = _mm_cvttps_epi32(fi);
+		__m128i const jj = _mm_cvttps_epi32(fj);
+		__m128i const i1 = _mm_cvttps_epi32(fi1);
+		__m128i const j1 = _mm_cvttps_epi32(fj1);
+		__m128i const int_one = _mm_set1_epi32(1);
+
+		__m128 const half = _mm_set1_ps(0.5f);
+		__m128 const n0 = CornerSSE2(_mm_sub_ps(_mm_sub_ps(half, _mm_mul_ps(x0, x0)), _mm_mul_ps(y0, y0)),
+			GradSSE2(HashLatticeSSE2(ii, jj), x0, y0, _mm_setzero_ps()));
+		__m128 const n1 = CornerSSE2(_mm_sub_ps(_mm_sub_ps(half, _mm_mul_ps(x1, x1)), _mm_mul_ps(y1, y1)),
+			GradSSE2(HashLatticeSSE2(_mm_add_epi32(ii, i1), _mm_add_epi32(jj, j1)), x1, y1, _mm_setzero_ps()));
+		__m128 const n2 = CornerSSE2(_mm_sub_ps(_mm_sub_ps(half, _mm_mul_ps(x2, x2)), _mm_mul_ps(y2, y2)),
+			GradSSE2(HashLatticeSSE2(_mm_add_epi32(ii, int_one), _mm_add_epi32(jj, int_one)), x2, y2, _mm_setzero_ps()));
+
+		return _mm_mul_ps(_mm_set1_ps(70), _mm_add_ps(_mm_add_ps(n0, n1), n2));
+	}
+
+	__m128 Noise3SSE2(__m128 x, __m128 y, __m128 z)
+	{
+		__m128 const s = _mm_mul_ps(_mm_add_ps(_mm_add_ps(x, y), z), _mm_set1_ps(F3));
+		__m128 const fi = FloorSSE2(_mm_add_ps(x, s));
+		__m128 const fj = FloorSSE2(_mm_add_ps(y, s));
+		__m128 const fk = FloorSSE2(_mm_add_ps(z, s));
+		__m128 const t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(fi, fj), fk), _mm_set1_ps(G3));
+		__m128 const x0 = _mm_sub_ps(x, _mm_sub_ps(fi, t));
+		__m128 const y0 = _mm_sub_ps(y, _mm_sub_ps(fj, t));
+		__m128 const z0 = _mm_sub_ps(z, _mm_sub_ps(fk, t));
+
+		__m128 const x_ge_y = _mm_cmpge_ps(x0, y0);
+		__m128 const y_ge_z = _mm_cmpge_ps(y0, z0);
+		__m128 const x_ge_z = _mm_cmpge_ps(x0, z0);
+		__m128 const one = _mm_set1_ps(1);
+		__m128 const fi1 = _mm_and_ps(_mm_and_ps(x_ge_y, x_ge_z), one);
+		__m128 const fj1 = _mm_and_ps(_mm_andnot_ps(x_ge_y, y_ge_z), one);
+		__m128 const fk1 = _mm_andnot_ps(_mm_or_ps(x_ge_z, y_ge_z), one);
+		__m128 const fi2 = _mm_and_ps(_mm_or_ps(x_ge_y, x_ge_z), one);
+		__m128 const fj2 = _mm_andnot_ps(_mm_andnot_ps(y_ge_z, x_ge_y), one);
+		__m128 const fk2 = _mm_andnot_ps(_mm_and_ps(x_ge_z, y_ge_z), one);
+
+		__m128 const g3 = _mm_set1_ps(G3);
+		__m128 const g3_2 = _mm_set1_ps(2 * G3);
+		__m128 const g3_3 = _mm_set1_ps(3 * G3 - 1);
+		__m128 const x1 = _mm_add_ps(_mm_sub_ps(x0, fi1), g3);
+		__m128 const y1 = _mm_add_ps(_mm_sub_ps(y0, fj1), g3);
+		__m128 const z1 = _mm_add_ps(_mm_sub_ps(z0, fk1), g3);
+		__m128 const x2 = _mm_add_ps(_mm_sub_ps(x0, fi2), g3_2);
+		__m128 const y2 = _mm_add_ps(_mm_sub_ps(y0, fj2), g3_2);
+		__m128 const z2 = _mm_add_ps(_mm_sub_ps(z0, fk2), g3_2);
+		__m128 const x3 = _mm_add_ps(x0, g3_3);
+		__m128 const y3 = _mm_add_ps(y0, g3_3);
+		__m128 const z3 = _mm_add_ps(z0, g3_3);
+
+		__m128i const ii = _mm_cvttps_epi32(fi);
+		__m128i const jj = _mm_cvttps_epi32(fj);
+		__m128i const kk = _mm_cvttps_epi32(fk);
+		__m128i const int_one = _mm_set1_epi32(1);
+
+		__m128 const r2 = _mm_set1_ps(0.6f);
+		__m128 const n0 = CornerSSE2(_mm_sub_ps(_mm_sub_ps(_mm_sub_ps(r2, _mm_mul_ps(x0, x0)), _mm_mul_ps(y0, y0)), _mm_mul_ps(z0, z0)),
+			GradSSE2(HashLatticeSSE2(ii, jj, kk), x0, y0, z0));
+		__m128 const n1 = CornerSSE2(_mm_sub_ps(_mm_sub_ps(_mm_sub_ps(r2, _mm_mul_ps(x1, x1)), _mm_mul_ps(y1, y1)), _mm_mul_ps(z1, z1)),
+			GradSSE2(HashLatticeSSE2(_mm_add_epi32(ii, _mm_cvttps_epi32(fi1)), _mm_add_epi32(jj, _mm_cvttps_epi32(fj1)),
+				_mm_add_epi32(kk, _mm_cvttps_epi32(fk1))), x1, y1, z1));
+		__m128 const n2 = CornerSSE2(_mm_sub_ps(_mm_sub_ps(_mm_sub_ps(r2, _mm_mul_ps(x2, x2)), _mm_mul_ps(y2, y2)), _mm_mul_ps(z2, z2)),
+			GradSSE2(HashLatticeSSE2(_mm_add_epi32(ii, _mm_cvttps_epi32(fi2)), _mm_add_epi32(jj, _mm_cvttps_epi32(fj2)),
+				_mm_add_epi32(kk, _mm_cvttps_epi32(fk2))), x2, y2, z2));
+		__m128 const n3 = CornerSSE2(_mm_sub_ps(_mm_sub_ps(_mm_sub_ps(r2, _mm_mul_ps(x3, x3)), _mm_mul_ps(y3, y3)), _mm_mul_ps(z3, z3)),
+			GradSSE2(HashLatticeSSE2(_mm_add_epi32(ii, int_one), _mm_add_epi32(jj, int_one), _mm_add_epi32(kk, int_one)), x3, y3, z3));
+
+		return _mm_mul_ps(_mm_set1_ps(32), _mm_add_ps(_mm_add_ps(_mm_add_ps(n0, n1), n2), n3));
+	}
+
+	void Noise2SSE2(float* out, float const * x, float const * y, size_t num)
+	{
+		size_t const num_vec = num & ~static_cast<size_t>(3);
+		for (size_t i = 0; i < num_vec; i += 4)
+		{
+			_mm_storeu_ps(out + i, Noise2SSE2(_mm_loadu_ps(x + i), _mm_loadu_ps(y + i)));
+		}
+
+		Noise2Scalar(out + num_vec, x + num_vec, y + num_vec, num - num_vec);
+	}
+
+	void Noise3SSE2(float* out, float const * x, float const * y, float const * z, size_t num)
+	{
+		size_t const num_vec = num & ~static_cast<size_t>(3);
+		for (size_t i = 0; i < num_vec; i += 4)
+		{
+			_mm_storeu_ps(out + i, Noise3SSE2(_mm_loadu_ps(x + i), _mm_loadu_ps(y + i), _mm_loadu_ps(z + i)));
+		}
+
+		Noise3Scalar(out + num_vec, x + num_vec, y + num_vec, z + num_vec, num - num_vec);
+	}
+#endif
+
+#ifdef KLAYGE_DISPATCH_AVX2_SUPPORT
+	// AVX2, 8 points per iteration. Written without FMA intrinsics to follow the scalar path, though the
+	// compiler may still fuse some multiply-adds, so the results can differ in the last bits.
+	///////////////////////////////////////////////////////////////////////////////
+
+	KLAYGE_TARGET_AVX2 __m256i MixHashAVX2(__m256i h)
+	{
+		h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+		h = _mm256_mullo_epi32(h, _mm256_set1_epi32(HASH_MIX));
+		return _mm256_xor_si256(h, _mm256_srli_epi32(h, 15));
+	}
+
+	KLAYGE_TARGET_AVX2 __m256i HashLatticeAVX2(__m256i i, __m256i j)
+	{
+		return MixHashAVX2(_mm256_xor_si256(_mm256_mullo_epi32(i, _mm256_set1_epi32(HASH_I)),
+			_mm256_mullo_epi32(j, _mm256_set1_epi32(HASH_J))));
+	}
+
+	KLAYGE_TARGET_AVX2 __m256i HashLatticeAVX2(__m256i i, __m256i j, __m256i k)
+	{
+		return MixHashAVX2(_mm256_xor_si256(_mm256_xor_si256(_mm256_mullo_epi32(i, _mm256_set1_epi32(HASH_I)),
+			_mm256_mullo_epi32(j, _mm256_set1_epi32(HASH_J))), _mm256_mullo_epi32(k, _mm256_set1_epi32(HASH_K))));
+	}
+
+	KLAYGE_TARGET_AVX2 __m256 GradAVX2(__m256i h, __m256 x, __m256 y, __m256 z)
+	{
+		__m256i const g = _mm256_srli_epi32(h, 28);
+		__m256 const lt8 = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(8), g));
+		__m256 const lt4 = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(4), g));
+		__m256 const eq12_14 = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(g, _mm256_set1_epi32(13)),
+			_mm256_set1_epi32(12)));
+		__m256 const u = _mm256_blendv_ps(y, x, lt8);
+		__m256 const v = _mm256_blendv_ps(_mm256_blendv_ps(z, x, eq12_14), y, lt4);
+		__m256 const u_sign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(g, _mm256_set1_epi32(1)), 31));
+		__m256 const v_sign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(g, _mm256_set1_epi32(2)), 30));
+		return _mm256_add_ps(_mm256_xor_ps(u, u_sign), _mm256_xor_ps(v, v_sign));
+	}
+
+	KLAYGE_TARGET_AVX2 __m256 CornerAVX2(__m256 r2, __m256 grad)
+	{
+		__m256 t = _mm256_max_ps(r2, _mm256_setzero_ps());
+		t = _mm256_mul_ps(t, t);
+		return _mm256_mul_ps(_mm256_mul_ps(t, t), grad);
+	}
+
+	KLAYGE_TARGET_AVX2 __m256 Noise2AVX2(__m256 x, __m256 y)
+	{
+		__m256 const s = _mm256_mul_ps(_mm256_add_ps(x, y), _mm256_set1_ps(F2));
+		__m256 const fi = _mm256_floor_ps(_mm256_add_ps(x, s));
+		__m256 const fj = _mm256_floor_ps(_mm256_add_ps(y, s));
+		__m256 const t = _mm256_mul_ps(_mm256_add_ps(fi, fj), _mm256_set1_ps(G2));
+		__m256 const x0 = _mm256_sub_ps(x, _mm256_sub_ps(fi, t));
+		__m256 const y0 = _mm256_sub_ps(y, _mm256_sub_ps(fj, t));
+
+		__m256 const one = _mm256_set1_ps(1);
+		__m256 const fi1 = _mm256_and_ps(_mm256_cmp_ps(x0, y0, _CMP_GT_OQ), one);
+		__m256 const fj1 = _mm256_sub_ps(one, fi1);
+
+		__m256 const x1 = _mm256_add_ps(_mm256_sub_ps(x0, fi1), _mm256_set1_ps(G2));
+		__m256 const y1 = _mm256_add_ps(_mm256_sub_ps(y0, fj1), _mm256_set1_ps(G2));
+		__m256 const x2 = _mm256_add_ps(x0, _mm256_set1_ps(2 * G2 - 1));
+		__m256 const y2 = _mm256_add_ps(y0, _mm256_set1_ps(2 * G2 - 1));
+
+		__m256i const ii = _mm256_cvttps_epi32(fi);
+		__m256i const jj = _mm256_cvttps_epi32(fj);
+		__m256i const int_one = _mm256_set1_epi32(1);
+
+		__m256 const half = _mm256_set1_ps(0.5f);
+		__m256 const zero = _mm256_setzero_ps();
+		__m256 const n0 = CornerAVX2(_mm256_sub_ps(_mm256_sub_ps(half, _mm256_mul_ps(x0, x0)), _mm256_mul_ps(y0, y0)),
+			GradAVX2(HashLatticeAVX2(ii, jj), x0, y0, zero));
+		__m256 const n1 = CornerAVX2(_mm256_sub_ps(_mm256_sub_ps(half, _mm256_mul_ps(x1, x1)), _mm256_mul_ps(y1, y1)),
+			GradAVX2(HashLatticeAVX2(_mm256_add_epi32(ii, _mm256_cvttps_epi32(fi1)), _mm256_add_epi32(jj, _mm256_cvttps_epi32(fj1))),
+				x1, y1, zero));
+		__m256 const n2 = CornerAVX2(_mm256_sub_ps(_mm256_sub_ps(half, _mm256_mul_ps(x2, x2)), _mm256_mul_ps(y2, y2)),
+			GradAVX2(HashLatticeAVX2(_mm256_add_epi32(ii, int_one), _mm256_add_epi32(jj, int_one)), x2, y2, zero));
+
+		return _mm256_mul_ps(_mm256_set1_ps(70), _mm256_add_ps(_mm256_add_ps(n0, n1), n2));
+	}
+
+	KLAYGE_TARGET_AVX2 __m256 Noise3AVX2(__m256 x, __m256 y, __m256 z)
+	{
+		__m256 const s = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(x, y), z), _mm256_set1_ps(F3));
+		__m256 const fi = _mm256_floor_ps(_mm256_add_ps(x, s));
+		__m256 const fj = _mm256_floor_ps(_mm256_add_ps(y, s));
+		__m256 const fk = _mm256_floor_ps(_mm256_add_ps(z, s));
+		__m256 const t = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(fi, fj), fk), _mm256_set1_ps(G3));
+		__m256 const x0 = _mm256_sub_ps(x, _mm256_sub_ps(fi, t));
+		__m256 const y0 = _mm256_sub_ps(y, _mm256_sub_ps(fj, t));
+		__m256 const z0 = _mm256_sub_ps(z, _mm256_sub_ps(fk, t));
+
+		__m256 const x_ge_y = _mm256_cmp_ps(x0, y0, _CMP_GE_OQ);
+		__m256 const y_ge_z = _mm256_cmp_ps(y0, z0, _CMP_GE_OQ);
+		__m256 const x_ge_z = _mm256_cmp_ps(x0, z0, _CMP_GE_OQ);
+		__m256 const one = _mm256_set1_ps(1);
+		__m256 const fi1 = _mm256_and_ps(_mm256_and_ps(x_ge_y, x_ge_z), one);
+		__m256 const fj1 = _mm256_and_ps(_mm256_andnot_ps(x_ge_y, y_ge_z), one);
+		__m256 const fk1 = _mm256_andnot_ps(_mm256_or_ps(x_ge_z, y_ge_z), one);
+		__m256 const fi2 = _mm256_and_ps(_mm256_or_ps(x_ge_y, x_ge_z), one);
+		__m256 const fj2 = _mm256_andnot_ps(_mm256_andnot_ps(y_ge_z, x_ge_y), one);
+		__m256 const fk2 = _mm256_andnot_ps(_mm256_and_ps(x_ge_z, y_ge_z), one);
+
+		__m256 const g3 = _mm256_set1_ps(G3);
+		__m256 const g3_2 = _mm256_set1_ps(2 * G3);
+		__m256 const g3_3 = _mm256_set1_ps(3 * G3 - 1);
+		__m256 const x1 = _mm256_add_ps(_mm256_sub_ps(x0, fi1), g3);
+		__m256 const y1 = _mm256_add_ps(_mm256_sub_ps(y0, fj1), g3);
+		__m256 const z1 = _mm256_add_ps(_mm256_sub_ps(z0, fk1), g3);
+		__m256 const x2 = _mm256_add_ps(_mm256_sub_ps(x0, fi2), g3_2);
+		__m256 const y2 = _mm256_add_ps(_mm256_sub_ps(y0, fj2), g3_2);
+		__m256 const z2 = _mm256_add_ps(_mm256_sub_ps(z0, fk2), g3_2);
+		__m256 const x3 = _mm256_add_ps(x0, g3_3);
+		__m256 const y3 = _mm256_add_ps(y0, g3_3);
+		__m256 const z3 = _mm256_add_ps(z0, g3_3);
+
+		__m256i const ii = _mm256_cvttps_epi32(fi);
+		__m256i const jj = _mm256_cvttps_epi32(fj);
+		__m256i const kk = _mm256_cvttps_epi32(fk);
+		__m256i const int_one = _mm256_set1_epi32(1);
+
+		__m256 const r2 = _mm256_set1_ps(0.6f);
+		__m256 const n0 = CornerAVX2(_mm256_sub_ps(_mm256_sub_ps(_mm256_sub_ps(r2, _mm256_mul_ps(x0, x0)), _mm256_mul_ps(y0, y0)),
+			_mm256_mul_ps(z0, z0)), GradAVX2(HashLatticeAVX2(ii, jj, kk), x0, y0, z0));
+		__m256 const n1 = CornerAVX2(_mm256_sub_ps(_mm256_sub_ps(_mm256_sub_ps(r2, _mm256_mul_ps(x1, x1)), _mm256_mul_ps(y1, y1)),
+			_mm256_mul_ps(z1, z1)), GradAVX2(HashLatticeAVX2(_mm256_add_epi32(ii, _mm256_cvttps_epi32(fi1)),
+				_mm256_add_epi32(jj, _mm256_cvttps_epi32(fj1)), _mm256_add_epi32(kk, _mm256_cvttps_epi32(fk1))), x1, y1, z1));
+		__m256 const n2 = CornerAVX2(_mm256_sub_ps(_mm256_sub_ps(_mm256_sub_ps(r2, _mm256_mul_ps(x2, x2)), _mm256_mul_ps(y2, y2)),
+			_mm256_mul_ps(z2, z2)), GradAVX2(HashLatticeAVX2(_mm256_add_epi32(ii, _mm256_cvttps_epi32(fi2)),
+				_mm256_add_epi32(jj, _mm256_cvttps_epi32(fj2)), _mm256_add_epi32(kk, _mm256_cvttps_epi32(fk2))), x2, y2, z2));
+		__m256 const n3 = CornerAVX2(_mm256_sub_ps(_mm256_sub_ps(_mm256_sub_ps(r2, _mm256_mul_ps(x3, x3)), _mm256_mul_ps(y3, y3)),
+			_mm256_mul_ps(z3, z3)), GradAVX2(HashLatticeAVX2(_mm256_add_epi32(ii, int_one), _mm256_add_epi32(jj, int_one),
+				_mm256_add_epi32(kk, int_one)), x3, y3, z3));
+
+		return _mm256_mul_ps(_mm256_set1_ps(32), _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(n0, n1), n2), n3));
+	}
+
+	KLAYGE_TARGET_AVX2 void Noise2AVX2(float* out, float const * x, float const * y, size_t num)
+	{
+		size_t const num_vec = num & ~static_cast<size_t>(7);
+		for (size_t i = 0; i < num_vec; i += 8)
+		{
+			_mm256_storeu_ps(out + i, Noise2AVX2(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+		}
+
+		Noise2Scalar(out + num_vec, x + num_vec, y + num_vec, num - num_vec);
+	}
+
+	KLAYGE_TARGET_AVX2 void Noise3AVX2(float* out, float const * x, float const * y, float const * z, size_t num)
+	{
+		size_t const num_vec = num & ~static_cast<size_t>(7);
+		for (size_t i = 0; i < num_vec; i += 8)
+		{
+			_mm256_storeu_ps(out + i, Noise3AVX2(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i), _mm256_loadu_ps(z + i)));
+		}
+
+		Noise3Scalar(out + num_vec, x + num_vec, y + num_vec, z + num_vec, num - num_vec);
+	}
+#endif
+
+#ifdef KLAYGE_DISPATCH_AVX512_SUPPORT
+	// AVX-512, 16 points per iteration, masked tails
+	///////////////////////////////////////////////////////////////////////////////
+
+	// The unmasked forms of some intrinsics trip -Wmaybe-uninitialized in GCC's headers.
+	// The zero-masking forms with all lanes enabled generate the same code.
+	__mmask16 const ALL_LANES = 0xFFFF;
+
+	KLAYGE_TARGET_AVX512 __m512 FloorAVX512(__m512 v)
+	{
+		return _mm512_maskz_roundscale_ps(ALL_LANES, v, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+	}
+
+	KLAYGE_TARGET_AVX512 __m512i MixHashAVX512(__m512i h)
+	{
+		h = _mm512_xor_si512(h, _mm512_maskz_srli_epi32(ALL_LANES, h, 16));
+		h = _mm512_mullo_epi32(h, _mm512_set1_epi32(HASH_MIX));
+		return _mm512_xor_si512(h, _mm512_maskz_srli_epi32(ALL_LANES, h, 15));
+	}
+
+	KLAYGE_TARGET_AVX512 __m512i HashLatticeAVX512(__m512i i, __m512i j)
+	{
+		return MixHashAVX512(_mm512_xor_si512(_mm512_mullo_epi32(i, _mm512_set1_epi32(HASH_I)),
+			_mm512_mullo_epi32(j, _mm512_set1_epi32(HASH_J))));
+	}
+
+	KLAYGE_TARGET_AVX512 __m512i HashLatticeAVX512(__m512i i, __m512i j, __m512i k)
+	{
+		return MixHashAVX512(_mm512_xor_si512(_mm512_xor_si512(_mm512_mullo_epi32(i, _mm512_set1_epi32(HASH_I)),
+			_mm512_mullo_epi32(j, _mm512_set1_epi32(HASH_J))), _mm512_mullo_epi32(k, _mm512_set1_epi32(HASH_K))));
+	}
+
+	KLAYGE_TARGET_AVX512 __m512 GradAVX512(__m512i h, __m512 x, __m512 y, __m512 z)
+	{
+		__m512i const g = _mm512_maskz_srli_epi32(ALL_LANES, h, 28);
+		__mmask16 const lt8 = _mm512_cmplt_epi32_mask(g, _mm512_set1_epi32(8));
+		__mmask16 const lt4 = _mm512_cmplt_epi32_mask(g, _mm512_set1_epi32(4));
+		__mmask16 const eq12_14 = _mm512_cmpeq_epi32_mask(_mm512_and_si512(g, _mm512_set1_epi32(13)), _mm512_set1_epi32(12));
+		__m512 const u = _mm512_mask_blend_ps(lt8, y, x);
+		__m512 const v = _mm512_mask_blend_ps(lt4, _mm512_mask_blend_ps(eq12_14, z, x), y);
+		__m512i const u_sign = _mm512_maskz_slli_epi32(ALL_LANES, _mm512_and_si512(g, _mm512_set1_epi32(1)), 31);
+		__m512i const v_sign = _mm512_maskz_slli_epi32(ALL_LANES, _mm512_and_si512(g, _mm512_set1_epi32(2)), 30);
+		return _mm512_add_ps(_mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(u), u_sign)),
+			_mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(v), v_sign)));
+	}
+
+	KLAYGE_TARGET_AVX512 __m512 CornerAVX512(__m512 r2, __m512 grad)
+	{
+		__m512 t = _mm512_maskz_max_ps(ALL_LANES, r2, _mm512_setzero_ps());
+		t = _mm512_mul_ps(t, t);
+		return _mm512_mul_ps(_mm512_mul_ps(t, t), grad);
+	}
+
+	KLAYGE_TARGET_AVX512 __m512 Noise2AVX512(__m512 x, __m512 y)
+	{
+		__m512 const s = _mm512_mul_ps(_mm512_add_ps(x, y), _mm512_set1_ps(F2));
+		__m512 const fi = FloorAVX512(_mm512_add_ps(x, s));
+		__m512 const fj = FloorAVX512(_mm512_add_ps(y, s));
+		__m512 const t = _mm512_mul_ps(_mm512_add_ps(fi, fj), _mm512_set1_ps(G2));
+		__m512 const x0 = _mm512_sub_ps(x, _mm512_sub_ps(fi, t));
+		__m512 const y0 = _mm512_sub_ps(y, _mm512_sub_ps(fj, t));
+
+		__mmask16 const i1_mask = _mm512_cmp_ps_mask(x0, y0, _CMP_GT_OQ);
+		__m512 const one = _mm512_set1_ps(1);
+		__m512 const fi1 = _mm512_maskz_mov_ps(i1_mask, one);
+		__m512 const fj1 = _mm512_sub_ps(one, fi1);
+
+		__m512 const x1 = _mm512_add_ps(_mm512_sub_ps(x0, fi1), _mm512_set1_ps(G2));
+		__m512 const y1 = _mm512_add_ps(_mm512_sub_ps(y0, fj1), _mm512_set1_ps(G2));
+		__m512 const x2 = _mm512_add_ps(x0, _mm512_set1_ps(2 * G2 - 1));
+		__m512 const y2 = _mm512_add_ps(y0, _mm512_set1_ps(2 * G2 - 1));
+
+		__m512i const ii = _mm512_maskz_cvttps_epi32(ALL_LANES, fi);
+		__m512i const jj = _mm512_maskz_cvttps_epi32(ALL_LANES, fj);
+		__m512i const int_one = _mm512_set1_epi32(1);
+		__m512i const i1 = _mm512_maskz_mov_epi32(i1_mask, int_one);
+		__m512i const j1 = _mm512_sub_epi32(int_one, i1);
+
+		__m512 const half = _mm512_set1_ps(0.5f);
+		__m512 const zero = _mm512_setzero_ps();
+		__m512 const n0 = CornerAVX512(_mm512_sub_ps(_mm512_sub_ps(half, _mm512_mul_ps(x0, x0)), _mm512_mul_ps(y0, y0)),
+			GradAVX512(HashLatticeAVX512(ii, jj), x0, y0, zero));
+		__m512 const n1 = CornerAVX512(_mm512_sub_ps(_mm512_sub_ps(half, _mm512_mul_ps(x1, x1)), _mm512_mul_ps(y1, y1)),
+			GradAVX512(HashLatticeAVX512(_mm512_add_epi32(ii, i1), _mm512_add_epi32(jj, j1)), x1, y1, zero));
+		__m512 const n2 = CornerAVX512(_mm512_sub_ps(_mm512_sub_ps(half, _mm512_mul_ps(x2, x2)), _mm512_mul_ps(y2, y2)),
+			GradAVX512(HashLatticeAVX512(_mm512_add_epi32(ii, int_one), _mm512_add_epi32(jj, int_one)), x2, y2, zero));
+
+		return _mm512_mul_ps(_mm512_set1_ps(70), _mm512_add_ps(_mm512_add_ps(n0, n1), n2));
+	}
+
+	KLAYGE_TARGET_AVX512 __m512 Noise3AVX512(__m512 x, __m512 y, __m512 z)
+	{
+		__m512 const s = _mm512_mul_ps(_mm512_add_ps(_mm512_add_ps(x, y), z), _mm512_set1_ps(F3));
+		__m512 const fi = FloorAVX512(_mm512_add_ps(x, s));
+		__m512 const fj = FloorAVX512(_mm512_add_ps(y, s));
+		__m512 const fk = FloorAVX512(_mm512_add_ps(z, s));
+		__m512 const t = _mm512_mul_ps(_mm512_add_ps(_mm512_add_ps(fi, fj), fk), _mm512_set1_ps(G3));
+		__m512 const x0 = _mm512_sub_ps(x, _mm512_sub_ps(fi, t));
+		__m512 const y0 = _mm512_sub_ps(y, _mm512_sub_ps(fj, t));
+		__m512 const z0 = _mm512_sub_ps(z, _mm512_sub_ps(fk, t));
+
+		__mmask16 const x_ge_y = _mm512_cmp_ps_mask(x0, y0, _CMP_GE_OQ);
+		__mmask16 const y_ge_z = _mm512_cmp_ps_mask(y0, z0, _CMP_GE_OQ);
+		__mmask16 const x_ge_z = _mm512_cmp_ps_mask(x0, z0, _CMP_GE_OQ);
+		__mmask16 const i1 = x_ge_y & x_ge_z;
+		__mmask16 const j1 = static_cast<__mmask16>(~x_ge_y) & y_ge_z;
+		__mmask16 const k1 = static_cast<__mmask16>(~(x_ge_z | y_ge_z));
+		__mmask16 const i2 = x_ge_y | x_ge_z;
+		__mmask16 const j2 = static_cast<__mmask16>(~x_ge_y) | y_ge_z;
+		__mmask16 const k2 = static_cast<__mmask16>(~(x_ge_z & y_ge_z));
+
+		__m512 const one = _mm512_set1_ps(1);
+		__m512 const g3 = _mm512_set1_ps(G3);
+		__m512 const g3_2 = _mm512_set1_ps(2 * G3);
+		__m512 const g3_3 = _mm512_set1_ps(3 * G3 - 1);
+		__m512 const x1 = _mm512_add_ps(_mm512_sub_ps(x0, _mm512_maskz_mov_ps(i1, one)), g3);
+		__m512 const y1 = _mm512_add_ps(_mm512_sub_ps(y0, _mm512_maskz_mov_ps(j1, one)), g3);
+		__m512 const z1 = _mm512_add_ps(_mm512_sub_ps(z0, _mm512_maskz_mov_ps(k1, one)), g3);
+		__m512 const x2 = _mm512_add_ps(_mm512_sub_ps(x0, _mm512_maskz_mov_ps(i2, one)), g3_2);
+		__m512 const y2 = _mm512_add_ps(_mm512_sub_ps(y0, _mm512_maskz_mov_ps(j2, one)), g3_2);
+		__m512 const z2 = _mm512_add_ps(_mm512_sub_ps(z0, _mm512_maskz_mov_ps(k2, one)), g3_2);
+		__m512 const x3 = _mm512_add_ps(x0, g3_3);
+		__m512 const y3 = _mm512_add_ps(y0, g3_3);
+		__m512 const z3 = _mm512_add_ps(z0, g3_3);
+
+		__m512i const ii = _mm512_maskz_cvttps_epi32(ALL_LANES, fi);
+		__m512i const jj = _mm512_maskz_cvttps_epi32(ALL_LANES, fj);
+		__m512i const kk = _mm512_maskz_cvttps_epi32(ALL_LANES, fk);
+		__m512i const int_one = _mm512_set1_epi32(1);
+
+		__m512 const r2 = _mm512_set1_ps(0.6f);
+		__m512 const n0 = CornerAVX512(_mm512_sub_ps(_mm512_sub_ps(_mm512_sub_ps(r2, _mm512_mul_ps(x0, x0)), _mm512_mul_ps(y0, y0)),
+			_mm512_mul_ps(z0, z0)), GradAVX512(HashLatticeAVX512(ii, jj, kk), x0, y0, z0));
+		__m512 const n1 = CornerAVX512(_mm512_sub_ps(_mm512_sub_ps(_mm512_sub_ps(r2, _mm512_mul_ps(x1, x1)), _mm512_mul_ps(y1, y1)),
+			_mm512_mul_ps(z1, z1)), GradAVX512(HashLatticeAVX512(_mm512_mask_add_epi32(ii, i1, ii, int_one),
+				_mm512_mask_add_epi32(jj, j1, jj, int_one), _mm512_mask_add_epi32(kk, k1, kk, int_one)), x1, y1, z1));
+		__m512 const n2 = CornerAVX512(_mm512_sub_ps(_mm512_sub_ps(_mm512_sub_ps(r2, _mm512_mul_ps(x2, x2)), _mm512_mul_ps(y2, y2)),
+			_mm512_mul_ps(z2, z2)), GradAVX512(HashLatticeAVX512(_mm512_mask_add_epi32(ii, i2, ii, int_one),
+				_mm512_mask_add_epi32(jj, j2, jj, int_one), _mm512_mask_add_epi32(kk, k2, kk, int_one)), x2, y2, z2));
+		__m512 const n3 = CornerAVX512(_mm512_sub_ps(_mm512_sub_ps(_mm512_sub_ps(r2, _mm512_mul_ps(x3, x3)), _mm512_mul_ps(y3, y3)),
+			_mm512_mul_ps(z3, z3)), GradAVX512(HashLatticeAVX512(_mm512_add_epi32(ii, int_one), _mm512_add_epi32(jj, int_one),
+				_mm512_add_epi32(kk, int_one)), x3, y3, z3));
+
+		return _mm512_mul_ps(_mm512_set1_ps(32), _mm512_add_ps(_mm512_add_ps(_mm512_add_ps(n0, n1), n2), n3));
+	}
+
+	KLAYGE_TARGET_AVX512 void Noise2AVX512(float* out, float const * x, float const * y, size_t num)
+	{
+		for (size_t i = 0; i < num; i += 16)
+		{
+			__mmask16 const mask = (num - i >= 16) ? ALL_LANES : static_cast<__mmask16>((1U << (num - i)) - 1);
+			_mm512_mask_storeu_ps(out + i, mask, Noise2AVX512(_mm512_maskz_loadu_ps(mask, x + i), _mm512_maskz_loadu_ps(mask, y + i)));
+		}
+	}
+
+	KLAYGE_TARGET_AVX512 void Noise3AVX512(float* out, float const * x, float const * y, float const * z, size_t num)
+	{
+		for (size_t i = 0; i < num; i += 16)
+		{
+			__mmask16 const mask = (num - i >= 16) ? ALL_LANES : static_cast<__mmask16>((1U << (num - i)) - 1);
+			_mm512_mask_storeu_ps(out + i, mask, Noise3AVX512(_mm512_maskz_loadu_ps(mask, x + i),
+				_mm512_maskz_loadu_ps(mask, y + i), _mm512_maskz_loadu_ps(mask, z + i)));
+		}
+	}
+#endif
+}
+
+namespace KlayGE
+{
+	namespace SIMDBatchLib
+	{
+		void SimplexNoise(float* out, float const * x, float const * y, size_t num)
+		{
+			switch (ActiveInstructionSet())
+			{
+#ifdef KLAYGE_DISPATCH_AVX512_SUPPORT
+			case SIMDIS_AVX512:
+				Noise2AVX512(out, x, y, num);
+				break;
+#endif
+
+#ifdef KLAYGE_DISPATCH_AVX2_SUPPORT
+			case SIMDIS_AVX2:
+				Noise2AVX2(out, x, y, num);
+				break;
+#endif
+
+#if defined(KLAYGE_SSE2_SUPPORT)
+			case SIMDIS_SSE2:
+				Noise2SSE2(out, x, y, num);
+				break;
+#endif
+
+			default:
+				Noise2Scalar(out, x, y, num);
+				break;
+			}
+		}
+
+		void SimplexNoise(float* out, float const * x, float const * y, float const * z, size_t num)
+		{
+			switch (ActiveInstructionSet())
+			{
+#ifdef KLAYGE_DISPATCH_AVX512_SUPPORT
+			case SIMDIS_AVX512:
+				Noise3AVX512(out, x, y, z, num);
+				break;
+#endif
+
+#ifdef KLAYGE_DISPATCH_AVX2_SUPPORT
+			case SIMDIS_AVX2:
+				Noise3AVX2(out, x, y, z, num);
+				break;
+#endif
+
+#if defined(KLAYGE_SSE2_SUPPORT)
+			case SIMDIS_SSE2:
+				Noise3SSE2(out, x, y, z, num);
+				break;
+#endif
+
+			default:
+				Noise3Scalar(out, x, y, z, num);
+				break;
+			}
+		}
+
+		void SimplexFBm(float* out, float const * x, float const * y, size_t num,
+			int octaves, float lacunarity, float gain)
+		{
+			float sx[NOISE_CHUNK];
+			float sy[NOISE_CHUNK];
+			float n[NOISE_CHUNK];
+			for (size_t begin = 0; begin < num; begin += NOISE_CHUNK)
+			{
+				size_t const count = std::min(num - begin, NOISE_CHUNK);
+				float* sum = out + begin;
+				for (size_t i = 0; i < count; ++ i)
+				{
+					sx[i] = x[begin + i];
+					sy[i] = y[begin + i];
+					sum[i] = 0;
+				}
+
+				float amp = 1;
+				float amp_sum = 0;
+				for (int o = 0; o < octaves; ++ o)
+				{
+					SimplexNoise(n, sx, sy, count);
+					for (size_t i = 0; i < count; ++ i)
+					{
+						sum[i] += n[i] * amp;
+						sx[i] *= lacunarity;
+						sy[i] *= lacunarity;
+					}
+					amp_sum += amp;
+					amp *= gain;
+				}
+
+				float const inv_amp_sum = 1 / amp_sum;
+				for (size_t i = 0; i < count; ++ i)
+				{
+					sum[i] *= inv_amp_sum;
+				}
+			}
+		}
+
+		void SimplexFBm(float* out, float const * x, float const * y, float const * z, size_t num,
+			int octaves, float lacunarity, float gain)
+		{
+			float sx[NOISE_CHUNK];
+			float sy[NOISE_CHUNK];
+			float sz[NOISE_CHUNK];
+			float n[NOISE_CHUNK];
+			for (size_t begin = 0; begin < num; begin += NOISE_CHUNK)
+			{
+				size_t const count = std::min(num - begin, NOISE_CHUNK);
+				float* sum = out + begin;
+				for (size_t i = 0; i < count; ++ i)
+				{
+					sx[i] = x[begin + i];
+					sy[i] = y[begin + i];
+					sz[i] = z[begin + i];
+					sum[i] = 0;
+				}
+
+				float amp = 1;
+				float amp_sum = 0;
+				for (int o = 0; o < octaves; ++ o)
+				{
+					SimplexNoise(n, sx, sy, sz, count);
+					for (size_t i = 0; i < count; ++ i)
+					{
+						sum[i] += n[i] * amp;
+						sx[i] *= lacunarity;
+						sy[i] *= lacunarity;
+						sz[i] *= lacunarity;
+					}
+					amp_sum += amp;
+					amp *= gain;
+				}
+
+				float const inv_amp_sum = 1 / amp_sum;
+				for (size_t i = 0; i < count; ++ i)
+				{
+					sum[i] *= inv_amp_sum;
+				}
+			}
+		}
+
+		void SimplexTileableFBm(float* out, float const * x, float const * y, size_t num, float w, float h,
+			int octaves, float lacunarity, float gain)
+		{
+			float sx[NOISE_CHUNK];
+			float sy[NOISE_CHUNK];
+			float wx[NOISE_CHUNK];
+			float hy[NOISE_CHUNK];
+			float n[4][NOISE_CHUNK];
+			for (size_t begin = 0; begin < num; begin += NOISE_CHUNK)
+			{
+				size_t const count = std::min(num - begin, NOISE_CHUNK);
+				float* sum = out + begin;
+				for (size_t i = 0; i < count; ++ i)
+				{
+					sx[i] = x[begin + i];
+					sy[i] = y[begin + i];
+					sum[i] = 0;
+				}
+
+				float amp = 1;
+				float amp_sum = 0;
+				for (int o = 0; o < octaves; ++ o)
+				{
+					// The 4 shifted copies of tileable_noise, blended bilinearly
+					for (size_t i = 0; i < count; ++ i)
+					{
+						wx[i] = sx[i] - w;
+						hy[i] = sy[i] - h;
+					}
+					SimplexNoise(n[0], sx, sy, count);
+					SimplexNoise(n[1], wx, sy, count);
+					SimplexNoise(n[2], sx, hy, count);
+					SimplexNoise(n[3], wx, hy, count);
+
+					float const inv_area = 1 / (w * h);
+					for (size_t i = 0; i < count; ++ i)
+					{
+						float const tn = (n[0][i] * (w - sx[i]) * (h - sy[i])
+							+ n[1][i] * sx[i] * (h - sy[i])
+							+ n[2][i] * (w - sx[i]) * sy[i]
+							+ n[3][i] * sx[i] * sy[i]) * inv_area;
+						sum[i] += tn * amp;
+						sx[i] *= lacunarity;
+						sy[i] *= lacunarity;
+					}
+					amp_sum += amp;
+					w *= lacunarity;
+					h *= lacunarity;
+					amp *= gain;
+				}
+
+				float const inv_amp_sum = 1 / amp_sum;
+				for (size_t i = 0; i < count; ++ i)
+				{
+					sum[i] *= inv_amp_sum;
+				}
+			}
+		}
+
+		void SimplexFBmImage(float* out, uint32_t width, uint32_t height, float offset_x, float offset_y,
+			float frequency, bool tileable, int octaves, float lacunarity, float gain, thread_pool& tp)
+		{
+			float const scale_x = frequency / width;
+			float const scale_y = frequency / height;
+			parallel_for_tiles(tp, height, NOISE_IMAGE_TILE_ROWS,
+				[=](size_t row_begin, size_t row_end)
+				{
+					std::vector<float> xs(width);
+					std::vector<float> ys(width);
+					for (uint32_t x = 0; x < width; ++ x)
+					{
+						xs[x] = (x + offset_x + 0.5f) * scale_x;
+					}
+
+					for (size_t y = row_begin; y < row_end; ++ y)
+					{
+						std::fill(ys.begin(), ys.end(), (y + offset_y + 0.5f) * scale_y);
+						float* row = out + y * width;
+						if (tileable)
+						{
+							SimplexTileableFBm(row, &xs[0], &ys[0], width, frequency, frequency, octaves, lacunarity, gain);
+						}
+						else
+						{
+							SimplexFBm(row, &xs[0], &ys[0], width, octaves, lacunarity, gain);
+						}
+					}
+				});
+		}
+	}
+}
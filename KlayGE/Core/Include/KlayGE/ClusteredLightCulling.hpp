@@ -0,0 +1,152 @@
+/**
+ * @file ClusteredLightCulling.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef _CLUSTEREDLIGHTCULLING_HPP
+#define _CLUSTEREDLIGHTCULLING_HPP
+
+#pragma once
+
+#include <KlayGE/PreDeclare.hpp>
+#include <KFL/Math.hpp>
+
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+namespace KlayGE
+{
+	// Bins the lights into clusters, the cells of a view space grid of screen tiles and exponential depth slices. Each
+	// cluster gets a compact list of the lights touching it, so the shading reads only those lights in one pass
+	// instead of testing every light per tile. The lights are tested against the bounds of the clusters with the
+	// SIMD kernels of SIMDBatchLib, spheres for the point and area lights and cones for the spot lights.
+	//
+	// Everything is in the view space of a left handed perspective projection.
+	class KLAYGE_CORE_API ClusteredLightCulling : boost::noncopyable
+	{
+	public:
+		ClusteredLightCulling();
+
+		// The screen is split into tiles of tile_size pixels, and the depth between the near and far planes of proj into
+		// num_slices slices. The bounds of the clusters are only rebuilt if the parameters changed.
+		void Setup(uint32_t width, uint32_t height, uint32_t tile_size, uint32_t num_slices, float4x4 const & proj);
+
+		void ClearLights();
+		// index is what goes into the lists, such as the position of the light in the arrays of the shader
+		void AddPointLight(uint32_t index, float3 const & pos, float range);
+		void AddSpotLight(uint32_t index, float3 const & pos, float3 const & dir, float cos_outer, float range);
+
+		void Build();
+		void Build(thread_pool& tp);
+
+		uint32_t TilesX() const
+		{
+			return tiles_x_;
+		}
+		uint32_t TilesY() const
+		{
+			return tiles_y_;
+		}
+		uint32_t NumSlices() const
+		{
+			return num_slices_;
+		}
+		uint32_t NumClusters() const
+		{
+			return tiles_x_ * tiles_y_ * num_slices_;
+		}
+		uint32_t ClusterIndex(uint32_t x, uint32_t y, uint32_t slice) const
+		{
+			return (slice * tiles_y_ + y) * tiles_x_ + x;
+		}
+		// The slice of a view depth is floor(log(z) * scale + bias)
+		float2 const & SliceScaleBias() const
+		{
+			return slice_scale_bias_;
+		}
+		uint32_t Slice(float z) const;
+		AABBox ClusterBound(uint32_t cluster) const;
+
+		// The offset into LightIndices() and the number of the lights, per cluster
+		std::vector<uint2> const & ClusterRanges() const
+		{
+			return cluster_ranges_;
+		}
+		std::vector<uint32_t> const & LightIndices() const
+		{
+			return light_indices_;
+		}
+
+	private:
+		void BinLights(size_t begin, size_t end);
+		void CompactLists();
+
+	private:
+		uint32_t width_;
+		uint32_t height_;
+		uint32_t tile_size_;
+		float4x4 proj_;
+
+		uint32_t tiles_x_;
+		uint32_t tiles_y_;
+		uint32_t num_slices_;
+		float near_plane_;
+		float far_plane_;
+		float2 slice_scale_bias_;
+
+		// Bounds of the clusters, slice by slice
+		std::vector<float> center_x_;
+		std::vector<float> center_y_;
+		std::vector<float> center_z_;
+		std::vector<float> extent_x_;
+		std::vector<float> extent_y_;
+		std::vector<float> extent_z_;
+
+		struct Light
+		{
+			uint32_t index;
+			bool spot;
+			float3 pos;
+			float3 dir;
+			float cos_outer;
+			float range;
+
+			// The clusters touched, bits from the first cluster of the first slice in range
+			uint32_t first_cluster;
+			uint32_t num_clusters;
+			std::vector<uint32_t> bits;
+		};
+		std::vector<Light> lights_;
+
+		std::vector<uint2> cluster_ranges_;
+		std::vector<uint32_t> light_indices_;
+	};
+}
+
+#endif		// _CLUSTEREDLIGHTCULLING_HPP
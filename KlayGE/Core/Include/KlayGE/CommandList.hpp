@@ -0,0 +1,163 @@
+/**
+ * @file CommandList.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef _COMMANDLIST_HPP
+#define _COMMANDLIST_HPP
+
+#pragma once
+
+#include <KlayGE/PreDeclare.hpp>
+#include <KlayGE/RenderEffect.hpp>
+
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+namespace KlayGE
+{
+	// Records draws and dispatches on any thread, and replays them on the thread owning the device. Between Begin()
+	// and End(), RenderEngine::Render, Dispatch, DispatchIndirect and BindFrameBuffer called on the recording thread
+	// go into the list, so Renderable::Render records without any change. Lists are submitted in order.
+	//
+	// The constant buffers and the resource parameters of an effect are captured with each command, only the ones
+	// changed since the last command of the list are stored. So an effect could be set up again for every draw, but
+	// it mustn't be written by two threads at the same time. Effects, techniques and layouts must live until the
+	// list is submitted.
+	//
+	// Anything else touching the device, such as mapping a buffer, must go through Execute(), which runs the
+	// function in order when the list is submitted.
+	class KLAYGE_CORE_API CommandList : boost::noncopyable
+	{
+	public:
+		CommandList();
+		virtual ~CommandList();
+
+		// The list being recorded on the calling thread, or nullptr
+		static CommandList* Recording();
+
+		void Begin();
+		void End();
+		// Drops the commands. A list could be recorded and submitted again without resetting.
+		void Reset();
+
+		bool Empty() const
+		{
+			return commands_.empty();
+		}
+		uint32_t NumCommands() const
+		{
+			return static_cast<uint32_t>(commands_.size());
+		}
+
+		void BindFrameBuffer(FrameBufferPtr const & fb);
+		// The frame buffer bound last in the list, or nullptr to use the one of the render engine
+		FrameBufferPtr const & CurFrameBuffer() const
+		{
+			return cur_frame_buffer_;
+		}
+
+		void Render(RenderEffect const & effect, RenderTechnique const & tech, RenderLayout const & rl);
+		void Dispatch(RenderEffect const & effect, RenderTechnique const & tech, uint32_t tgx, uint32_t tgy, uint32_t tgz);
+		void DispatchIndirect(RenderEffect const & effect, RenderTechnique const & tech,
+			GraphicsBufferPtr const & buff_args, uint32_t offset);
+		void Execute(std::function<void()> const & func);
+
+		// Replays the commands on the calling thread. Must be called on the thread owning the device.
+		virtual void Submit();
+
+	private:
+		enum CommandType
+		{
+			CT_BindFrameBuffer,
+			CT_Render,
+			CT_Dispatch,
+			CT_DispatchIndirect,
+			CT_Execute
+		};
+
+		struct Command
+		{
+			CommandType type;
+			RenderEffect const * effect;
+			RenderTechnique const * tech;
+			RenderLayout const * rl;
+			uint32_t args[3];
+			// Index of the frame buffer, the indirect args or the function
+			uint32_t index;
+
+			uint32_t first_cbuff;
+			uint32_t num_cbuffs;
+			uint32_t first_resource;
+			uint32_t num_resources;
+		};
+
+		// The bytes are in cbuff_data_
+		struct CBufferSnapshot
+		{
+			RenderEffectConstantBuffer* cbuff;
+			uint32_t offset;
+			uint32_t size;
+		};
+
+		struct ResourceSnapshot
+		{
+			RenderEffectParameter* param;
+			TextureSubresource tex;
+			SamplerStateObjectPtr sampler;
+			GraphicsBufferPtr buff;
+		};
+
+		Command& AddCommand(CommandType type, RenderEffect const * effect, RenderTechnique const * tech);
+		void CaptureEffect(Command& cmd, RenderEffect const & effect);
+		void RestoreEffect(Command const & cmd);
+
+	private:
+		bool recording_;
+
+		std::vector<Command> commands_;
+		std::vector<FrameBufferPtr> frame_buffers_;
+		std::vector<GraphicsBufferPtr> indirect_args_;
+		std::vector<std::function<void()>> funcs_;
+
+		std::vector<CBufferSnapshot> cbuff_snapshots_;
+		std::vector<uint8_t> cbuff_data_;
+		std::vector<ResourceSnapshot> resource_snapshots_;
+
+		// The last snapshot of each constant buffer and resource parameter in the list, to skip the unchanged ones
+		std::unordered_map<RenderEffectConstantBuffer const *, uint32_t> last_cbuffs_;
+		std::unordered_map<RenderEffectParameter const *, uint32_t> last_resources_;
+
+		FrameBufferPtr cur_frame_buffer_;
+	};
+}
+
+#endif			// _COMMANDLIST_HPP
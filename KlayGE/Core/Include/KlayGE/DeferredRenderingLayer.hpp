@@ -40,6 +40,7 @@
 #include <KlayGE/Light.hpp>
 #include <KlayGE/IndirectLightingLayer.hpp>
 #include <KlayGE/CascadedShadowLayer.hpp>
+#include <KlayGE/ClusteredLightCulling.hpp>
 
 #define TRIDITIONAL_DEFERRED 0
 #define LIGHT_INDEXED_DEFERRED 1
@@ -328,9 +329,11 @@ namespace KlayGE
 		void BuildLightList();
 		void BuildVisibleSceneObjList(bool& has_opaque_objs, bool& has_transparency_back_objs, bool& has_transparency_front_objs);
 		void BuildPassScanList(bool has_opaque_objs, bool has_transparency_back_objs, bool has_transparency_front_objs);
+		void AddClipViews();
 		void CheckLightVisible(uint32_t vp_index, uint32_t light_index);
 		void AppendGBufferPassScanCode(uint32_t vp_index, PassTargetBuffer pass_tb);
 		void AppendShadowPassScanCode(uint32_t light_index);
+		void AppendShadowCachePassScanCode(uint32_t light_index, uint32_t num_faces);
 		void AppendCascadedShadowPassScanCode(uint32_t vp_index, uint32_t light_index);
 		void AppendIndirectLightingPassScanCode(uint32_t vp_index, uint32_t light_index);
 		void AppendShadingPassScanCode(uint32_t vp_index, PassTargetBuffer pass_tb);
@@ -370,6 +373,7 @@ namespace KlayGE
 		void CreateDepthMinMaxMap(PerViewport const & pvp);
 
 		void UpdateTileBasedLighting(PerViewport const & pvp, PassTargetBuffer pass_tb);
+		void UploadLightClusters();
 		void CreateDepthMinMaxMapCS(PerViewport const & pvp);
 #endif
 
@@ -448,6 +452,7 @@ namespace KlayGE
 
 		RenderTechnique* technique_tbdr_shadowing_unified_;
 		RenderTechnique* technique_tbdr_unified_;
+		RenderTechnique* technique_tbdr_clustered_;
 #endif
 		static uint32_t const MAX_NUM_SHADOWED_LIGHTS = 4;
 		static uint32_t const MAX_NUM_SHADOWED_SPOT_LIGHTS = 4;
@@ -460,6 +465,10 @@ namespace KlayGE
 		FrameBufferPtr sm_fb_;
 		TexturePtr sm_tex_;
 		TexturePtr sm_depth_tex_;
+		// The static caster layers of the spot and point light shadow maps, indexed by the slots of
+		// SceneManager::ShadowCache()
+		std::vector<FrameBufferPtr> sm_cache_fbs_;
+		std::vector<TexturePtr> sm_cache_depth_texs_;
 		FrameBufferPtr csm_fb_;
 		TexturePtr csm_tex_;
 		std::array<TexturePtr, MAX_NUM_SHADOWED_SPOT_LIGHTS + MAX_NUM_PROJECTIVE_SHADOWED_SPOT_LIGHTS> unfiltered_sm_2d_texs_;
@@ -546,6 +555,14 @@ namespace KlayGE
 		RenderEffectParameter* shading_rw_tex_param_;
 		RenderEffectParameter* lights_type_param_;
 		PostProcessPtr copy_pp_;
+
+		ClusteredLightCulling cluster_culling_;
+		GraphicsBufferPtr cluster_ranges_buff_;
+		GraphicsBufferPtr cluster_light_indices_buff_;
+		RenderEffectParameter* cluster_dims_param_;
+		RenderEffectParameter* cluster_slice_scale_bias_param_;
+		RenderEffectParameter* cluster_ranges_param_;
+		RenderEffectParameter* cluster_light_indices_param_;
 #endif
 
 		RenderEffectParameter* skylight_diff_spec_mip_param_;
@@ -58,6 +58,8 @@ namespace KlayGE
 	typedef std::shared_ptr<SceneObjectLightSourceProxy> SceneObjectLightSourceProxyPtr;
 	class SceneObjectCameraProxy;
 	typedef std::shared_ptr<SceneObjectCameraProxy> SceneObjectCameraProxyPtr;
+	class TransformHierarchy;
+	class ShadowMapCache;
 
 	struct ElementInitData;
 	class Camera;
@@ -122,6 +124,8 @@ namespace KlayGE
 	typedef std::shared_ptr<SamplerStateObject> SamplerStateObjectPtr;
 	class ShaderObject;
 	typedef std::shared_ptr<ShaderObject> ShaderObjectPtr;
+	class CommandList;
+	typedef std::shared_ptr<CommandList> CommandListPtr;
 	class Texture;
 	typedef std::shared_ptr<Texture> TexturePtr;
 	class TexCompression;
@@ -97,6 +97,7 @@ namespace KlayGE
 		bool full_npot_texture_support : 1;
 		bool render_to_texture_array_support : 1;
 		bool load_from_buffer_support : 1;
+		bool cbuffer_partial_update_support : 1;
 
 		bool gs_support : 1;
 		bool cs_support : 1;
@@ -58,6 +58,8 @@
 #include <vector>
 #include <string>
 #include <algorithm>
+#include <atomic>
+#include <unordered_map>
 
 #include <boost/noncopyable.hpp>
 
@@ -273,7 +275,7 @@ namespace KlayGE
 				if (val_in_cbuff != value)
 				{
 					val_in_cbuff = value;
-					data_.cbuff_desc.cbuff->Dirty(true);
+					data_.cbuff_desc.cbuff->Dirty(data_.cbuff_desc.offset, static_cast<uint32_t>(sizeof(T)));
 				}
 			}
 			else
@@ -411,7 +413,11 @@ namespace KlayGE
 					memcpy(target + i * this->data_.cbuff_desc.stride, &value[i], sizeof(value[i]));
 				}
 
-				this->data_.cbuff_desc.cbuff->Dirty(true);
+				if (!value.empty())
+				{
+					this->data_.cbuff_desc.cbuff->Dirty(this->data_.cbuff_desc.offset,
+						static_cast<uint32_t>((value.size() - 1) * this->data_.cbuff_desc.stride + sizeof(T)));
+				}
 			}
 			else
 			{
@@ -617,8 +623,14 @@ namespace KlayGE
 		{
 			return static_cast<uint32_t>(params_.size());
 		}
+		// The string versions hash the string on every call. Use the hash versions, with CT_HASH or RT_HASH of
+		// the name, or a RenderEffectParameterHandle, in per-frame code.
 		RenderEffectParameter* ParameterBySemantic(std::string const & semantic) const;
 		RenderEffectParameter* ParameterByName(std::string const & name) const;
+		RenderEffectParameter* ParameterBySemanticHash(size_t semantic_hash) const;
+		RenderEffectParameter* ParameterByNameHash(size_t name_hash) const;
+		// Returns INVALID_INDEX if there is no such parameter
+		uint32_t ParameterIndexByNameHash(size_t name_hash) const;
 		RenderEffectParameter* ParameterByIndex(uint32_t n) const
 		{
 			BOOST_ASSERT(n < this->NumParameters());
@@ -630,6 +642,7 @@ namespace KlayGE
 			return static_cast<uint32_t>(cbuffers_.size());
 		}
 		RenderEffectConstantBuffer* CBufferByName(std::string const & name) const;
+		RenderEffectConstantBuffer* CBufferByNameHash(size_t name_hash) const;
 		RenderEffectConstantBuffer* CBufferByIndex(uint32_t n) const
 		{
 			BOOST_ASSERT(n < this->NumCBuffers());
@@ -661,6 +674,11 @@ namespace KlayGE
 		void GenHLSLShaderText();
 		std::string const & HLSLShaderText() const;
 #endif
+
+		// Number of lookups by string, from any effect, since the last call. Always 0 in ship builds.
+		static uint32_t NumStringLookupsJustMade();
+
+		static uint32_t const INVALID_INDEX = 0xFFFFFFFF;
 		
 	private:
 		RenderEffectTemplatePtr effect_template_;
@@ -726,6 +744,10 @@ namespace KlayGE
 
 		std::string const & TypeName(uint32_t code) const;
 
+		uint32_t ParameterIndexByNameHash(size_t name_hash) const;
+		uint32_t ParameterIndexBySemanticHash(size_t semantic_hash) const;
+		uint32_t CBufferIndexByNameHash(size_t name_hash) const;
+
 #if KLAYGE_IS_DEV_PLATFORM
 		void GenHLSLShaderText(RenderEffect const & effect);
 		std::string const & HLSLShaderText() const
@@ -739,7 +761,15 @@ namespace KlayGE
 		void RecursiveIncludeNode(XMLNodePtr const & root, std::vector<std::string>& include_names) const;
 		void InsertIncludeNodes(XMLDocument& target_doc, XMLNodePtr const & target_root,
 			XMLNodePtr const & target_place, XMLNodePtr const & include_root) const;
+		// Compiles the passes on the thread pool, and links each technique on this thread as soon as its passes
+		// are compiled. All the techniques are linked before returning, so there is no technique to fall back to
+		// meanwhile: the callers check Validate() right after loading, and GL links on the loading thread only.
+		// On a pool thread, everything is done inline.
+		void CompileShaders(RenderEffect const & effect);
 #endif
+		// Clones share the template and keep the order of parameters and cbuffers, so the indices are
+		// valid for all of them
+		void BuildIndices(RenderEffect const & effect);
 
 	private:
 		std::string res_name_;
@@ -757,13 +787,22 @@ namespace KlayGE
 #endif
 
 		std::vector<ShaderDesc> shader_descs_;
+
+		std::unordered_map<size_t, uint32_t> param_name_indices_;
+		std::unordered_map<size_t, uint32_t> param_semantic_indices_;
+		std::unordered_map<size_t, uint32_t> cbuffer_name_indices_;
 	};
 
 	class KLAYGE_CORE_API RenderTechnique : boost::noncopyable
 	{
 	public:
 #if KLAYGE_IS_DEV_PLATFORM
+		// Load only parses the technique. CompileShaders compiles the shaders of one pass, and could be called
+		// from any thread once all techniques are loaded. LinkShaders has to be called on the main thread after
+		// all passes, and the passes they share shaders with, are compiled.
 		void Load(RenderEffect& effect, XMLNodePtr const & node, uint32_t tech_index);
+		void CompileShaders(RenderEffect const & effect, uint32_t tech_index, uint32_t pass_index);
+		void LinkShaders(RenderEffect const & effect, uint32_t tech_index);
 #endif
 
 		bool StreamIn(RenderEffect& effect, ResIdentifierPtr const & res, uint32_t tech_index);
@@ -834,6 +873,14 @@ namespace KlayGE
 			return has_tessellation_;
 		}
 
+	private:
+#if KLAYGE_IS_DEV_PLATFORM
+		bool OwnsPasses() const
+		{
+			return !parent_tech_ || (passes_ != parent_tech_->passes_);
+		}
+#endif
+
 	private:
 		std::string name_;
 		size_t name_hash_;
@@ -848,6 +895,11 @@ namespace KlayGE
 		bool is_validate_;
 		bool has_discard_;
 		bool has_tessellation_;
+
+#if KLAYGE_IS_DEV_PLATFORM
+		// Set if the technique has no pass node, and inherits the passes and the flags from the parent
+		RenderTechnique const * parent_tech_;
+#endif
 	};
 
 	class KLAYGE_CORE_API RenderPass : boost::noncopyable
@@ -857,6 +909,10 @@ namespace KlayGE
 		void Load(RenderEffect& effect, XMLNodePtr const & node, uint32_t tech_index, uint32_t pass_index,
 			RenderPass const * inherit_pass);
 		void Load(RenderEffect& effect, uint32_t tech_index, uint32_t pass_index, RenderPass const * inherit_pass);
+		// Compiles the shaders owned by this pass. Free of API calls that have to be on the main thread.
+		void CompileShaders(RenderEffect const & effect, uint32_t tech_index, uint32_t pass_index);
+		// Attaches the shaders shared from the passes loaded earlier, and links
+		void LinkShaders(RenderEffect const & effect, uint32_t tech_index, uint32_t pass_index);
 #endif
 
 		bool StreamIn(RenderEffect& effect, ResIdentifierPtr const & res, uint32_t tech_index, uint32_t pass_index);
@@ -940,7 +996,7 @@ namespace KlayGE
 	{
 	public:
 		RenderEffectConstantBuffer()
-			: dirty_(true)
+			: partial_update_(false)
 		{
 		}
 
@@ -976,6 +1032,10 @@ namespace KlayGE
 		}
 
 		void Resize(uint32_t size);
+		uint32_t Size() const
+		{
+			return static_cast<uint32_t>(buff_.size());
+		}
 
 		template <typename T>
 		T const * VariableInBuff(uint32_t offset) const
@@ -1000,15 +1060,38 @@ namespace KlayGE
 			return r2t.t;
 		}
 
-		void Dirty(bool dirty)
+		// Marks the whole buffer dirty, or clean
+		void Dirty(bool dirty);
+		// Marks a range dirty. Ranges are widened to float4 registers and merged when they touch, so
+		// parameters set in order end up in one range.
+		void Dirty(uint32_t offset, uint32_t size)
 		{
-			dirty_ = dirty;
+			uint32_t const begin = offset & ~(REGISTER_SIZE - 1);
+			uint32_t const end = std::min((offset + size + REGISTER_SIZE - 1) & ~(REGISTER_SIZE - 1),
+				static_cast<uint32_t>(buff_.size()));
+			if (!dirty_ranges_.empty() && (begin >= dirty_ranges_.back().first) && (begin <= dirty_ranges_.back().second))
+			{
+				dirty_ranges_.back().second = std::max(dirty_ranges_.back().second, end);
+			}
+			else
+			{
+				this->AddDirtyRange(begin, end);
+			}
 		}
 		bool Dirty() const
 		{
-			return dirty_;
+			return !dirty_ranges_.empty();
+		}
+		uint32_t NumDirtyRanges() const
+		{
+			return static_cast<uint32_t>(dirty_ranges_.size());
+		}
+		std::pair<uint32_t, uint32_t> const & DirtyRange(uint32_t index) const
+		{
+			return dirty_ranges_[index];
 		}
 
+		// Uploads the dirty ranges, or the whole buffer if the device can't update a part of it
 		void Update();
 		GraphicsBufferPtr const & HWBuff() const
 		{
@@ -1017,12 +1100,22 @@ namespace KlayGE
 		void BindHWBuff(GraphicsBufferPtr const & buff);
 
 	private:
+		void AddDirtyRange(uint32_t begin, uint32_t end);
+
+	private:
+		static uint32_t const REGISTER_SIZE = 16;
+		// More ranges than this are merged into one
+		static uint32_t const MAX_DIRTY_RANGES = 4;
+
 		std::shared_ptr<std::pair<std::string, size_t>> name_;
 		std::shared_ptr<std::vector<uint32_t>> param_indices_;
 
 		GraphicsBufferPtr hw_buff_;
+		// RenderDeviceCaps::cbuffer_partial_update_support, read when hw_buff_ is set
+		bool partial_update_;
 		std::vector<uint8_t> buff_;
-		bool dirty_;
+		// Sorted [begin, end) byte ranges, not touching each other
+		std::vector<std::pair<uint32_t, uint32_t>> dirty_ranges_;
 	};
 
 	class KLAYGE_CORE_API RenderEffectParameter : boost::noncopyable
@@ -1136,6 +1229,60 @@ namespace KlayGE
 		RenderEffectConstantBuffer* cbuff_;
 	};
 
+	// A parameter known by a name hashed at compile time. The index is resolved on first use and kept, then
+	// checked against the name hash on every use, so one handle serves all effects, cloned or not. Safe to
+	// share between threads.
+	//
+	//   static RenderEffectParameterHandle<float4x4> const mvp_handle(CT_HASH("mvp"));
+	//   mvp_handle.Set(*effect, mvp);
+	template <typename T>
+	class RenderEffectParameterHandle : boost::noncopyable
+	{
+	public:
+		explicit RenderEffectParameterHandle(size_t name_hash)
+			: name_hash_(name_hash), index_(RenderEffect::INVALID_INDEX)
+		{
+		}
+
+		size_t NameHash() const
+		{
+			return name_hash_;
+		}
+
+		// nullptr if the effect doesn't have this parameter
+		RenderEffectParameter* Resolve(RenderEffect const & effect) const
+		{
+			uint32_t index = index_.load(std::memory_order_relaxed);
+			if ((index >= effect.NumParameters()) || (effect.ParameterByIndex(index)->NameHash() != name_hash_))
+			{
+				index = effect.ParameterIndexByNameHash(name_hash_);
+				if (RenderEffect::INVALID_INDEX == index)
+				{
+					return nullptr;
+				}
+				index_.store(index, std::memory_order_relaxed);
+			}
+			return effect.ParameterByIndex(index);
+		}
+
+		void Set(RenderEffect const & effect, T const & value) const
+		{
+			RenderEffectParameter* param = this->Resolve(effect);
+			BOOST_ASSERT(param);
+			*param = value;
+		}
+		void Value(RenderEffect const & effect, T& value) const
+		{
+			RenderEffectParameter* param = this->Resolve(effect);
+			BOOST_ASSERT(param);
+			param->Value(value);
+		}
+
+	private:
+		size_t const name_hash_;
+		mutable std::atomic<uint32_t> index_;
+	};
+
 	KLAYGE_CORE_API RenderEffectPtr SyncLoadRenderEffect(std::string const & effect_name);
 	KLAYGE_CORE_API RenderEffectPtr ASyncLoadRenderEffect(std::string const & effect_name);
 }
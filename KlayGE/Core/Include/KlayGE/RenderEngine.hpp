@@ -78,10 +78,32 @@
 #include <KlayGE/RenderSettings.hpp>
 #include <KFL/Color.hpp>
 
+#include <array>
 #include <vector>
 
 namespace KlayGE
 {
+	enum RenderStateType
+	{
+		RST_Rasterizer = 0,
+		RST_DepthStencil,
+		RST_Blend,
+		RST_FrameBuffer,
+		RST_Shader,
+		RST_Texture,
+		RST_Sampler,
+		RST_Buffer,
+
+		RST_NumStateTypes
+	};
+
+	// State changes sent to the API, and the ones filtered out because the state was already bound
+	struct RenderStateChanges
+	{
+		std::array<uint32_t, RST_NumStateTypes> issued;
+		std::array<uint32_t, RST_NumStateTypes> filtered;
+	};
+
 	class KLAYGE_CORE_API RenderEngine
 	{
 	public:
@@ -101,6 +123,8 @@ namespace KlayGE
 		void Dispatch(RenderEffect const & effect, RenderTechnique const & tech, uint32_t tgx, uint32_t tgy, uint32_t tgz);
 		void DispatchIndirect(RenderEffect const & effect, RenderTechnique const & tech,
 			GraphicsBufferPtr const & buff_args, uint32_t offset);
+		// Replays command lists recorded on other threads, in order. Called on the thread owning the device.
+		void Submit(CommandListPtr const * cmd_lists, uint32_t num_cmd_lists);
 		virtual void EndPass();
 		virtual void EndFrame();
 		virtual void UpdateGPUTimestampsFrequency();
@@ -112,6 +136,7 @@ namespace KlayGE
 		uint32_t NumVerticesJustRendered();
 		uint32_t NumDrawsJustCalled();
 		uint32_t NumDispatchesJustCalled();
+		RenderStateChanges StateChangesJustMade();
 
 		void CreateRenderWindow(std::string const & name, RenderSettings& settings);
 		void DestroyRenderWindow();
@@ -269,7 +294,48 @@ namespace KlayGE
 	protected:
 		void Destroy();
 
+		// The state cache shared by the plugins. Returns true if state is not what the slot holds, and needs to be
+		// sent to the API. Every call is counted as issued or filtered.
+		bool UpdateStateCache(RenderStateType type, uint32_t slot, uintptr_t state);
+		template <typename T>
+		bool UpdateStateCache(RenderStateType type, uint32_t slot, T* state)
+		{
+			return this->UpdateStateCache(type, slot, reinterpret_cast<uintptr_t>(state));
+		}
+		// Same for the slots [first_slot, first_slot + num) bound by one API call, counted as one change
+		template <typename T>
+		bool UpdateStateCache(RenderStateType type, uint32_t first_slot, uint32_t num, T* const * states)
+		{
+			uintptr_t* cache = this->StateCacheSlots(type, first_slot, num);
+			bool changed = false;
+			for (uint32_t i = 0; i < num; ++ i)
+			{
+				uintptr_t const state = reinterpret_cast<uintptr_t>(states[i]);
+				changed |= (cache[i] != state);
+				cache[i] = state;
+			}
+			this->CountStateChange(type, changed);
+			return changed;
+		}
+		// For the bindings filtered by a cache of the plugin, such as the views that have to be tracked by resource
+		void CountStateChange(RenderStateType type, bool issued)
+		{
+			if (issued)
+			{
+				++ state_changes_.issued[type];
+			}
+			else
+			{
+				++ state_changes_.filtered[type];
+			}
+		}
+		// Must be called when the API state is changed behind the cache, for example when the device is reset
+		void InvalidateStateCache(RenderStateType type);
+		void InvalidateStateCache();
+
 	private:
+		uintptr_t* StateCacheSlots(RenderStateType type, uint32_t first_slot, uint32_t num);
+
 		virtual void CheckConfig(RenderSettings& settings);
 		virtual void StereoscopicForLCDShutter(int32_t eye);
 		void AssemblePostProcessChain();
@@ -311,6 +377,9 @@ namespace KlayGE
 		uint32_t num_draws_just_called_;
 		uint32_t num_dispatches_just_called_;
 
+		std::array<std::vector<uintptr_t>, RST_NumStateTypes> state_cache_;
+		RenderStateChanges state_changes_;
+
 		RenderDeviceCaps caps_;
 
 		RasterizerStateObjectPtr cur_rs_obj_;
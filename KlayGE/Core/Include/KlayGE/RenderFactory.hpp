@@ -119,6 +119,9 @@ namespace KlayGE
 		SamplerStateObjectPtr MakeSamplerStateObject(SamplerStateDesc const & desc);
 		virtual ShaderObjectPtr MakeShaderObject() = 0;
 
+		// A list replayed through the render engine. Could be overridden with a native implementation.
+		virtual CommandListPtr MakeCommandList();
+
 	private:
 		virtual std::unique_ptr<RenderEngine> DoMakeRenderEngine() = 0;
 
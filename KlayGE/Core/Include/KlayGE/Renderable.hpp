@@ -154,6 +154,10 @@ namespace KlayGE
 		{
 			return technique_;
 		}
+		RenderMaterialPtr const & Material() const
+		{
+			return mtl_;
+		}
 		virtual RenderLayout& GetRenderLayout() const = 0;
 		virtual std::wstring const & Name() const = 0;
 
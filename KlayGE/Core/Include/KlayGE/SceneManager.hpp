@@ -24,11 +24,15 @@
 #include <KlayGE/PreDeclare.hpp>
 
 #include <KlayGE/Renderable.hpp>
+#include <KlayGE/RenderEngine.hpp>
+#include <KlayGE/TransformHierarchy.hpp>
+#include <KlayGE/ShadowMapCache.hpp>
 #include <KFL/Frustum.hpp>
 #include <KFL/Thread.hpp>
 
 #include <vector>
 #include <unordered_map>
+#include <atomic>
 
 #include <boost/noncopyable.hpp>
 
@@ -45,8 +49,51 @@ namespace KlayGE
 
 		void SmallObjectThreshold(float area);
 		void SceneUpdateElapse(float elapse);
+		// Pipelines the SubThreadUpdate of the objects with rendering. With a latency of 1 or 2 frames, the update
+		// of the next frame is launched before the current frame is flushed, and runs on the thread pool while the
+		// main thread renders. The matrices and the visibility it sets are kept in the objects, and published at
+		// the beginning of a frame once the update is done. It's waited for at most latency frames, a slow update
+		// is rendered with the older state meanwhile. 0, the default, runs the update after the frame.
+		// Only the objects with SceneObject::SOA_PipelinedUpdate are pipelined. Their SubThreadUpdate must change
+		// the objects only through the ModelMatrix and Visible setters, which are deferred, and must not read the
+		// state written by the main thread, such as AbsModelMatrix and PosBoundWS. The other objects, and the
+		// overlay ones, are updated before the frame is flushed, at the same rate. The objects deleted while an
+		// update is in flight stay in the scene until it's published.
+		void PipelinedUpdate(uint32_t latency);
+		uint32_t PipelinedUpdate() const;
+		// Culls the objects hidden behind SceneObject::SOA_Occluder objects, by rasterizing the occluders into
+		// a low resolution depth buffer on the CPU
+		void OcclusionCulling(bool enable);
+		bool OcclusionCulling() const;
+		void OcclusionBufferSize(uint32_t width, uint32_t height);
+		// Records the render queue into up to num command lists on the thread pool, then submits them in order.
+		// The queue is only split where no effect has renderables on both sides, so an effect is only written by
+		// one thread. A queue dominated by a shared effect, such as the one of the GBuffer, is rendered on the
+		// calling thread. The renderables must touch the device only through RenderEngine or
+		// CommandList::Execute. 0 and 1 render on the calling thread, the default.
+		void ParallelRecording(uint32_t num);
+		uint32_t ParallelRecording() const;
+		// Splits the entries into at most num_slices ranges in order, of about the same size, so no owner has
+		// entries in two ranges. starts gets the first entry of each range, then the number of entries.
+		static void SplitByOwner(std::vector<void const *> const & owners, uint32_t num_slices,
+			std::vector<size_t>& starts);
 		virtual void ClipScene();
 
+		// Registers a view to be flushed later in the frame, by its camera and the index of its cascade in
+		// CascadedShadowLayer (-1 for none). The first flush clipping a registered view clips all the registered
+		// views not clipped yet together, through the spatial index of the scene manager, instead of one
+		// ClipScene per view. The views are dropped at the beginning of the next frame.
+		void AddClipView(Camera const & camera, int32_t cascade_index, float4x4 const & view_proj,
+			float small_obj_threshold);
+		// The same for a shadow map lit along light_dir. The planes a caster could cross by moving along light_dir
+		// are dropped, so the objects out of the view casting shadows into it are kept.
+		void AddShadowClipView(Camera const & camera, int32_t cascade_index, float4x4 const & view_proj,
+			float small_obj_threshold, float3 const & light_dir);
+
+		// The cached static caster layers of the shadow maps. The layers are invalidated when a static caster
+		// in their views is added, removed, moved, shown or hidden, before the passes of a frame.
+		ShadowMapCache& ShadowCache();
+
 		void AddCamera(CameraPtr const & camera);
 		void DelCamera(CameraPtr const & camera);
 
@@ -61,12 +108,14 @@ namespace KlayGE
 		LightSourcePtr& GetLight(uint32_t index);
 		LightSourcePtr const & GetLight(uint32_t index) const;
 
+		// Thread safe and lock free. The requests are queued, and applied in order on the main thread at the
+		// beginning of Update and Flush.
 		void AddSceneObject(SceneObjectPtr const & obj);
-		void AddSceneObjectLocked(SceneObjectPtr const & obj);
 		void DelSceneObject(SceneObjectPtr const & obj);
-		void DelSceneObjectLocked(SceneObjectPtr const & obj);
 		void AddRenderable(Renderable* obj);
 
+		// The objects in the scene as of the last Update or Flush. An object added or deleted isn't counted, or
+		// is still counted, until the next Update or Flush applies the request.
 		uint32_t NumSceneObjects() const;
 		SceneObjectPtr& GetSceneObject(uint32_t index);
 		SceneObjectPtr const & GetSceneObject(uint32_t index) const;
@@ -88,23 +137,39 @@ namespace KlayGE
 		uint32_t NumVerticesRendered() const;
 		uint32_t NumDrawCalls() const;
 		uint32_t NumDispatchCalls() const;
+		RenderStateChanges const & StateChanges() const;
+		uint32_t NumStateChangesIssued() const;
+		uint32_t NumStateChangesFiltered() const;
+		// Effect parameters and cbuffers looked up by string in the last frame, 0 in ship builds
+		uint32_t NumEffectStringLookups() const;
 
 	protected:
 		void Flush(uint32_t urt);
 
 		std::vector<CameraPtr>::iterator DelCamera(std::vector<CameraPtr>::iterator iter);
 		std::vector<LightSourcePtr>::iterator DelLight(std::vector<LightSourcePtr>::iterator iter);
+		// Deletes the object right away, and renumbers the ones after it. Not for the deleting in bulk.
 		std::vector<SceneObjectPtr>::iterator DelSceneObject(std::vector<SceneObjectPtr>::iterator iter);
-		std::vector<SceneObjectPtr>::iterator DelSceneObjectLocked(std::vector<SceneObjectPtr>::iterator iter);
 		virtual void OnAddSceneObject(SceneObjectPtr const & obj) = 0;
 		virtual void OnDelSceneObject(std::vector<SceneObjectPtr>::iterator iter) = 0;
 		virtual void DoSuspend() = 0;
 		virtual void DoResume() = 0;
 
-		void UpdateThreadFunc();
+		// Overlaps of the cullable objects with the frusta of the views ClipViews clips at once, indexed by
+		// the view then by SceneObject::SceneIndex(). overlaps comes filled with BO_No, and the bounds of the
+		// visible moveable objects are up to date. By default all the bounds are tested against all the frusta.
+		// A scene manager with a spatial index overrides it to only reach the objects in the frusta.
+		virtual void ClipViewBounds(std::vector<Frustum> const & frusta, std::vector<std::vector<BoundOverlap>>& overlaps);
 
 		BoundOverlap VisibleTestFromParent(SceneObject* obj, float3 const & eye_pos, float4x4 const & view_proj);
 
+		// Visibility of an object from the camera being flushed. BO_No for objects not in scene_objs_.
+		BoundOverlap VisibleMark(SceneObject const * obj) const;
+		void VisibleMark(SceneObject const * obj, BoundOverlap vm);
+
+		// Called at the end of ClipScene. Marks the objects hidden behind the occluders BO_No.
+		void OcclusionCull(Camera const & camera, float4x4 const & view_proj);
+
 	protected:
 		std::vector<CameraPtr> cameras_;
 		Frustum const * frustum_;
@@ -112,18 +177,100 @@ namespace KlayGE
 		std::vector<SceneObjectPtr> scene_objs_;
 		std::vector<SceneObjectPtr> overlay_scene_objs_;
 
+		// Visibility of scene_objs_ from the camera being flushed, indexed by SceneObject::SceneIndex(). ClipScene
+		// writes here instead of into the objects, so it can run in parallel. Each camera and set of visible
+		// objects gets its own array, cached in visible_marks_map_ during a frame.
+		std::shared_ptr<std::vector<BoundOverlap>> visible_marks_;
 		std::unordered_map<size_t, std::shared_ptr<std::vector<BoundOverlap>>> visible_marks_map_;
 
 		float small_obj_threshold_;
 		float update_elapse_;
 
+		bool occlusion_culling_;
+		OcclusionBufferPtr occlusion_buffer_;
+
 	private:
 		void FlushScene();
 
+		bool InScene(SceneObject const * obj) const;
+		void UpdateClipLevels();
+		BoundOverlap ClipObject(SceneObject* so, Camera const & camera, float4x4 const & view_proj);
+		void OnSceneObjectsChanged();
+		void SortRenderQueue(Camera const & camera);
+		void RenderQueue(bool parallel);
+		void ClipViews(size_t scene_seed);
+		void UpdateTransforms();
+		void UpdateStaticCasters();
+		void InvalidateStaticCaster(SceneObject const & obj);
+
+		struct SceneCommand;
+		void PushSceneCommand(SceneObjectPtr const & obj, bool add);
+		void ApplySceneCommands();
+		// Applies and recycles the commands linked from first. Stops at a delete while the update is running
+		// on the objects, and returns its link, or 0 if all are applied.
+		uint32_t ApplySceneCommands(uint32_t first, bool& changed, bool& deleted);
+		uint32_t AllocSceneCommand();
+		// The command of an index, allocating its chunk on the first use
+		SceneCommand& SceneCommandAt(uint32_t index);
+		// Recycles the commands linked from first to last, both index + 1
+		void FreeSceneCommands(uint32_t first, uint32_t last);
+		// Both return true if scene_objs_ is changed. A deleted object leaves a null in scene_objs_, until
+		// CompactSceneObjects removes them all and renumbers the rest once.
+		bool DoAddSceneObject(SceneObjectPtr const & obj);
+		bool DoDelSceneObject(SceneObjectPtr const & obj);
+		void DetachSceneObject(std::vector<SceneObjectPtr>::iterator iter);
+		void CompactSceneObjects();
+		void LaunchSceneUpdate();
+		void WaitSceneUpdate();
+		// Publishes the changes of a pipelined update, if it's done or has been in flight for the latency.
+		// Returns false if it's still running.
+		bool PublishSceneUpdate();
+
 	private:
 		uint32_t urt_;
 
-		std::vector<std::pair<RenderTechnique const *, std::vector<Renderable*>>> render_queue_;
+		// Renderables added this flush, sorted by 64-bit keys before rendering. The queue and the sorting buffers
+		// are reused from flush to flush, so they don't allocate once grown.
+		std::vector<Renderable*> render_queue_;
+		std::vector<std::pair<float, RenderTechnique const *>> queue_techs_;
+		std::vector<float> queue_depth_boxes_;
+		std::vector<uint64_t> queue_keys_;
+		std::vector<uint32_t> queue_indices_;
+		std::vector<uint64_t> queue_tmp_keys_;
+		std::vector<uint32_t> queue_tmp_indices_;
+
+		// Command lists of ParallelRecording, and the first queue entry of each of them
+		uint32_t num_cmd_lists_;
+		std::vector<void const *> queue_effects_;
+		std::vector<CommandListPtr> cmd_lists_;
+		std::vector<size_t> cmd_list_starts_;
+
+		// Indices of scene_objs_ grouped by the depth in the hierarchy. An object only reads the visibility of
+		// its parent, so the objects in one level can be clipped in parallel once the upper levels are done.
+		std::vector<std::vector<uint32_t>> clip_levels_;
+		bool clip_levels_dirty_;
+
+		// Views registered for the multi-frustum pass of ClipViews
+		struct ClipView
+		{
+			Camera const * camera;
+			int32_t cascade_index;
+			float4x4 view_proj;
+			Frustum frustum;
+			float small_obj_threshold;
+			bool clipped;
+		};
+		std::vector<ClipView> clip_views_;
+		std::vector<std::vector<BoundOverlap>> clip_view_overlaps_;
+		std::vector<float> clip_view_boxes_;
+		std::vector<uint32_t> clip_view_bits_;
+
+		// Local and absolute matrices of scene_objs_
+		TransformHierarchy transforms_;
+
+		ShadowMapCache shadow_cache_;
+		// Visible() of scene_objs_ at the last frame, to catch the static casters shown or hidden
+		std::vector<uint8_t> static_visibles_;
 
 		uint32_t num_objects_rendered_;
 		uint32_t num_renderables_rendered_;
@@ -131,10 +278,44 @@ namespace KlayGE
 		uint32_t num_vertices_rendered_;
 		uint32_t num_draw_calls_;
 		uint32_t num_dispatch_calls_;
-
-		std::mutex update_mutex_;
-		std::unique_ptr<joiner<void>> update_thread_;
-		volatile bool quit_;
+		RenderStateChanges state_changes_;
+		uint32_t num_effect_string_lookups_;
+
+		// Add and delete requests, pushed by any thread onto a lock free stack, and taken all at once by the
+		// main thread. The commands are pooled in chunks, each twice as large as the one before, and linked by
+		// index + 1. The applied ones go back to a free list, whose head is tagged in the high 32 bits against
+		// ABA, so pushing doesn't allocate once the pool has grown.
+		struct SceneCommand
+		{
+			SceneObjectPtr obj;
+			bool add;
+			std::atomic<uint32_t> next;
+		};
+		static uint32_t const MAX_SCENE_CMD_CHUNKS = 24;
+		std::atomic<SceneCommand*> scene_cmd_chunks_[MAX_SCENE_CMD_CHUNKS];
+		std::atomic<uint32_t> num_scene_cmds_;
+		std::atomic<uint64_t> free_scene_cmds_;
+		std::atomic<uint32_t> scene_cmds_;
+		// Commands held by ApplySceneCommands until the update is done, in order. Older than scene_cmds_.
+		uint32_t held_scene_cmds_;
+
+		// The SubThreadUpdate of the objects are partitioned over the thread pool. They run after the main
+		// thread updates, overlapped with presenting the frame, and are joined before the next frame is
+		// flushed. So Flush always sees the objects after a whole update, without locking. In the pipelined
+		// mode, they run during the flush instead, see PipelinedUpdate.
+		// The objects are held until joined, the deleted and the overlay ones could be dropped meanwhile.
+		std::unique_ptr<joiner<void>> scene_update_;
+		std::vector<SceneObjectPtr> scene_update_objs_;
+		// Objects updated on the calling thread in the pipelined mode
+		std::vector<SceneObject*> immediate_update_objs_;
+		float last_scene_update_time_;
+		float next_scene_update_time_;
+
+		// The pipelined mode of the update. The objects' own matrices and visibility are the half written by
+		// the update, the hierarchy and the attributes are the half read by Flush.
+		uint32_t pipeline_latency_;
+		uint32_t update_frames_in_flight_;
+		std::atomic<bool> scene_update_done_;
 
 		bool deferred_mode_;
 	};
@@ -35,7 +35,10 @@ namespace KlayGE
 			SOA_Moveable = 1UL << 2,
 			SOA_Invisible = 1UL << 3,
 			SOA_NotCastShadow = 1UL << 4,
-			SOA_SSS = 1UL << 5
+			SOA_SSS = 1UL << 5,
+			SOA_Occluder = 1UL << 6,
+			// SubThreadUpdate is run by the pipelined update of SceneManager, see SceneManager::PipelinedUpdate
+			SOA_PipelinedUpdate = 1UL << 7
 		};
 
 	public:
@@ -54,15 +57,22 @@ namespace KlayGE
 		virtual float4x4 const & AbsModelMatrix() const;
 		virtual AABBox const & PosBoundWS() const;
 		void UpdateAbsModelMatrix();
-		void VisibleMark(BoundOverlap vm);
-		BoundOverlap VisibleMark() const;
+		// Updates the absolute matrix and the world space bound, but not the renderable, which could be shared
+		// by other objects. Safe to call on different objects in parallel.
+		void UpdateAbsModelMatrixNoRenderable();
+		// Index in the scene manager's object list, maintained by SceneManager. The visibility of the object
+		// is kept per camera by the scene manager at this index.
+		uint32_t SceneIndex() const;
+		void SceneIndex(uint32_t index);
+		// Moves the transform into the scene manager's hierarchy, or back to the object with nullptr. Maintained
+		// by SceneManager. While bound, the absolute matrix is computed by the hierarchy.
+		void BindTransform(TransformHierarchy* transforms);
+		uint32_t TransformNode() const;
 
 		virtual void OnAttachRenderable(bool add_to_scene);
 
 		virtual void AddToSceneManager();
-		virtual void AddToSceneManagerLocked();
 		virtual void DelFromSceneManager();
-		virtual void DelFromSceneManagerLocked();
 
 		void BindSubThreadUpdateFunc(std::function<void(SceneObject&, float, float)> const & update_func);
 		void BindMainThreadUpdateFunc(std::function<void(SceneObject&, float, float)> const & update_func);
@@ -70,10 +80,24 @@ namespace KlayGE
 		virtual void SubThreadUpdate(float app_time, float elapsed_time);
 		virtual bool MainThreadUpdate(float app_time, float elapsed_time);
 
+		// While deferred on the calling thread, ModelMatrix and Visible only change the object's own copy, not the
+		// state read by rendering. The changes are published by ApplyDeferredUpdates. Used by the pipelined update
+		// of SceneManager, which simulates the next frame while the current one is rendered. The children without
+		// SOA_PipelinedUpdate are published with their parent.
+		static void DeferUpdates(bool defer);
+		void ApplyDeferredUpdates();
+
 		uint32_t Attrib() const;
 		bool Visible() const;
 		void Visible(bool vis);
 
+		// For occlusion culling. The triangles in model space an SOA_Occluder object draws into the occlusion buffer.
+		// They must stay inside the real geometry. Objects without them use the bounding box of the renderable,
+		// which only fits boxy objects like walls and buildings.
+		void OccluderMesh(std::vector<float3> const & positions, std::vector<uint32_t> const & indices);
+		std::vector<float3> const & OccluderPositions() const;
+		std::vector<uint32_t> const & OccluderIndices() const;
+
 		vertex_elements_type const & InstanceFormat() const;
 		virtual void const * InstanceData() const;
 
@@ -104,7 +128,17 @@ namespace KlayGE
 		float4x4 model_;
 		float4x4 abs_model_;
 		AABBoxPtr pos_aabb_ws_;
-		BoundOverlap visible_mark_;
+		uint32_t scene_index_;
+		TransformHierarchy* transforms_;
+		uint32_t transform_node_;
+
+		// Changes made while the updates are deferred
+		bool model_dirty_;
+		bool visible_dirty_;
+		bool pending_visible_;
+
+		std::vector<float3> occluder_positions_;
+		std::vector<uint32_t> occluder_indices_;
 
 		std::function<void(SceneObject&, float, float)> sub_thread_update_func_;
 		std::function<void(SceneObject&, float, float)> main_thread_update_func_;
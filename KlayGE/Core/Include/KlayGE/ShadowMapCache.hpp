@@ -0,0 +1,93 @@
+/**
+ * @file ShadowMapCache.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+
+#ifndef _SHADOWMAPCACHE_HPP
+#define _SHADOWMAPCACHE_HPP
+
+#pragma once
+
+#include <KlayGE/PreDeclare.hpp>
+#include <KFL/Math.hpp>
+#include <KFL/Frustum.hpp>
+
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+namespace KlayGE
+{
+	// Bookkeeping of the shadow maps with a cached layer of the static casters. A layer belongs to a face of a
+	// light. It stays valid until the view of the face changes, or a static caster in the view is added, removed,
+	// moved, shown or hidden. The moveable casters are rendered over the layer every frame.
+	//
+	// The layers themselves are owned by the renderer, indexed by slot.
+	class KLAYGE_CORE_API ShadowMapCache : boost::noncopyable
+	{
+	public:
+		static uint32_t const INVALID_SLOT = 0xFFFFFFFFU;
+
+	public:
+		ShadowMapCache();
+
+		// Frees the slots not acquired since the last call. Called once a frame, before acquiring.
+		void NewFrame();
+
+		// Returns the slot of a face of a light, adding one if needed. The layer is invalidated if view_proj is
+		// different from the last time.
+		uint32_t Acquire(void const * light, uint32_t face, float4x4 const & view_proj);
+		// The slot acquired in this frame, or INVALID_SLOT.
+		uint32_t Find(void const * light, uint32_t face) const;
+		uint32_t NumSlots() const;
+
+		bool Valid(uint32_t slot) const;
+		// Called after the static casters are rendered into the layer
+		void Validate(uint32_t slot);
+
+		// A static caster in aabb is changed. Invalidates the layers seeing it.
+		void Invalidate(AABBox const & aabb);
+		void InvalidateAll();
+
+	private:
+		struct Slot
+		{
+			void const * light;
+			uint32_t face;
+			uint32_t frame;
+			bool valid;
+			float4x4 view_proj;
+			Frustum frustum;
+		};
+		std::vector<Slot> slots_;
+		uint32_t frame_;
+	};
+}
+
+#endif		// _SHADOWMAPCACHE_HPP
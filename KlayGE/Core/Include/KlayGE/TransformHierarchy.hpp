@@ -0,0 +1,115 @@
+/**
+ * @file TransformHierarchy.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+
+#ifndef _TRANSFORMHIERARCHY_HPP
+#define _TRANSFORMHIERARCHY_HPP
+
+#pragma once
+
+#include <KlayGE/PreDeclare.hpp>
+#include <KFL/Math.hpp>
+
+#include <vector>
+#include <atomic>
+
+#include <boost/noncopyable.hpp>
+
+namespace KlayGE
+{
+	// Local and world matrices of a forest of nodes, kept in contiguous arrays sorted by the depth in the
+	// hierarchy, with the siblings next to each other. Setting a local matrix only marks the node dirty. Update
+	// walks the levels from the roots, and recomputes the dirty nodes and their subtrees with the batch
+	// matrix kernel, in parallel within a level.
+	//
+	// world = parent_world * local
+	//
+	// Nodes are referred by handles, which stay valid until deleted. The slots in the arrays are reordered
+	// when nodes are added, deleted or reparented, so references to the matrices are only valid until then.
+	class KLAYGE_CORE_API TransformHierarchy : boost::noncopyable
+	{
+	public:
+		static uint32_t const INVALID_NODE = 0xFFFFFFFFU;
+
+	public:
+		TransformHierarchy();
+
+		// Adds a node under parent, or a root with INVALID_NODE. The world matrix is computed right away.
+		uint32_t AddNode(uint32_t parent, float4x4 const & local);
+		// The children have to be deleted or reparented first.
+		void DelNode(uint32_t node);
+		void Clear();
+
+		uint32_t NumNodes() const;
+
+		uint32_t Parent(uint32_t node) const;
+		void Parent(uint32_t node, uint32_t parent);
+
+		float4x4 const & LocalMatrix(uint32_t node) const;
+		// Safe to call on different nodes in parallel
+		void LocalMatrix(uint32_t node, float4x4 const & mat);
+		float4x4 const & WorldMatrix(uint32_t node) const;
+		// If the world matrix is recomputed by the last Update.
+		bool WorldChanged(uint32_t node) const;
+
+		// Returns false if nothing is changed, which costs nothing when no local matrix is set.
+		bool Update();
+		bool Update(thread_pool& tp);
+
+	private:
+		void Relayout();
+		bool BeginUpdate();
+		void UpdateSlots(size_t begin, size_t end, bool root);
+
+	private:
+		// Indexed by handle
+		std::vector<uint32_t> node_slots_;
+		std::vector<uint32_t> node_parents_;
+		std::vector<uint32_t> free_nodes_;
+		uint32_t num_nodes_;
+
+		// Indexed by slot. Slots of deleted nodes stay until the next relayout, with INVALID_NODE in slot_nodes_.
+		std::vector<float4x4> local_;
+		std::vector<float4x4> world_;
+		std::vector<uint32_t> parent_slots_;
+		std::vector<uint32_t> slot_nodes_;
+		std::vector<uint8_t> dirty_;
+		std::vector<uint8_t> changed_;
+
+		// Slot ranges of the levels, level i is [level_starts_[i], level_starts_[i + 1])
+		std::vector<size_t> level_starts_;
+
+		bool layout_dirty_;
+		std::atomic<bool> any_dirty_;
+		bool any_changed_;
+	};
+}
+
+#endif		// _TRANSFORMHIERARCHY_HPP
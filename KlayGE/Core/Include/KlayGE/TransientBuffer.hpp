@@ -36,7 +36,6 @@
 #include <KlayGE/PreDeclare.hpp>
 
 #include <vector>
-#include <list>
 
 namespace KlayGE
 {
@@ -55,19 +54,15 @@ namespace KlayGE
 		}
 	};
 
+	// Allocates linearly from a ring. OnPresent puts a fence at the current position, and the space before a fence
+	// is reused once the GPU can't be reading it any more. The buffer grows when the ring is full.
 	class KLAYGE_CORE_API TransientBuffer
 	{
-		// Frames that have ended
-		struct RetiredFrame
+		// Where the allocations of a frame end
+		struct FrameFence
 		{
-			// Sub allocs that are unuseful and will be freed at the end of the frame
-			std::list<SubAlloc> pending_frees_;
 			uint32_t frame_id;
-
-			explicit RetiredFrame(uint32_t id)
-				: frame_id(id)
-			{
-			}
+			uint32_t offset;
 		};
 
 	public:
@@ -82,11 +77,12 @@ namespace KlayGE
 
 		// Allocate a sub space from transient buffer
 		SubAlloc Alloc(uint32_t size_in_byte, void const * data);
-		// Knowtify transient buffer that this alloc is unused and will be freed at the end of the frame.
+		// Knowtify transient buffer that this alloc is unused. The space is reclaimed by frame in OnPresent.
 		void Dealloc(SubAlloc const & alloc);
 		void EnsureDataReady();
-		// Do with retired frames
+		// Fence the allocations of the current frame, and reclaim the space of retired frames
 		void OnPresent();
+		void OnPresent(uint32_t frame_id);
 
 		GraphicsBufferPtr const & GetBuffer() const
 		{
@@ -95,18 +91,23 @@ namespace KlayGE
 
 	private:
 		GraphicsBufferPtr DoCreateBuffer(BindFlag bind_flag, uint32_t size_in_byte);
-		// Free the sub alloc and return the space allocated back to transient buffer.
-		void DoFree(SubAlloc const & alloc);
+		void Grow(uint32_t size_in_byte);
 
 	private:
 		bool use_no_overwrite_;
 		uint32_t num_pre_frames_;
 
 		GraphicsBufferPtr buffer_;
-		std::list<SubAlloc> free_list_;
-		std::list<RetiredFrame> retired_frames_;
 		BindFlag bind_flag_;
 
+		// The space in use is [tail_, head_), or [tail_, wrap_end_) and [0, head_) after wrapping around. head_
+		// never catches up with tail_ from behind, so head_ == tail_ means empty.
+		uint32_t head_;
+		uint32_t tail_;
+		uint32_t wrap_end_;
+		// Oldest first
+		std::vector<FrameFence> fences_;
+
 		std::vector<uint8_t> simulate_buffer_;
 		uint32_t valid_min_;
 		uint32_t valid_max_;
@@ -162,7 +162,7 @@ namespace KlayGE
 					x_(0), y_(0), width_(0), height_(0),
 					dialog_(dialog), index_(0),
 					id_(0), type_(type), enabled_(true),
-					bounding_box_(0, 0, 0, 0)
+					bounding_box_(0, 0, 0, 0), dirty_(true)
 		{
 			BOOST_ASSERT(dialog);
 		}
@@ -174,6 +174,7 @@ namespace KlayGE
 		{
 			is_mouse_over_ = false;
 			has_focus_ = false;
+			dirty_ = true;
 
 			for (size_t i = 0; i < elements_.size(); ++ i)
 			{
@@ -184,6 +185,22 @@ namespace KlayGE
 
 		virtual void Render() = 0;
 
+		// The dialog caches the geometry and text generated by Render, and replays them until the control is dirty.
+		// State, layout and text changes make it dirty. Call Dirty(true) after changing the elements directly.
+		bool Dirty() const
+		{
+			return dirty_;
+		}
+		void Dirty(bool dirty)
+		{
+			dirty_ = dirty;
+		}
+		// A control that changes by time, such as a blinking caret, is rendered every frame while it's animating
+		virtual bool Animating() const
+		{
+			return false;
+		}
+
 		virtual bool CanHaveFocus() const
 		{
 			return false;
@@ -195,18 +212,22 @@ namespace KlayGE
 		virtual void OnFocusIn()
 		{
 			has_focus_ = true;
+			dirty_ = true;
 		}
 		virtual void OnFocusOut()
 		{
 			has_focus_ = false;
+			dirty_ = true;
 		}
 		virtual void OnMouseEnter()
 		{
 			is_mouse_over_ = true;
+			dirty_ = true;
 		}
 		virtual void OnMouseLeave()
 		{
 			is_mouse_over_ = false;
+			dirty_ = true;
 		}
 		virtual void OnHotkey()
 		{
@@ -224,6 +245,7 @@ namespace KlayGE
 		virtual void SetEnabled(bool bEnabled)
 		{
 			enabled_ = bEnabled;
+			dirty_ = true;
 		}
 		virtual bool GetEnabled() const
 		{
@@ -232,6 +254,7 @@ namespace KlayGE
 		virtual void SetVisible(bool bVisible)
 		{
 			visible_ = bVisible;
+			dirty_ = true;
 		}
 		virtual bool GetVisible() const
 		{
@@ -257,12 +280,14 @@ namespace KlayGE
 			x_ = x;
 			y_ = y;
 			this->UpdateRects();
+			dirty_ = true;
 		}
 		void SetSize(int width, int height)
 		{
 			width_ = width;
 			height_ = height;
 			this->UpdateRects();
+			dirty_ = true;
 		}
 
 		void SetHotkey(uint8_t hotkey)
@@ -281,6 +306,7 @@ namespace KlayGE
 			{
 				element->FontColor().States[UICS_Normal] = color;
 			}
+			dirty_ = true;
 		}
 		UIElementPtr const & GetElement(uint32_t iElement) const
 		{
@@ -296,6 +322,7 @@ namespace KlayGE
 
 			// Update the data
 			*elements_[iElement] = *element;
+			dirty_ = true;
 		}
 
 		bool GetIsDefault() const
@@ -305,6 +332,7 @@ namespace KlayGE
 		void SetIsDefault(bool bIsDefault)
 		{
 			is_default_ = bIsDefault;
+			dirty_ = true;
 		}
 		uint32_t GetIndex() const
 		{
@@ -367,8 +395,12 @@ namespace KlayGE
 		bool enabled_;			// Enabled/disabled flag
 
 		IRect bounding_box_;		// Rectangle defining the active region of the control
+
+		bool dirty_;			// The cached geometry needs to be regenerated
 	};
 
+	class UIRectRenderable;
+
 	class KLAYGE_CORE_API UIManager : public std::enable_shared_from_this<UIManager>
 	{
 	public:
@@ -387,6 +419,23 @@ namespace KlayGE
 			}
 		};
 
+		struct string_cache
+		{
+			Rect rc;
+			float depth;
+			Color clr;
+			std::wstring text;
+			uint32_t align;
+		};
+
+		// Quads and strings generated by a dialog or a control, recorded once and drawn every frame until
+		// the owner changes
+		struct RenderCache
+		{
+			std::vector<std::pair<UIRectRenderable*, std::vector<VertexFormat>>> quads;
+			std::vector<std::pair<uint32_t, string_cache>> strings;
+		};
+
 		UIManager();
 		~UIManager();
 
@@ -432,6 +481,11 @@ namespace KlayGE
 		void DrawQuad(float3 const & offset, VertexFormat const * vertices, TexturePtr const & texture);
 		void DrawString(std::wstring const & strText, uint32_t font_index,
 			IRect const & rc, float depth, Color const & clr, uint32_t align);
+		// DrawRect, DrawQuad and DrawString between BeginCache and EndCache are recorded into the cache instead
+		// of drawn. DrawCache draws the recorded ones in this frame.
+		void BeginCache(RenderCache& cache);
+		void EndCache();
+		void DrawCache(RenderCache const & cache);
 		Size_T<float> CalcSize(std::wstring const & strText, uint32_t font_index,
 			IRect const & rc, uint32_t align);
 
@@ -448,6 +502,9 @@ namespace KlayGE
 	private:
 		void Init();
 		void InputHandler(InputEngine const & sender, InputAction const & action);
+		UIRectRenderable& RectRenderable(TexturePtr const & texture);
+		VertexFormat* AddQuad(TexturePtr const & texture);
+		void RenderStrings(std::vector<std::pair<uint32_t, string_cache>> const & strings);
 
 	private:
 		static std::unique_ptr<UIManager> ui_mgr_instance_;
@@ -463,16 +520,10 @@ namespace KlayGE
 		std::array<std::vector<IRect >, UICT_Num_Control_Types> elem_texture_rcs_;
 
 		std::map<TexturePtr, RenderablePtr> rects_;
+		std::vector<std::pair<uint32_t, string_cache>> strings_;
 
-		struct string_cache
-		{
-			Rect rc;
-			float depth;
-			Color clr;
-			std::wstring text;
-			uint32_t align;
-		};
-		std::map<size_t, std::vector<string_cache>> strings_;
+		RenderCache* recording_cache_;
+		std::vector<RenderCache const *> drawn_caches_;
 
 		bool mouse_on_ui_;
 		bool inited_;
@@ -532,6 +583,16 @@ namespace KlayGE
 
 		void Render();
 
+		// The caption and background are cached like the controls. A dirty dialog regenerates all of them.
+		bool Dirty() const
+		{
+			return dirty_;
+		}
+		void Dirty(bool dirty)
+		{
+			dirty_ = dirty;
+		}
+
 		void RequestFocus(UIControl& control);
 		void ClearFocus();
 
@@ -543,6 +604,7 @@ namespace KlayGE
 		void SetVisible(bool bVisible)
 		{
 			visible_ = bVisible;
+			dirty_ = true;
 		}
 		bool GetMinimized() const
 		{
@@ -551,6 +613,7 @@ namespace KlayGE
 		void SetMinimized(bool bMinimized)
 		{
 			minimized_ = bMinimized;
+			dirty_ = true;
 		}
 		void SetBackgroundColors(Color const & colorAllCorners);
 		void SetBackgroundColors(Color const & colorTopLeft, Color const & colorTopRight,
@@ -558,6 +621,7 @@ namespace KlayGE
 		void EnableCaption(bool bEnable)
 		{
 			show_caption_ = bEnable;
+			dirty_ = true;
 		}
 		bool IsCaptionEnabled() const
 		{
@@ -570,6 +634,7 @@ namespace KlayGE
 		void SetCaptionHeight(int nHeight)
 		{
 			caption_height_ = nHeight;
+			dirty_ = true;
 		}
 		void SetID(std::string const & id)
 		{
@@ -582,6 +647,7 @@ namespace KlayGE
 		void SetCaptionText(std::wstring const & strText)
 		{
 			caption_ = strText;
+			dirty_ = true;
 		}
 		int2 GetLocation() const
 		{
@@ -595,11 +661,13 @@ namespace KlayGE
 			bounding_box_.top() = y;
 			bounding_box_.right() = x + w;
 			bounding_box_.bottom() = y + h;
+			dirty_ = true;
 		}
 		void SetSize(int width, int height)
 		{
 			bounding_box_.right() = bounding_box_.left() + width;
 			bounding_box_.bottom() = bounding_box_.top() + height;
+			dirty_ = true;
 		}
 		int GetWidth() const
 		{
@@ -612,6 +680,7 @@ namespace KlayGE
 		void AlwaysInOpacity(bool opacity)
 		{
 			always_in_opacity_ = opacity;
+			dirty_ = true;
 		}
 		bool AlwaysInOpacity() const
 		{
@@ -675,6 +744,10 @@ namespace KlayGE
 		// Control events
 		bool OnCycleFocus(bool bForward);
 
+		void SetOpacity(float opacity);
+		void RenderCaption();
+		void UpdateRenderOrder();
+
 		std::weak_ptr<UIControl> control_focus_;				// The control which has focus
 		std::weak_ptr<UIControl> control_mouse_over_;			// The control which is hovered over
 
@@ -705,6 +778,11 @@ namespace KlayGE
 
 		std::map<std::string, int> id_name_;
 		std::map<int, ControlLocation> id_location_;
+
+		bool dirty_;
+		UIManager::RenderCache cache_;
+		std::vector<UIManager::RenderCache> control_caches_;	// Parallel to controls_
+		std::vector<std::pair<size_t, float>> render_order_;	// Control index and depth base
 	};
 
 	class KLAYGE_CORE_API UIStatic : public UIControl
@@ -1105,6 +1183,12 @@ namespace KlayGE
 			drag_ = false;
 		}
 
+		// Holding an arrow scrolls repeatedly
+		virtual bool Animating() const
+		{
+			return arrow_ != CLEAR;
+		}
+
 		virtual void Render();
 		virtual void UpdateRects();
 
@@ -1209,6 +1293,10 @@ namespace KlayGE
 			UIControl::OnFocusOut();
 			drag_ = false;
 		}
+		virtual bool Animating() const
+		{
+			return scroll_bar_.Animating();
+		}
 
 		virtual void    Render();
 		virtual void    UpdateRects();
@@ -1224,6 +1312,7 @@ namespace KlayGE
 		void SetStyle(STYLE style)
 		{
 			style_ = style;
+			dirty_ = true;
 		}
 		int  GetScrollBarWidth() const
 		{
@@ -1233,11 +1322,13 @@ namespace KlayGE
 		{
 			sb_width_ = width;
 			this->UpdateRects();
+			dirty_ = true;
 		}
 		void SetBorder(int border, int margin)
 		{
 			border_ = border;
 			margin_ = margin;
+			dirty_ = true;
 		}
 		int AddItem(std::wstring const & strText);
 		void SetItemData(int nIndex, std::experimental::any const & data);
@@ -1325,6 +1416,10 @@ namespace KlayGE
 		}
 		virtual void OnHotkey();
 		virtual void OnFocusOut();
+		virtual bool Animating() const
+		{
+			return scroll_bar_.Animating();
+		}
 		virtual void Render();
 
 		virtual void UpdateRects();
@@ -1505,6 +1600,11 @@ namespace KlayGE
 			UIControl::OnFocusOut();
 			mouse_drag_ = false;
 		}
+		// The caret blinks while focused
+		virtual bool Animating() const
+		{
+			return has_focus_;
+		}
 		virtual void Render();
 
 		void SetText(std::wstring const & wszText, bool bSelected = false);
@@ -1520,18 +1620,22 @@ namespace KlayGE
 		virtual void SetTextColor(Color const & Color)
 		{
 			text_color_ = Color;	// Text color
+			dirty_ = true;
 		}
 		void SetSelectedTextColor(Color const & Color)
 		{
 			sel_text_color_ = Color;	// Selected text color
+			dirty_ = true;
 		}
 		void SetSelectedBackColor(Color const & Color)
 		{
 			sel_bk_color_ = Color;	// Selected background color
+			dirty_ = true;
 		}
 		void SetCaretColor(Color const & Color)
 		{
 			caret_color_ = Color;	// Caret color
+			dirty_ = true;
 		}
 		void SetBorderWidth(int nBorder)
 		{
@@ -693,11 +693,15 @@ namespace KlayGE
 		XEvent event;
 		while (!main_wnd_->Closed())
 		{
-			do
+			// A headless window has no display, and no events
+			if (x_display)
 			{
-				XNextEvent(x_display, &event);
-				main_wnd_->MsgProc(event);
-			} while(XPending(x_display));
+				do
+				{
+					XNextEvent(x_display, &event);
+					main_wnd_->MsgProc(event);
+				} while(XPending(x_display));
+			}
 
 			re.Refresh();
 		}
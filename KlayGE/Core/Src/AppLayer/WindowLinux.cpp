@@ -45,6 +45,21 @@ namespace KlayGE
 		: active_(false), ready_(false), closed_(false), dpi_scale_(1), win_rotation_(WR_Identity)
 	{
 		x_display_ = XOpenDisplay(nullptr);
+		if (!x_display_)
+		{
+			// No display server, such as on build machines. The window only keeps its size, for the render
+			// factories presenting nothing, such as Null.
+			vi_ = nullptr;
+			x_window_ = 0;
+			wm_delete_window_ = 0;
+			left_ = settings.left;
+			top_ = settings.top;
+			width_ = settings.width;
+			height_ = settings.height;
+			active_ = true;
+			ready_ = true;
+			return;
+		}
 
 		int r_size, g_size, b_size, a_size, d_size, s_size;
 		switch (settings.color_fmt)
@@ -281,10 +296,13 @@ namespace KlayGE
 
 	Window::~Window()
 	{
-		//XFree(fbc_);
-		XFree(vi_);
-		XDestroyWindow(x_display_, x_window_);
-		XCloseDisplay(x_display_);
+		if (x_display_)
+		{
+			//XFree(fbc_);
+			XFree(vi_);
+			XDestroyWindow(x_display_, x_window_);
+			XCloseDisplay(x_display_);
+		}
 	}
 
 	void Window::MsgProc(XEvent const & event)
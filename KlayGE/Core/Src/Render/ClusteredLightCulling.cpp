@@ -0,0 +1,266 @@
+/**
+ * @file ClusteredLightCulling.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/AABBox.hpp>
+#include <KFL/Sphere.hpp>
+#include <KFL/SIMDBatch.hpp>
+#include <KFL/Thread.hpp>
+
+#include <cmath>
+#include <algorithm>
+
+#include <KlayGE/ClusteredLightCulling.hpp>
+
+namespace
+{
+	// Lights binned per task
+	size_t const LIGHT_TILE_SIZE = 16;
+}
+
+namespace KlayGE
+{
+	ClusteredLightCulling::ClusteredLightCulling()
+		: width_(0), height_(0), tile_size_(0), proj_(float4x4::Identity()),
+			tiles_x_(0), tiles_y_(0), num_slices_(0), near_plane_(1), far_plane_(1), slice_scale_bias_(0, 0)
+	{
+	}
+
+	void ClusteredLightCulling::Setup(uint32_t width, uint32_t height, uint32_t tile_size, uint32_t num_slices,
+		float4x4 const & proj)
+	{
+		BOOST_ASSERT((width > 0) && (height > 0) && (tile_size > 0) && (num_slices > 0));
+
+		if ((width == width_) && (height == height_) && (tile_size == tile_size_) && (num_slices == num_slices_)
+			&& (proj == proj_))
+		{
+			return;
+		}
+
+		width_ = width;
+		height_ = height;
+		tile_size_ = tile_size;
+		proj_ = proj;
+
+		tiles_x_ = (width + tile_size - 1) / tile_size;
+		tiles_y_ = (height + tile_size - 1) / tile_size;
+		num_slices_ = num_slices;
+
+		// z_ndc = (z * q - near * q) / z, q = far / (far - near)
+		near_plane_ = -proj(3, 2) / proj(2, 2);
+		far_plane_ = proj(3, 2) / (1 - proj(2, 2));
+		float const scale = num_slices / std::log(far_plane_ / near_plane_);
+		slice_scale_bias_ = float2(scale, -std::log(near_plane_) * scale);
+
+		uint32_t const num_clusters = this->NumClusters();
+		center_x_.resize(num_clusters);
+		center_y_.resize(num_clusters);
+		center_z_.resize(num_clusters);
+		extent_x_.resize(num_clusters);
+		extent_y_.resize(num_clusters);
+		extent_z_.resize(num_clusters);
+
+		// x = (x_ndc - proj(2, 0)) * z / proj(0, 0), and the same for y
+		std::vector<float> tile_x(tiles_x_ + 1);
+		for (uint32_t x = 0; x <= tiles_x_; ++ x)
+		{
+			float const ndc = std::min(x * tile_size, width) * 2.0f / width - 1;
+			tile_x[x] = (ndc - proj(2, 0)) / proj(0, 0);
+		}
+		std::vector<float> tile_y(tiles_y_ + 1);
+		for (uint32_t y = 0; y <= tiles_y_; ++ y)
+		{
+			float const ndc = 1 - std::min(y * tile_size, height) * 2.0f / height;
+			tile_y[y] = (ndc - proj(2, 1)) / proj(1, 1);
+		}
+
+		for (uint32_t s = 0; s < num_slices_; ++ s)
+		{
+			float const z0 = near_plane_ * std::pow(far_plane_ / near_plane_, static_cast<float>(s) / num_slices_);
+			float const z1 = near_plane_ * std::pow(far_plane_ / near_plane_, static_cast<float>(s + 1) / num_slices_);
+			for (uint32_t y = 0; y < tiles_y_; ++ y)
+			{
+				float const y_min = std::min(std::min(tile_y[y] * z0, tile_y[y] * z1), std::min(tile_y[y + 1] * z0, tile_y[y + 1] * z1));
+				float const y_max = std::max(std::max(tile_y[y] * z0, tile_y[y] * z1), std::max(tile_y[y + 1] * z0, tile_y[y + 1] * z1));
+				for (uint32_t x = 0; x < tiles_x_; ++ x)
+				{
+					float const x_min = std::min(std::min(tile_x[x] * z0, tile_x[x] * z1), std::min(tile_x[x + 1] * z0, tile_x[x + 1] * z1));
+					float const x_max = std::max(std::max(tile_x[x] * z0, tile_x[x] * z1), std::max(tile_x[x + 1] * z0, tile_x[x + 1] * z1));
+
+					uint32_t const cluster = this->ClusterIndex(x, y, s);
+					center_x_[cluster] = (x_min + x_max) / 2;
+					center_y_[cluster] = (y_min + y_max) / 2;
+					center_z_[cluster] = (z0 + z1) / 2;
+					extent_x_[cluster] = (x_max - x_min) / 2;
+					extent_y_[cluster] = (y_max - y_min) / 2;
+					extent_z_[cluster] = (z1 - z0) / 2;
+				}
+			}
+		}
+	}
+
+	void ClusteredLightCulling::ClearLights()
+	{
+		lights_.resize(0);
+	}
+
+	void ClusteredLightCulling::AddPointLight(uint32_t index, float3 const & pos, float range)
+	{
+		lights_.emplace_back();
+		Light& light = lights_.back();
+		light.index = index;
+		light.spot = false;
+		light.pos = pos;
+		light.dir = float3(0, 0, 1);
+		light.cos_outer = -1;
+		light.range = range;
+	}
+
+	void ClusteredLightCulling::AddSpotLight(uint32_t index, float3 const & pos, float3 const & dir, float cos_outer,
+		float range)
+	{
+		lights_.emplace_back();
+		Light& light = lights_.back();
+		light.index = index;
+		light.spot = true;
+		light.pos = pos;
+		light.dir = dir;
+		light.cos_outer = cos_outer;
+		light.range = range;
+	}
+
+	void ClusteredLightCulling::Build()
+	{
+		this->BinLights(0, lights_.size());
+		this->CompactLists();
+	}
+
+	void ClusteredLightCulling::Build(thread_pool& tp)
+	{
+		parallel_for_tiles(tp, lights_.size(), LIGHT_TILE_SIZE,
+			[this](size_t begin, size_t end)
+			{
+				this->BinLights(begin, end);
+			});
+		this->CompactLists();
+	}
+
+	uint32_t ClusteredLightCulling::Slice(float z) const
+	{
+		float const slice = std::log(std::max(z, near_plane_)) * slice_scale_bias_.x() + slice_scale_bias_.y();
+		return std::min(static_cast<uint32_t>(std::max(slice, 0.0f)), num_slices_ - 1);
+	}
+
+	AABBox ClusteredLightCulling::ClusterBound(uint32_t cluster) const
+	{
+		float3 const center(center_x_[cluster], center_y_[cluster], center_z_[cluster]);
+		float3 const extent(extent_x_[cluster], extent_y_[cluster], extent_z_[cluster]);
+		return AABBox(center - extent, center + extent);
+	}
+
+	// Only the slices overlapping the depth range of a light are tested
+	void ClusteredLightCulling::BinLights(size_t begin, size_t end)
+	{
+		uint32_t const clusters_per_slice = tiles_x_ * tiles_y_;
+		std::vector<uint32_t> cone_bits;
+		for (size_t i = begin; i < end; ++ i)
+		{
+			Light& light = lights_[i];
+			light.num_clusters = 0;
+
+			float const z_min = light.pos.z() - light.range;
+			float const z_max = light.pos.z() + light.range;
+			if ((z_max < near_plane_) || (z_min > far_plane_))
+			{
+				continue;
+			}
+
+			uint32_t const first_slice = this->Slice(z_min);
+			uint32_t const last_slice = this->Slice(z_max);
+			light.first_cluster = first_slice * clusters_per_slice;
+			light.num_clusters = (last_slice - first_slice + 1) * clusters_per_slice;
+
+			SIMDBatchLib::AABBoxSoA const boxes = { &center_x_[light.first_cluster], &center_y_[light.first_cluster],
+				&center_z_[light.first_cluster], &extent_x_[light.first_cluster], &extent_y_[light.first_cluster],
+				&extent_z_[light.first_cluster] };
+			size_t const num_words = (light.num_clusters + 31) / 32;
+			light.bits.resize(num_words);
+			SIMDBatchLib::IntersectAABBSphere(&light.bits[0], boxes, light.num_clusters, Sphere(light.pos, light.range));
+			if (light.spot)
+			{
+				cone_bits.resize(num_words);
+				SIMDBatchLib::IntersectAABBCone(&cone_bits[0], boxes, light.num_clusters,
+					light.pos, light.dir, light.cos_outer, light.range);
+				for (size_t w = 0; w < num_words; ++ w)
+				{
+					light.bits[w] &= cone_bits[w];
+				}
+			}
+		}
+	}
+
+	// The lists are in the order the lights are added
+	void ClusteredLightCulling::CompactLists()
+	{
+		cluster_ranges_.assign(this->NumClusters(), uint2(0, 0));
+		for (auto const & light : lights_)
+		{
+			for (uint32_t c = 0; c < light.num_clusters; ++ c)
+			{
+				if (light.bits[c / 32] & (1UL << (c & 31)))
+				{
+					++ cluster_ranges_[light.first_cluster + c].y();
+				}
+			}
+		}
+
+		uint32_t offset = 0;
+		for (auto& range : cluster_ranges_)
+		{
+			range.x() = offset;
+			offset += range.y();
+			range.y() = 0;
+		}
+
+		light_indices_.resize(offset);
+		for (auto const & light : lights_)
+		{
+			for (uint32_t c = 0; c < light.num_clusters; ++ c)
+			{
+				if (light.bits[c / 32] & (1UL << (c & 31)))
+				{
+					uint2& range = cluster_ranges_[light.first_cluster + c];
+					light_indices_[range.x() + range.y()] = light.index;
+					++ range.y();
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,360 @@
+/**
+ * @file CommandList.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KlayGE/KlayGE.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/RenderFactory.hpp>
+#include <KlayGE/RenderEngine.hpp>
+#include <KlayGE/RenderEffect.hpp>
+#include <KlayGE/FrameBuffer.hpp>
+
+#include <cstring>
+
+#include <KlayGE/CommandList.hpp>
+
+namespace
+{
+	using namespace KlayGE;
+
+	thread_local CommandList* recording_cmd_list = nullptr;
+
+	enum ResourceKind
+	{
+		RK_None,
+		RK_Texture,
+		RK_Sampler,
+		RK_Buffer
+	};
+
+	ResourceKind ParamResourceKind(uint32_t type)
+	{
+		switch (type)
+		{
+		case REDT_texture1D:
+		case REDT_texture2D:
+		case REDT_texture3D:
+		case REDT_textureCUBE:
+		case REDT_texture1DArray:
+		case REDT_texture2DArray:
+		case REDT_texture3DArray:
+		case REDT_textureCUBEArray:
+		case REDT_rw_texture1D:
+		case REDT_rw_texture2D:
+		case REDT_rw_texture3D:
+		case REDT_rw_texture1DArray:
+		case REDT_rw_texture2DArray:
+			return RK_Texture;
+
+		case REDT_sampler:
+			return RK_Sampler;
+
+		case REDT_buffer:
+		case REDT_structured_buffer:
+		case REDT_byte_address_buffer:
+		case REDT_rw_buffer:
+		case REDT_rw_structured_buffer:
+		case REDT_rw_byte_address_buffer:
+		case REDT_append_structured_buffer:
+		case REDT_consume_structured_buffer:
+			return RK_Buffer;
+
+		default:
+			return RK_None;
+		}
+	}
+
+	bool SameSubresource(TextureSubresource const & lhs, TextureSubresource const & rhs)
+	{
+		return (lhs.tex == rhs.tex) && (lhs.first_array_index == rhs.first_array_index) && (lhs.num_items == rhs.num_items)
+			&& (lhs.first_level == rhs.first_level) && (lhs.num_levels == rhs.num_levels);
+	}
+}
+
+namespace KlayGE
+{
+	CommandList::CommandList()
+		: recording_(false)
+	{
+	}
+
+	CommandList::~CommandList()
+	{
+		BOOST_ASSERT(!recording_);
+	}
+
+	CommandList* CommandList::Recording()
+	{
+		return recording_cmd_list;
+	}
+
+	void CommandList::Begin()
+	{
+		BOOST_ASSERT(!recording_cmd_list);
+
+		this->Reset();
+		recording_ = true;
+		recording_cmd_list = this;
+	}
+
+	void CommandList::End()
+	{
+		BOOST_ASSERT(this == recording_cmd_list);
+
+		recording_ = false;
+		recording_cmd_list = nullptr;
+	}
+
+	void CommandList::Reset()
+	{
+		commands_.clear();
+		frame_buffers_.clear();
+		indirect_args_.clear();
+		funcs_.clear();
+		cbuff_snapshots_.clear();
+		cbuff_data_.clear();
+		resource_snapshots_.clear();
+		last_cbuffs_.clear();
+		last_resources_.clear();
+		cur_frame_buffer_.reset();
+	}
+
+	void CommandList::BindFrameBuffer(FrameBufferPtr const & fb)
+	{
+		Command& cmd = this->AddCommand(CT_BindFrameBuffer, nullptr, nullptr);
+		cmd.index = static_cast<uint32_t>(frame_buffers_.size());
+		frame_buffers_.push_back(fb);
+
+		cur_frame_buffer_ = fb;
+	}
+
+	void CommandList::Render(RenderEffect const & effect, RenderTechnique const & tech, RenderLayout const & rl)
+	{
+		Command& cmd = this->AddCommand(CT_Render, &effect, &tech);
+		cmd.rl = &rl;
+	}
+
+	void CommandList::Dispatch(RenderEffect const & effect, RenderTechnique const & tech, uint32_t tgx, uint32_t tgy, uint32_t tgz)
+	{
+		Command& cmd = this->AddCommand(CT_Dispatch, &effect, &tech);
+		cmd.args[0] = tgx;
+		cmd.args[1] = tgy;
+		cmd.args[2] = tgz;
+	}
+
+	void CommandList::DispatchIndirect(RenderEffect const & effect, RenderTechnique const & tech,
+		GraphicsBufferPtr const & buff_args, uint32_t offset)
+	{
+		Command& cmd = this->AddCommand(CT_DispatchIndirect, &effect, &tech);
+		cmd.args[0] = offset;
+		cmd.index = static_cast<uint32_t>(indirect_args_.size());
+		indirect_args_.push_back(buff_args);
+	}
+
+	void CommandList::Execute(std::function<void()> const & func)
+	{
+		Command& cmd = this->AddCommand(CT_Execute, nullptr, nullptr);
+		cmd.index = static_cast<uint32_t>(funcs_.size());
+		funcs_.push_back(func);
+	}
+
+	void CommandList::Submit()
+	{
+		BOOST_ASSERT(!recording_);
+		BOOST_ASSERT(!recording_cmd_list);
+
+		RenderEngine& re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
+		for (auto const & cmd : commands_)
+		{
+			if (cmd.effect)
+			{
+				this->RestoreEffect(cmd);
+			}
+
+			switch (cmd.type)
+			{
+			case CT_BindFrameBuffer:
+				re.BindFrameBuffer(frame_buffers_[cmd.index]);
+				break;
+
+			case CT_Render:
+				re.Render(*cmd.effect, *cmd.tech, *cmd.rl);
+				break;
+
+			case CT_Dispatch:
+				re.Dispatch(*cmd.effect, *cmd.tech, cmd.args[0], cmd.args[1], cmd.args[2]);
+				break;
+
+			case CT_DispatchIndirect:
+				re.DispatchIndirect(*cmd.effect, *cmd.tech, indirect_args_[cmd.index], cmd.args[0]);
+				break;
+
+			case CT_Execute:
+				funcs_[cmd.index]();
+				break;
+
+			default:
+				BOOST_ASSERT(false);
+				break;
+			}
+		}
+	}
+
+	CommandList::Command& CommandList::AddCommand(CommandType type, RenderEffect const * effect, RenderTechnique const * tech)
+	{
+		BOOST_ASSERT(recording_);
+
+		commands_.emplace_back();
+		Command& cmd = commands_.back();
+		cmd.type = type;
+		cmd.effect = effect;
+		cmd.tech = tech;
+		cmd.rl = nullptr;
+		cmd.args[0] = cmd.args[1] = cmd.args[2] = 0;
+		cmd.index = 0;
+		cmd.first_cbuff = static_cast<uint32_t>(cbuff_snapshots_.size());
+		cmd.num_cbuffs = 0;
+		cmd.first_resource = static_cast<uint32_t>(resource_snapshots_.size());
+		cmd.num_resources = 0;
+
+		if (effect)
+		{
+			this->CaptureEffect(cmd, *effect);
+		}
+
+		return cmd;
+	}
+
+	void CommandList::CaptureEffect(Command& cmd, RenderEffect const & effect)
+	{
+		for (uint32_t i = 0; i < effect.NumCBuffers(); ++ i)
+		{
+			RenderEffectConstantBuffer* cbuff = effect.CBufferByIndex(i);
+			uint32_t const size = cbuff->Size();
+			if (0 == size)
+			{
+				continue;
+			}
+
+			uint8_t const * data = cbuff->VariableInBuff<uint8_t>(0);
+			auto iter = last_cbuffs_.find(cbuff);
+			if ((iter != last_cbuffs_.end())
+				&& (cbuff_snapshots_[iter->second].size == size)
+				&& (0 == std::memcmp(&cbuff_data_[cbuff_snapshots_[iter->second].offset], data, size)))
+			{
+				continue;
+			}
+
+			CBufferSnapshot snapshot;
+			snapshot.cbuff = cbuff;
+			snapshot.offset = static_cast<uint32_t>(cbuff_data_.size());
+			snapshot.size = size;
+			cbuff_data_.insert(cbuff_data_.end(), data, data + size);
+
+			last_cbuffs_[cbuff] = static_cast<uint32_t>(cbuff_snapshots_.size());
+			cbuff_snapshots_.push_back(snapshot);
+			++ cmd.num_cbuffs;
+		}
+
+		for (uint32_t i = 0; i < effect.NumParameters(); ++ i)
+		{
+			RenderEffectParameter* param = effect.ParameterByIndex(i);
+			ResourceKind const kind = ParamResourceKind(param->Type());
+			if (RK_None == kind)
+			{
+				continue;
+			}
+
+			ResourceSnapshot snapshot;
+			snapshot.param = param;
+			switch (kind)
+			{
+			case RK_Texture:
+				param->Value(snapshot.tex);
+				break;
+
+			case RK_Sampler:
+				param->Value(snapshot.sampler);
+				break;
+
+			default:
+				param->Value(snapshot.buff);
+				break;
+			}
+
+			auto iter = last_resources_.find(param);
+			if (iter != last_resources_.end())
+			{
+				ResourceSnapshot const & last = resource_snapshots_[iter->second];
+				if (SameSubresource(last.tex, snapshot.tex) && (last.sampler == snapshot.sampler) && (last.buff == snapshot.buff))
+				{
+					continue;
+				}
+			}
+
+			last_resources_[param] = static_cast<uint32_t>(resource_snapshots_.size());
+			resource_snapshots_.push_back(snapshot);
+			++ cmd.num_resources;
+		}
+	}
+
+	void CommandList::RestoreEffect(Command const & cmd)
+	{
+		for (uint32_t i = cmd.first_cbuff; i < cmd.first_cbuff + cmd.num_cbuffs; ++ i)
+		{
+			CBufferSnapshot const & snapshot = cbuff_snapshots_[i];
+			uint8_t* data = snapshot.cbuff->VariableInBuff<uint8_t>(0);
+			uint8_t const * src = &cbuff_data_[snapshot.offset];
+			if (std::memcmp(data, src, snapshot.size) != 0)
+			{
+				std::memcpy(data, src, snapshot.size);
+				snapshot.cbuff->Dirty(true);
+			}
+		}
+
+		for (uint32_t i = cmd.first_resource; i < cmd.first_resource + cmd.num_resources; ++ i)
+		{
+			ResourceSnapshot const & snapshot = resource_snapshots_[i];
+			switch (ParamResourceKind(snapshot.param->Type()))
+			{
+			case RK_Texture:
+				*snapshot.param = snapshot.tex;
+				break;
+
+			case RK_Sampler:
+				*snapshot.param = snapshot.sampler;
+				break;
+
+			default:
+				*snapshot.param = snapshot.buff;
+				break;
+			}
+		}
+	}
+}
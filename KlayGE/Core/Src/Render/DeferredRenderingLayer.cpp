@@ -67,8 +67,14 @@ namespace KlayGE
 
 	float const ESM_SCALE_FACTOR = 300.0f;
 
+	float const SM_SMALL_OBJ_THRESHOLD = 0.002f;
+	// Or-ed with the face in index_in_pass, for the passes rendering the static casters into the cached layers
+	int32_t const SM_CACHE_FILL_PASS = 0x10;
+
 #if DEFAULT_DEFERRED == LIGHT_INDEXED_DEFERRED
 	uint32_t const TILE_SIZE = 32;
+	// Depth slices of the light clusters, must match CLUSTER_SLICES in TileBasedDeferredRendering.fxml
+	uint32_t const CLUSTER_SLICES = 16;
 #endif
 
 	template <typename T>
@@ -384,9 +390,12 @@ namespace KlayGE
 		{
 			PostProcess::OnRenderBegin();
 
+			static RenderEffectParameterHandle<float4x4> const inv_proj_handle(CT_HASH("inv_proj"));
+			static RenderEffectParameterHandle<float3> const depth_near_far_invfar_handle(CT_HASH("depth_near_far_invfar"));
+
 			Camera const & camera = Context::Instance().AppInstance().ActiveCamera();
-			*(effect_->ParameterByName("inv_proj")) = camera.InverseProjMatrix();
-			*(effect_->ParameterByName("depth_near_far_invfar")) = float3(camera.NearPlane(), camera.FarPlane(), 1 / camera.FarPlane());
+			inv_proj_handle.Set(*effect_, camera.InverseProjMatrix());
+			depth_near_far_invfar_handle.Set(*effect_, float3(camera.NearPlane(), camera.FarPlane(), 1 / camera.FarPlane()));
 		}
 	};
 
@@ -625,6 +634,7 @@ namespace KlayGE
 		{
 			technique_tbdr_shadowing_unified_ = dr_effect_->TechniqueByName("TBDRShadowingUnified");
 			technique_tbdr_unified_ = dr_effect_->TechniqueByName("TBDRUnified");
+			technique_tbdr_clustered_ = dr_effect_->TechniqueByName("TBDRClustered");
 		}
 		else
 		{
@@ -852,6 +862,10 @@ namespace KlayGE
 			shading_in_tex_param_ = dr_effect_->ParameterByName("shading_in_tex");
 			shading_rw_tex_param_ = dr_effect_->ParameterByName("shading_rw_tex");
 			lights_type_param_ = dr_effect_->ParameterByName("lights_type");
+			cluster_dims_param_ = dr_effect_->ParameterByName("cluster_dims");
+			cluster_slice_scale_bias_param_ = dr_effect_->ParameterByName("cluster_slice_scale_bias");
+			cluster_ranges_param_ = dr_effect_->ParameterByName("cluster_ranges");
+			cluster_light_indices_param_ = dr_effect_->ParameterByName("cluster_light_indices");
 
 			projective_shadowing_rw_tex_param_ = dr_effect_->ParameterByName("projective_shadowing_rw_tex");
 			shadowing_rw_tex_param_ = dr_effect_->ParameterByName("shadowing_rw_tex");
@@ -1406,6 +1420,8 @@ namespace KlayGE
 		{
 			curr_cascade_index_ = -1;
 
+			scene_mgr.ShadowCache().NewFrame();
+
 			this->BuildLightList();
 
 			bool has_opaque_objs = false;
@@ -1414,6 +1430,7 @@ namespace KlayGE
 			this->BuildVisibleSceneObjList(has_opaque_objs, has_transparency_back_objs, has_transparency_front_objs);
 
 			this->BuildPassScanList(has_opaque_objs, has_transparency_back_objs, has_transparency_front_objs);
+			this->AddClipViews();
 
 			num_objects_rendered_ = 0;
 			num_renderables_rendered_ = 0;
@@ -1595,6 +1612,15 @@ namespace KlayGE
 							}
 							cascaded_shadow_layer_->UpdateCascades(scene_camera, light_camera.ViewProjMatrix(),
 								cascade_border);
+
+							// All the cascades are clipped in one pass, with the casters toward the sun kept
+							float3 const & light_dir = lights_[cascaded_shadow_index_]->Direction();
+							for (uint32_t i = 0; i < pvp.num_cascades; ++ i)
+							{
+								scene_mgr.AddShadowClipView(light_camera, i,
+									light_camera.ViewProjMatrix() * cascaded_shadow_layer_->CascadeCropMatrix(i),
+									SM_SMALL_OBJ_THRESHOLD, light_dir);
+							}
 						}
 					}
 				}
@@ -1630,6 +1656,24 @@ namespace KlayGE
 		case PC_ShadowMap:
 			{
 				auto const & light = *lights_[org_no];
+				if (index_in_pass & SM_CACHE_FILL_PASS)
+				{
+					int32_t const face = index_in_pass & ~SM_CACHE_FILL_PASS;
+					this->PrepareLightCamera(pvp, light, face, pass_type);
+
+					ShadowMapCache& sm_cache = scene_mgr.ShadowCache();
+					uint32_t const slot = sm_cache.Find(&light, face);
+					FrameBufferPtr const & fb = sm_cache_fbs_[slot];
+					fb->GetViewport()->camera = sm_fb_->GetViewport()->camera;
+					re.BindFrameBuffer(fb);
+					fb->Attached(FrameBuffer::ATT_Color0)->Discard();
+					fb->Attached(FrameBuffer::ATT_DepthStencil)->ClearDepth(1.0f);
+					sm_cache.Validate(slot);
+
+					urv = App3DFramework::URV_NeedFlush | App3DFramework::URV_StaticOnly;
+					break;
+				}
+
 				this->PrepareLightCamera(pvp, light, index_in_pass, pass_type);
 
 				if (index_in_pass > 0)
@@ -1650,9 +1694,24 @@ namespace KlayGE
 					switch (pass_rt)
 					{
 					case PRT_ShadowMap:
-						re.BindFrameBuffer(sm_fb_);
-						sm_fb_->Attached(FrameBuffer::ATT_Color0)->Discard();
-						sm_fb_->Attached(FrameBuffer::ATT_DepthStencil)->ClearDepth(1.0f);
+						{
+							// The static casters are copied from the cached layer, only the moveable ones are rendered
+							ShadowMapCache const & sm_cache = scene_mgr.ShadowCache();
+							uint32_t const slot = sm_cache.Find(&light, index_in_pass);
+							bool const cached = (slot != ShadowMapCache::INVALID_SLOT) && sm_cache.Valid(slot);
+							if (cached)
+							{
+								sm_cache_depth_texs_[slot]->CopyToTexture(*sm_depth_tex_);
+								urv |= App3DFramework::URV_DynamicOnly;
+							}
+
+							re.BindFrameBuffer(sm_fb_);
+							sm_fb_->Attached(FrameBuffer::ATT_Color0)->Discard();
+							if (!cached)
+							{
+								sm_fb_->Attached(FrameBuffer::ATT_DepthStencil)->ClearDepth(1.0f);
+							}
+						}
 						break;
 
 					case PRT_ShadowMapWODepth:
@@ -1884,7 +1943,7 @@ namespace KlayGE
 			break;
 		}
 
-		scene_mgr.SmallObjectThreshold((PC_ShadowMap == pass_cat) ? 0.002f : 0.0f);
+		scene_mgr.SmallObjectThreshold((PC_ShadowMap == pass_cat) ? SM_SMALL_OBJ_THRESHOLD : 0.0f);
 		return urv;
 	}
 
@@ -2180,6 +2239,58 @@ namespace KlayGE
 #endif
 	}
 
+	// Registers the views of the shadow maps and the viewports to the scene manager, which clips them together at
+	// the first flush. The cascades are registered after they are updated.
+	void DeferredRenderingLayer::AddClipViews()
+	{
+		SceneManager& scene_mgr = Context::Instance().SceneManagerInstance();
+
+		for (auto const & light : lights_)
+		{
+			if (!light->Enabled())
+			{
+				continue;
+			}
+
+			int32_t const attr = light->Attrib();
+			switch (light->Type())
+			{
+			case LightSource::LT_Spot:
+				if (!(attr & LightSource::LSA_NoShadow) || (attr & LightSource::LSA_IndirectLighting))
+				{
+					Camera const & sm_camera = *light->SMCamera(0);
+					scene_mgr.AddClipView(sm_camera, -1, sm_camera.ViewProjMatrix(), SM_SMALL_OBJ_THRESHOLD);
+				}
+				break;
+
+			case LightSource::LT_Point:
+			case LightSource::LT_SphereArea:
+			case LightSource::LT_TubeArea:
+				if (!(attr & LightSource::LSA_NoShadow))
+				{
+					for (uint32_t face = 0; face < 6; ++ face)
+					{
+						Camera const & sm_camera = *light->SMCamera(face);
+						scene_mgr.AddClipView(sm_camera, -1, sm_camera.ViewProjMatrix(), SM_SMALL_OBJ_THRESHOLD);
+					}
+				}
+				break;
+
+			default:
+				break;
+			}
+		}
+
+		for (auto const & pvp : viewports_)
+		{
+			if (pvp.attrib & VPAM_Enabled)
+			{
+				Camera const & camera = *pvp.frame_buffer->GetViewport()->camera;
+				scene_mgr.AddClipView(camera, -1, camera.ViewProjMatrix(), 0);
+			}
+		}
+	}
+
 	void DeferredRenderingLayer::CheckLightVisible(uint32_t vp_index, uint32_t light_index)
 	{
 		SceneManager& scene_mgr = Context::Instance().SceneManagerInstance();
@@ -2306,6 +2417,10 @@ namespace KlayGE
 
 				if (sm_seq != 0)
 				{
+					if (PT_GenShadowMap == shadow_pt)
+					{
+						this->AppendShadowCachePassScanCode(light_index, 1);
+					}
 					pass_scaned_.push_back(this->ComposePassScanCode(0, shadow_pt, light_index, 0, false));
 					pass_scaned_.push_back(this->ComposePassScanCode(0, shadow_pt, light_index, 1, false));
 				}
@@ -2317,6 +2432,10 @@ namespace KlayGE
 		case LightSource::LT_TubeArea:
 			if (0 == (attr & LightSource::LSA_NoShadow))
 			{
+				if (PT_GenShadowMap == shadow_pt)
+				{
+					this->AppendShadowCachePassScanCode(light_index, 6);
+				}
 				for (int j = 0; j < 7; ++ j)
 				{
 					pass_scaned_.push_back(this->ComposePassScanCode(0, shadow_pt, light_index, j, false));
@@ -2336,6 +2455,36 @@ namespace KlayGE
 		}
 	}
 
+	// The static casters of the spot and point lights are rendered into cached layers, before the shadow maps of the
+	// light. Only the invalid layers are filled. The sun isn't cached, since its cascades follow the camera.
+	void DeferredRenderingLayer::AppendShadowCachePassScanCode(uint32_t light_index, uint32_t num_faces)
+	{
+		RenderFactory& rf = Context::Instance().RenderFactoryInstance();
+		ShadowMapCache& sm_cache = Context::Instance().SceneManagerInstance().ShadowCache();
+
+		auto const & light = *lights_[light_index];
+		for (uint32_t face = 0; face < num_faces; ++ face)
+		{
+			uint32_t const slot = sm_cache.Acquire(&light, face, light.SMCamera(face)->ViewProjMatrix());
+			while (slot >= sm_cache_fbs_.size())
+			{
+				TexturePtr depth_tex = rf.MakeTexture2D(SM_SIZE, SM_SIZE, 1, 1, sm_depth_tex_->Format(), 1, 0,
+					EAH_GPU_Read | EAH_GPU_Write, nullptr);
+				FrameBufferPtr fb = rf.MakeFrameBuffer();
+				fb->Attach(FrameBuffer::ATT_Color0, sm_fb_->Attached(FrameBuffer::ATT_Color0));
+				fb->Attach(FrameBuffer::ATT_DepthStencil, rf.Make2DDepthStencilRenderView(*depth_tex, 0, 1, 0));
+				sm_cache_depth_texs_.push_back(depth_tex);
+				sm_cache_fbs_.push_back(fb);
+			}
+
+			if (!sm_cache.Valid(slot))
+			{
+				pass_scaned_.push_back(this->ComposePassScanCode(0, PT_GenShadowMap, light_index,
+					SM_CACHE_FILL_PASS | face, false));
+			}
+		}
+	}
+
 	void DeferredRenderingLayer::AppendCascadedShadowPassScanCode(uint32_t vp_index, uint32_t light_index)
 	{
 		BOOST_ASSERT(LightSource::LT_Sun == lights_[light_index]->Type());
@@ -3981,8 +4130,20 @@ namespace KlayGE
 		*skylight_diff_spec_mip_param_ = int3(0, 0, 0);
 		*skylight_mip_bias_param_ = 0.0f;
 
+		// The point, spot and area lights are binned into clusters of a tile and a depth slice on the CPU, so the
+		// shading reads the lists instead of culling the lights per tile
+		bool const clustered = technique_tbdr_clustered_->Validate();
+		if (clustered)
+		{
+			cluster_culling_.Setup(w, h, TILE_SIZE, CLUSTER_SLICES, pvp.proj);
+			*cluster_dims_param_ = uint3(cluster_culling_.TilesX(), cluster_culling_.TilesY(), cluster_culling_.NumSlices());
+			*cluster_slice_scale_bias_param_ = cluster_culling_.SliceScaleBias();
+		}
+
 		for (uint32_t li = 0; li < lights_.size();)
 		{
+			cluster_culling_.ClearLights();
+
 			std::array<std::vector<uint32_t>, 11> available_lights;
 			for (uint32_t batch = 0; (batch < light_batch_) && (li < lights_.size()); ++ li)
 			{
@@ -4187,6 +4348,31 @@ namespace KlayGE
 						= float4(aabb.Min().x(), aabb.Min().y(), aabb.Min().z(), 0);
 					*reinterpret_cast<float4*>(lights_aabb_max + offset * lights_aabb_max_param_->Stride())
 						= float4(aabb.Max().x(), aabb.Max().y(), aabb.Max().z(), 0);
+
+					if (clustered)
+					{
+						switch (type)
+						{
+						case LightSource::LT_Point:
+							cluster_culling_.AddPointLight(offset, loc_es, range);
+							break;
+
+						case LightSource::LT_Spot:
+							cluster_culling_.AddSpotLight(offset, loc_es, dir_es, light.CosOuterInner().x(), range);
+							break;
+
+						case LightSource::LT_SphereArea:
+							cluster_culling_.AddPointLight(offset, loc_es, range + light.Radius());
+							break;
+
+						case LightSource::LT_TubeArea:
+							cluster_culling_.AddPointLight(offset, loc_es, range + MathLib::length(extend_es));
+							break;
+
+						default:
+							break;
+						}
+					}
 				}
 			}
 
@@ -4218,8 +4404,17 @@ namespace KlayGE
 				*shading_rw_tex_param_
 					= (PTB_Opaque == pass_tb) ? pvp.merged_shading_texs[pvp.curr_merged_buffer_index] : pvp.shading_tex;
 			}
-			re.Dispatch(*dr_effect_, *technique_tbdr_unified_,
-				(w + TILE_SIZE - 1) / TILE_SIZE, (h + TILE_SIZE - 1) / TILE_SIZE, 1);
+			if (clustered)
+			{
+				this->UploadLightClusters();
+				re.Dispatch(*dr_effect_, *technique_tbdr_clustered_,
+					(w + TILE_SIZE - 1) / TILE_SIZE, (h + TILE_SIZE - 1) / TILE_SIZE, 1);
+			}
+			else
+			{
+				re.Dispatch(*dr_effect_, *technique_tbdr_unified_,
+					(w + TILE_SIZE - 1) / TILE_SIZE, (h + TILE_SIZE - 1) / TILE_SIZE, 1);
+			}
 
 			if (available_lights[0].empty())
 			{
@@ -4231,6 +4426,41 @@ namespace KlayGE
 		}
 	}
 
+	void DeferredRenderingLayer::UploadLightClusters()
+	{
+		cluster_culling_.Build(Context::Instance().ThreadPool());
+
+		RenderFactory& rf = Context::Instance().RenderFactoryInstance();
+
+		std::vector<uint2> const & ranges = cluster_culling_.ClusterRanges();
+		uint32_t const ranges_size = static_cast<uint32_t>(ranges.size() * sizeof(ranges[0]));
+		if (!cluster_ranges_buff_ || (cluster_ranges_buff_->Size() < ranges_size))
+		{
+			cluster_ranges_buff_ = rf.MakeVertexBuffer(BU_Dynamic, EAH_CPU_Write | EAH_GPU_Read | EAH_GPU_Structured,
+				ranges_size, nullptr, EF_GR32UI);
+			*cluster_ranges_param_ = cluster_ranges_buff_;
+		}
+		{
+			GraphicsBuffer::Mapper mapper(*cluster_ranges_buff_, BA_Write_Only);
+			std::copy(ranges.begin(), ranges.end(), mapper.Pointer<uint2>());
+		}
+
+		// Grows by half, the number of indices changes every frame
+		std::vector<uint32_t> const & indices = cluster_culling_.LightIndices();
+		uint32_t const indices_size = static_cast<uint32_t>(std::max<size_t>(indices.size(), 1) * sizeof(uint32_t));
+		if (!cluster_light_indices_buff_ || (cluster_light_indices_buff_->Size() < indices_size))
+		{
+			cluster_light_indices_buff_ = rf.MakeVertexBuffer(BU_Dynamic, EAH_CPU_Write | EAH_GPU_Read | EAH_GPU_Structured,
+				indices_size * 3 / 2, nullptr, EF_R32UI);
+			*cluster_light_indices_param_ = cluster_light_indices_buff_;
+		}
+		if (!indices.empty())
+		{
+			GraphicsBuffer::Mapper mapper(*cluster_light_indices_buff_, BA_Write_Only);
+			std::copy(indices.begin(), indices.end(), mapper.Pointer<uint32_t>());
+		}
+	}
+
 	void DeferredRenderingLayer::CreateDepthMinMaxMapCS(PerViewport const & pvp)
 	{
 		RenderEngine& re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
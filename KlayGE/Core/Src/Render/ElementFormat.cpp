@@ -36,6 +36,68 @@
 
 #include <KFL/Math.hpp>
 #include <KFL/Half.hpp>
+#include <KFL/SIMDBatch.hpp>
+
+#include <algorithm>
+
+namespace
+{
+	using namespace KlayGE;
+
+	uint32_t const HALF_CONVERSION_BATCH = 256;
+
+	// Only ABGR16F has the same layout as Color. R16F, GR16F and BGR16F are converted in small batches
+	// through a buffer on the stack.
+	void ConvertHalfToABGR32F(uint32_t num_channels, half const * input, uint32_t num_elems, Color* output)
+	{
+		if (4 == num_channels)
+		{
+			SIMDBatchLib::HalfToFloat(&output->r(), input, num_elems * 4);
+		}
+		else
+		{
+			float buff[HALF_CONVERSION_BATCH * 3];
+			for (uint32_t i = 0; i < num_elems; i += HALF_CONVERSION_BATCH)
+			{
+				uint32_t const n = std::min(num_elems - i, HALF_CONVERSION_BATCH);
+				SIMDBatchLib::HalfToFloat(buff, input + i * num_channels, n * num_channels);
+				for (uint32_t j = 0; j < n; ++ j)
+				{
+					Color& clr = output[i + j];
+					clr = Color(0, 0, 0, 1);
+					for (uint32_t c = 0; c < num_channels; ++ c)
+					{
+						clr[c] = buff[j * num_channels + c];
+					}
+				}
+			}
+		}
+	}
+
+	void ConvertHalfFromABGR32F(uint32_t num_channels, Color const * input, uint32_t num_elems, half* output)
+	{
+		if (4 == num_channels)
+		{
+			SIMDBatchLib::FloatToHalf(output, &input->r(), num_elems * 4);
+		}
+		else
+		{
+			float buff[HALF_CONVERSION_BATCH * 3];
+			for (uint32_t i = 0; i < num_elems; i += HALF_CONVERSION_BATCH)
+			{
+				uint32_t const n = std::min(num_elems - i, HALF_CONVERSION_BATCH);
+				for (uint32_t j = 0; j < n; ++ j)
+				{
+					for (uint32_t c = 0; c < num_channels; ++ c)
+					{
+						buff[j * num_channels + c] = input[i + j][c];
+					}
+				}
+				SIMDBatchLib::FloatToHalf(output + i * num_channels, buff, n * num_channels);
+			}
+		}
+	}
+}
 
 namespace KlayGE
 {
@@ -538,19 +600,11 @@ namespace KlayGE
 
 
 		case EF_R16F:
-			for (uint32_t i = 0; i < num_elems; ++ i, p += elem_size, ++ output)
-			{
-				half const s = *reinterpret_cast<half const *>(p);
-				*output = Color(s, 0, 0, 1);
-			}
+			ConvertHalfToABGR32F(1, reinterpret_cast<half const *>(p), num_elems, output);
 			break;
 
 		case EF_GR16F:
-			for (uint32_t i = 0; i < num_elems; ++ i, p += elem_size, ++ output)
-			{
-				half const * s = reinterpret_cast<half const *>(p);
-				*output = Color(s[0], s[1], 0, 1);
-			}
+			ConvertHalfToABGR32F(2, reinterpret_cast<half const *>(p), num_elems, output);
 			break;
 
 		case EF_B10G11R11F:
@@ -646,19 +700,11 @@ namespace KlayGE
 			break;
 
 		case EF_BGR16F:
-			for (uint32_t i = 0; i < num_elems; ++ i, p += elem_size, ++ output)
-			{
-				half const * s = reinterpret_cast<half const *>(p);
-				*output = Color(s[0], s[1], s[2], 1);
-			}
+			ConvertHalfToABGR32F(3, reinterpret_cast<half const *>(p), num_elems, output);
 			break;
 
 		case EF_ABGR16F:
-			for (uint32_t i = 0; i < num_elems; ++ i, p += elem_size, ++ output)
-			{
-				half const * s = reinterpret_cast<half const *>(p);
-				*output = Color(s[0], s[1], s[2], s[3]);
-			}
+			ConvertHalfToABGR32F(4, reinterpret_cast<half const *>(p), num_elems, output);
 			break;
 
 		case EF_R32F:
@@ -1293,20 +1339,11 @@ namespace KlayGE
 
 
 		case EF_R16F:
-			for (uint32_t i = 0; i < num_elems; ++ i, ++ input, p += elem_size)
-			{
-				half* s = reinterpret_cast<half*>(p);
-				*s = half(input->r());
-			}
+			ConvertHalfFromABGR32F(1, input, num_elems, reinterpret_cast<half*>(p));
 			break;
 
 		case EF_GR16F:
-			for (uint32_t i = 0; i < num_elems; ++ i, ++ input, p += elem_size)
-			{
-				half* s = reinterpret_cast<half*>(p);
-				s[0] = half(input->r());
-				s[1] = half(input->g());
-			}
+			ConvertHalfFromABGR32F(2, input, num_elems, reinterpret_cast<half*>(p));
 			break;
 
 		case EF_B10G11R11F:
@@ -1427,24 +1464,11 @@ namespace KlayGE
 			break;
 
 		case EF_BGR16F:
-			for (uint32_t i = 0; i < num_elems; ++ i, ++ input, p += elem_size)
-			{
-				half* s = reinterpret_cast<half*>(p);
-				s[0] = half(input->r());
-				s[1] = half(input->g());
-				s[2] = half(input->b());
-			}
+			ConvertHalfFromABGR32F(3, input, num_elems, reinterpret_cast<half*>(p));
 			break;
 
 		case EF_ABGR16F:
-			for (uint32_t i = 0; i < num_elems; ++ i, ++ input, p += elem_size)
-			{
-				half* s = reinterpret_cast<half*>(p);
-				s[0] = half(input->r());
-				s[1] = half(input->g());
-				s[2] = half(input->b());
-				s[3] = half(input->a());
-			}
+			ConvertHalfFromABGR32F(4, input, num_elems, reinterpret_cast<half*>(p));
 			break;
 
 		case EF_R32F:
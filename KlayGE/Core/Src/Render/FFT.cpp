@@ -16,6 +16,7 @@
 #include <KlayGE/RenderFactory.hpp>
 #include <KlayGE/RenderEngine.hpp>
 #include <KFL/Half.hpp>
+#include <KFL/SIMDBatch.hpp>
 #include <KlayGE/RenderEffect.hpp>
 #include <KlayGE/FrameBuffer.hpp>
 
@@ -164,6 +165,10 @@ namespace KlayGE
 	{
 		half* ptr = &lookup_i_wr_wi[0];
 
+		// Each pass is filled in float and converted in one batch
+		std::vector<float> pass_lookup(n * 4);
+		float* pass_ptr = &pass_lookup[0];
+
 		for (int i = 0; i < log_n; ++ i)
 		{
 			int const blocks = 1UL << (log_n - 1 - i);
@@ -189,18 +194,19 @@ namespace KlayGE
 					float wr, wi;
 					this->ComputeWeight(wr, wi, n, k * blocks);
 
-					ptr[i1 * 4 + 0] = half((j1 + 0.5f) / n);
-					ptr[i1 * 4 + 1] = half((j2 + 0.5f) / n);
-					ptr[i1 * 4 + 2] = half(+wr);
-					ptr[i1 * 4 + 3] = half(+wi);
+					pass_ptr[i1 * 4 + 0] = (j1 + 0.5f) / n;
+					pass_ptr[i1 * 4 + 1] = (j2 + 0.5f) / n;
+					pass_ptr[i1 * 4 + 2] = +wr;
+					pass_ptr[i1 * 4 + 3] = +wi;
 
-					ptr[i2 * 4 + 0] = half((j1 + 0.5f) / n);
-					ptr[i2 * 4 + 1] = half((j2 + 0.5f) / n);
-					ptr[i2 * 4 + 2] = half(-wr);
-					ptr[i2 * 4 + 3] = half(-wi);
+					pass_ptr[i2 * 4 + 0] = (j1 + 0.5f) / n;
+					pass_ptr[i2 * 4 + 1] = (j2 + 0.5f) / n;
+					pass_ptr[i2 * 4 + 2] = -wr;
+					pass_ptr[i2 * 4 + 3] = -wi;
 				}
 			}
 
+			SIMDBatchLib::FloatToHalf(ptr, pass_ptr, n * 4);
 			ptr += n * 4;
 		}
 	}
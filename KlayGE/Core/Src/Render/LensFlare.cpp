@@ -11,6 +11,7 @@
 /////////////////////////////////////////////////////////////////////////////////
 
 #include <KlayGE/KlayGE.hpp>
+#include <KFL/Util.hpp>
 #include <KlayGE/App3D.hpp>
 #include <KlayGE/RenderFactory.hpp>
 #include <KlayGE/RenderEngine.hpp>
@@ -76,13 +77,16 @@ namespace KlayGE
 
 	void LensFlareRenderable::OnRenderBegin()
 	{
+		static RenderEffectParameterHandle<float3> const eye_pos_handle(CT_HASH("eye_pos"));
+		static RenderEffectParameterHandle<float> const scale_handle(CT_HASH("scale"));
+
 		App3DFramework const & app = Context::Instance().AppInstance();
 		Camera const & camera = app.ActiveCamera();
 			
-		*(effect_->ParameterByName("eye_pos")) = camera.EyePos();
+		eye_pos_handle.Set(*effect_, camera.EyePos());
 
 		RenderEngine& re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
-		*(effect_->ParameterByName("scale")) = static_cast<float>(re.CurFrameBuffer()->Width()) / re.CurFrameBuffer()->Height();
+		scale_handle.Set(*effect_, static_cast<float>(re.CurFrameBuffer()->Width()) / re.CurFrameBuffer()->Height());
 	}
 
 	
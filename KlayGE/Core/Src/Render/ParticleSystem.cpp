@@ -29,6 +29,7 @@
  */
 
 #include <KlayGE/KlayGE.hpp>
+#include <KFL/Util.hpp>
 #include <KlayGE/Texture.hpp>
 #include <KlayGE/RenderFactory.hpp>
 #include <KlayGE/RenderEngine.hpp>
@@ -514,18 +515,24 @@ namespace
 			float4x4 const & view = camera.ViewMatrix();
 			float4x4 const & proj = camera.ProjMatrix();
 
-			*(effect_->ParameterByName("model_view")) = model_mat_ * view;
-			*(effect_->ParameterByName("proj")) = proj;
-			*(effect_->ParameterByName("far_plane")) = camera.FarPlane();
+			static RenderEffectParameterHandle<float4x4> const model_view_handle(CT_HASH("model_view"));
+			static RenderEffectParameterHandle<float4x4> const proj_handle(CT_HASH("proj"));
+			static RenderEffectParameterHandle<float> const far_plane_handle(CT_HASH("far_plane"));
+			static RenderEffectParameterHandle<float> const point_radius_handle(CT_HASH("point_radius"));
+			static RenderEffectParameterHandle<TexturePtr> const depth_tex_handle(CT_HASH("depth_tex"));
+
+			model_view_handle.Set(*effect_, model_mat_ * view);
+			proj_handle.Set(*effect_, proj);
+			far_plane_handle.Set(*effect_, camera.FarPlane());
 
 			float scale_x = sqrt(model_mat_(0, 0) * model_mat_(0, 0) + model_mat_(0, 1) * model_mat_(0, 1) + model_mat_(0, 2) * model_mat_(0, 2));
 			float scale_y = sqrt(model_mat_(1, 0) * model_mat_(1, 0) + model_mat_(1, 1) * model_mat_(1, 1) + model_mat_(1, 2) * model_mat_(1, 2));
-			*(effect_->ParameterByName("point_radius")) = 0.08f * std::max(scale_x, scale_y);
+			point_radius_handle.Set(*effect_, 0.08f * std::max(scale_x, scale_y));
 
 			auto drl = Context::Instance().DeferredRenderingLayerInstance();
 			if (drl)
 			{
-				*(effect_->ParameterByName("depth_tex")) = drl->CurrFrameDepthTex(drl->ActiveViewport());
+				depth_tex_handle.Set(*effect_, drl->CurrFrameDepthTex(drl->ActiveViewport()));
 			}
 		}
 
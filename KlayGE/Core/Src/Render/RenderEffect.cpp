@@ -55,7 +55,10 @@
 #include <KFL/XMLDom.hpp>
 #include <KFL/Thread.hpp>
 
+#include <algorithm>
+#include <condition_variable>
 #include <fstream>
+#include <thread>
 #include <boost/assert.hpp>
 #if defined(KLAYGE_COMPILER_GCC)
 #pragma GCC diagnostic push
@@ -79,6 +82,10 @@ namespace
 
 	std::mutex singleton_mutex;
 
+#ifndef KLAYGE_SHIP
+	std::atomic<uint32_t> num_string_lookups(0);
+#endif
+
 	class type_define
 	{
 	public:
@@ -2816,41 +2823,58 @@ namespace KlayGE
 
 	RenderEffectParameter* RenderEffect::ParameterByName(std::string const & name) const
 	{
-		size_t const name_hash = boost::hash_range(name.begin(), name.end());
-		for (auto const & param : params_)
-		{
-			if (name_hash == param->NameHash())
-			{
-				return param.get();
-			}
-		}
-		return nullptr;
+#ifndef KLAYGE_SHIP
+		++ num_string_lookups;
+#endif
+		return this->ParameterByNameHash(RT_HASH(name.c_str()));
 	}
 
 	RenderEffectParameter* RenderEffect::ParameterBySemantic(std::string const & semantic) const
 	{
-		size_t const semantic_hash = boost::hash_range(semantic.begin(), semantic.end());
-		for (auto const & param : params_)
-		{
-			if (semantic_hash == param->SemanticHash())
-			{
-				return param.get();
-			}
-		}
-		return nullptr;
+#ifndef KLAYGE_SHIP
+		++ num_string_lookups;
+#endif
+		return this->ParameterBySemanticHash(RT_HASH(semantic.c_str()));
+	}
+
+	RenderEffectParameter* RenderEffect::ParameterByNameHash(size_t name_hash) const
+	{
+		uint32_t const index = effect_template_->ParameterIndexByNameHash(name_hash);
+		return (index != INVALID_INDEX) ? params_[index].get() : nullptr;
+	}
+
+	RenderEffectParameter* RenderEffect::ParameterBySemanticHash(size_t semantic_hash) const
+	{
+		uint32_t const index = effect_template_->ParameterIndexBySemanticHash(semantic_hash);
+		return (index != INVALID_INDEX) ? params_[index].get() : nullptr;
+	}
+
+	uint32_t RenderEffect::ParameterIndexByNameHash(size_t name_hash) const
+	{
+		return effect_template_->ParameterIndexByNameHash(name_hash);
 	}
 
 	RenderEffectConstantBuffer* RenderEffect::CBufferByName(std::string const & name) const
 	{
-		size_t const name_hash = boost::hash_range(name.begin(), name.end());
-		for (auto const & cbuffer : cbuffers_)
-		{
-			if (name_hash == cbuffer->NameHash())
-			{
-				return cbuffer.get();
-			}
-		}
-		return nullptr;
+#ifndef KLAYGE_SHIP
+		++ num_string_lookups;
+#endif
+		return this->CBufferByNameHash(RT_HASH(name.c_str()));
+	}
+
+	RenderEffectConstantBuffer* RenderEffect::CBufferByNameHash(size_t name_hash) const
+	{
+		uint32_t const index = effect_template_->CBufferIndexByNameHash(name_hash);
+		return (index != INVALID_INDEX) ? cbuffers_[index].get() : nullptr;
+	}
+
+	uint32_t RenderEffect::NumStringLookupsJustMade()
+	{
+#ifndef KLAYGE_SHIP
+		return num_string_lookups.exchange(0);
+#else
+		return 0;
+#endif
 	}
 
 	uint32_t RenderEffect::NumTechniques() const
@@ -2965,6 +2989,111 @@ namespace KlayGE
 			}
 		}
 	}
+
+	void RenderEffectTemplate::CompileShaders(RenderEffect const & effect)
+	{
+		// An effect loaded by a task of the pool compiles on its own thread. Waiting there for other tasks could
+		// deadlock, if the pool is busy with the tasks waiting.
+		if (thread_pool::in_pool_thread())
+		{
+			for (uint32_t tech_index = 0; tech_index < techniques_.size(); ++ tech_index)
+			{
+				for (uint32_t pass_index = 0; pass_index < techniques_[tech_index]->NumPasses(); ++ pass_index)
+				{
+					techniques_[tech_index]->CompileShaders(effect, tech_index, pass_index);
+				}
+				techniques_[tech_index]->LinkShaders(effect, tech_index);
+			}
+			return;
+		}
+
+		std::vector<std::pair<uint32_t, uint32_t>> jobs;
+		for (uint32_t tech_index = 0; tech_index < techniques_.size(); ++ tech_index)
+		{
+			for (uint32_t pass_index = 0; pass_index < techniques_[tech_index]->NumPasses(); ++ pass_index)
+			{
+				jobs.emplace_back(tech_index, pass_index);
+			}
+		}
+
+		// HLSL compiling and DXBC to GLSL translation of different passes are independent. The workers take
+		// the passes in order, so the techniques are compiled roughly in the order they are linked.
+		std::atomic<size_t> next_job(0);
+		std::vector<uint8_t> compiled(jobs.size(), false);
+		std::mutex compiled_mutex;
+		std::condition_variable compiled_cond;
+		auto run_job = [this, &effect, &jobs, &next_job, &compiled, &compiled_mutex, &compiled_cond]()
+			{
+				size_t const job = next_job.fetch_add(1);
+				if (job >= jobs.size())
+				{
+					return false;
+				}
+
+				techniques_[jobs[job].first]->CompileShaders(effect, jobs[job].first, jobs[job].second);
+
+				{
+					std::lock_guard<std::mutex> lock(compiled_mutex);
+					compiled[job] = true;
+				}
+				compiled_cond.notify_all();
+				return true;
+			};
+
+		thread_pool& tp = Context::Instance().ThreadPool();
+		size_t const num_threads = std::max(std::thread::hardware_concurrency(), 1U);
+		std::vector<joiner<void>> joiners;
+		for (size_t i = 1; i < std::min(num_threads, jobs.size()); ++ i)
+		{
+			joiners.push_back(tp([&run_job]()
+				{
+					while (run_job())
+					{
+					}
+				}));
+		}
+
+		// Linking makes API calls, so it stays on this thread. A technique is linked as soon as its passes are
+		// compiled, while the workers go on with the later ones. Shared shaders always come from the passes
+		// before, so they are linked already. This thread compiles the passes left while waiting, so the load
+		// goes on even if the pool has no thread to spare.
+		size_t job_end = 0;
+		for (uint32_t tech_index = 0; tech_index < techniques_.size(); ++ tech_index)
+		{
+			size_t const job_begin = job_end;
+			job_end += techniques_[tech_index]->NumPasses();
+
+			auto tech_compiled = [&compiled, job_begin, job_end]()
+				{
+					return std::find(compiled.begin() + job_begin, compiled.begin() + job_end, false)
+						== compiled.begin() + job_end;
+				};
+			for (;;)
+			{
+				{
+					std::unique_lock<std::mutex> lock(compiled_mutex);
+					if (tech_compiled())
+					{
+						break;
+					}
+				}
+
+				if (!run_job())
+				{
+					std::unique_lock<std::mutex> lock(compiled_mutex);
+					compiled_cond.wait(lock, tech_compiled);
+					break;
+				}
+			}
+
+			techniques_[tech_index]->LinkShaders(effect, tech_index);
+		}
+
+		for (auto& j : joiners)
+		{
+			j();
+		}
+	}
 #endif
 
 	void RenderEffectTemplate::Load(std::string const & name, RenderEffect& effect)
@@ -2987,7 +3116,7 @@ namespace KlayGE
 #endif
 
 		res_name_ = fxml_name;
-		res_name_hash_ = boost::hash_range(fxml_name.begin(), fxml_name.end());
+		res_name_hash_ = RT_HASH(fxml_name.c_str());
 #if KLAYGE_IS_DEV_PLATFORM
 		if (source)
 		{
@@ -3172,6 +3301,7 @@ namespace KlayGE
 					effect.params_.push_back(MakeUniquePtr<RenderEffectParameter>());
 					effect.params_.back()->Load(node);
 				}
+				this->BuildIndices(effect);
 
 				for (XMLNodePtr shader_node = root->FirstNode("shader"); shader_node; shader_node = shader_node->NextSibling("shader"))
 				{
@@ -3187,6 +3317,8 @@ namespace KlayGE
 					techniques_.push_back(MakeUniquePtr<RenderTechnique>());
 					techniques_.back()->Load(effect, node, index);
 				}
+
+				this->CompileShaders(effect);
 			}
 
 			std::ofstream ofs(kfx_name.c_str(), std::ios_base::binary | std::ios_base::out);
@@ -3277,6 +3409,7 @@ namespace KlayGE
 								effect.params_[i]->StreamIn(source);
 							}
 						}
+						this->BuildIndices(effect);
 
 						{
 							uint16_t num_shader_frags;
@@ -3458,7 +3591,7 @@ namespace KlayGE
 
 	RenderTechnique* RenderEffectTemplate::TechniqueByName(std::string const & name) const
 	{
-		size_t const name_hash = boost::hash_range(name.begin(), name.end());
+		size_t const name_hash = RT_HASH(name.c_str());
 		for (auto const & tech : techniques_)
 		{
 			if (name_hash == tech->NameHash())
@@ -3501,6 +3634,46 @@ namespace KlayGE
 		return type_define::instance().type_name(code);
 	}
 
+	uint32_t RenderEffectTemplate::ParameterIndexByNameHash(size_t name_hash) const
+	{
+		auto iter = param_name_indices_.find(name_hash);
+		return (iter != param_name_indices_.end()) ? iter->second : RenderEffect::INVALID_INDEX;
+	}
+
+	uint32_t RenderEffectTemplate::ParameterIndexBySemanticHash(size_t semantic_hash) const
+	{
+		auto iter = param_semantic_indices_.find(semantic_hash);
+		return (iter != param_semantic_indices_.end()) ? iter->second : RenderEffect::INVALID_INDEX;
+	}
+
+	uint32_t RenderEffectTemplate::CBufferIndexByNameHash(size_t name_hash) const
+	{
+		auto iter = cbuffer_name_indices_.find(name_hash);
+		return (iter != cbuffer_name_indices_.end()) ? iter->second : RenderEffect::INVALID_INDEX;
+	}
+
+	void RenderEffectTemplate::BuildIndices(RenderEffect const & effect)
+	{
+		// emplace keeps the first one of the same hash, as the linear search used to
+		param_name_indices_.clear();
+		param_semantic_indices_.clear();
+		for (uint32_t i = 0; i < effect.params_.size(); ++ i)
+		{
+			RenderEffectParameter const & param = *effect.params_[i];
+			param_name_indices_.emplace(param.NameHash(), i);
+			if (param.HasSemantic())
+			{
+				param_semantic_indices_.emplace(param.SemanticHash(), i);
+			}
+		}
+
+		cbuffer_name_indices_.clear();
+		for (uint32_t i = 0; i < effect.cbuffers_.size(); ++ i)
+		{
+			cbuffer_name_indices_.emplace(effect.cbuffers_[i]->NameHash(), i);
+		}
+	}
+
 #if KLAYGE_IS_DEV_PLATFORM
 	void RenderEffectTemplate::GenHLSLShaderText(RenderEffect const & effect)
 	{
@@ -3788,7 +3961,7 @@ namespace KlayGE
 	void RenderTechnique::Load(RenderEffect& effect, XMLNodePtr const & node, uint32_t tech_index)
 	{
 		name_ = node->Attrib("name")->ValueString();
-		name_hash_ = boost::hash_range(name_.begin(), name_.end());
+		name_hash_ = RT_HASH(name_.c_str());
 
 		RenderTechnique* parent_tech = nullptr;
 		XMLAttributePtr inherit_attr = node->Attrib("inherit");
@@ -3861,9 +4034,8 @@ namespace KlayGE
 
 		if (!node->FirstNode("pass") && parent_tech)
 		{
-			is_validate_ = parent_tech->is_validate_;
-			has_discard_ = parent_tech->has_discard_;
-			has_tessellation_ = parent_tech->has_tessellation_;
+			parent_tech_ = parent_tech;
+
 			transparent_ = parent_tech->transparent_;
 			weight_ = parent_tech->weight_;
 
@@ -3881,16 +4053,13 @@ namespace KlayGE
 					auto inherit_pass = parent_tech->passes_[index].get();
 
 					pass->Load(effect, tech_index, index, inherit_pass);
-					is_validate_ &= pass->Validate();
 				}
 			}
 		}
 		else
 		{
-			is_validate_ = true;
+			parent_tech_ = nullptr;
 
-			has_discard_ = false;
-			has_tessellation_ = false;
 			transparent_ = false;
 			if (parent_tech)
 			{
@@ -3915,8 +4084,6 @@ namespace KlayGE
 
 				pass->Load(effect, pass_node, tech_index, index, inherit_pass);
 
-				is_validate_ &= pass->Validate();
-
 				for (XMLNodePtr state_node = pass_node->FirstNode("state"); state_node; state_node = state_node->NextSibling("state"))
 				{
 					++ weight_;
@@ -3931,9 +4098,6 @@ namespace KlayGE
 						}
 					}
 				}
-
-				has_discard_ |= pass->GetShaderObject(effect)->HasDiscard();
-				has_tessellation_ |= pass->GetShaderObject(effect)->HasTessellation();
 			}
 			if (transparent_)
 			{
@@ -3941,12 +4105,52 @@ namespace KlayGE
 			}
 		}
 	}
+
+	void RenderTechnique::CompileShaders(RenderEffect const & effect, uint32_t tech_index, uint32_t pass_index)
+	{
+		if (this->OwnsPasses())
+		{
+			passes_[pass_index]->CompileShaders(effect, tech_index, pass_index);
+		}
+	}
+
+	void RenderTechnique::LinkShaders(RenderEffect const & effect, uint32_t tech_index)
+	{
+		if (parent_tech_)
+		{
+			is_validate_ = parent_tech_->is_validate_;
+			has_discard_ = parent_tech_->has_discard_;
+			has_tessellation_ = parent_tech_->has_tessellation_;
+		}
+		else
+		{
+			is_validate_ = true;
+			has_discard_ = false;
+			has_tessellation_ = false;
+		}
+
+		if (this->OwnsPasses())
+		{
+			for (uint32_t pass_index = 0; pass_index < passes_.size(); ++ pass_index)
+			{
+				auto const & pass = passes_[pass_index];
+				pass->LinkShaders(effect, tech_index, pass_index);
+				is_validate_ &= pass->Validate();
+
+				if (!parent_tech_)
+				{
+					has_discard_ |= pass->GetShaderObject(effect)->HasDiscard();
+					has_tessellation_ |= pass->GetShaderObject(effect)->HasTessellation();
+				}
+			}
+		}
+	}
 #endif
 
 	bool RenderTechnique::StreamIn(RenderEffect& effect, ResIdentifierPtr const & res, uint32_t tech_index)
 	{
 		name_ = ReadShortString(res);
-		name_hash_ = boost::hash_range(name_.begin(), name_.end());
+		name_hash_ = RT_HASH(name_.c_str());
 
 		uint8_t num_anno;
 		res->read(&num_anno, sizeof(num_anno));
@@ -4066,7 +4270,7 @@ namespace KlayGE
 		RenderFactory& rf = Context::Instance().RenderFactoryInstance();
 
 		name_ = node->Attrib("name")->ValueString();
-		name_hash_ = boost::hash_range(name_.begin(), name_.end());
+		name_hash_ = RT_HASH(name_.c_str());
 
 		{
 			XMLNodePtr anno_node = node->FirstNode("annotation");
@@ -4539,33 +4743,15 @@ namespace KlayGE
 		depth_stencil_state_obj_ = rf.MakeDepthStencilStateObject(dss_desc);
 		blend_state_obj_ = rf.MakeBlendStateObject(bs_desc);
 
-		auto const & shader_obj = this->GetShaderObject(effect);
-
+		// The first pass using a shader compiles it, the others share it
 		for (int type = 0; type < ShaderObject::ST_NumShaderTypes; ++ type)
 		{
 			ShaderDesc& sd = effect.GetShaderDesc(shader_desc_ids_[type]);
-			if (!sd.func_name.empty())
+			if (!sd.func_name.empty() && (0xFFFFFFFF == sd.tech_pass_type))
 			{
-				if (sd.tech_pass_type != 0xFFFFFFFF)
-				{
-					auto const & tech = *effect.TechniqueByIndex(sd.tech_pass_type >> 16);
-					auto const & pass = tech.Pass((sd.tech_pass_type >> 8) & 0xFF);
-					shader_obj->AttachShader(static_cast<ShaderObject::ShaderType>(type),
-						effect, tech, pass, pass.GetShaderObject(effect));
-				}
-				else
-				{
-					auto const & tech = *effect.TechniqueByIndex(tech_index);
-					shader_obj->AttachShader(static_cast<ShaderObject::ShaderType>(type),
-						effect, tech, *this, shader_desc_ids_);
-					sd.tech_pass_type = (tech_index << 16) + (pass_index << 8) + type;
-				}
+				sd.tech_pass_type = (tech_index << 16) + (pass_index << 8) + type;
 			}
 		}
-
-		shader_obj->LinkShaders(effect);
-
-		is_validate_ = shader_obj->Validate();
 	}
 
 	void RenderPass::Load(RenderEffect& effect,
@@ -4598,7 +4784,6 @@ namespace KlayGE
 		}
 
 		shader_obj_index_ = effect.AddShaderObject();
-		auto const & shader_obj = this->GetShaderObject(effect);
 
 		shader_desc_ids_.fill(0);
 
@@ -4618,12 +4803,41 @@ namespace KlayGE
 				sd.macros_hash = macros_hash;
 				sd.tech_pass_type = (tech_index << 16) + (pass_index << 8) + type;
 				shader_desc_ids_[type] = effect.AddShaderDesc(sd);
-				
-				auto const & tech = *effect.TechniqueByIndex(tech_index);
+			}
+		}
+	}
+
+	void RenderPass::CompileShaders(RenderEffect const & effect, uint32_t tech_index, uint32_t pass_index)
+	{
+		auto const & tech = *effect.TechniqueByIndex(tech_index);
+		auto const & shader_obj = this->GetShaderObject(effect);
+
+		for (int type = 0; type < ShaderObject::ST_NumShaderTypes; ++ type)
+		{
+			ShaderDesc const & sd = effect.GetShaderDesc(shader_desc_ids_[type]);
+			if (!sd.func_name.empty() && (sd.tech_pass_type == (tech_index << 16) + (pass_index << 8) + type))
+			{
 				shader_obj->AttachShader(static_cast<ShaderObject::ShaderType>(type),
 					effect, tech, *this, shader_desc_ids_);
 			}
 		}
+	}
+
+	void RenderPass::LinkShaders(RenderEffect const & effect, uint32_t tech_index, uint32_t pass_index)
+	{
+		auto const & shader_obj = this->GetShaderObject(effect);
+
+		for (int type = 0; type < ShaderObject::ST_NumShaderTypes; ++ type)
+		{
+			ShaderDesc const & sd = effect.GetShaderDesc(shader_desc_ids_[type]);
+			if (!sd.func_name.empty() && (sd.tech_pass_type != (tech_index << 16) + (pass_index << 8) + type))
+			{
+				auto const & tech = *effect.TechniqueByIndex(sd.tech_pass_type >> 16);
+				auto const & pass = tech.Pass((sd.tech_pass_type >> 8) & 0xFF);
+				shader_obj->AttachShader(static_cast<ShaderObject::ShaderType>(type),
+					effect, tech, pass, pass.GetShaderObject(effect));
+			}
+		}
 
 		shader_obj->LinkShaders(effect);
 
@@ -4637,7 +4851,7 @@ namespace KlayGE
 		RenderFactory& rf = Context::Instance().RenderFactoryInstance();
 
 		name_ = ReadShortString(res);
-		name_hash_ = boost::hash_range(name_.begin(), name_.end());
+		name_hash_ = RT_HASH(name_.c_str());
 
 		uint8_t num_anno;
 		res->read(&num_anno, sizeof(num_anno));
@@ -4901,7 +5115,7 @@ namespace KlayGE
 	{
 		name_ = MakeSharedPtr<std::remove_reference<decltype(*name_)>::type>();
 		name_->first = name;
-		name_->second = boost::hash_range(name_->first.begin(), name_->first.end());
+		name_->second = RT_HASH(name_->first.c_str());
 		param_indices_ = MakeSharedPtr<std::remove_reference<decltype(*param_indices_)>::type>();
 	}
 #endif
@@ -4910,7 +5124,7 @@ namespace KlayGE
 	{
 		name_ = MakeSharedPtr<std::remove_reference<decltype(*name_)>::type>();
 		name_->first = ReadShortString(res);
-		name_->second = boost::hash_range(name_->first.begin(), name_->first.end());
+		name_->second = RT_HASH(name_->first.c_str());
 		param_indices_ = MakeSharedPtr<std::remove_reference<decltype(*param_indices_)>::type>();
 
 		uint16_t len;
@@ -4975,25 +5189,83 @@ namespace KlayGE
 			{
 				RenderFactory& rf = Context::Instance().RenderFactoryInstance();
 				hw_buff_ = rf.MakeConstantBuffer(BU_Dynamic, 0, size, nullptr);
+				partial_update_ = rf.RenderEngineInstance().DeviceCaps().cbuffer_partial_update_support;
 			}
 		}
 
-		dirty_ = true;
+		this->Dirty(true);
+	}
+
+	void RenderEffectConstantBuffer::Dirty(bool dirty)
+	{
+		dirty_ranges_.clear();
+		if (dirty && !buff_.empty())
+		{
+			dirty_ranges_.emplace_back(0, static_cast<uint32_t>(buff_.size()));
+		}
+	}
+
+	void RenderEffectConstantBuffer::AddDirtyRange(uint32_t begin, uint32_t end)
+	{
+		if (begin >= end)
+		{
+			return;
+		}
+
+		auto iter = std::lower_bound(dirty_ranges_.begin(), dirty_ranges_.end(), begin,
+			[](std::pair<uint32_t, uint32_t> const & range, uint32_t offset)
+			{
+				return range.second < offset;
+			});
+		if ((iter != dirty_ranges_.end()) && (iter->first <= end))
+		{
+			// Touches *iter, and maybe the ones after it
+			iter->first = std::min(iter->first, begin);
+			iter->second = std::max(iter->second, end);
+			auto next = iter + 1;
+			while ((next != dirty_ranges_.end()) && (next->first <= iter->second))
+			{
+				iter->second = std::max(iter->second, next->second);
+				++ next;
+			}
+			dirty_ranges_.erase(iter + 1, next);
+		}
+		else
+		{
+			dirty_ranges_.emplace(iter, begin, end);
+			if (dirty_ranges_.size() > MAX_DIRTY_RANGES)
+			{
+				// Too many small uploads cost more than one big one
+				dirty_ranges_.front().second = dirty_ranges_.back().second;
+				dirty_ranges_.resize(1);
+			}
+		}
 	}
 
 	void RenderEffectConstantBuffer::Update()
 	{
-		if (dirty_)
+		if (!dirty_ranges_.empty())
 		{
-			hw_buff_->UpdateSubresource(0, static_cast<uint32_t>(buff_.size()), &buff_[0]);
+			if (partial_update_)
+			{
+				for (auto const & range : dirty_ranges_)
+				{
+					hw_buff_->UpdateSubresource(range.first, range.second - range.first, &buff_[range.first]);
+				}
+			}
+			else
+			{
+				hw_buff_->UpdateSubresource(0, static_cast<uint32_t>(buff_.size()), &buff_[0]);
+			}
 
-			dirty_ = false;
+			dirty_ranges_.clear();
 		}
 	}
 
 	void RenderEffectConstantBuffer::BindHWBuff(GraphicsBufferPtr const & buff)
 	{
 		hw_buff_ = buff;
+		partial_update_ = Context::Instance().RenderFactoryInstance().RenderEngineInstance().DeviceCaps().cbuffer_partial_update_support;
 		buff_.resize(buff->Size());
 	}
 
@@ -5004,14 +5276,14 @@ namespace KlayGE
 		type_ = type_define::instance().type_code(node->Attrib("type")->ValueString());
 		name_ = MakeSharedPtr<std::remove_reference<decltype(*name_)>::type>();
 		name_->first = node->Attrib("name")->ValueString();
-		name_->second = boost::hash_range(name_->first.begin(), name_->first.end());
+		name_->second = RT_HASH(name_->first.c_str());
 
 		XMLAttributePtr attr = node->Attrib("semantic");
 		if (attr)
 		{
 			semantic_ = MakeSharedPtr<std::remove_reference<decltype(*semantic_)>::type>();
 			semantic_->first = attr->ValueString();
-			semantic_->second = boost::hash_range(semantic_->first.begin(), semantic_->first.end());
+			semantic_->second = RT_HASH(semantic_->first.c_str());
 		}
 
 		uint32_t as;
@@ -5077,14 +5349,14 @@ namespace KlayGE
 		type_ = LE2Native(type_);
 		name_ = MakeSharedPtr<std::remove_reference<decltype(*name_)>::type>();
 		name_->first = ReadShortString(res);
-		name_->second = boost::hash_range(name_->first.begin(), name_->first.end());
+		name_->second = RT_HASH(name_->first.c_str());
 
 		std::string sem = ReadShortString(res);
 		if (!sem.empty())
 		{
 			semantic_ = MakeSharedPtr<std::remove_reference<decltype(*semantic_)>::type>();
 			semantic_->first = sem;
-			semantic_->second = boost::hash_range(sem.begin(), sem.end());
+			semantic_->second = RT_HASH(sem.c_str());
 		}
 
 		uint32_t as;
@@ -5796,7 +6068,7 @@ namespace KlayGE
 				target[i] = MathLib::transpose(value[i]);
 			}
 
-			data_.cbuff_desc.cbuff->Dirty(true);
+			data_.cbuff_desc.cbuff->Dirty(data_.cbuff_desc.offset, static_cast<uint32_t>(value.size() * sizeof(float4x4)));
 		}
 		else
 		{
@@ -54,6 +54,7 @@
 #include <KlayGE/App3D.hpp>
 #include <KlayGE/Window.hpp>
 #include <KlayGE/PerfProfiler.hpp>
+#include <KlayGE/CommandList.hpp>
 
 #include <boost/lexical_cast.hpp>
 
@@ -75,6 +76,8 @@ namespace KlayGE
 			stereo_method_(STM_None), stereo_separation_(0),
 			fb_stage_(0), force_line_mode_(false)
 	{
+		state_changes_.issued.fill(0);
+		state_changes_.filtered.fill(0);
 	}
 
 	// 
@@ -485,7 +488,9 @@ namespace KlayGE
 		DepthStencilStateObjectPtr const & dss_obj, uint16_t front_stencil_ref, uint16_t back_stencil_ref,
 		BlendStateObjectPtr const & bs_obj, Color const & blend_factor, uint32_t sample_mask)
 	{
-		if (cur_rs_obj_ != rs_obj)
+		bool const rs_changed = (cur_rs_obj_ != rs_obj);
+		this->CountStateChange(RST_Rasterizer, rs_changed);
+		if (rs_changed)
 		{
 			if (force_line_mode_)
 			{
@@ -501,7 +506,10 @@ namespace KlayGE
 			cur_rs_obj_ = rs_obj;
 		}
 
-		if ((cur_dss_obj_ != dss_obj) || (cur_front_stencil_ref_ != front_stencil_ref) || (cur_back_stencil_ref_ != back_stencil_ref))
+		bool const dss_changed = (cur_dss_obj_ != dss_obj) || (cur_front_stencil_ref_ != front_stencil_ref)
+			|| (cur_back_stencil_ref_ != back_stencil_ref);
+		this->CountStateChange(RST_DepthStencil, dss_changed);
+		if (dss_changed)
 		{
 			dss_obj->Active(front_stencil_ref, back_stencil_ref);
 			cur_dss_obj_ = dss_obj;
@@ -509,7 +517,9 @@ namespace KlayGE
 			cur_back_stencil_ref_ = back_stencil_ref;
 		}
 
-		if ((cur_bs_obj_ != bs_obj) || (cur_blend_factor_ != blend_factor) || (cur_sample_mask_ != sample_mask))
+		bool const bs_changed = (cur_bs_obj_ != bs_obj) || (cur_blend_factor_ != blend_factor) || (cur_sample_mask_ != sample_mask);
+		this->CountStateChange(RST_Blend, bs_changed);
+		if (bs_changed)
 		{
 			bs_obj->Active(blend_factor, sample_mask);
 			cur_bs_obj_ = bs_obj;
@@ -532,7 +542,16 @@ namespace KlayGE
 			new_fb = this->DefaultFrameBuffer();
 		}
 
-		if ((fb != new_fb) || (fb && fb->Dirty()))
+		CommandList* cmd_list = CommandList::Recording();
+		if (cmd_list)
+		{
+			cmd_list->BindFrameBuffer(new_fb);
+			return;
+		}
+
+		bool const fb_changed = (cur_frame_buffer_ != new_fb) || new_fb->Dirty();
+		this->CountStateChange(RST_FrameBuffer, fb_changed);
+		if (fb_changed)
 		{
 			if (cur_frame_buffer_)
 			{
@@ -550,6 +569,11 @@ namespace KlayGE
 	/////////////////////////////////////////////////////////////////////////////////
 	FrameBufferPtr const & RenderEngine::CurFrameBuffer() const
 	{
+		CommandList const * cmd_list = CommandList::Recording();
+		if (cmd_list && cmd_list->CurFrameBuffer())
+		{
+			return cmd_list->CurFrameBuffer();
+		}
 		return cur_frame_buffer_;
 	}
 
@@ -582,18 +606,50 @@ namespace KlayGE
 	/////////////////////////////////////////////////////////////////////////////////
 	void RenderEngine::Render(RenderEffect const & effect, RenderTechnique const & tech, RenderLayout const & rl)
 	{
-		this->DoRender(effect, tech, rl);
+		CommandList* cmd_list = CommandList::Recording();
+		if (cmd_list)
+		{
+			cmd_list->Render(effect, tech, rl);
+		}
+		else
+		{
+			this->DoRender(effect, tech, rl);
+		}
 	}
 
 	void RenderEngine::Dispatch(RenderEffect const & effect, RenderTechnique const & tech, uint32_t tgx, uint32_t tgy, uint32_t tgz)
 	{
-		this->DoDispatch(effect, tech, tgx, tgy, tgz);
+		CommandList* cmd_list = CommandList::Recording();
+		if (cmd_list)
+		{
+			cmd_list->Dispatch(effect, tech, tgx, tgy, tgz);
+		}
+		else
+		{
+			this->DoDispatch(effect, tech, tgx, tgy, tgz);
+		}
 	}
 
 	void RenderEngine::DispatchIndirect(RenderEffect const & effect, RenderTechnique const & tech,
 		GraphicsBufferPtr const & buff_args, uint32_t offset)
 	{
-		this->DoDispatchIndirect(effect, tech, buff_args, offset);
+		CommandList* cmd_list = CommandList::Recording();
+		if (cmd_list)
+		{
+			cmd_list->DispatchIndirect(effect, tech, buff_args, offset);
+		}
+		else
+		{
+			this->DoDispatchIndirect(effect, tech, buff_args, offset);
+		}
+	}
+
+	void RenderEngine::Submit(CommandListPtr const * cmd_lists, uint32_t num_cmd_lists)
+	{
+		for (uint32_t i = 0; i < num_cmd_lists; ++ i)
+		{
+			cmd_lists[i]->Submit();
+		}
 	}
 
 	// ϴRender()ȾͼԪ
@@ -628,6 +684,47 @@ namespace KlayGE
 		return ret;
 	}
 
+	RenderStateChanges RenderEngine::StateChangesJustMade()
+	{
+		RenderStateChanges const ret = state_changes_;
+		state_changes_.issued.fill(0);
+		state_changes_.filtered.fill(0);
+		return ret;
+	}
+
+	bool RenderEngine::UpdateStateCache(RenderStateType type, uint32_t slot, uintptr_t state)
+	{
+		uintptr_t& cached = *this->StateCacheSlots(type, slot, 1);
+		bool const changed = (cached != state);
+		cached = state;
+		this->CountStateChange(type, changed);
+		return changed;
+	}
+
+	uintptr_t* RenderEngine::StateCacheSlots(RenderStateType type, uint32_t first_slot, uint32_t num)
+	{
+		// The slots never set hold a value no state has, so the first binding is always sent
+		auto& cache = state_cache_[type];
+		if (first_slot + num > cache.size())
+		{
+			cache.resize(first_slot + num, ~static_cast<uintptr_t>(0));
+		}
+		return cache.data() + first_slot;
+	}
+
+	void RenderEngine::InvalidateStateCache(RenderStateType type)
+	{
+		state_cache_[type].clear();
+	}
+
+	void RenderEngine::InvalidateStateCache()
+	{
+		for (auto& cache : state_cache_)
+		{
+			cache.clear();
+		}
+	}
+
 	// ȡȾ豸
 	/////////////////////////////////////////////////////////////////////////////////
 	RenderDeviceCaps const & RenderEngine::DeviceCaps() const
@@ -1216,6 +1313,8 @@ namespace KlayGE
 
 	void RenderEngine::Destroy()
 	{
+		this->InvalidateStateCache();
+
 		cur_frame_buffer_.reset();
 		screen_frame_buffer_.reset();
 		ds_tex_.reset();
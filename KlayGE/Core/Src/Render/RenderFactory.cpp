@@ -27,6 +27,7 @@
 #include <KlayGE/ShaderObject.hpp>
 #include <KlayGE/RenderLayout.hpp>
 #include <KlayGE/Fence.hpp>
+#include <KlayGE/CommandList.hpp>
 
 #include <KlayGE/RenderFactory.hpp>
 
@@ -135,6 +136,11 @@ namespace KlayGE
 		return ret;
 	}
 
+	CommandListPtr RenderFactory::MakeCommandList()
+	{
+		return MakeSharedPtr<CommandList>();
+	}
+
 	RasterizerStateObjectPtr RenderFactory::MakeRasterizerStateObject(RasterizerStateDesc const & desc)
 	{
 		RasterizerStateObjectPtr ret;
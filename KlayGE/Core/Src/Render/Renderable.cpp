@@ -28,6 +28,7 @@
 #include <KlayGE/Camera.hpp>
 #include <KlayGE/RenderMaterial.hpp>
 #include <KlayGE/DeferredRenderingLayer.hpp>
+#include <KlayGE/CommandList.hpp>
 
 #include <KlayGE/Renderable.hpp>
 
@@ -203,17 +204,29 @@ namespace KlayGE
 
 	void Renderable::Render()
 	{
-		this->UpdateInstanceStream();
+		// The instance stream is mapped on the thread owning the device, when a command list is submitted
+		CommandList* cmd_list = CommandList::Recording();
+		if (cmd_list)
+		{
+			cmd_list->Execute([this]
+				{
+					this->UpdateInstanceStream();
+				});
+		}
+		else
+		{
+			this->UpdateInstanceStream();
+		}
 
 		RenderEngine& re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
 
 		RenderLayout const & layout = this->GetRenderLayout();
-		GraphicsBufferPtr const & inst_stream = layout.InstanceStream();
+		bool const fill_inst_stream = !instances_.empty() && !instances_[0]->InstanceFormat().empty();
 		RenderTechnique const & tech = *this->GetRenderTechnique();
 		auto const & effect = *this->GetRenderEffect();
-		if (inst_stream)
+		if (fill_inst_stream || layout.InstanceStream())
 		{
-			if (layout.NumInstances() > 0)
+			if (fill_inst_stream || (layout.NumInstances() > 0))
 			{
 				this->OnRenderBegin();
 				re.Render(effect, tech, layout);
@@ -23,6 +23,8 @@
 #include <map>
 #include <sstream>
 #include <fstream>
+#include <atomic>
+#include <mutex>
 
 #include <boost/lexical_cast.hpp>
 
@@ -124,7 +126,10 @@ namespace
 			}
 			return hr;
 #else
-			std::string mark = boost::lexical_cast<std::string>(static_cast<void const *>(src_data.c_str()));
+			// Passes are compiled in parallel, and the same entry point could be compiled with different macros
+			static std::atomic<uint32_t> num_compiles(0);
+			std::string mark = boost::lexical_cast<std::string>(static_cast<void const *>(src_data.c_str()))
+				+ "_" + boost::lexical_cast<std::string>(num_compiles.fetch_add(1));
 			std::string compile_input_file = entry_point + mark + "Input.tmp";
 			std::string compile_output_file = entry_point + mark + "Output.tmp";
 
@@ -162,15 +167,14 @@ namespace
 #ifdef KLAYGE_PLATFORM_WINDOWS
 			ss << d3dcompiler_wrapper_name << ".exe";
 #else
-			static bool first = true;
-			if (first)
-			{
-				ss << WINE_PATH << "wineserver -p";
-				system(ss.str().c_str());
-				// We should hold on a persistant wineserver, or XCode will lost connection after wineserver instance close and wine may not be able to find '.exe.so' file
-				first = false;
-				ss.str(std::string());
-			}
+			static std::once_flag wineserver_flag;
+			std::call_once(wineserver_flag, []()
+				{
+					std::ostringstream wineserver_ss;
+					wineserver_ss << WINE_PATH << "wineserver -p";
+					system(wineserver_ss.str().c_str());
+					// We should hold on a persistant wineserver, or XCode will lost connection after wineserver instance close and wine may not be able to find '.exe.so' file
+				});
 			d3dcompiler_wrapper_name += ".exe.so";
 			std::string wrapper_path = ResLoader::Instance().Locate(d3dcompiler_wrapper_name);
 			ss << WINE_PATH << "wine " << wrapper_path;
@@ -0,0 +1,143 @@
+/**
+ * @file ShadowMapCache.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/AABBox.hpp>
+
+#include <KlayGE/ShadowMapCache.hpp>
+
+namespace KlayGE
+{
+	uint32_t const ShadowMapCache::INVALID_SLOT;
+
+	ShadowMapCache::ShadowMapCache()
+		: frame_(0)
+	{
+	}
+
+	void ShadowMapCache::NewFrame()
+	{
+		for (auto& slot : slots_)
+		{
+			if (slot.light && (slot.frame != frame_))
+			{
+				slot.light = nullptr;
+				slot.valid = false;
+			}
+		}
+		++ frame_;
+	}
+
+	uint32_t ShadowMapCache::Acquire(void const * light, uint32_t face, float4x4 const & view_proj)
+	{
+		BOOST_ASSERT(light);
+
+		uint32_t ret = INVALID_SLOT;
+		for (uint32_t i = 0; i < slots_.size(); ++ i)
+		{
+			if ((slots_[i].light == light) && (slots_[i].face == face))
+			{
+				ret = i;
+				break;
+			}
+			if (!slots_[i].light && (INVALID_SLOT == ret))
+			{
+				ret = i;
+			}
+		}
+		if (INVALID_SLOT == ret)
+		{
+			ret = static_cast<uint32_t>(slots_.size());
+			slots_.emplace_back();
+		}
+
+		Slot& slot = slots_[ret];
+		if ((slot.light != light) || (slot.face != face) || !(slot.view_proj == view_proj))
+		{
+			slot.light = light;
+			slot.face = face;
+			slot.valid = false;
+			slot.view_proj = view_proj;
+			slot.frustum.ClipMatrix(view_proj, MathLib::inverse(view_proj));
+		}
+		slot.frame = frame_;
+
+		return ret;
+	}
+
+	uint32_t ShadowMapCache::Find(void const * light, uint32_t face) const
+	{
+		for (uint32_t i = 0; i < slots_.size(); ++ i)
+		{
+			if ((slots_[i].light == light) && (slots_[i].face == face) && (slots_[i].frame == frame_))
+			{
+				return i;
+			}
+		}
+		return INVALID_SLOT;
+	}
+
+	uint32_t ShadowMapCache::NumSlots() const
+	{
+		return static_cast<uint32_t>(slots_.size());
+	}
+
+	bool ShadowMapCache::Valid(uint32_t slot) const
+	{
+		BOOST_ASSERT(slot < slots_.size());
+		return slots_[slot].valid;
+	}
+
+	void ShadowMapCache::Validate(uint32_t slot)
+	{
+		BOOST_ASSERT((slot < slots_.size()) && slots_[slot].light);
+		slots_[slot].valid = true;
+	}
+
+	void ShadowMapCache::Invalidate(AABBox const & aabb)
+	{
+		for (auto& slot : slots_)
+		{
+			if (slot.valid && (slot.frustum.Intersect(aabb) != BO_No))
+			{
+				slot.valid = false;
+			}
+		}
+	}
+
+	void ShadowMapCache::InvalidateAll()
+	{
+		for (auto& slot : slots_)
+		{
+			slot.valid = false;
+		}
+	}
+}
@@ -33,12 +33,16 @@
 #include <KlayGE/RenderEngine.hpp>
 #include <KlayGE/App3D.hpp>
 
+#include <algorithm>
+#include <cstring>
+
 #include <KlayGE/TransientBuffer.hpp>
 
 namespace KlayGE
 {
 	TransientBuffer::TransientBuffer(uint32_t size_in_byte, TransientBuffer::BindFlag bind_flag)
-		: bind_flag_(bind_flag)
+		: bind_flag_(bind_flag),
+			head_(0), tail_(0), wrap_end_(0)
 	{
 		RenderFactory& rf = Context::Instance().RenderFactoryInstance();
 		RenderEngine const & re = rf.RenderEngineInstance();
@@ -54,15 +58,11 @@ namespace KlayGE
 		{
 			num_pre_frames_ = 1;
 			simulate_buffer_.resize(buffer_->Size());
-			valid_min_ = 0;
-			valid_max_ = 0;
 		}
+		valid_min_ = 0xFFFFFFFF;
+		valid_max_ = 0;
 
-		SubAlloc alloc(0, size_in_byte);
-		free_list_.push_back(alloc);
-
-		App3DFramework const & app = Context::Instance().AppInstance();
-		retired_frames_.push_back(RetiredFrame(app.TotalNumFrames() + 1));
+		fences_.reserve(num_pre_frames_ + 1);
 	}
 
 	GraphicsBufferPtr TransientBuffer::DoCreateBuffer(TransientBuffer::BindFlag bind_flag, uint32_t size_in_byte)
@@ -88,63 +88,45 @@ namespace KlayGE
 
 	SubAlloc TransientBuffer::Alloc(uint32_t size_in_byte, void const * data)
 	{
-		SubAlloc ret;
-
-		// Use first fit method to find a free sub alloc
-		bool found = false;
-		auto iter = free_list_.begin();
-		auto first_fit_iter = iter;
-		for (; iter != free_list_.end(); ++ iter)
+		if (head_ == tail_)
 		{
-			if (iter->length_ >= size_in_byte)
+			// Empty. Starts over from the beginning to keep the allocations in one piece. The fences in flight
+			// are all at head_, with nothing before them.
+			head_ = 0;
+			tail_ = 0;
+			for (auto& fence : fences_)
 			{
-				first_fit_iter = iter;
-				found = true;
-				break;
+				fence.offset = 0;
 			}
 		}
 
-		// If there is not enough space, reallocate a larger buffer.
-		if (!found)
+		uint32_t const buffer_size = buffer_->Size();
+		uint32_t offset = 0xFFFFFFFF;
+		if (head_ >= tail_)
 		{
-			uint32_t const old_buffer_size = buffer_->Size();
-			uint32_t larger_buffer_size = std::max(old_buffer_size * 2, old_buffer_size + size_in_byte);
-			GraphicsBufferPtr larger_buffer = this->DoCreateBuffer(bind_flag_, larger_buffer_size);
-			SubAlloc alloc(old_buffer_size, larger_buffer_size - old_buffer_size);
-			if (!free_list_.empty() && (free_list_.back().offset_ + free_list_.back().length_ == alloc.offset_))
-			{
-				free_list_.back().length_ += alloc.length_;
-			}
-			else
+			if (head_ + size_in_byte <= buffer_size)
 			{
-				free_list_.push_back(alloc);
+				offset = head_;
 			}
-			first_fit_iter = free_list_.end();
-			-- first_fit_iter;
-			if (use_no_overwrite_)
+			else if (size_in_byte < tail_)
 			{
-				buffer_->CopyToBuffer(*larger_buffer);
+				wrap_end_ = head_;
+				offset = 0;
 			}
-			else
-			{
-				simulate_buffer_.resize(larger_buffer_size);
-			}
-			buffer_ = larger_buffer;
 		}
-
-		uint32_t left_size = first_fit_iter->length_ - size_in_byte;
-		ret.length_ = size_in_byte;
-		ret.offset_ = first_fit_iter->offset_;
-		if (0 == left_size)
+		else if (head_ + size_in_byte < tail_)
 		{
-			free_list_.erase(first_fit_iter);
+			offset = head_;
 		}
-		else
+
+		if (0xFFFFFFFF == offset)
 		{
-			first_fit_iter->length_ = left_size;
-			first_fit_iter->offset_ += size_in_byte;
+			this->Grow(size_in_byte);
+			offset = head_;
 		}
+		head_ = offset + size_in_byte;
 
+		SubAlloc ret(offset, size_in_byte);
 		if (use_no_overwrite_)
 		{
 			GraphicsBuffer::Mapper mapper(*buffer_, BA_Write_No_Overwrite);
@@ -161,128 +143,74 @@ namespace KlayGE
 		return ret;
 	}
 
-	void TransientBuffer::Dealloc(SubAlloc const & alloc)
+	void TransientBuffer::Grow(uint32_t size_in_byte)
 	{
-		if ((alloc.length_ > 0) && !retired_frames_.empty())
+		uint32_t const old_buffer_size = buffer_->Size();
+		uint32_t const larger_buffer_size = std::max(old_buffer_size * 2, old_buffer_size + size_in_byte);
+		GraphicsBufferPtr larger_buffer = this->DoCreateBuffer(bind_flag_, larger_buffer_size);
+		if (use_no_overwrite_)
 		{
-			RetiredFrame& frame = retired_frames_.back();
-			frame.pending_frees_.push_back(alloc);
-
-			if (!use_no_overwrite_)
-			{
-				if (alloc.offset_ == valid_min_)
-				{
-					valid_min_ += alloc.length_;
-				}
-				if (alloc.offset_ + alloc.length_ == valid_max_)
-				{
-					valid_max_ -= alloc.length_;
-				}
-			}
+			buffer_->CopyToBuffer(*larger_buffer);
+		}
+		else
+		{
+			simulate_buffer_.resize(larger_buffer_size);
+		}
+		buffer_ = larger_buffer;
+
+		// The frames in flight read the old buffer. In the new one, the whole old range is taken as used by the
+		// current frame, so its allocations keep their offsets, and it's reclaimed when this frame retires.
+		tail_ = 0;
+		head_ = old_buffer_size;
+		wrap_end_ = 0;
+		for (auto& fence : fences_)
+		{
+			fence.offset = 0;
 		}
 	}
 
-	void TransientBuffer::OnPresent()
+	void TransientBuffer::Dealloc(SubAlloc const & alloc)
 	{
-		if (!retired_frames_.empty())
-		{
-			App3DFramework const & app = Context::Instance().AppInstance();
-			uint32_t const frame_id = app.TotalNumFrames();
+		KFL_UNUSED(alloc);
+	}
 
-			// First, deal with deletes from this frame
-			RetiredFrame& ret_frame = retired_frames_.back();
-			if (!ret_frame.pending_frees_.empty()) 
-			{
-				// Append a new (empty) RetiredFrame to retired_frames_
-				retired_frames_.push_back(RetiredFrame(frame_id + 1));
-			}
-			// Second, return pending frees to free_list
-			auto frame_iter = retired_frames_.begin();
-			for (; frame_iter != retired_frames_.end();)
-			{
-				if (frame_iter->frame_id + num_pre_frames_ <= frame_id)
-				{
-					auto iter = frame_iter->pending_frees_.begin();
-					for (; iter != frame_iter->pending_frees_.end(); ++ iter)
-					{
-						this->DoFree(*iter);
-					}
-					frame_iter = retired_frames_.erase(frame_iter);
-				}
-				else
-				{
-					++ frame_iter;
-				}
-			}
-		}
+	void TransientBuffer::OnPresent()
+	{
+		App3DFramework const & app = Context::Instance().AppInstance();
+		this->OnPresent(app.TotalNumFrames());
 	}
 
-	void TransientBuffer::DoFree(SubAlloc const & alloc)
+	void TransientBuffer::OnPresent(uint32_t frame_id)
 	{
-		if (free_list_.empty())
+		if (!fences_.empty() && (fences_.back().frame_id == frame_id))
 		{
-			free_list_.push_back(alloc);
+			fences_.back().offset = head_;
 		}
 		else
 		{
-			// Find where to insert the alloc
-			auto insert_position = free_list_.begin();
-			while (insert_position != free_list_.end())
-			{
-				if (insert_position->offset_ > alloc.offset_)
-				{
-					break;
-				}
-				++ insert_position;
-			}
+			fences_.push_back({ frame_id, head_ });
+		}
 
-			bool left_merged = false;
-			// If the alloc is adjacent to previous alloc, merge them.
-			auto previous = insert_position;
-			if (insert_position != free_list_.begin())
-			{
-				-- previous;
-				if (previous->offset_ + previous->length_ == alloc.offset_)
-				{
-					previous->length_ += alloc.length_;
-					left_merged = true;
-				}
-			}
+		auto iter = fences_.begin();
+		for (; (iter != fences_.end()) && (iter->frame_id + num_pre_frames_ <= frame_id); ++ iter)
+		{
+			tail_ = iter->offset;
+		}
+		fences_.erase(fences_.begin(), iter);
 
-			bool right_merged = false;
-			// If the alloc is adjecent to next alloc, merge them.
-			auto next = insert_position;
-			if (insert_position != free_list_.end())
-			{
-				if (left_merged)
-				{
-					if (previous->offset_ + previous->length_ == next->offset_)
-					{
-						previous->length_ += next->length_;
-						free_list_.erase(next);
-						right_merged = true;
-					}
-				}
-				else
-				{
-					if (alloc.offset_ + alloc.length_ == next->offset_)
-					{
-						next->offset_ -= alloc.length_;
-						next->length_ += alloc.length_;
-						right_merged = true;
-					}
-				}
-			}
-			if (!(left_merged || right_merged))
-			{
-				free_list_.emplace(insert_position, alloc);
-			}
+		if ((head_ < tail_) && (tail_ == wrap_end_))
+		{
+			// Everything before the wrap point is retired
+			tail_ = 0;
 		}
+
+		valid_min_ = 0xFFFFFFFF;
+		valid_max_ = 0;
 	}
 
 	void TransientBuffer::EnsureDataReady()
 	{
-		if (!use_no_overwrite_)
+		if (!use_no_overwrite_ && (valid_max_ > valid_min_))
 		{
 			GraphicsBuffer::Mapper mapper(*buffer_, BA_Write_Only);
 			memcpy(mapper.Pointer<uint8_t>() + valid_min_, &simulate_buffer_[valid_min_],
@@ -39,6 +39,9 @@
 #include <KFL/Util.hpp>
 #include <KlayGE/Context.hpp>
 #include <KFL/Math.hpp>
+#include <KFL/OcclusionBuffer.hpp>
+#include <KFL/SIMDBatch.hpp>
+#include <KFL/RadixSort.hpp>
 #include <KlayGE/App3D.hpp>
 #include <KlayGE/Window.hpp>
 #include <KlayGE/Viewport.hpp>
@@ -53,13 +56,68 @@
 #include <KlayGE/InputFactory.hpp>
 #include <KlayGE/FrameBuffer.hpp>
 #include <KlayGE/DeferredRenderingLayer.hpp>
+#include <KlayGE/CommandList.hpp>
 
 #include <map>
 #include <algorithm>
+#include <numeric>
 #include <boost/functional/hash.hpp>
 
 #include <KlayGE/SceneManager.hpp>
 
+namespace
+{
+	// Number of objects clipped by one task. Big enough to hide the cost of scheduling.
+	size_t const CLIP_TILE_SIZE = 256;
+	// Number of objects updated by one task. Smaller than clipping, the update functions are heavier.
+	size_t const UPDATE_TILE_SIZE = 64;
+	// Number of scene commands in the first chunk of the pool
+	uint32_t const SCENE_CMD_CHUNK_SIZE = 64;
+	// Minimum number of renderables recorded into one command list. Recording and replaying a list costs more
+	// than rendering a few renderables directly.
+	uint32_t const MIN_CMD_LIST_SIZE = 64;
+
+	uint32_t const DEFAULT_OCCLUSION_BUFFER_WIDTH = 256;
+	uint32_t const DEFAULT_OCCLUSION_BUFFER_HEIGHT = 128;
+
+	// Layout of the render queue sort keys, from the most significant bit:
+	//   [63]      Opaque or transparent
+	//   [62, 48]  Rank of the technique by weight
+	//   [47, 24]  Quantized view depth. Front to back for opaque, back to front for transparent.
+	//   [23, 12]  Material
+	//   [11, 0]   Mesh
+	int const SORT_KEY_PASS_SHIFT = 63;
+	int const SORT_KEY_TECH_SHIFT = 48;
+	int const SORT_KEY_DEPTH_SHIFT = 24;
+	int const SORT_KEY_MATERIAL_SHIFT = 12;
+	uint32_t const SORT_KEY_TECH_MASK = 0x7FFF;
+	uint32_t const SORT_KEY_DEPTH_MASK = 0xFFFFFF;
+	uint32_t const SORT_KEY_ID_MASK = 0xFFF;
+
+	// Folds a pointer into the 12 bits of a key field, so the draws sharing a resource are adjacent
+	uint64_t PointerKey(void const * p)
+	{
+		uint64_t const v = reinterpret_cast<uintptr_t>(p) >> 4;
+		return (v ^ (v >> 12) ^ (v >> 24)) & SORT_KEY_ID_MASK;
+	}
+
+	// Key of the visible marks of a view in visible_marks_map_. scene_seed is the hash of the visible objects.
+	size_t ViewSeed(size_t scene_seed, KlayGE::Camera const & camera, int32_t cascade_index)
+	{
+		size_t seed = scene_seed;
+		boost::hash_combine(seed, camera.OmniDirectionalMode());
+		boost::hash_combine(seed, &camera);
+		boost::hash_combine(seed, cascade_index);
+		return seed;
+	}
+
+	// Objects in the cached layers of the shadow maps
+	bool IsStaticCaster(uint32_t attr)
+	{
+		return !(attr & (KlayGE::SceneObject::SOA_Moveable | KlayGE::SceneObject::SOA_NotCastShadow));
+	}
+}
+
 namespace KlayGE
 {
 	// 캯
@@ -68,27 +126,45 @@ namespace KlayGE
 		: frustum_(nullptr),
 			small_obj_threshold_(0),
 			update_elapse_(1.0f / 60),
+			occlusion_culling_(false),
+			num_cmd_lists_(0),
+			clip_levels_dirty_(true),
 			num_objects_rendered_(0), num_renderables_rendered_(0),
 			num_primitives_rendered_(0), num_vertices_rendered_(0),
-			num_draw_calls_(0), num_dispatch_calls_(0),
-			quit_(false), deferred_mode_(false)
+			num_draw_calls_(0), num_dispatch_calls_(0), num_effect_string_lookups_(0),
+			num_scene_cmds_(0), free_scene_cmds_(0), scene_cmds_(0), held_scene_cmds_(0),
+			last_scene_update_time_(0), next_scene_update_time_(0),
+			pipeline_latency_(0), update_frames_in_flight_(0), scene_update_done_(false),
+			deferred_mode_(false)
 	{
+		state_changes_.issued.fill(0);
+		state_changes_.filtered.fill(0);
+
+		for (auto& chunk : scene_cmd_chunks_)
+		{
+			chunk.store(nullptr, std::memory_order_relaxed);
+		}
 	}
 
 	// 
 	/////////////////////////////////////////////////////////////////////////////////
 	SceneManager::~SceneManager()
 	{
-		quit_ = true;
-		(*update_thread_)();
+		this->WaitSceneUpdate();
 
 		this->ClearLight();
 		this->ClearCamera();
 		this->ClearObject();
+
+		for (auto& chunk : scene_cmd_chunks_)
+		{
+			delete[] chunk.load(std::memory_order_relaxed);
+		}
 	}
 
 	void SceneManager::Suspend()
 	{
+		this->WaitSceneUpdate();
 		this->DoSuspend();
 	}
 
@@ -102,11 +178,57 @@ namespace KlayGE
 		small_obj_threshold_ = area;
 	}
 
+	void SceneManager::PipelinedUpdate(uint32_t latency)
+	{
+		// Switching modes in the middle of an update would publish it twice or never
+		this->WaitSceneUpdate();
+		pipeline_latency_ = std::min(latency, 2U);
+	}
+
+	uint32_t SceneManager::PipelinedUpdate() const
+	{
+		return pipeline_latency_;
+	}
+
+	void SceneManager::ParallelRecording(uint32_t num)
+	{
+		num_cmd_lists_ = num;
+		if (num_cmd_lists_ < cmd_lists_.size())
+		{
+			cmd_lists_.resize(num_cmd_lists_);
+		}
+	}
+
+	uint32_t SceneManager::ParallelRecording() const
+	{
+		return num_cmd_lists_;
+	}
+
 	void SceneManager::SceneUpdateElapse(float elapse)
 	{
 		update_elapse_ = elapse;
 	}
 
+	void SceneManager::OcclusionCulling(bool enable)
+	{
+		occlusion_culling_ = enable;
+		if (occlusion_culling_ && !occlusion_buffer_)
+		{
+			occlusion_buffer_ = MakeSharedPtr<OcclusionBuffer>(DEFAULT_OCCLUSION_BUFFER_WIDTH,
+				DEFAULT_OCCLUSION_BUFFER_HEIGHT);
+		}
+	}
+
+	bool SceneManager::OcclusionCulling() const
+	{
+		return occlusion_culling_;
+	}
+
+	void SceneManager::OcclusionBufferSize(uint32_t width, uint32_t height)
+	{
+		occlusion_buffer_ = MakeSharedPtr<OcclusionBuffer>(width, height);
+	}
+
 	// ü
 	/////////////////////////////////////////////////////////////////////////////////
 	void SceneManager::ClipScene()
@@ -125,54 +247,459 @@ namespace KlayGE
 			}
 		}
 
-		for (auto const & obj : scene_objs_)
+		this->UpdateClipLevels();
+
+		thread_pool& tp = Context::Instance().ThreadPool();
+		std::vector<BoundOverlap>& visible_marks = *visible_marks_;
+		for (auto const & level : clip_levels_)
+		{
+			parallel_for_tiles(tp, level.size(), CLIP_TILE_SIZE,
+				[this, &level, &visible_marks, &camera, &view_proj](size_t begin, size_t end)
+				{
+					for (size_t i = begin; i < end; ++ i)
+					{
+						uint32_t const index = level[i];
+						visible_marks[index] = this->ClipObject(scene_objs_[index].get(), camera, view_proj);
+					}
+				});
+		}
+
+		this->OcclusionCull(camera, view_proj);
+	}
+
+	void SceneManager::AddClipView(Camera const & camera, int32_t cascade_index, float4x4 const & view_proj,
+		float small_obj_threshold)
+	{
+		ClipView view;
+		view.camera = &camera;
+		view.cascade_index = cascade_index;
+		view.view_proj = view_proj;
+		view.small_obj_threshold = small_obj_threshold;
+		view.clipped = false;
+		if (camera.OmniDirectionalMode())
+		{
+			// Not culled by the frustum, the same as in ClipScene
+			for (uint32_t p = 0; p < 6; ++ p)
+			{
+				view.frustum.FrustumPlane(p, Plane(0, 0, 0, 1));
+			}
+		}
+		else
+		{
+			view.frustum.ClipMatrix(view_proj, MathLib::inverse(view_proj));
+		}
+		clip_views_.push_back(view);
+	}
+
+	void SceneManager::AddShadowClipView(Camera const & camera, int32_t cascade_index, float4x4 const & view_proj,
+		float small_obj_threshold, float3 const & light_dir)
+	{
+		this->AddClipView(camera, cascade_index, view_proj, small_obj_threshold);
+
+		// A box swept along light_dir ends up inside of every plane facing light_dir
+		Frustum& frustum = clip_views_.back().frustum;
+		for (uint32_t p = 0; p < 6; ++ p)
 		{
-			auto so = obj.get();
-			BoundOverlap visible;
-			uint32_t const attr = so->Attrib();
-			if (so->Visible())
+			if (MathLib::dot(frustum.FrustumPlane(p).Normal(), light_dir) > 0)
 			{
-				visible = this->VisibleTestFromParent(so, camera.EyePos(), view_proj);
-				if (BO_Partial == visible)
+				frustum.FrustumPlane(p, Plane(0, 0, 0, 1));
+			}
+		}
+	}
+
+	ShadowMapCache& SceneManager::ShadowCache()
+	{
+		return shadow_cache_;
+	}
+
+	// The views not clipped yet are clipped in one pass over the scene. The frusta are tested together by
+	// ClipViewBounds, then the hierarchy and the small objects are resolved per view.
+	void SceneManager::ClipViews(size_t scene_seed)
+	{
+		std::vector<ClipView*> views;
+		for (auto& view : clip_views_)
+		{
+			if (!view.clipped)
+			{
+				view.clipped = true;
+				views.push_back(&view);
+			}
+		}
+		if (views.empty())
+		{
+			return;
+		}
+
+		this->UpdateClipLevels();
+
+		size_t const num_views = views.size();
+		size_t const num = scene_objs_.size();
+		std::vector<Frustum> frusta(num_views);
+		std::vector<std::shared_ptr<std::vector<BoundOverlap>>> marks(num_views);
+		for (size_t v = 0; v < num_views; ++ v)
+		{
+			frusta[v] = views[v]->frustum;
+			marks[v] = MakeSharedPtr<std::vector<BoundOverlap>>(num, BO_No);
+		}
+
+		thread_pool& tp = Context::Instance().ThreadPool();
+		parallel_for_tiles(tp, num, CLIP_TILE_SIZE,
+			[this](size_t begin, size_t end)
+			{
+				for (size_t i = begin; i < end; ++ i)
 				{
-					if (attr & SceneObject::SOA_Moveable)
+					SceneObject* so = scene_objs_[i].get();
+					if (so->Visible() && (so->Attrib() & SceneObject::SOA_Moveable))
 					{
-						so->UpdateAbsModelMatrix();
+						so->UpdateAbsModelMatrixNoRenderable();
 					}
+				}
+			});
 
-					if (attr & SceneObject::SOA_Cullable)
+		clip_view_overlaps_.resize(std::max(clip_view_overlaps_.size(), num_views));
+		for (size_t v = 0; v < num_views; ++ v)
+		{
+			clip_view_overlaps_[v].assign(num, BO_No);
+		}
+		this->ClipViewBounds(frusta, clip_view_overlaps_);
+
+		// An object is hidden in the views its parent is hidden, and fully inside of the views its parent is
+		// fully inside of, the same as ClipObject. So the levels are resolved from the top.
+		for (auto const & level : clip_levels_)
+		{
+			parallel_for_tiles(tp, level.size(), CLIP_TILE_SIZE,
+				[this, num_views, &level, &views, &marks](size_t begin, size_t end)
+				{
+					for (size_t k = begin; k < end; ++ k)
 					{
-						if (small_obj_threshold_ > 0)
+						uint32_t const index = level[k];
+						SceneObject const * so = scene_objs_[index].get();
+						if (!so->Visible())
 						{
-							visible = (MathLib::perspective_area(camera.EyePos(), view_proj,
-								so->PosBoundWS()) > small_obj_threshold_) ? BO_Yes : BO_No;
+							continue;
 						}
-						else
+
+						uint32_t const attr = so->Attrib();
+						SceneObject const * parent = so->Parent();
+						bool const parent_in_scene = parent && this->InScene(parent);
+
+						for (size_t v = 0; v < num_views; ++ v)
 						{
-							visible = BO_Yes;
+							std::vector<BoundOverlap>& view_marks = *marks[v];
+							BoundOverlap visible = BO_Partial;
+							if (parent)
+							{
+								visible = parent_in_scene ? view_marks[parent->SceneIndex()] : BO_No;
+							}
+							if ((BO_Partial == visible) && (attr & SceneObject::SOA_Cullable))
+							{
+								visible = clip_view_overlaps_[v][index];
+							}
+							else if ((BO_Partial == visible) && !parent)
+							{
+								visible = BO_Yes;
+							}
+
+							if ((visible != BO_No) && (attr & SceneObject::SOA_Cullable))
+							{
+								ClipView const & view = *views[v];
+								if ((view.small_obj_threshold > 0)
+									&& (MathLib::perspective_area(view.camera->EyePos(), view.view_proj,
+										so->PosBoundWS()) <= view.small_obj_threshold))
+								{
+									visible = BO_No;
+								}
+							}
+							view_marks[index] = visible;
 						}
 					}
-					else
+				});
+		}
+
+		for (size_t v = 0; v < num_views; ++ v)
+		{
+			visible_marks_ = marks[v];
+			this->OcclusionCull(*views[v]->camera, views[v]->view_proj);
+
+			visible_marks_map_.emplace(ViewSeed(scene_seed, *views[v]->camera, views[v]->cascade_index), marks[v]);
+		}
+	}
+
+	// All the bounds are gathered once and tested against all the frusta
+	void SceneManager::ClipViewBounds(std::vector<Frustum> const & frusta,
+		std::vector<std::vector<BoundOverlap>>& overlaps)
+	{
+		size_t const num_views = frusta.size();
+		size_t const num = scene_objs_.size();
+
+		// Each tile has its own bitsets, the visible ones then the inside ones, so the tiles never write to
+		// the same word
+		size_t const words_per_tile = CLIP_TILE_SIZE / 32;
+		size_t const num_tiles = (num + CLIP_TILE_SIZE - 1) / CLIP_TILE_SIZE;
+		clip_view_boxes_.resize(num * 6);
+		clip_view_bits_.resize(num_tiles * num_views * words_per_tile * 2);
+		float* soa = clip_view_boxes_.data();
+		uint32_t* bits = clip_view_bits_.data();
+
+		parallel_for_tiles(Context::Instance().ThreadPool(), num, CLIP_TILE_SIZE,
+			[this, num, num_views, soa, bits, words_per_tile, &frusta, &overlaps](size_t begin, size_t end)
+			{
+				for (size_t i = begin; i < end; ++ i)
+				{
+					AABBox const & aabb = scene_objs_[i]->PosBoundWS();
+					float3 const center = aabb.Center();
+					float3 const extent = aabb.HalfSize();
+					soa[num * 0 + i] = center.x();
+					soa[num * 1 + i] = center.y();
+					soa[num * 2 + i] = center.z();
+					soa[num * 3 + i] = extent.x();
+					soa[num * 4 + i] = extent.y();
+					soa[num * 5 + i] = extent.z();
+				}
+
+				SIMDBatchLib::AABBoxSoA const boxes = { soa + num * 0 + begin, soa + num * 1 + begin,
+					soa + num * 2 + begin, soa + num * 3 + begin, soa + num * 4 + begin, soa + num * 5 + begin };
+				uint32_t* visible_bits = bits + begin / CLIP_TILE_SIZE * num_views * words_per_tile * 2;
+				uint32_t* inside_bits = visible_bits + num_views * words_per_tile;
+				SIMDBatchLib::IntersectAABBFrusta(visible_bits, inside_bits, boxes, end - begin, frusta.data(),
+					num_views);
+
+				size_t const stride = (end - begin + 31) / 32;
+				for (size_t v = 0; v < num_views; ++ v)
+				{
+					for (size_t i = begin; i < end; ++ i)
 					{
-						visible = BO_Yes;
+						size_t const word = v * stride + (i - begin) / 32;
+						uint32_t const bit = 1UL << ((i - begin) & 31);
+						if (visible_bits[word] & bit)
+						{
+							overlaps[v][i] = (inside_bits[word] & bit) ? BO_Yes : BO_Partial;
+						}
 					}
+				}
+			});
+	}
 
-					if (!camera.OmniDirectionalMode() && (attr & SceneObject::SOA_Cullable)
-						&& (BO_Yes == visible))
+	void SceneManager::UpdateTransforms()
+	{
+		if (transforms_.Update(Context::Instance().ThreadPool()))
+		{
+			// The moveable objects refresh their bounds when clipped. The static ones are only refreshed here,
+			// when they or their parents are moved.
+			for (size_t i = 0; i < scene_objs_.size(); ++ i)
+			{
+				auto const & obj = scene_objs_[i];
+				if (!(obj->Attrib() & SceneObject::SOA_Moveable) && transforms_.WorldChanged(obj->TransformNode()))
+				{
+					// The shadows are removed from where the object was, and added to where it is
+					if (static_visibles_[i])
+					{
+						this->InvalidateStaticCaster(*obj);
+					}
+					obj->UpdateAbsModelMatrix();
+					if (static_visibles_[i])
 					{
-						visible = this->AABBVisible(so->PosBoundWS());
+						this->InvalidateStaticCaster(*obj);
 					}
 				}
 			}
+		}
+	}
+
+	void SceneManager::UpdateStaticCasters()
+	{
+		for (size_t i = 0; i < scene_objs_.size(); ++ i)
+		{
+			uint8_t const visible = scene_objs_[i]->Visible();
+			if (visible != static_visibles_[i])
+			{
+				this->InvalidateStaticCaster(*scene_objs_[i]);
+				static_visibles_[i] = visible;
+			}
+		}
+	}
+
+	void SceneManager::InvalidateStaticCaster(SceneObject const & obj)
+	{
+		uint32_t const attr = obj.Attrib();
+		if (IsStaticCaster(attr))
+		{
+			if (attr & SceneObject::SOA_Cullable)
+			{
+				shadow_cache_.Invalidate(obj.PosBoundWS());
+			}
 			else
 			{
-				visible = BO_No;
+				shadow_cache_.InvalidateAll();
+			}
+		}
+	}
+
+	void SceneManager::OcclusionCull(Camera const & camera, float4x4 const & view_proj)
+	{
+		if (!occlusion_culling_ || camera.OmniDirectionalMode())
+		{
+			return;
+		}
+
+		std::vector<BoundOverlap>& visible_marks = *visible_marks_;
+
+		occlusion_buffer_->Clear();
+		for (size_t i = 0; i < scene_objs_.size(); ++ i)
+		{
+			SceneObject* so = scene_objs_[i].get();
+			if ((visible_marks[i] != BO_No) && (so->Attrib() & SceneObject::SOA_Occluder))
+			{
+				float4x4 const mvp = so->AbsModelMatrix() * view_proj;
+				auto const & indices = so->OccluderIndices();
+				if (!indices.empty())
+				{
+					occlusion_buffer_->AddOccluder(&so->OccluderPositions()[0], &indices[0],
+						static_cast<uint32_t>(indices.size()), mvp);
+				}
+				else if (so->GetRenderable())
+				{
+					occlusion_buffer_->AddOccluder(so->GetRenderable()->PosBound(), mvp);
+				}
 			}
+		}
+		if (0 == occlusion_buffer_->NumOccluderTriangles())
+		{
+			return;
+		}
+
+		thread_pool& tp = Context::Instance().ThreadPool();
+		occlusion_buffer_->Rasterize(tp);
+
+		// Only the leaves are tested, the objects with children aren't rendered anyway
+		OcclusionBuffer const & ob = *occlusion_buffer_;
+		parallel_for_tiles(tp, scene_objs_.size(), CLIP_TILE_SIZE,
+			[this, &ob, &visible_marks, &view_proj](size_t begin, size_t end)
+			{
+				for (size_t i = begin; i < end; ++ i)
+				{
+					SceneObject const * so = scene_objs_[i].get();
+					uint32_t const attr = so->Attrib();
+					if ((visible_marks[i] != BO_No) && (attr & SceneObject::SOA_Cullable)
+						&& !(attr & SceneObject::SOA_Occluder) && (0 == so->NumChildren()))
+					{
+						if (!ob.IsVisible(so->PosBoundWS(), view_proj))
+						{
+							visible_marks[i] = BO_No;
+						}
+					}
+				}
+			});
+	}
+
+	BoundOverlap SceneManager::ClipObject(SceneObject* so, Camera const & camera, float4x4 const & view_proj)
+	{
+		BoundOverlap visible;
+		uint32_t const attr = so->Attrib();
+		if (so->Visible())
+		{
+			visible = this->VisibleTestFromParent(so, camera.EyePos(), view_proj);
+			if (BO_Partial == visible)
+			{
+				if (attr & SceneObject::SOA_Moveable)
+				{
+					so->UpdateAbsModelMatrixNoRenderable();
+				}
+
+				if (attr & SceneObject::SOA_Cullable)
+				{
+					if (small_obj_threshold_ > 0)
+					{
+						visible = (MathLib::perspective_area(camera.EyePos(), view_proj,
+							so->PosBoundWS()) > small_obj_threshold_) ? BO_Yes : BO_No;
+					}
+					else
+					{
+						visible = BO_Yes;
+					}
+				}
+				else
+				{
+					visible = BO_Yes;
+				}
+
+				if (!camera.OmniDirectionalMode() && (attr & SceneObject::SOA_Cullable)
+					&& (BO_Yes == visible))
+				{
+					visible = this->AABBVisible(so->PosBoundWS());
+				}
+			}
+		}
+		else
+		{
+			visible = BO_No;
+		}
+
+		return visible;
+	}
+
+	bool SceneManager::InScene(SceneObject const * obj) const
+	{
+		uint32_t const index = obj->SceneIndex();
+		return (index < scene_objs_.size()) && (scene_objs_[index].get() == obj);
+	}
+
+	void SceneManager::UpdateClipLevels()
+	{
+		if (clip_levels_dirty_)
+		{
+			clip_levels_.clear();
+			for (uint32_t i = 0; i < scene_objs_.size(); ++ i)
+			{
+				uint32_t depth = 0;
+				for (SceneObject const * parent = scene_objs_[i]->Parent(); parent && this->InScene(parent);
+					parent = parent->Parent())
+				{
+					++ depth;
+				}
+
+				if (depth >= clip_levels_.size())
+				{
+					clip_levels_.resize(depth + 1);
+				}
+				clip_levels_[depth].push_back(i);
+			}
+
+			clip_levels_dirty_ = false;
+		}
+	}
 
-			so->VisibleMark(visible);
+	void SceneManager::OnSceneObjectsChanged()
+	{
+		// The indices are changed, so are the cached marks
+		clip_levels_dirty_ = true;
+		visible_marks_map_.clear();
+		visible_marks_.reset();
+		for (auto& view : clip_views_)
+		{
+			view.clipped = false;
 		}
 	}
 
+	BoundOverlap SceneManager::VisibleMark(SceneObject const * obj) const
+	{
+		if (visible_marks_ && this->InScene(obj))
+		{
+			return (*visible_marks_)[obj->SceneIndex()];
+		}
+		else
+		{
+			return BO_No;
+		}
+	}
+
+	void SceneManager::VisibleMark(SceneObject const * obj, BoundOverlap vm)
+	{
+		BOOST_ASSERT(visible_marks_ && this->InScene(obj));
+
+		(*visible_marks_)[obj->SceneIndex()] = vm;
+	}
+
 	void SceneManager::AddCamera(CameraPtr const & camera)
 	{
 		cameras_.push_back(camera);
@@ -186,7 +713,6 @@ namespace KlayGE
 
 	std::vector<CameraPtr>::iterator SceneManager::DelCamera(std::vector<CameraPtr>::iterator iter)
 	{
-		std::lock_guard<std::mutex> lock(update_mutex_);
 		return cameras_.erase(iter);
 	}
 
@@ -218,7 +744,6 @@ namespace KlayGE
 
 	std::vector<LightSourcePtr>::iterator SceneManager::DelLight(std::vector<LightSourcePtr>::iterator iter)
 	{
-		std::lock_guard<std::mutex> lock(update_mutex_);
 		return lights_.erase(iter);
 	}
 
@@ -241,11 +766,10 @@ namespace KlayGE
 	/////////////////////////////////////////////////////////////////////////////////
 	void SceneManager::AddSceneObject(SceneObjectPtr const & obj)
 	{
-		std::lock_guard<std::mutex> lock(update_mutex_);
-		this->AddSceneObjectLocked(obj);
+		this->PushSceneCommand(obj, true);
 	}
 
-	void SceneManager::AddSceneObjectLocked(SceneObjectPtr const & obj)
+	bool SceneManager::DoAddSceneObject(SceneObjectPtr const & obj)
 	{
 		App3DFramework& app = Context::Instance().AppInstance();
 		float const app_time = app.AppTime();
@@ -255,51 +779,244 @@ namespace KlayGE
 		uint32_t const attr = obj->Attrib();
 		if (attr & SceneObject::SOA_Overlay)
 		{
+			obj->SceneIndex(static_cast<uint32_t>(overlay_scene_objs_.size()));
 			overlay_scene_objs_.push_back(obj);
+			return false;
 		}
 		else
 		{
+			obj->BindTransform(&transforms_);
 			if ((attr & SceneObject::SOA_Cullable)
 				&& !(attr & SceneObject::SOA_Moveable))
 			{
-				obj->UpdateAbsModelMatrix();
+				obj->UpdateAbsModelMatrix();
+			}
+
+			obj->SceneIndex(static_cast<uint32_t>(scene_objs_.size()));
+			scene_objs_.push_back(obj);
+			static_visibles_.push_back(obj->Visible());
+			if (static_visibles_.back())
+			{
+				this->InvalidateStaticCaster(*obj);
+			}
+			this->OnAddSceneObject(obj);
+			return true;
+		}
+	}
+
+	// ɾȾ
+	/////////////////////////////////////////////////////////////////////////////////
+	void SceneManager::DelSceneObject(SceneObjectPtr const & obj)
+	{
+		this->PushSceneCommand(obj, false);
+	}
+
+	bool SceneManager::DoDelSceneObject(SceneObjectPtr const & obj)
+	{
+		uint32_t const index = obj->SceneIndex();
+		if ((index < scene_objs_.size()) && (scene_objs_[index] == obj))
+		{
+			this->DetachSceneObject(scene_objs_.begin() + index);
+			scene_objs_[index].reset();
+			return true;
+		}
+		return false;
+	}
+
+	void SceneManager::DetachSceneObject(std::vector<SceneObjectPtr>::iterator iter)
+	{
+		this->OnDelSceneObject(iter);
+		if (static_visibles_[iter - scene_objs_.begin()])
+		{
+			this->InvalidateStaticCaster(**iter);
+		}
+		(*iter)->SceneIndex(static_cast<uint32_t>(-1));
+		(*iter)->BindTransform(nullptr);
+	}
+
+	void SceneManager::CompactSceneObjects()
+	{
+		size_t num = 0;
+		for (size_t i = 0; i < scene_objs_.size(); ++ i)
+		{
+			if (scene_objs_[i])
+			{
+				if (num != i)
+				{
+					scene_objs_[num] = std::move(scene_objs_[i]);
+					static_visibles_[num] = static_visibles_[i];
+					scene_objs_[num]->SceneIndex(static_cast<uint32_t>(num));
+				}
+				++ num;
+			}
+		}
+		scene_objs_.resize(num);
+		static_visibles_.resize(num);
+	}
+
+	void SceneManager::PushSceneCommand(SceneObjectPtr const & obj, bool add)
+	{
+		uint32_t const index = this->AllocSceneCommand();
+		SceneCommand& cmd = this->SceneCommandAt(index);
+		cmd.obj = obj;
+		cmd.add = add;
+		uint32_t head = scene_cmds_.load(std::memory_order_relaxed);
+		do
+		{
+			cmd.next.store(head, std::memory_order_relaxed);
+		} while (!scene_cmds_.compare_exchange_weak(head, index + 1, std::memory_order_release, std::memory_order_relaxed));
+	}
+
+	uint32_t SceneManager::AllocSceneCommand()
+	{
+		// The tag changes on every pop and push, so a head popped and pushed back by other threads in between
+		// fails the exchange
+		uint64_t head = free_scene_cmds_.load(std::memory_order_acquire);
+		while (static_cast<uint32_t>(head) != 0)
+		{
+			uint32_t const index = static_cast<uint32_t>(head) - 1;
+			uint64_t const new_head = (((head >> 32) + 1) << 32) | this->SceneCommandAt(index).next.load(std::memory_order_relaxed);
+			if (free_scene_cmds_.compare_exchange_weak(head, new_head, std::memory_order_acquire, std::memory_order_acquire))
+			{
+				return index;
+			}
+		}
+
+		return num_scene_cmds_.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	SceneManager::SceneCommand& SceneManager::SceneCommandAt(uint32_t index)
+	{
+		uint32_t chunk = 0;
+		uint32_t chunk_size = SCENE_CMD_CHUNK_SIZE;
+		while (index >= chunk_size)
+		{
+			index -= chunk_size;
+			chunk_size *= 2;
+			++ chunk;
+		}
+		BOOST_ASSERT(chunk < MAX_SCENE_CMD_CHUNKS);
+
+		SceneCommand* cmds = scene_cmd_chunks_[chunk].load(std::memory_order_acquire);
+		if (!cmds)
+		{
+			// The threads reaching a new chunk at the same time race to allocate it, the losers drop theirs
+			SceneCommand* new_cmds = new SceneCommand[chunk_size];
+			if (scene_cmd_chunks_[chunk].compare_exchange_strong(cmds, new_cmds, std::memory_order_acq_rel,
+				std::memory_order_acquire))
+			{
+				cmds = new_cmds;
+			}
+			else
+			{
+				delete[] new_cmds;
+			}
+		}
+		return cmds[index];
+	}
+
+	void SceneManager::FreeSceneCommands(uint32_t first, uint32_t last)
+	{
+		SceneCommand& tail = this->SceneCommandAt(last - 1);
+		uint64_t head = free_scene_cmds_.load(std::memory_order_relaxed);
+		do
+		{
+			tail.next.store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+		} while (!free_scene_cmds_.compare_exchange_weak(head, (((head >> 32) + 1) << 32) | first,
+			std::memory_order_release, std::memory_order_relaxed));
+	}
+
+	void SceneManager::ApplySceneCommands()
+	{
+		bool changed = false;
+		bool deleted = false;
+
+		if (held_scene_cmds_ != 0)
+		{
+			held_scene_cmds_ = this->ApplySceneCommands(held_scene_cmds_, changed, deleted);
+		}
+
+		// The whole stack is taken at once, so there is no ABA problem. Adding an object could add its children,
+		// which are applied in the next round. The new requests wait behind the held ones.
+		while (held_scene_cmds_ == 0)
+		{
+			uint32_t link = scene_cmds_.exchange(0, std::memory_order_acquire);
+			if (0 == link)
+			{
+				break;
+			}
+
+			// In reverse order of pushing
+			uint32_t ordered = 0;
+			while (link != 0)
+			{
+				SceneCommand& cmd = this->SceneCommandAt(link - 1);
+				uint32_t const next = cmd.next.load(std::memory_order_relaxed);
+				cmd.next.store(ordered, std::memory_order_relaxed);
+				ordered = link;
+				link = next;
 			}
 
-			scene_objs_.push_back(obj);
-			this->OnAddSceneObject(obj);
+			held_scene_cmds_ = this->ApplySceneCommands(ordered, changed, deleted);
 		}
-	}
 
-	// ɾȾ
-	/////////////////////////////////////////////////////////////////////////////////
-	void SceneManager::DelSceneObject(SceneObjectPtr const & obj)
-	{
-		std::lock_guard<std::mutex> lock(update_mutex_);
-		this->DelSceneObjectLocked(obj);
+		// The deleted objects are removed, and the indices and the cached marks are changed, once for all the
+		// requests
+		if (deleted)
+		{
+			this->CompactSceneObjects();
+		}
+		if (changed)
+		{
+			this->OnSceneObjectsChanged();
+		}
 	}
 
-	void SceneManager::DelSceneObjectLocked(SceneObjectPtr const & obj)
+	uint32_t SceneManager::ApplySceneCommands(uint32_t first, bool& changed, bool& deleted)
 	{
-		for (auto iter = scene_objs_.begin(); iter != scene_objs_.end(); ++ iter)
+		uint32_t link = first;
+		uint32_t last = 0;
+		while (link != 0)
 		{
-			if (*iter == obj)
+			SceneCommand& cmd = this->SceneCommandAt(link - 1);
+			if (cmd.add)
+			{
+				changed |= this->DoAddSceneObject(cmd.obj);
+			}
+			else if (scene_update_)
 			{
-				this->DelSceneObjectLocked(iter);
+				// The update could still be running on it
 				break;
 			}
+			else if (this->DoDelSceneObject(cmd.obj))
+			{
+				changed = true;
+				deleted = true;
+			}
+			cmd.obj.reset();
+			last = link;
+			link = cmd.next.load(std::memory_order_relaxed);
 		}
-	}
 
-	std::vector<SceneObjectPtr>::iterator SceneManager::DelSceneObject(std::vector<SceneObjectPtr>::iterator iter)
-	{
-		std::lock_guard<std::mutex> lock(update_mutex_);
-		return this->DelSceneObjectLocked(iter);
+		if (last != 0)
+		{
+			this->SceneCommandAt(last - 1).next.store(0, std::memory_order_relaxed);
+			this->FreeSceneCommands(first, last);
+		}
+		return link;
 	}
 
-	std::vector<SceneObjectPtr>::iterator SceneManager::DelSceneObjectLocked(std::vector<SceneObjectPtr>::iterator iter)
+	std::vector<SceneObjectPtr>::iterator SceneManager::DelSceneObject(std::vector<SceneObjectPtr>::iterator iter)
 	{
-		this->OnDelSceneObject(iter);
-		return scene_objs_.erase(iter);
+		this->DetachSceneObject(iter);
+		static_visibles_.erase(static_visibles_.begin() + (iter - scene_objs_.begin()));
+		iter = scene_objs_.erase(iter);
+		for (auto renumber_iter = iter; renumber_iter != scene_objs_.end(); ++ renumber_iter)
+		{
+			(*renumber_iter)->SceneIndex(static_cast<uint32_t>(renumber_iter - scene_objs_.begin()));
+		}
+		this->OnSceneObjectsChanged();
+		return iter;
 	}
 
 	// Ⱦ
@@ -352,22 +1069,8 @@ namespace KlayGE
 
 			if (add)
 			{
-				RenderTechnique const * obj_tech = obj->GetRenderTechnique();
-				BOOST_ASSERT(obj_tech);
-				bool found = false;
-				for (auto& items : render_queue_)
-				{
-					if (items.first == obj_tech)
-					{
-						items.second.push_back(obj);
-						found = true;
-						break;
-					}
-				}
-				if (!found)
-				{
-					render_queue_.emplace_back(obj_tech, std::vector<Renderable*>(1, obj));
-				}
+				BOOST_ASSERT(obj->GetRenderTechnique());
+				render_queue_.push_back(obj);
 			}
 		}
 	}
@@ -447,9 +1150,37 @@ namespace KlayGE
 
 	void SceneManager::ClearObject()
 	{
-		std::lock_guard<std::mutex> lock(update_mutex_);
+		this->WaitSceneUpdate();
+
+		// The pending requests are older than the clearing, dropping them gives the same scene
+		for (uint32_t const first : { held_scene_cmds_, scene_cmds_.exchange(0, std::memory_order_acquire) })
+		{
+			if (first != 0)
+			{
+				uint32_t last = first;
+				for (uint32_t link = first; link != 0;)
+				{
+					SceneCommand& cmd = this->SceneCommandAt(link - 1);
+					cmd.obj.reset();
+					last = link;
+					link = cmd.next.load(std::memory_order_relaxed);
+				}
+				this->FreeSceneCommands(first, last);
+			}
+		}
+		held_scene_cmds_ = 0;
+
+		for (auto const & obj : scene_objs_)
+		{
+			obj->SceneIndex(static_cast<uint32_t>(-1));
+			obj->BindTransform(nullptr);
+		}
 		scene_objs_.resize(0);
+		static_visibles_.resize(0);
+		transforms_.Clear();
+		shadow_cache_.InvalidateAll();
 		overlay_scene_objs_.resize(0);
+		this->OnSceneObjectsChanged();
 	}
 
 	// ³
@@ -461,14 +1192,25 @@ namespace KlayGE
 		RenderEngine& re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
 		re.BeginFrame();
 
-		this->FlushScene();
+		bool launch_update = false;
+		if (pipeline_latency_ > 0)
+		{
+			// The deleted objects are still alive until the scene commands are applied
+			launch_update = this->PublishSceneUpdate();
+		}
+		else
+		{
+			this->WaitSceneUpdate();
+		}
+		this->ApplySceneCommands();
 
-		if (!update_thread_ && !quit_)
+		if (launch_update)
 		{
-			update_thread_ = MakeUniquePtr<joiner<void>>(Context::Instance().ThreadPool()(
-				std::bind(&SceneManager::UpdateThreadFunc, this)));
+			this->LaunchSceneUpdate();
 		}
 
+		this->FlushScene();
+
 		InputEngine& ie = Context::Instance().InputFactoryInstance().InputEngineInstance();
 		ie.Update();
 
@@ -490,45 +1232,161 @@ namespace KlayGE
 		}
 
 		std::vector<SceneObjectPtr> added_scene_objs;
+		for (auto const & scene_obj : scene_objs_)
+		{
+			if (scene_obj->MainThreadUpdate(app_time, frame_time))
+			{
+				added_scene_objs.push_back(scene_obj);
+			}
+		}
+
+		if (0 == pipeline_latency_)
 		{
-			std::lock_guard<std::mutex> lock(update_mutex_);
+			this->LaunchSceneUpdate();
+		}
 
-			for (auto const & scene_obj : scene_objs_)
+		overlay_scene_objs_.clear();
+		for (auto iter = lights_.begin(); iter != lights_.end();)
+		{
+			if ((*iter)->Attrib() & LightSource::LSA_Temporary)
 			{
-				if (scene_obj->MainThreadUpdate(app_time, frame_time))
-				{
-					added_scene_objs.push_back(scene_obj);
-				}
+				iter = this->DelLight(iter);
+			}
+			else
+			{
+				++ iter;
 			}
+		}
+
+		for (auto const & scene_obj : added_scene_objs)
+		{
+			scene_obj->OnAttachRenderable(true);
+			this->OnAddSceneObject(scene_obj);
+		}
+
+		re.EndFrame();
+	}
 
-			overlay_scene_objs_.clear();
-			for (auto iter = lights_.begin(); iter != lights_.end();)
+	void SceneManager::LaunchSceneUpdate()
+	{
+		App3DFramework& app = Context::Instance().AppInstance();
+		WindowPtr const & win = app.MainWnd();
+		float const app_time = app.AppTime();
+		if (!win || !win->Active() || (app_time < next_scene_update_time_))
+		{
+			return;
+		}
+
+		float const frame_time = app_time - last_scene_update_time_;
+		last_scene_update_time_ = app_time;
+		next_scene_update_time_ = std::max(next_scene_update_time_ + update_elapse_, app_time);
+
+		// The overlay objects are cleared right after, the pass works on its own list. In the pipelined mode,
+		// the objects not opted in are updated right here, before the frame is flushed.
+		bool const pipelined = (pipeline_latency_ > 0);
+		scene_update_objs_.resize(0);
+		immediate_update_objs_.resize(0);
+		for (auto const & scene_obj : scene_objs_)
+		{
+			if (!pipelined || (scene_obj->Attrib() & SceneObject::SOA_PipelinedUpdate))
 			{
-				if ((*iter)->Attrib() & LightSource::LSA_Temporary)
+				scene_update_objs_.push_back(scene_obj);
+			}
+			else
+			{
+				immediate_update_objs_.push_back(scene_obj.get());
+			}
+		}
+		for (auto const & scene_obj : overlay_scene_objs_)
+		{
+			if (pipelined)
+			{
+				immediate_update_objs_.push_back(scene_obj.get());
+			}
+			else
+			{
+				scene_update_objs_.push_back(scene_obj);
+			}
+		}
+
+		thread_pool& tp = Context::Instance().ThreadPool();
+		if (!immediate_update_objs_.empty())
+		{
+			parallel_for_tiles(tp, immediate_update_objs_.size(), UPDATE_TILE_SIZE,
+				[this, app_time, frame_time](size_t begin, size_t end)
 				{
-					iter = this->DelLight(iter);
-				}
-				else
+					for (size_t i = begin; i < end; ++ i)
+					{
+						immediate_update_objs_[i]->SubThreadUpdate(app_time, frame_time);
+					}
+				});
+		}
+
+		if (scene_update_objs_.empty())
+		{
+			return;
+		}
+
+		update_frames_in_flight_ = 0;
+		scene_update_done_ = false;
+
+		scene_update_ = MakeUniquePtr<joiner<void>>(tp([this, &tp, app_time, frame_time, pipelined]
+			{
+				// An object only updates itself, so the objects are independent
+				parallel_for_tiles(tp, scene_update_objs_.size(), UPDATE_TILE_SIZE,
+					[this, app_time, frame_time, pipelined](size_t begin, size_t end)
+					{
+						SceneObject::DeferUpdates(pipelined);
+						for (size_t i = begin; i < end; ++ i)
+						{
+							scene_update_objs_[i]->SubThreadUpdate(app_time, frame_time);
+						}
+						SceneObject::DeferUpdates(false);
+					});
+
+				scene_update_done_ = true;
+			}));
+	}
+
+	void SceneManager::WaitSceneUpdate()
+	{
+		if (scene_update_)
+		{
+			(*scene_update_)();
+			scene_update_.reset();
+
+			if (pipeline_latency_ > 0)
+			{
+				for (auto const & obj : scene_update_objs_)
 				{
-					++ iter;
+					obj->ApplyDeferredUpdates();
 				}
 			}
-		
-			for (auto const & scene_obj : added_scene_objs)
+			scene_update_objs_.resize(0);
+		}
+	}
+
+	bool SceneManager::PublishSceneUpdate()
+	{
+		if (scene_update_)
+		{
+			++ update_frames_in_flight_;
+			if (!scene_update_done_ && (update_frames_in_flight_ < pipeline_latency_))
 			{
-				scene_obj->OnAttachRenderable(true);
-				this->OnAddSceneObject(scene_obj);
+				return false;
 			}
-		}
 
-		re.EndFrame();
+			this->WaitSceneUpdate();
+		}
+		return true;
 	}
 
 	// ȾеȾ
 	/////////////////////////////////////////////////////////////////////////////////
 	void SceneManager::Flush(uint32_t urt)
 	{
-		std::lock_guard<std::mutex> lock(update_mutex_);
+		// Objects added in the passes before, the overlay ones in particular
+		this->ApplySceneCommands();
 
 		urt_ = urt;
 
@@ -545,13 +1403,23 @@ namespace KlayGE
 		Camera& camera = app.ActiveCamera();
 		auto const & scene_objs = (urt & App3DFramework::URV_Overlay) ? overlay_scene_objs_ : scene_objs_;
 
-		for (auto const & scene_obj : scene_objs)
-		{
-			scene_obj->VisibleMark(BO_No);
-		}
 		if (urt & App3DFramework::URV_NeedFlush)
 		{
 			frustum_ = &camera.ViewFrustum();
+		}
+		std::shared_ptr<std::vector<BoundOverlap>> flush_marks;
+		if (urt & App3DFramework::URV_Overlay)
+		{
+			flush_marks = MakeSharedPtr<std::vector<BoundOverlap>>(scene_objs.size());
+			for (size_t i = 0; i < scene_objs.size(); ++ i)
+			{
+				scene_objs[i]->MainThreadUpdate(app_time, frame_time);
+				(*flush_marks)[i] = scene_objs[i]->Visible() ? BO_Yes : BO_No;
+			}
+		}
+		else if (urt & App3DFramework::URV_NeedFlush)
+		{
+			this->UpdateTransforms();
 
 			std::vector<uint32_t> visible_list((scene_objs.size() + 31) / 32, 0);
 			for (size_t i = 0; i < scene_objs.size(); ++ i)
@@ -561,46 +1429,46 @@ namespace KlayGE
 					visible_list[i / 32] |= (1UL << (i & 31));
 				}
 			}
-			size_t seed = 0;
-			boost::hash_range(seed, visible_list.begin(), visible_list.end());
-			boost::hash_combine(seed, camera.OmniDirectionalMode());
-			boost::hash_combine(seed, &camera);
+			size_t scene_seed = 0;
+			boost::hash_range(scene_seed, visible_list.begin(), visible_list.end());
+			auto drl = Context::Instance().DeferredRenderingLayerInstance();
+			size_t const seed = ViewSeed(scene_seed, camera, drl ? drl->CurrCascadeIndex() : -1);
 
 			auto vmiter = visible_marks_map_.find(seed);
 			if (vmiter == visible_marks_map_.end())
 			{
+				this->ClipViews(scene_seed);
+				vmiter = visible_marks_map_.find(seed);
+			}
+			if (vmiter == visible_marks_map_.end())
+			{
+				visible_marks_ = MakeSharedPtr<std::vector<BoundOverlap>>(scene_objs.size(), BO_No);
 				this->ClipScene();
 
-				std::shared_ptr<std::vector<BoundOverlap>> visible_marks
-					= MakeSharedPtr<std::vector<BoundOverlap>>(scene_objs.size());
-				for (size_t i = 0; i < scene_objs.size(); ++ i)
-				{
-					(*visible_marks)[i] = scene_objs[i]->VisibleMark();
-				}
-
-				visible_marks_map_.emplace(seed, visible_marks);
+				visible_marks_map_.emplace(seed, visible_marks_);
 			}
 			else
 			{
-				for (size_t i = 0; i < scene_objs.size(); ++ i)
-				{
-					scene_objs[i]->VisibleMark((*vmiter->second)[i]);
-				}
+				visible_marks_ = vmiter->second;
 			}
+
+			flush_marks = visible_marks_;
 		}
-		if (urt & App3DFramework::URV_Overlay)
+		else
 		{
-			for (auto const & scene_obj : scene_objs)
-			{
-				scene_obj->MainThreadUpdate(app_time, frame_time);
-				scene_obj->VisibleMark(scene_obj->Visible() ? BO_Yes : BO_No);
-			}
+			flush_marks = MakeSharedPtr<std::vector<BoundOverlap>>(scene_objs.size(), BO_No);
 		}
 
-		for (auto const & obj : scene_objs)
+		// The static and the moveable objects could be rendered separately, such as the layers of the cached
+		// shadow maps
+		bool const static_only = (urt & App3DFramework::URV_StaticOnly) != 0;
+		bool const dynamic_only = (urt & App3DFramework::URV_DynamicOnly) != 0;
+
+		std::vector<BoundOverlap> const & visible_marks = *flush_marks;
+		for (size_t i = 0; i < scene_objs.size(); ++ i)
 		{
-			auto so = obj.get();
-			if ((so->VisibleMark() != BO_No) && (0 == so->NumChildren()))
+			auto so = scene_objs[i].get();
+			if ((visible_marks[i] != BO_No) && (0 == so->NumChildren()))
 			{
 				auto renderable = so->GetRenderable().get();
 				if (renderable)
@@ -610,14 +1478,21 @@ namespace KlayGE
 			}
 		}
 
-		for (auto const & obj : scene_objs)
+		for (size_t i = 0; i < scene_objs.size(); ++ i)
 		{
-			auto so = obj.get();
-			if ((so->VisibleMark() != BO_No) && (0 == so->NumChildren()))
+			auto so = scene_objs[i].get();
+			if ((visible_marks[i] != BO_No) && (0 == so->NumChildren())
+				&& !((so->Attrib() & SceneObject::SOA_Moveable) ? static_only : dynamic_only))
 			{
 				auto renderable = so->GetRenderable().get();
 				if (renderable)
 				{
+					// The renderable could be shared, so it's not touched when clipping in parallel
+					if (!(urt & App3DFramework::URV_Overlay) && (so->Attrib() & SceneObject::SOA_Moveable))
+					{
+						renderable->ModelMatrix(so->AbsModelMatrix());
+					}
+
 					if (0 == renderable->NumInstances())
 					{
 						renderable->AddToRenderQueue();
@@ -628,66 +1503,217 @@ namespace KlayGE
 			}
 		}
 
-		std::sort(render_queue_.begin(), render_queue_.end(),
-			[](std::pair<RenderTechnique const *, std::vector<Renderable*>> const & lhs,
-				std::pair<RenderTechnique const *, std::vector<Renderable*>> const & rhs)
+		this->SortRenderQueue(camera);
+		this->RenderQueue(!(urt & App3DFramework::URV_Overlay));
+		num_renderables_rendered_ = static_cast<uint32_t>(render_queue_.size());
+		render_queue_.resize(0);
+
+		num_primitives_rendered_ += re.NumPrimitivesJustRendered();
+		num_vertices_rendered_ += re.NumVerticesJustRendered();
+
+		urt_ = 0;
+	}
+
+	void SceneManager::RenderQueue(bool parallel)
+	{
+		size_t const num = render_queue_.size();
+		uint32_t const num_lists = parallel
+			? std::min(num_cmd_lists_, static_cast<uint32_t>(num / MIN_CMD_LIST_SIZE)) : 0;
+		if (num_lists <= 1)
+		{
+			for (size_t i = 0; i < num; ++ i)
 			{
-				BOOST_ASSERT(lhs.first);
-				BOOST_ASSERT(rhs.first);
+				render_queue_[queue_indices_[i]]->Render();
+			}
+			return;
+		}
 
-				return lhs.first->Weight() < rhs.first->Weight();
-			});
+		// The renderables set their parameters on the effect before drawing, so the ones of an effect, even not
+		// adjacent after sorting, are recorded by one thread
+		queue_effects_.resize(num);
+		for (size_t i = 0; i < num; ++ i)
+		{
+			queue_effects_[i] = render_queue_[queue_indices_[i]]->GetRenderEffect().get();
+		}
+		SplitByOwner(queue_effects_, num_lists, cmd_list_starts_);
+
+		uint32_t const num_slices = static_cast<uint32_t>(cmd_list_starts_.size() - 1);
+		if (num_slices <= 1)
+		{
+			for (size_t i = 0; i < num; ++ i)
+			{
+				render_queue_[queue_indices_[i]]->Render();
+			}
+			return;
+		}
 
-		float4 const & view_mat_z = camera.ViewMatrix().Col(2);
-		for (auto& items : render_queue_)
+		RenderFactory& rf = Context::Instance().RenderFactoryInstance();
+		while (cmd_lists_.size() < num_slices)
 		{
-			if (!items.first->Transparent() && !items.first->HasDiscard() && (items.second.size() > 1))
+			cmd_lists_.push_back(rf.MakeCommandList());
+		}
+
+		parallel_for_tiles(Context::Instance().ThreadPool(), num_slices, 1,
+			[this](size_t begin, size_t end)
 			{
-				std::vector<std::pair<float, uint32_t>> min_depths(items.second.size());
-				for (size_t j = 0; j < min_depths.size(); ++ j)
+				for (size_t s = begin; s < end; ++ s)
 				{
-					Renderable const * renderable = items.second[j];
-					AABBox const & box = renderable->PosBound();
-					uint32_t const num = renderable->NumInstances();
-					float md = 1e10f;
-					for (uint32_t i = 0; i < num; ++ i)
+					CommandList& cmd_list = *cmd_lists_[s];
+					cmd_list.Begin();
+					for (size_t i = cmd_list_starts_[s]; i < cmd_list_starts_[s + 1]; ++ i)
 					{
-						float4x4 const & mat = renderable->GetInstance(i)->ModelMatrix();
-						float4 const zvec(MathLib::dot(mat.Row(0), view_mat_z),
-							MathLib::dot(mat.Row(1), view_mat_z), MathLib::dot(mat.Row(2), view_mat_z),
-							MathLib::dot(mat.Row(3), view_mat_z));
-						for (int k = 0; k < 8; ++ k)
-						{
-							float3 const v = box.Corner(k);
-							md = std::min(md, v.x() * zvec.x() + v.y() * zvec.y() + v.z() * zvec.z() + zvec.w());
-						}
+						render_queue_[queue_indices_[i]]->Render();
 					}
-
-					min_depths[j] = std::make_pair(md, static_cast<uint32_t>(j));
+					cmd_list.End();
 				}
+			});
+
+		rf.RenderEngineInstance().Submit(&cmd_lists_[0], num_slices);
+		for (uint32_t s = 0; s < num_slices; ++ s)
+		{
+			cmd_lists_[s]->Reset();
+		}
+	}
+
+	void SceneManager::SplitByOwner(std::vector<void const *> const & owners, uint32_t num_slices,
+		std::vector<size_t>& starts)
+	{
+		size_t const num = owners.size();
+
+		std::unordered_map<void const *, size_t> last_entries;
+		for (size_t i = 0; i < num; ++ i)
+		{
+			last_entries[owners[i]] = i;
+		}
+
+		// A range could end after i only if no owner before it has entries after it. The range is cut at the first
+		// such place past its share.
+		starts.assign(1, 0);
+		size_t reach = 0;
+		for (size_t i = 0; (i + 1 < num) && (starts.size() < num_slices); ++ i)
+		{
+			reach = std::max(reach, last_entries[owners[i]]);
+			if ((reach == i) && (i + 1 >= num * starts.size() / num_slices))
+			{
+				starts.push_back(i + 1);
+			}
+		}
+		starts.push_back(num);
+	}
+
+	void SceneManager::SortRenderQueue(Camera const & camera)
+	{
+		uint32_t const num = static_cast<uint32_t>(render_queue_.size());
 
-				std::sort(min_depths.begin(), min_depths.end());
+		// Techniques are ranked by weight. Equal weights are told apart by the address, so the renderables of
+		// one technique stay together.
+		queue_techs_.resize(num);
+		for (uint32_t i = 0; i < num; ++ i)
+		{
+			RenderTechnique const * tech = render_queue_[i]->GetRenderTechnique();
+			queue_techs_[i] = std::make_pair(tech->Weight(), tech);
+		}
+		std::sort(queue_techs_.begin(), queue_techs_.end());
+		queue_techs_.erase(std::unique(queue_techs_.begin(), queue_techs_.end()), queue_techs_.end());
 
-				std::vector<Renderable*> sorted_items(min_depths.size());
-				for (size_t j = 0; j < min_depths.size(); ++ j)
+		// World space bounds of all the instances, as SoA streams
+		size_t num_boxes = 0;
+		for (uint32_t i = 0; i < num; ++ i)
+		{
+			num_boxes += render_queue_[i]->NumInstances();
+		}
+		queue_depth_boxes_.resize(num_boxes * 7);
+		float* center_x = &queue_depth_boxes_[0 * num_boxes];
+		float* center_y = &queue_depth_boxes_[1 * num_boxes];
+		float* center_z = &queue_depth_boxes_[2 * num_boxes];
+		float* extent_x = &queue_depth_boxes_[3 * num_boxes];
+		float* extent_y = &queue_depth_boxes_[4 * num_boxes];
+		float* extent_z = &queue_depth_boxes_[5 * num_boxes];
+		float* depths = &queue_depth_boxes_[6 * num_boxes];
+		size_t box = 0;
+		for (uint32_t i = 0; i < num; ++ i)
+		{
+			Renderable const * renderable = render_queue_[i];
+			for (uint32_t j = 0; j < renderable->NumInstances(); ++ j, ++ box)
+			{
+				SceneObject const * so = renderable->GetInstance(j);
+				uint32_t const attr = so->Attrib();
+				AABBox aabb_ws;
+				if (!(attr & SceneObject::SOA_Overlay) && (attr & (SceneObject::SOA_Cullable | SceneObject::SOA_Moveable)))
+				{
+					aabb_ws = so->PosBoundWS();
+				}
+				else
 				{
-					sorted_items[j] = items.second[min_depths[j].second];
+					aabb_ws = MathLib::transform_aabb(renderable->PosBound(), so->AbsModelMatrix());
 				}
-				items.second.swap(sorted_items);
+
+				float3 const center = aabb_ws.Center();
+				float3 const extent = aabb_ws.HalfSize();
+				center_x[box] = center.x();
+				center_y[box] = center.y();
+				center_z[box] = center.z();
+				extent_x[box] = extent.x();
+				extent_y[box] = extent.y();
+				extent_z[box] = extent.z();
+			}
+		}
+		if (num_boxes > 0)
+		{
+			SIMDBatchLib::AABBoxSoA const boxes = { center_x, center_y, center_z, extent_x, extent_y, extent_z };
+			float4 const & view_mat_z = camera.ViewMatrix().Col(2);
+			SIMDBatchLib::AABBPlaneDistance(depths, boxes, num_boxes,
+				Plane(view_mat_z.x(), view_mat_z.y(), view_mat_z.z(), view_mat_z.w()));
+		}
+
+		float const near_plane = camera.NearPlane();
+		float const inv_depth_range = 1 / (camera.FarPlane() - near_plane);
+
+		queue_keys_.resize(num);
+		queue_indices_.resize(num);
+		queue_tmp_keys_.resize(num);
+		queue_tmp_indices_.resize(num);
+		box = 0;
+		for (uint32_t i = 0; i < num; ++ i)
+		{
+			Renderable const * renderable = render_queue_[i];
+			RenderTechnique const * tech = renderable->GetRenderTechnique();
+
+			uint32_t const num_instances = renderable->NumInstances();
+			float md = camera.FarPlane();
+			for (uint32_t j = 0; j < num_instances; ++ j, ++ box)
+			{
+				md = std::min(md, depths[box]);
 			}
 
-			for (auto const & item : items.second)
+			uint32_t depth_key;
+			if (tech->HasDiscard() && !tech->Transparent())
 			{
-				item->Render();
+				// Early z doesn't work with discard anyway, group them by material and mesh instead
+				depth_key = 0;
+			}
+			else
+			{
+				depth_key = static_cast<uint32_t>(MathLib::clamp((md - near_plane) * inv_depth_range, 0.0f, 1.0f) * SORT_KEY_DEPTH_MASK);
+				if (tech->Transparent())
+				{
+					depth_key = SORT_KEY_DEPTH_MASK - depth_key;
+				}
 			}
-			num_renderables_rendered_ += static_cast<uint32_t>(items.second.size());
-		}
-		render_queue_.resize(0);
 
-		num_primitives_rendered_ += re.NumPrimitivesJustRendered();
-		num_vertices_rendered_ += re.NumVerticesJustRendered();
+			uint32_t const tech_rank = static_cast<uint32_t>(std::lower_bound(queue_techs_.begin(), queue_techs_.end(),
+				std::make_pair(tech->Weight(), tech)) - queue_techs_.begin());
 
-		urt_ = 0;
+			queue_keys_[i] = (static_cast<uint64_t>(tech->Transparent()) << SORT_KEY_PASS_SHIFT)
+				| (static_cast<uint64_t>(std::min(tech_rank, SORT_KEY_TECH_MASK)) << SORT_KEY_TECH_SHIFT)
+				| (static_cast<uint64_t>(depth_key) << SORT_KEY_DEPTH_SHIFT)
+				| (PointerKey(renderable->Material().get()) << SORT_KEY_MATERIAL_SHIFT)
+				| PointerKey(&renderable->GetRenderLayout());
+			queue_indices_[i] = i;
+		}
+
+		RadixSort(queue_keys_.data(), queue_indices_.data(), num, queue_tmp_keys_.data(), queue_tmp_indices_.data(),
+			Context::Instance().ThreadPool());
 	}
 
 	// ȡȾ
@@ -728,11 +1754,39 @@ namespace KlayGE
 		return num_dispatch_calls_;
 	}
 
+	RenderStateChanges const & SceneManager::StateChanges() const
+	{
+		return state_changes_;
+	}
+
+	uint32_t SceneManager::NumStateChangesIssued() const
+	{
+		return std::accumulate(state_changes_.issued.begin(), state_changes_.issued.end(), 0U);
+	}
+
+	uint32_t SceneManager::NumStateChangesFiltered() const
+	{
+		return std::accumulate(state_changes_.filtered.begin(), state_changes_.filtered.end(), 0U);
+	}
+
+	uint32_t SceneManager::NumEffectStringLookups() const
+	{
+		return num_effect_string_lookups_;
+	}
+
 	void SceneManager::FlushScene()
 	{
 		RenderEngine& re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
 
 		visible_marks_map_.clear();
+		clip_views_.clear();
+
+		// The cached shadow maps are checked in the first pass, so they are invalidated by the changes of the
+		// static casters before it. The visibility is compared here, before SceneObject::Pass hides the objects
+		// not casting shadows.
+		this->ApplySceneCommands();
+		this->UpdateTransforms();
+		this->UpdateStaticCasters();
 
 		uint32_t urt;
 		App3DFramework& app = Context::Instance().AppInstance();
@@ -768,41 +1822,8 @@ namespace KlayGE
 
 		num_draw_calls_ = re.NumDrawsJustCalled();
 		num_dispatch_calls_ = re.NumDispatchesJustCalled();
-	}
-
-	void SceneManager::UpdateThreadFunc()
-	{
-		Timer timer;
-		float app_time = 0;
-		while (!quit_)
-		{
-			float const frame_time = static_cast<float>(timer.elapsed());
-			timer.restart();
-			app_time += frame_time;
-
-			if (Context::Instance().AppValid())
-			{
-				WindowPtr const & win = Context::Instance().AppInstance().MainWnd();
-				if (win && win->Active())
-				{
-					std::lock_guard<std::mutex> lock(update_mutex_);
-
-					for (auto const & scene_obj : scene_objs_)
-					{
-						scene_obj->SubThreadUpdate(app_time, frame_time);
-					}
-					for (auto const & scene_obj : overlay_scene_objs_)
-					{
-						scene_obj->SubThreadUpdate(app_time, frame_time);
-					}
-				}
-
-				if (frame_time < update_elapse_)
-				{
-					Sleep(static_cast<uint32_t>((update_elapse_ - frame_time) * 1000));
-				}
-			}
-		}
+		state_changes_ = re.StateChangesJustMade();
+		num_effect_string_lookups_ = RenderEffect::NumStringLookupsJustMade();
 	}
 
 	BoundOverlap SceneManager::VisibleTestFromParent(SceneObject* obj, float3 const & eye_pos, float4x4 const & view_proj)
@@ -810,7 +1831,7 @@ namespace KlayGE
 		BoundOverlap visible;
 		if (obj->Parent())
 		{
-			BoundOverlap parent_bo = obj->Parent()->VisibleMark();
+			BoundOverlap parent_bo = this->VisibleMark(obj->Parent());
 			if (BO_No == parent_bo)
 			{
 				visible = BO_No;
@@ -820,7 +1841,7 @@ namespace KlayGE
 				uint32_t const attr = obj->Attrib();
 				if (attr & SceneObject::SOA_Moveable)
 				{
-					obj->UpdateAbsModelMatrix();
+					obj->UpdateAbsModelMatrixNoRenderable();
 				}
 
 				if (attr & SceneObject::SOA_Cullable)
@@ -19,17 +19,25 @@
 #include <KlayGE/Context.hpp>
 #include <KFL/Math.hpp>
 #include <KlayGE/Renderable.hpp>
+#include <KlayGE/TransformHierarchy.hpp>
 
 #include <boost/assert.hpp>
 
 #include <KlayGE/SceneObject.hpp>
 
+namespace
+{
+	thread_local bool defer_updates = false;
+}
+
 namespace KlayGE
 {
 	SceneObject::SceneObject(uint32_t attrib)
 		: attrib_(attrib), parent_(nullptr), renderable_hw_res_ready_(false),
 			model_(float4x4::Identity()), abs_model_(float4x4::Identity()),
-			visible_mark_(BO_No)
+			scene_index_(static_cast<uint32_t>(-1)),
+			transforms_(nullptr), transform_node_(TransformHierarchy::INVALID_NODE),
+			model_dirty_(false), visible_dirty_(false), pending_visible_(true)
 	{
 		if (!(attrib & SOA_Overlay) && (attrib & (SOA_Cullable | SOA_Moveable)))
 		{
@@ -49,6 +57,12 @@ namespace KlayGE
 	void SceneObject::Parent(SceneObject* so)
 	{
 		parent_ = so;
+
+		if (transforms_)
+		{
+			transforms_->Parent(transform_node_, (so && (so->transforms_ == transforms_))
+				? so->transform_node_ : TransformHierarchy::INVALID_NODE);
+		}
 	}
 
 	uint32_t SceneObject::NumChildren() const
@@ -70,6 +84,18 @@ namespace KlayGE
 	void SceneObject::ModelMatrix(float4x4 const & mat)
 	{
 		model_ = mat;
+
+		if (transforms_)
+		{
+			if (defer_updates)
+			{
+				model_dirty_ = true;
+			}
+			else
+			{
+				transforms_->LocalMatrix(transform_node_, mat);
+			}
+		}
 	}
 
 	float4x4 const & SceneObject::ModelMatrix() const
@@ -79,7 +105,7 @@ namespace KlayGE
 
 	float4x4 const & SceneObject::AbsModelMatrix() const
 	{
-		return abs_model_;
+		return transforms_ ? transforms_->WorldMatrix(transform_node_) : abs_model_;
 	}
 
 	AABBox const & SceneObject::PosBoundWS() const
@@ -89,34 +115,85 @@ namespace KlayGE
 
 	void SceneObject::UpdateAbsModelMatrix()
 	{
-		if (parent_)
-		{
-			abs_model_ = parent_->ModelMatrix() * model_;
-		}
-		else
+		this->UpdateAbsModelMatrixNoRenderable();
+
+		if (renderable_)
 		{
-			abs_model_ = model_;
+			renderable_->ModelMatrix(this->AbsModelMatrix());
 		}
+	}
 
-		if (renderable_)
+	void SceneObject::UpdateAbsModelMatrixNoRenderable()
+	{
+		if (!transforms_)
 		{
-			if (pos_aabb_ws_)
+			if (parent_)
 			{
-				*pos_aabb_ws_ = MathLib::transform_aabb(renderable_->PosBound(), abs_model_);
+				abs_model_ = parent_->ModelMatrix() * model_;
 			}
+			else
+			{
+				abs_model_ = model_;
+			}
+		}
 
-			renderable_->ModelMatrix(abs_model_);
+		if (renderable_ && pos_aabb_ws_)
+		{
+			*pos_aabb_ws_ = MathLib::transform_aabb(renderable_->PosBound(), this->AbsModelMatrix());
 		}
 	}
 
-	void SceneObject::VisibleMark(BoundOverlap vm)
+	uint32_t SceneObject::SceneIndex() const
 	{
-		visible_mark_ = vm;
+		return scene_index_;
 	}
 
-	BoundOverlap SceneObject::VisibleMark() const
+	void SceneObject::SceneIndex(uint32_t index)
 	{
-		return visible_mark_;
+		scene_index_ = index;
+	}
+
+	void SceneObject::BindTransform(TransformHierarchy* transforms)
+	{
+		if (transforms_ == transforms)
+		{
+			return;
+		}
+
+		if (transforms_)
+		{
+			// Keeps the last absolute matrix, and detaches the children still in the hierarchy
+			abs_model_ = transforms_->WorldMatrix(transform_node_);
+			for (auto const & child : children_)
+			{
+				if (child->transforms_ == transforms_)
+				{
+					transforms_->Parent(child->transform_node_, TransformHierarchy::INVALID_NODE);
+				}
+			}
+			transforms_->DelNode(transform_node_);
+			transform_node_ = TransformHierarchy::INVALID_NODE;
+		}
+
+		transforms_ = transforms;
+
+		if (transforms_)
+		{
+			transform_node_ = transforms_->AddNode((parent_ && (parent_->transforms_ == transforms_))
+				? parent_->transform_node_ : TransformHierarchy::INVALID_NODE, model_);
+			for (auto const & child : children_)
+			{
+				if (child->transforms_ == transforms_)
+				{
+					transforms_->Parent(child->transform_node_, transform_node_);
+				}
+			}
+		}
+	}
+
+	uint32_t SceneObject::TransformNode() const
+	{
+		return transform_node_;
 	}
 
 	void SceneObject::BindSubThreadUpdateFunc(std::function<void(SceneObject&, float, float)> const & update_func)
@@ -156,40 +233,61 @@ namespace KlayGE
 		return refreshed;
 	}
 
-	void SceneObject::AddToSceneManager()
+	void SceneObject::DeferUpdates(bool defer)
 	{
-		Context::Instance().SceneManagerInstance().AddSceneObject(this->shared_from_this());
-		for (auto const & child : children_)
-		{
-			child->AddToSceneManager();
-		}
+		defer_updates = defer;
 	}
 
-	void SceneObject::AddToSceneManagerLocked()
+	void SceneObject::ApplyDeferredUpdates()
 	{
-		Context::Instance().SceneManagerInstance().AddSceneObjectLocked(this->shared_from_this());
+		if (model_dirty_)
+		{
+			if (transforms_)
+			{
+				transforms_->LocalMatrix(transform_node_, model_);
+			}
+			model_dirty_ = false;
+		}
+
+		// The pipelined children are published on their own
 		for (auto const & child : children_)
 		{
-			child->AddToSceneManagerLocked();
+			if (!(child->Attrib() & SOA_PipelinedUpdate))
+			{
+				child->ApplyDeferredUpdates();
+			}
+		}
+
+		if (visible_dirty_)
+		{
+			if (pending_visible_)
+			{
+				attrib_ &= ~SOA_Invisible;
+			}
+			else
+			{
+				attrib_ |= SOA_Invisible;
+			}
+			visible_dirty_ = false;
 		}
 	}
 
-	void SceneObject::DelFromSceneManager()
+	void SceneObject::AddToSceneManager()
 	{
+		Context::Instance().SceneManagerInstance().AddSceneObject(this->shared_from_this());
 		for (auto const & child : children_)
 		{
-			child->DelFromSceneManager();
+			child->AddToSceneManager();
 		}
-		Context::Instance().SceneManagerInstance().DelSceneObject(this->shared_from_this());
 	}
 
-	void SceneObject::DelFromSceneManagerLocked()
+	void SceneObject::DelFromSceneManager()
 	{
 		for (auto const & child : children_)
 		{
-			child->DelFromSceneManagerLocked();
+			child->DelFromSceneManager();
 		}
-		Context::Instance().SceneManagerInstance().DelSceneObjectLocked(this->shared_from_this());
+		Context::Instance().SceneManagerInstance().DelSceneObject(this->shared_from_this());
 	}
 
 	uint32_t SceneObject::Attrib() const
@@ -204,7 +302,12 @@ namespace KlayGE
 
 	void SceneObject::Visible(bool vis)
 	{
-		if (vis)
+		if (defer_updates)
+		{
+			visible_dirty_ = true;
+			pending_visible_ = vis;
+		}
+		else if (vis)
 		{
 			attrib_ &= ~SOA_Invisible;
 		}
@@ -219,6 +322,24 @@ namespace KlayGE
 		}
 	}
 
+	void SceneObject::OccluderMesh(std::vector<float3> const & positions, std::vector<uint32_t> const & indices)
+	{
+		BOOST_ASSERT(indices.size() % 3 == 0);
+
+		occluder_positions_ = positions;
+		occluder_indices_ = indices;
+	}
+
+	std::vector<float3> const & SceneObject::OccluderPositions() const
+	{
+		return occluder_positions_;
+	}
+
+	std::vector<uint32_t> const & SceneObject::OccluderIndices() const
+	{
+		return occluder_indices_;
+	}
+
 	vertex_elements_type const & SceneObject::InstanceFormat() const
 	{
 		return instance_format_;
@@ -333,7 +454,7 @@ namespace KlayGE
 	{
 		if (add_to_scene)
 		{
-			this->AddToSceneManagerLocked();
+			this->AddToSceneManager();
 		}
 	}
 }
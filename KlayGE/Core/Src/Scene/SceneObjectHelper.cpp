@@ -66,7 +66,7 @@ namespace KlayGE
 
 				if (add_to_scene)
 				{
-					child->AddToSceneManagerLocked();
+					child->AddToSceneManager();
 				}
 			}
 		}
@@ -117,12 +117,13 @@ namespace KlayGE
 
 	bool SceneObjectLightSourceProxy::MainThreadUpdate(float /*app_time*/, float /*elapsed_time*/)
 	{
-		model_ = model_scaling_ * MathLib::to_matrix(light_->Rotation()) * MathLib::translation(light_->Position());
+		float4x4 model = model_scaling_ * MathLib::to_matrix(light_->Rotation()) * MathLib::translation(light_->Position());
 		if (LightSource::LT_Spot == light_->Type())
 		{
 			float radius = light_->CosOuterInner().w();
-			model_ = MathLib::scaling(radius, radius, 1.0f) * model_;
+			model = MathLib::scaling(radius, radius, 1.0f) * model;
 		}
+		this->ModelMatrix(model);
 
 		RenderModelPtr light_model = checked_pointer_cast<RenderModel>(renderable_);
 		for (uint32_t i = 0; i < light_model->NumSubrenderables(); ++ i)
@@ -222,7 +223,7 @@ namespace KlayGE
 
 	void SceneObjectCameraProxy::SubThreadUpdate(float /*app_time*/, float /*elapsed_time*/)
 	{
-		model_ = model_scaling_ * camera_->InverseViewMatrix();
+		this->ModelMatrix(model_scaling_ * camera_->InverseViewMatrix());
 	}
 
 	void SceneObjectCameraProxy::Scaling(float x, float y, float z)
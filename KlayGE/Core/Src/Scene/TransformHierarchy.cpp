@@ -0,0 +1,363 @@
+/**
+ * @file TransformHierarchy.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/SIMDBatch.hpp>
+#include <KFL/Thread.hpp>
+
+#include <algorithm>
+
+#include <KlayGE/TransformHierarchy.hpp>
+
+namespace
+{
+	// Number of nodes updated by one task
+	size_t const UPDATE_TILE_SIZE = 1024;
+}
+
+namespace KlayGE
+{
+	uint32_t const TransformHierarchy::INVALID_NODE;
+
+	TransformHierarchy::TransformHierarchy()
+		: num_nodes_(0), layout_dirty_(false), any_dirty_(false), any_changed_(false)
+	{
+		level_starts_.push_back(0);
+	}
+
+	uint32_t TransformHierarchy::AddNode(uint32_t parent, float4x4 const & local)
+	{
+		uint32_t node;
+		if (free_nodes_.empty())
+		{
+			node = static_cast<uint32_t>(node_slots_.size());
+			node_slots_.push_back(INVALID_NODE);
+			node_parents_.push_back(INVALID_NODE);
+		}
+		else
+		{
+			node = free_nodes_.back();
+			free_nodes_.pop_back();
+		}
+
+		// Appended out of order, sorted into its level at the next update
+		uint32_t const slot = static_cast<uint32_t>(local_.size());
+		uint32_t const parent_slot = (parent != INVALID_NODE) ? node_slots_[parent] : INVALID_NODE;
+		float4x4 const world = (parent_slot != INVALID_NODE) ? world_[parent_slot] * local : local;
+		local_.push_back(local);
+		world_.push_back(world);
+		parent_slots_.push_back(parent_slot);
+		slot_nodes_.push_back(node);
+		dirty_.push_back(0);
+		changed_.push_back(0);
+
+		node_slots_[node] = slot;
+		node_parents_[node] = parent;
+		++ num_nodes_;
+		layout_dirty_ = true;
+
+		return node;
+	}
+
+	void TransformHierarchy::DelNode(uint32_t node)
+	{
+		BOOST_ASSERT(node_slots_[node] != INVALID_NODE);
+
+		slot_nodes_[node_slots_[node]] = INVALID_NODE;
+		node_slots_[node] = INVALID_NODE;
+		node_parents_[node] = INVALID_NODE;
+		free_nodes_.push_back(node);
+		-- num_nodes_;
+		layout_dirty_ = true;
+	}
+
+	void TransformHierarchy::Clear()
+	{
+		node_slots_.clear();
+		node_parents_.clear();
+		free_nodes_.clear();
+		num_nodes_ = 0;
+
+		local_.clear();
+		world_.clear();
+		parent_slots_.clear();
+		slot_nodes_.clear();
+		dirty_.clear();
+		changed_.clear();
+
+		level_starts_.assign(1, 0);
+
+		layout_dirty_ = false;
+		any_dirty_ = false;
+		any_changed_ = false;
+	}
+
+	uint32_t TransformHierarchy::NumNodes() const
+	{
+		return num_nodes_;
+	}
+
+	uint32_t TransformHierarchy::Parent(uint32_t node) const
+	{
+		return node_parents_[node];
+	}
+
+	void TransformHierarchy::Parent(uint32_t node, uint32_t parent)
+	{
+		BOOST_ASSERT(node != parent);
+
+		uint32_t const slot = node_slots_[node];
+		node_parents_[node] = parent;
+		parent_slots_[slot] = (parent != INVALID_NODE) ? node_slots_[parent] : INVALID_NODE;
+		dirty_[slot] = 1;
+		any_dirty_ = true;
+		layout_dirty_ = true;
+	}
+
+	float4x4 const & TransformHierarchy::LocalMatrix(uint32_t node) const
+	{
+		return local_[node_slots_[node]];
+	}
+
+	void TransformHierarchy::LocalMatrix(uint32_t node, float4x4 const & mat)
+	{
+		uint32_t const slot = node_slots_[node];
+		local_[slot] = mat;
+		dirty_[slot] = 1;
+		if (!any_dirty_.load(std::memory_order_relaxed))
+		{
+			any_dirty_.store(true, std::memory_order_relaxed);
+		}
+	}
+
+	float4x4 const & TransformHierarchy::WorldMatrix(uint32_t node) const
+	{
+		return world_[node_slots_[node]];
+	}
+
+	bool TransformHierarchy::WorldChanged(uint32_t node) const
+	{
+		return changed_[node_slots_[node]] != 0;
+	}
+
+	bool TransformHierarchy::Update()
+	{
+		if (!this->BeginUpdate())
+		{
+			return false;
+		}
+
+		for (size_t level = 0; level + 1 < level_starts_.size(); ++ level)
+		{
+			this->UpdateSlots(level_starts_[level], level_starts_[level + 1], 0 == level);
+		}
+
+		any_dirty_ = false;
+		any_changed_ = true;
+		return true;
+	}
+
+	bool TransformHierarchy::Update(thread_pool& tp)
+	{
+		if (!this->BeginUpdate())
+		{
+			return false;
+		}
+
+		// A level only reads the world matrices of the level above, so the nodes in it are independent
+		for (size_t level = 0; level + 1 < level_starts_.size(); ++ level)
+		{
+			size_t const begin = level_starts_[level];
+			bool const root = (0 == level);
+			parallel_for_tiles(tp, level_starts_[level + 1] - begin, UPDATE_TILE_SIZE,
+				[this, begin, root](size_t tile_begin, size_t tile_end)
+				{
+					this->UpdateSlots(begin + tile_begin, begin + tile_end, root);
+				});
+		}
+
+		any_dirty_ = false;
+		any_changed_ = true;
+		return true;
+	}
+
+	void TransformHierarchy::Relayout()
+	{
+		uint32_t const num_handles = static_cast<uint32_t>(node_slots_.size());
+
+		// Depths of the nodes, walking up until a known one
+		std::vector<uint32_t> depths(num_handles, INVALID_NODE);
+		std::vector<uint32_t> chain;
+		uint32_t max_depth = 0;
+		for (uint32_t node = 0; node < num_handles; ++ node)
+		{
+			if ((node_slots_[node] == INVALID_NODE) || (depths[node] != INVALID_NODE))
+			{
+				continue;
+			}
+
+			chain.clear();
+			uint32_t n = node;
+			while ((n != INVALID_NODE) && (depths[n] == INVALID_NODE))
+			{
+				chain.push_back(n);
+				n = node_parents_[n];
+			}
+			uint32_t depth = (n != INVALID_NODE) ? depths[n] + 1 : 0;
+			for (auto iter = chain.rbegin(); iter != chain.rend(); ++ iter, ++ depth)
+			{
+				depths[*iter] = depth;
+			}
+			max_depth = std::max(max_depth, depth - 1);
+		}
+
+		std::vector<std::vector<uint32_t>> levels(num_nodes_ > 0 ? max_depth + 1 : 0);
+		for (uint32_t node = 0; node < num_handles; ++ node)
+		{
+			if (node_slots_[node] != INVALID_NODE)
+			{
+				levels[depths[node]].push_back(node);
+			}
+		}
+
+		// New slots level by level. The children are ordered by the slots of their parents, so the siblings
+		// are adjacent, and the dirty subtrees become runs.
+		std::vector<uint32_t> new_slots(num_handles, INVALID_NODE);
+		uint32_t slot = 0;
+		level_starts_.assign(1, 0);
+		for (size_t d = 0; d < levels.size(); ++ d)
+		{
+			auto& level = levels[d];
+			if (d > 0)
+			{
+				std::stable_sort(level.begin(), level.end(),
+					[this, &new_slots](uint32_t lhs, uint32_t rhs)
+					{
+						return new_slots[node_parents_[lhs]] < new_slots[node_parents_[rhs]];
+					});
+			}
+			for (auto node : level)
+			{
+				new_slots[node] = slot;
+				++ slot;
+			}
+			level_starts_.push_back(slot);
+		}
+
+		std::vector<float4x4> local(num_nodes_);
+		std::vector<float4x4> world(num_nodes_);
+		std::vector<uint32_t> parent_slots(num_nodes_);
+		std::vector<uint32_t> slot_nodes(num_nodes_);
+		std::vector<uint8_t> dirty(num_nodes_);
+		std::vector<uint8_t> changed(num_nodes_);
+		for (uint32_t node = 0; node < num_handles; ++ node)
+		{
+			uint32_t const old_slot = node_slots_[node];
+			if (old_slot != INVALID_NODE)
+			{
+				uint32_t const new_slot = new_slots[node];
+				uint32_t const parent = node_parents_[node];
+				local[new_slot] = local_[old_slot];
+				world[new_slot] = world_[old_slot];
+				parent_slots[new_slot] = (parent != INVALID_NODE) ? new_slots[parent] : INVALID_NODE;
+				slot_nodes[new_slot] = node;
+				dirty[new_slot] = dirty_[old_slot];
+				changed[new_slot] = changed_[old_slot];
+			}
+		}
+
+		local_.swap(local);
+		world_.swap(world);
+		parent_slots_.swap(parent_slots);
+		slot_nodes_.swap(slot_nodes);
+		dirty_.swap(dirty);
+		changed_.swap(changed);
+		node_slots_.swap(new_slots);
+
+		layout_dirty_ = false;
+	}
+
+	bool TransformHierarchy::BeginUpdate()
+	{
+		if (layout_dirty_)
+		{
+			this->Relayout();
+		}
+
+		if (!any_dirty_)
+		{
+			if (any_changed_)
+			{
+				std::fill(changed_.begin(), changed_.end(), static_cast<uint8_t>(0));
+				any_changed_ = false;
+			}
+			return false;
+		}
+
+		return true;
+	}
+
+	void TransformHierarchy::UpdateSlots(size_t begin, size_t end, bool root)
+	{
+		for (size_t i = begin; i < end; ++ i)
+		{
+			changed_[i] = dirty_[i] | (root ? 0 : changed_[parent_slots_[i]]);
+			dirty_[i] = 0;
+		}
+
+		for (size_t i = begin; i < end;)
+		{
+			if (changed_[i])
+			{
+				size_t j = i + 1;
+				while ((j < end) && changed_[j])
+				{
+					++ j;
+				}
+
+				if (root)
+				{
+					std::copy(local_.begin() + i, local_.begin() + j, world_.begin() + i);
+				}
+				else
+				{
+					SIMDBatchLib::MultiplyMatrices(&world_[i], &world_[0], &parent_slots_[i], &local_[i], j - i);
+				}
+
+				i = j;
+			}
+			else
+			{
+				++ i;
+			}
+		}
+	}
+}
@@ -36,6 +36,7 @@
 #undef Bool		// for boost::foreach
 #endif
 
+#include <algorithm>
 #include <cstring>
 #include <fstream>
 
@@ -82,8 +83,20 @@ namespace KlayGE
 	std::unique_ptr<UIManager> UIManager::ui_mgr_instance_;
 
 
+	// The quads of one texture are appended to contiguous vertex and index arenas on the CPU. Each frame they are
+	// uploaded with one allocation per buffer and drawn with one draw call, or one per 0xFFFF vertices. The arenas
+	// keep their capacity from frame to frame, so adding a quad doesn't allocate.
 	class UIRectRenderable : public RenderableHelper
 	{
+		// The indices of a batch are relative to its first vertex. 0xFFFF is reserved for primitive restart.
+		static uint32_t const MAX_BATCH_VERTICES = 0xFFFF / 4 * 4;
+
+		struct Batch
+		{
+			uint32_t first_vertex;
+			uint32_t first_index;
+		};
+
 	public:
 		UIRectRenderable(TexturePtr const & texture, RenderEffectPtr const & effect)
 			: RenderableHelper(L"UIRect"),
@@ -107,6 +120,8 @@ namespace KlayGE
 			uint32_t const INIT_NUM_QUAD = 1024;
 			tb_vb_ = MakeSharedPtr<TransientBuffer>(static_cast<uint32_t>(INIT_NUM_QUAD * 4 * sizeof(UIManager::VertexFormat)), TransientBuffer::BF_Vertex);
 			tb_ib_ = MakeSharedPtr<TransientBuffer>(static_cast<uint32_t>(INIT_NUM_QUAD * INDEX_PER_QUAD * sizeof(uint16_t)), TransientBuffer::BF_Index);
+			vertices_.reserve(INIT_NUM_QUAD * 4);
+			indices_.reserve(INIT_NUM_QUAD * INDEX_PER_QUAD);
 
 			rl_->BindVertexStream(tb_vb_->GetBuffer(), std::make_tuple(vertex_element(VEU_Position, 0, EF_BGR32F),
 												vertex_element(VEU_Diffuse, 0, EF_ABGR32F),
@@ -129,7 +144,7 @@ namespace KlayGE
 
 		bool Empty() const
 		{
-			return tb_ib_sub_allocs_.empty();
+			return indices_.empty();
 		}
 
 		void OnRenderBegin()
@@ -144,6 +159,9 @@ namespace KlayGE
 
 			*half_width_height_ep_ = float2(half_width, half_height);
 
+			vb_alloc_ = tb_vb_->Alloc(static_cast<uint32_t>(vertices_.size() * sizeof(vertices_[0])), &vertices_[0]);
+			ib_alloc_ = tb_ib_->Alloc(static_cast<uint32_t>(indices_.size() * sizeof(indices_[0])), &indices_[0]);
+
 			tb_vb_->EnsureDataReady();
 			tb_ib_->EnsureDataReady();
 
@@ -153,11 +171,15 @@ namespace KlayGE
 		
 		void OnRenderEnd()
 		{
+			tb_vb_->Dealloc(vb_alloc_);
+			tb_ib_->Dealloc(ib_alloc_);
+
 			tb_vb_->OnPresent();
 			tb_ib_->OnPresent();
 
-			tb_vb_sub_allocs_.clear();
-			tb_ib_sub_allocs_.clear();
+			vertices_.clear();
+			indices_.clear();
+			batches_.clear();
 		}
 
 		void Render()
@@ -166,64 +188,61 @@ namespace KlayGE
 
 			this->OnRenderBegin();
 
-			BOOST_ASSERT(tb_vb_sub_allocs_.size() == tb_ib_sub_allocs_.size());
-
-			for (size_t i = 0; i < tb_vb_sub_allocs_.size(); ++ i)
+			BOOST_ASSERT(vb_alloc_.offset_ % sizeof(UIManager::VertexFormat) == 0);
+			uint32_t const base_vertex = static_cast<uint32_t>(vb_alloc_.offset_ / sizeof(UIManager::VertexFormat));
+			uint32_t const base_index = static_cast<uint32_t>(ib_alloc_.offset_ / sizeof(uint16_t));
+			for (size_t i = 0; i < batches_.size(); ++ i)
 			{
-				uint32_t vert_length = tb_vb_sub_allocs_[i].length_;
-				uint32_t const ind_offset = tb_ib_sub_allocs_[i].offset_;
-				uint32_t ind_length = tb_ib_sub_allocs_[i].length_;
-
-				while ((i + 1 < tb_vb_sub_allocs_.size())
-					&& (tb_vb_sub_allocs_[i].offset_ + tb_vb_sub_allocs_[i].length_ == tb_vb_sub_allocs_[i + 1].offset_)
-					&& (tb_ib_sub_allocs_[i].offset_ + tb_ib_sub_allocs_[i].length_ == tb_ib_sub_allocs_[i + 1].offset_))
-				{
-					vert_length += tb_vb_sub_allocs_[i + 1].length_;
-					ind_length += tb_ib_sub_allocs_[i + 1].length_;
-					++ i;
-				}
+				uint32_t const end_vertex = (i + 1 < batches_.size())
+					? batches_[i + 1].first_vertex : static_cast<uint32_t>(vertices_.size());
+				uint32_t const end_index = (i + 1 < batches_.size())
+					? batches_[i + 1].first_index : static_cast<uint32_t>(indices_.size());
 
-				rl_->NumVertices(vert_length / sizeof(UIManager::VertexFormat));
-				rl_->StartIndexLocation(ind_offset / sizeof(uint16_t));
-				rl_->NumIndices(ind_length / sizeof(uint16_t));
+				rl_->StartVertexLocation(base_vertex + batches_[i].first_vertex);
+				rl_->NumVertices(end_vertex - batches_[i].first_vertex);
+				rl_->StartIndexLocation(base_index + batches_[i].first_index);
+				rl_->NumIndices(end_index - batches_[i].first_index);
 
 				re.Render(*this->GetRenderEffect(), *this->GetRenderTechnique(), *rl_);
 			}
 
-			for (size_t i = 0; i < tb_vb_sub_allocs_.size(); ++ i)
-			{
-				tb_vb_->Dealloc(tb_vb_sub_allocs_[i]);
-				tb_ib_->Dealloc(tb_ib_sub_allocs_[i]);
-			}
-
 			this->OnRenderEnd();
 		}
 
-		void AddQuad(std::vector<UIManager::VertexFormat> const & vertices)
+		// Returns the 4 vertices of a new quad to be filled in place
+		UIManager::VertexFormat* AddQuad()
 		{
-			tb_vb_sub_allocs_.push_back(tb_vb_->Alloc(static_cast<uint32_t>(vertices.size() * sizeof(vertices[0])), &vertices[0]));
-			
-			uint16_t const last_index = static_cast<uint16_t>(tb_vb_sub_allocs_.back().offset_ / sizeof(UIManager::VertexFormat));
-			std::vector<uint16_t> indices;
-			indices.resize(restart_ ? 5 : 6);
-			indices[0] = last_index + 0;
-			indices[1] = last_index + 1;
+			uint32_t const first_vertex = static_cast<uint32_t>(vertices_.size());
+			if (batches_.empty() || (first_vertex - batches_.back().first_vertex + 4 > MAX_BATCH_VERTICES))
+			{
+				batches_.push_back(Batch{ first_vertex, static_cast<uint32_t>(indices_.size()) });
+			}
+
+			uint16_t const last_index = static_cast<uint16_t>(first_vertex - batches_.back().first_vertex);
 			if (restart_)
 			{
-				indices[2] = last_index + 3;
-				indices[3] = last_index + 2;
-				indices[4] = 0xFFFF;
+				uint16_t const quad_indices[] = { static_cast<uint16_t>(last_index + 0), static_cast<uint16_t>(last_index + 1),
+					static_cast<uint16_t>(last_index + 3), static_cast<uint16_t>(last_index + 2), 0xFFFF };
+				indices_.insert(indices_.end(), std::begin(quad_indices), std::end(quad_indices));
 			}
 			else
 			{
-				indices[2] = last_index + 2;
-				indices[3] = last_index + 2;
-				indices[4] = last_index + 3;
-				indices[5] = last_index + 0;
+				uint16_t const quad_indices[] = { static_cast<uint16_t>(last_index + 0), static_cast<uint16_t>(last_index + 1),
+					static_cast<uint16_t>(last_index + 2), static_cast<uint16_t>(last_index + 2),
+					static_cast<uint16_t>(last_index + 3), static_cast<uint16_t>(last_index + 0) };
+				indices_.insert(indices_.end(), std::begin(quad_indices), std::end(quad_indices));
 			}
-			BOOST_ASSERT(last_index + 3 <= 0xFFFF);
 
-			tb_ib_sub_allocs_.push_back(tb_ib_->Alloc(static_cast<uint32_t>(indices.size() * sizeof(indices[0])), &indices[0]));
+			vertices_.resize(vertices_.size() + 4);
+			return &vertices_[first_vertex];
+		}
+
+		void AddQuads(UIManager::VertexFormat const * vertices, uint32_t num_quads)
+		{
+			for (uint32_t i = 0; i < num_quads; ++ i)
+			{
+				std::copy(vertices + i * 4, vertices + i * 4 + 4, this->AddQuad());
+			}
 		}
 
 	private:
@@ -236,8 +255,12 @@ namespace KlayGE
 
 		TransientBufferPtr tb_vb_;
 		TransientBufferPtr tb_ib_;
-		std::vector<SubAlloc> tb_vb_sub_allocs_;
-		std::vector<SubAlloc> tb_ib_sub_allocs_;
+		SubAlloc vb_alloc_;
+		SubAlloc ib_alloc_;
+
+		std::vector<UIManager::VertexFormat> vertices_;
+		std::vector<uint16_t> indices_;
+		std::vector<Batch> batches_;
 	};
 
 
@@ -293,7 +316,8 @@ namespace KlayGE
 
 
 	UIManager::UIManager()
-		: mouse_on_ui_(false),
+		: recording_cache_(nullptr),
+			mouse_on_ui_(false),
 			inited_(false)
 	{
 	}
@@ -921,10 +945,8 @@ namespace KlayGE
 
 	void UIManager::Render()
 	{
-		for (auto& str : strings_)
-		{
-			str.second.clear();
-		}
+		strings_.clear();
+		drawn_caches_.clear();
 
 		for (auto const & dialog : dialogs_)
 		{
@@ -940,13 +962,20 @@ namespace KlayGE
 				ui_rect_obj->AddToSceneManager();
 			}
 		}
-		for (auto const & str : strings_)
+		for (auto const & cache : drawn_caches_)
+		{
+			this->RenderStrings(cache->strings);
+		}
+		this->RenderStrings(strings_);
+	}
+
+	void UIManager::RenderStrings(std::vector<std::pair<uint32_t, string_cache>> const & strings)
+	{
+		for (auto const & str : strings)
 		{
 			auto const & font = font_cache_[str.first];
-			for (auto const & s : str.second)
-			{
-				font.first->RenderText(s.rc, s.depth, 1, 1, s.clr, s.text, font.second, s.align);
-			}
+			string_cache const & s = str.second;
+			font.first->RenderText(s.rc, s.depth, 1, 1, s.clr, s.text, font.second, s.align);
 		}
 	}
 
@@ -966,19 +995,7 @@ namespace KlayGE
 			texcoord = Rect(0, 0, 0, 0);
 		}
 
-		std::shared_ptr<UIRectRenderable> renderable;
-		if (rects_.find(texture) == rects_.end())
-		{
-			renderable = MakeSharedPtr<UIRectRenderable>(texture, effect_);
-			rects_[texture] = renderable;
-		}
-		else
-		{
-			renderable = checked_pointer_cast<UIRectRenderable>(rects_[texture]);
-		}
-		BOOST_ASSERT(renderable);
-
-		std::vector<VertexFormat> vertices(4);
+		VertexFormat* vertices = this->AddQuad(texture);
 		vertices[0] = VertexFormat(pos + float3(0, 0, 0),
 			clrs[0], float2(texcoord.left(), texcoord.top()));
 		vertices[1] = VertexFormat(pos + float3(width, 0, 0),
@@ -987,42 +1004,60 @@ namespace KlayGE
 			clrs[2], float2(texcoord.right(), texcoord.bottom()));
 		vertices[3] = VertexFormat(pos + float3(0, height, 0),
 			clrs[3], float2(texcoord.left(), texcoord.bottom()));
-
-		renderable->AddQuad(vertices);
 	}
 
 	void UIManager::DrawQuad(float3 const & offset, VertexFormat const * vertices, TexturePtr const & texture)
 	{
-		std::shared_ptr<UIRectRenderable> renderable;
-		if (rects_.find(texture) == rects_.end())
+		VertexFormat* verts = this->AddQuad(texture);
+		for (int i = 0; i < 4; ++ i)
 		{
-			renderable = MakeSharedPtr<UIRectRenderable>(texture, effect_);
-			rects_[texture] = renderable;
+			verts[i] = VertexFormat(offset + vertices[i].pos, vertices[i].clr, vertices[i].tex);
 		}
-		else
+	}
+
+	UIRectRenderable& UIManager::RectRenderable(TexturePtr const & texture)
+	{
+		auto iter = rects_.find(texture);
+		if (iter == rects_.end())
 		{
-			renderable = checked_pointer_cast<UIRectRenderable>(rects_[texture]);
+			iter = rects_.emplace(texture, MakeSharedPtr<UIRectRenderable>(texture, effect_)).first;
 		}
-		BOOST_ASSERT(renderable);
+		return *checked_cast<UIRectRenderable*>(iter->second.get());
+	}
 
-		std::vector<VertexFormat> verts(4);
-		verts[0] = VertexFormat(offset + vertices[0].pos,
-			vertices[0].clr, vertices[0].tex);
-		verts[1] = VertexFormat(offset + vertices[1].pos,
-			vertices[1].clr, vertices[1].tex);
-		verts[2] = VertexFormat(offset + vertices[2].pos,
-			vertices[2].clr, vertices[2].tex);
-		verts[3] = VertexFormat(offset + vertices[3].pos,
-			vertices[3].clr, vertices[3].tex);
+	UIManager::VertexFormat* UIManager::AddQuad(TexturePtr const & texture)
+	{
+		UIRectRenderable& renderable = this->RectRenderable(texture);
+		if (recording_cache_)
+		{
+			auto& quads = recording_cache_->quads;
+			auto iter = std::find_if(quads.begin(), quads.end(),
+				[&renderable](std::pair<UIRectRenderable*, std::vector<VertexFormat>> const & q)
+				{
+					return q.first == &renderable;
+				});
+			if (iter == quads.end())
+			{
+				quads.emplace_back(&renderable, std::vector<VertexFormat>());
+				iter = quads.end() - 1;
+			}
 
-		renderable->AddQuad(verts);
+			size_t const first_vertex = iter->second.size();
+			iter->second.resize(first_vertex + 4);
+			return &iter->second[first_vertex];
+		}
+		else
+		{
+			return renderable.AddQuad();
+		}
 	}
 
 	void UIManager::DrawString(std::wstring const & strText, uint32_t font_index,
 		IRect const & rc, float depth, Color const & clr, uint32_t align)
 	{
-		strings_[font_index].push_back(string_cache());
-		string_cache& sc = strings_[font_index].back();
+		auto& strings = recording_cache_ ? recording_cache_->strings : strings_;
+		strings.emplace_back(font_index, string_cache());
+		string_cache& sc = strings.back().second;
 		sc.rc = rc;
 		sc.depth = depth;
 		sc.clr = clr;
@@ -1030,6 +1065,41 @@ namespace KlayGE
 		sc.align = align;
 	}
 
+	void UIManager::BeginCache(RenderCache& cache)
+	{
+		BOOST_ASSERT(!recording_cache_);
+
+		// Keep the per-texture vectors, so recording again doesn't allocate
+		for (auto& quad : cache.quads)
+		{
+			quad.second.clear();
+		}
+		cache.strings.clear();
+
+		recording_cache_ = &cache;
+	}
+
+	void UIManager::EndCache()
+	{
+		BOOST_ASSERT(recording_cache_);
+		recording_cache_ = nullptr;
+	}
+
+	void UIManager::DrawCache(RenderCache const & cache)
+	{
+		for (auto const & quad : cache.quads)
+		{
+			if (!quad.second.empty())
+			{
+				quad.first->AddQuads(&quad.second[0], static_cast<uint32_t>(quad.second.size() / 4));
+			}
+		}
+		if (!cache.strings.empty())
+		{
+			drawn_caches_.push_back(&cache);
+		}
+	}
+
 	Size_T<float> UIManager::CalcSize(std::wstring const & strText, uint32_t font_index,
 		IRect const & /*rc*/, uint32_t /*align*/)
 	{
@@ -1218,7 +1288,8 @@ namespace KlayGE
 					caption_height_(18),
 					top_left_clr_(0, 0, 0, 0), top_right_clr_(0, 0, 0, 0),
 					bottom_left_clr_(0, 0, 0, 0), bottom_right_clr_(0, 0, 0, 0),
-					opacity_(0.5f)
+					opacity_(0.5f),
+					dirty_(true)
 	{
 		TexturePtr ct;
 		if (control_tex)
@@ -1245,6 +1316,7 @@ namespace KlayGE
 
 		// Add to the list
 		controls_.push_back(control);
+		dirty_ = true;
 	}
 
 	void UIDialog::InitControl(UIControl& control)
@@ -1338,8 +1410,61 @@ namespace KlayGE
 			return;
 		}
 
-		depth_base_ = 0.5f;
+		UIManager& mgr = UIManager::Instance();
 
+		bool layout_dirty = dirty_;
+		for (auto const & control : controls_)
+		{
+			layout_dirty |= control->Dirty();
+		}
+
+		// The location and opacity of the dialog are in the geometry of all controls
+		if (dirty_)
+		{
+			for (auto const & control : controls_)
+			{
+				control->Dirty(true);
+			}
+			control_caches_.resize(controls_.size());
+
+			depth_base_ = 0.5f;
+			mgr.BeginCache(cache_);
+			this->RenderCaption();
+			mgr.EndCache();
+
+			dirty_ = false;
+		}
+		mgr.DrawCache(cache_);
+
+		// If the dialog is minimized, skip rendering
+		// its controls.
+		if (!minimized_)
+		{
+			if (layout_dirty)
+			{
+				this->UpdateRenderOrder();
+			}
+
+			BOOST_ASSERT(control_caches_.size() == controls_.size());
+			for (auto const & order : render_order_)
+			{
+				UIControl& control = *controls_[order.first];
+				UIManager::RenderCache& cache = control_caches_[order.first];
+				if (control.Dirty() || control.Animating())
+				{
+					depth_base_ = order.second;
+					mgr.BeginCache(cache);
+					control.Render();
+					mgr.EndCache();
+					control.Dirty(false);
+				}
+				mgr.DrawCache(cache);
+			}
+		}
+	}
+
+	void UIDialog::RenderCaption()
+	{
 		bool bBackgroundIsVisible = (top_left_clr_.a() != 0) || (top_right_clr_.a() != 0)
 			|| (bottom_right_clr_.a() != 0) || (bottom_left_clr_.a() != 0);
 		if (!minimized_ && bBackgroundIsVisible)
@@ -1406,68 +1531,86 @@ namespace KlayGE
 
 			this->DrawString(wstrOutput, cap_element_, rc, true);
 		}
+	}
 
-		// If the dialog is minimized, skip rendering
-		// its controls.
-		if (!minimized_)
+	void UIDialog::UpdateRenderOrder()
+	{
+		std::vector<float> old_depth_bases(controls_.size(), -1.0f);
+		for (auto const & order : render_order_)
+		{
+			if (order.first < controls_.size())
+			{
+				old_depth_bases[order.first] = order.second;
+			}
+		}
+		render_order_.clear();
+
+		std::vector<std::vector<size_t>> intersected_groups;
+		for (size_t i = 0; i < controls_.size(); ++ i)
 		{
-			std::vector<std::vector<size_t>> intersected_groups;
-			for (size_t i = 0; i < controls_.size(); ++ i)
+			for (size_t j = 0; j < i; ++ j)
 			{
-				for (size_t j = 0; j < i; ++ j)
+				IRect rc = controls_[i]->BoundingBoxRect() & controls_[j]->BoundingBoxRect();
+				if ((rc.Width() > 0) && (rc.Height() > 0))
 				{
-					IRect rc = controls_[i]->BoundingBoxRect() & controls_[j]->BoundingBoxRect();
-					if ((rc.Width() > 0) && (rc.Height() > 0))
+					size_t k = 0;
+					while (k < intersected_groups.size())
 					{
-						size_t k = 0;
-						while (k < intersected_groups.size())
+						if (std::find(intersected_groups[k].begin(), intersected_groups[k].end(),
+							i) != intersected_groups[k].end())
 						{
-							if (std::find(intersected_groups[k].begin(), intersected_groups[k].end(),
-								i) != intersected_groups[k].end())
-							{
-								intersected_groups[k].push_back(i);
-								break;
-							}
-
-							++ k;
+							intersected_groups[k].push_back(i);
+							break;
 						}
 
-						if (k == intersected_groups.size())
-						{
-							intersected_groups.push_back(std::vector<size_t>());
-							intersected_groups.back().push_back(j);
-							intersected_groups.back().push_back(i);
-						}
+						++ k;
+					}
 
-						break;
+					if (k == intersected_groups.size())
+					{
+						intersected_groups.push_back(std::vector<size_t>());
+						intersected_groups.back().push_back(j);
+						intersected_groups.back().push_back(i);
 					}
+
+					break;
 				}
 			}
+		}
 
-			std::vector<size_t> intersected_controls;
-			for (size_t i = 0; i < intersected_groups.size(); ++ i)
+		std::vector<size_t> intersected_controls;
+		for (size_t i = 0; i < intersected_groups.size(); ++ i)
+		{
+			intersected_controls.insert(intersected_controls.end(), intersected_groups[i].begin(), intersected_groups[i].end());
+		}
+		std::sort(intersected_controls.begin(), intersected_controls.end());
+
+		for (size_t i = 0; i < controls_.size(); ++ i)
+		{
+			auto iter = std::lower_bound(intersected_controls.begin(), intersected_controls.end(), i);
+			if ((iter == intersected_controls.end()) || (*iter != i))
 			{
-				intersected_controls.insert(intersected_controls.end(), intersected_groups[i].begin(), intersected_groups[i].end());
+				render_order_.emplace_back(i, 0.5f);
 			}
-			std::sort(intersected_controls.begin(), intersected_controls.end());
+		}
 
-			for (size_t i = 0; i < controls_.size(); ++ i)
+		// The overlapped controls are layered by depth
+		for (size_t i = 0; i < intersected_groups.size(); ++ i)
+		{
+			float depth_base = 0.5f;
+			for (size_t j = 0; j < intersected_groups[i].size(); ++ j)
 			{
-				auto iter = std::lower_bound(intersected_controls.begin(), intersected_controls.end(), i);
-				if ((iter == intersected_controls.end()) || (*iter != i))
-				{
-					controls_[i]->Render();
-				}
+				render_order_.emplace_back(intersected_groups[i][j], depth_base);
+				depth_base -= 0.05f;
 			}
+		}
 
-			for (size_t i = 0; i < intersected_groups.size(); ++ i)
+		// The depth is in the cached geometry
+		for (auto const & order : render_order_)
+		{
+			if (old_depth_bases[order.first] != order.second)
 			{
-				depth_base_ = 0.5f;
-				for (size_t j = 0; j < intersected_groups[i].size(); ++ j)
-				{
-					controls_[intersected_groups[i][j]]->Render();
-					depth_base_ -= 0.05f;
-				}
+				controls_[order.first]->Dirty(true);
 			}
 		}
 	}
@@ -1498,6 +1641,7 @@ namespace KlayGE
 		top_right_clr_ = colorTopRight;
 		bottom_left_clr_ = colorBottomLeft;
 		bottom_right_clr_ = colorBottomRight;
+		dirty_ = true;
 	}
 
 	bool UIDialog::ContainsPoint(int2 const & pt) const
@@ -1614,6 +1758,7 @@ namespace KlayGE
 				}
 
 				controls_.erase(controls_.begin() + i);
+				dirty_ = true;
 
 				return;
 			}
@@ -1629,6 +1774,7 @@ namespace KlayGE
 		control_mouse_over_.reset();
 
 		controls_.clear();
+		dirty_ = true;
 	}
 
 	// Device state notification
@@ -1648,6 +1794,7 @@ namespace KlayGE
 		{
 			control->Refresh();
 		}
+		dirty_ = true;
 
 		if (keyboard_input_)
 		{
@@ -1665,6 +1812,7 @@ namespace KlayGE
 			fonts_.resize(index + 1, -1);
 		}
 		fonts_[index] = static_cast<int>(UIManager::Instance().AddFont(font, font_size));
+		dirty_ = true;
 	}
 
 	FontPtr const & UIDialog::GetFont(size_t index) const
@@ -1951,11 +2099,24 @@ namespace KlayGE
 		}
 	}
 
+	void UIDialog::SetOpacity(float opacity)
+	{
+		if (opacity_ != opacity)
+		{
+			opacity_ = opacity;
+			if (!always_in_opacity_)
+			{
+				dirty_ = true;
+			}
+		}
+	}
+
 	void UIDialog::KeyDownHandler(uint32_t key)
 	{
 		if (control_focus_.lock() && control_focus_.lock()->GetEnabled())
 		{
 			control_focus_.lock()->KeyDownHandler(*this, key);
+			control_focus_.lock()->Dirty(true);
 		}
 		else
 		{
@@ -1970,6 +2131,7 @@ namespace KlayGE
 					if (control->GetHotkey() == static_cast<uint8_t>(key & 0xFF))
 					{
 						control->OnHotkey();
+						control->Dirty(true);
 						handled = true;
 						break;
 					}
@@ -2005,11 +2167,11 @@ namespace KlayGE
 
 		if (control_focus_.lock() || control_mouse_over_.lock())
 		{
-			opacity_ = 1.0f;
+			this->SetOpacity(1.0f);
 		}
 		else
 		{
-			opacity_ = 0.5f;
+			this->SetOpacity(0.5f);
 		}
 	}
 
@@ -2018,15 +2180,16 @@ namespace KlayGE
 		if (control_focus_.lock() && control_focus_.lock()->GetEnabled())
 		{
 			control_focus_.lock()->KeyUpHandler(*this, key);
+			control_focus_.lock()->Dirty(true);
 		}
 
 		if (control_focus_.lock() || control_mouse_over_.lock())
 		{
-			opacity_ = 1.0f;
+			this->SetOpacity(1.0f);
 		}
 		else
 		{
-			opacity_ = 0.5f;
+			this->SetOpacity(0.5f);
 		}
 	}
 
@@ -2049,6 +2212,7 @@ namespace KlayGE
 		if (control)
 		{
 			control->MouseDownHandler(*this, buttons, local_pt);
+			control->Dirty(true);
 		}
 		else
 		{
@@ -2061,11 +2225,11 @@ namespace KlayGE
 
 		if (this->ContainsPoint(pt) || control_focus_.lock() || control_mouse_over_.lock())
 		{
-			opacity_ = 1.0f;
+			this->SetOpacity(1.0f);
 		}
 		else
 		{
-			opacity_ = 0.5f;
+			this->SetOpacity(0.5f);
 		}
 	}
 
@@ -2088,6 +2252,7 @@ namespace KlayGE
 		if (control)
 		{
 			control->MouseUpHandler(*this, buttons, local_pt);
+			control->Dirty(true);
 		}
 		else
 		{
@@ -2100,11 +2265,11 @@ namespace KlayGE
 
 		if (this->ContainsPoint(pt) || control_focus_.lock() || control_mouse_over_.lock())
 		{
-			opacity_ = 1.0f;
+			this->SetOpacity(1.0f);
 		}
 		else
 		{
-			opacity_ = 0.5f;
+			this->SetOpacity(0.5f);
 		}
 	}
 
@@ -2127,6 +2292,7 @@ namespace KlayGE
 		if (control)
 		{
 			control->MouseWheelHandler(*this, buttons, local_pt, z_delta);
+			control->Dirty(true);
 		}
 		else
 		{
@@ -2139,11 +2305,11 @@ namespace KlayGE
 
 		if (this->ContainsPoint(pt) || control_focus_.lock() || control_mouse_over_.lock())
 		{
-			opacity_ = 1.0f;
+			this->SetOpacity(1.0f);
 		}
 		else
 		{
-			opacity_ = 0.5f;
+			this->SetOpacity(0.5f);
 		}
 	}
 
@@ -2182,15 +2348,16 @@ namespace KlayGE
 		if (control)
 		{
 			control->MouseOverHandler(*this, buttons, local_pt);
+			control->Dirty(true);
 		}
 
 		if (this->ContainsPoint(pt) || control_focus_.lock() || control_mouse_over_.lock())
 		{
-			opacity_ = 1.0f;
+			this->SetOpacity(1.0f);
 		}
 		else
 		{
-			opacity_ = 0.5f;
+			this->SetOpacity(0.5f);
 		}
 	}
 }
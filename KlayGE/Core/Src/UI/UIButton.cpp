@@ -193,6 +193,7 @@ namespace KlayGE
 	void UIButton::SetText(std::wstring const & strText)
 	{
 		text_ = strText;
+		dirty_ = true;
 	}
 
 	void UIButton::OnHotkey()
@@ -128,6 +128,8 @@ namespace KlayGE
 		checked_ = bChecked;
 
 		this->OnChangedEvent()(*this);
+
+		dirty_ = true;
 	}
 
 	void UICheckBox::UpdateRects()
@@ -137,6 +139,8 @@ namespace KlayGE
 		text_rc_.left() += static_cast<int32_t>(1.25f * button_rc_.Width());
 
 		bounding_box_ = button_rc_ | text_rc_;
+
+		dirty_ = true;
 	}
 
 	void UICheckBox::Render()
@@ -197,6 +201,7 @@ namespace KlayGE
 	void UICheckBox::SetText(std::wstring const & strText)
 	{
 		text_ = strText;
+		dirty_ = true;
 	}
 
 	void UICheckBox::OnHotkey()
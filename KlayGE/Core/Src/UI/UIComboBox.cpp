@@ -129,6 +129,8 @@ namespace KlayGE
 		{
 			pElement->FontColor().States[UICS_Normal] = color;
 		}
+
+		dirty_ = true;
 	}
 
 	void UIComboBox::OnFocusOut()
@@ -182,6 +184,8 @@ namespace KlayGE
 		{
 			bounding_box_ = show_rc_ | button_rc_ | text_rc_;
 		}
+
+		dirty_ = true;
 	}
 
 	void UIComboBox::KeyDownHandler(UIDialog const & sender, uint32_t key)
@@ -583,6 +587,7 @@ namespace KlayGE
 
 		// Update the scroll bar with new range
 		scroll_bar_.SetTrackRange(0, items_.size());
+		dirty_ = true;
 
 		// If this is the only item in the list, it's selected
 		if (1 == this->GetNumItems())
@@ -617,6 +622,7 @@ namespace KlayGE
 
 		// Update the scroll bar with new range
 		scroll_bar_.SetTrackRange(0, items_.size());
+		dirty_ = true;
 
 		// If this is the only item in the list, it's selected
 		if (1 == this->GetNumItems())
@@ -633,6 +639,7 @@ namespace KlayGE
 	{
 		items_.erase(items_.begin() + index);
 		scroll_bar_.SetTrackRange(0, items_.size());
+		dirty_ = true;
 		if (selected_ >= static_cast<int>(items_.size()))
 		{
 			selected_ = static_cast<int>(items_.size() - 1);
@@ -644,6 +651,7 @@ namespace KlayGE
 		items_.clear();
 		scroll_bar_.SetTrackRange(0, 1);
 		focused_ = selected_ = -1;
+		dirty_ = true;
 	}
 
 	bool UIComboBox::ContainsItem(std::wstring const & strText, uint32_t iStart) const
@@ -723,6 +731,7 @@ namespace KlayGE
 		BOOST_ASSERT(index < this->GetNumItems());
 
 		focused_ = selected_ = index;
+		dirty_ = true;
 		this->OnSelectionChangedEvent()(*this);
 	}
 
@@ -355,6 +355,7 @@ namespace KlayGE
 	{
 		BOOST_ASSERT((nCP >= 0) && (nCP <= static_cast<int>(buffer_.GetTextSize())));
 		caret_pos_ = nCP;
+		dirty_ = true;
 
 		// Obtain the X offset of the character.
 		int nX2;
@@ -463,6 +464,8 @@ namespace KlayGE
 		{
 			bounding_box_ |= render_rc_[i];
 		}
+
+		dirty_ = true;
 	}
 
 	void UIEditBox::OnFocusIn()
@@ -793,6 +796,7 @@ namespace KlayGE
 	{
 		caret_on_ = true;
 		last_blink_time_ = timer_.current_time();
+		dirty_ = true;
 	}
 
 	void UIEditBox::Render()
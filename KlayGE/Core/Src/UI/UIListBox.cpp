@@ -131,6 +131,7 @@ namespace KlayGE
 
 		items_.push_back(pNewItem);
 		scroll_bar_.SetTrackRange(0, items_.size());
+		dirty_ = true;
 
 		return ret;
 	}
@@ -152,6 +153,7 @@ namespace KlayGE
 
 		items_.push_back(pNewItem);
 		scroll_bar_.SetTrackRange(0, items_.size());
+		dirty_ = true;
 
 		return ret;
 	}
@@ -166,6 +168,7 @@ namespace KlayGE
 
 		items_.insert(items_.begin() + nIndex, pNewItem);
 		scroll_bar_.SetTrackRange(0, items_.size());
+		dirty_ = true;
 	}
 
 	void UIListBox::RemoveItem(int nIndex)
@@ -174,6 +177,7 @@ namespace KlayGE
 
 		items_.erase(items_.begin() + nIndex);
 		scroll_bar_.SetTrackRange(0, items_.size());
+		dirty_ = true;
 		if (selected_ >= static_cast<int>(items_.size()))
 		{
 			selected_ = static_cast<int>(items_.size() - 1);
@@ -186,6 +190,7 @@ namespace KlayGE
 	{
 		items_.clear();
 		scroll_bar_.SetTrackRange(0, 1);
+		dirty_ = true;
 	}
 
 	std::shared_ptr<UIListBoxItem> UIListBox::GetItem(int nIndex) const
@@ -263,6 +268,7 @@ namespace KlayGE
 
 			// Adjust scroll bar
 			scroll_bar_.ShowItem(selected_);
+			dirty_ = true;
 		}
 
 		this->OnSelectionEvent()(*this);
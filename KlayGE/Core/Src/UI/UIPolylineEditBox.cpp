@@ -93,6 +93,8 @@ namespace KlayGE
 	{
 		BOOST_ASSERT(index < static_cast<int>(ctrl_points_.size()));
 		active_pt_ = index;
+
+		dirty_ = true;
 	}
 	
 	int UIPolylineEditBox::ActivePoint() const
@@ -105,6 +107,8 @@ namespace KlayGE
 		active_pt_ = -1;
 		ctrl_points_.clear();
 		move_point_ = false;
+
+		dirty_ = true;
 	}
 
 	int UIPolylineEditBox::AddCtrlPoint(float pos, float value)
@@ -152,21 +156,26 @@ namespace KlayGE
 		}
 
 		ctrl_points_.erase(ctrl_points_.begin() + index);
+
+		dirty_ = true;
 	}
 
 	void UIPolylineEditBox::SetCtrlPoint(int index, float pos, float value)
 	{
 		ctrl_points_[index] = float2(pos, value);
+		dirty_ = true;
 	}
 
 	void UIPolylineEditBox::SetCtrlPoints(std::vector<float2> const & ctrl_points)
 	{
 		ctrl_points_ = ctrl_points;
+		dirty_ = true;
 	}
 
 	void UIPolylineEditBox::SetColor(Color const & clr)
 	{
 		elements_[POLYLINE_INDEX]->TextureColor().States[UICS_Normal] = clr;
+		dirty_ = true;
 	}
 
 	size_t UIPolylineEditBox::NumCtrlPoints() const
@@ -73,6 +73,7 @@ namespace KlayGE
 	void UIProgressBar::SetValue(int value)
 	{
 		progress_ = value;
+		dirty_ = true;
 	}
 	
 	int UIProgressBar::GetValue() const
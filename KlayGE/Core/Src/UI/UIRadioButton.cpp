@@ -139,6 +139,8 @@ namespace KlayGE
 
 		checked_ = bChecked;
 		this->OnChangedEvent()(*this);
+
+		dirty_ = true;
 	}
 
 	void UIRadioButton::UpdateRects()
@@ -150,6 +152,8 @@ namespace KlayGE
 		text_rc_.left() += static_cast<int32_t>(1.25f * button_rc_.Width());
 
 		bounding_box_ = button_rc_ | text_rc_;
+
+		dirty_ = true;
 	}
 
 	void UIRadioButton::Render()
@@ -212,6 +216,7 @@ namespace KlayGE
 	void UIRadioButton::SetText(std::wstring const & strText)
 	{
 		text_ = strText;
+		dirty_ = true;
 	}
 
 	void UIRadioButton::OnHotkey()
@@ -159,6 +159,8 @@ namespace KlayGE
 			thumb_rc_.bottom() = thumb_rc_.top();
 			show_thumb_ = false;
 		}
+
+		dirty_ = true;
 	}
 
 	// Scroll() scrolls by nDelta items.  A positive value scrolls down, while a negative
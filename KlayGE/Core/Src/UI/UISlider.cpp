@@ -192,6 +192,8 @@ namespace KlayGE
 		button_rc_ += int2(button_x_, 0);
 
 		bounding_box_ = button_rc_ | slider_rc_;
+
+		dirty_ = true;
 	}
 
 	int UISlider::ValueFromPos(int x)
@@ -0,0 +1,120 @@
+/**
+ * @file AABBTree.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef _AABBTREE_HPP
+#define _AABBTREE_HPP
+
+#pragma once
+
+#include <KlayGE/PreDeclare.hpp>
+#include <KFL/AABBox.hpp>
+
+#include <vector>
+
+namespace KlayGE
+{
+	// Binary tree of AABBs with one scene object per leaf. A tree is either built at once with binned SAH,
+	// for the static objects, or maintained incrementally with inserts, removes and moves, for the moving
+	// objects. Leaves inserted incrementally are fattened, so an object moving a little doesn't touch the tree.
+	class AABBTree
+	{
+	public:
+		AABBTree();
+
+		void Clear();
+
+		// Replaces the tree with a SAH tree of the objects. The leaves are the exact bounds.
+		void Build(std::vector<SceneObject*> const & objs, std::vector<AABBox> const & bounds);
+
+		// Returns the proxy of the new leaf
+		int Insert(SceneObject* obj, AABBox const & aabb);
+		void Remove(int proxy);
+		// Reinserts the leaf if the new bound is out of its fat bound. Returns true if the tree is changed.
+		bool Move(int proxy, AABBox const & aabb);
+
+		// Collects the leaves intersecting the frustum, with the overlap and the remaining plane mask of their
+		// leaf bounds. The nodes are tested level by level with the batch frustum kernel.
+		void Cull(std::vector<SceneObject*>& objs, std::vector<BoundOverlap>& overlaps,
+			std::vector<uint8_t>& plane_masks, Frustum const & frustum);
+
+		uint32_t NumLeaves() const;
+		uint32_t Height() const;
+
+		// Checks the links, the heights and the number of the leaves, and that the bound of every node contains
+		// the bounds of its children. For the tests.
+		bool Validate() const;
+
+	private:
+		struct aabb_tree_node_t
+		{
+			float3 center;
+			float3 extent;
+			int parent;		// Next free node in the free list
+			int children[2];
+			int height;		// 0 for leaves, -1 for free nodes
+			SceneObject* obj;
+
+			bool IsLeaf() const
+			{
+				return -1 == children[0];
+			}
+		};
+
+		int AllocateNode();
+		void FreeNode(int index);
+		void InsertLeaf(int leaf);
+		void RemoveLeaf(int leaf);
+		int Balance(int index);
+		void UpdateNode(int index);
+
+		int BuildRange(std::vector<int>& leaves, size_t begin, size_t end);
+
+		void CollectLeaves(int index, std::vector<SceneObject*>& objs, std::vector<BoundOverlap>& overlaps,
+			std::vector<uint8_t>& plane_masks);
+
+	private:
+		std::vector<aabb_tree_node_t> nodes_;
+		int root_;
+		int free_list_;
+		uint32_t num_leaves_;
+
+		// Scratch of Cull
+		std::vector<int> curr_level_;
+		std::vector<int> next_level_;
+		std::vector<uint8_t> curr_masks_;
+		std::vector<uint8_t> next_masks_;
+		std::vector<float> soa_;
+		std::vector<uint32_t> visible_bits_;
+		std::vector<BoundOverlap> level_overlaps_;
+		std::vector<int> stack_;
+	};
+}
+
+#endif		// _AABBTREE_HPP
@@ -0,0 +1,92 @@
+/**
+ * @file BVH.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef _BVH_HPP
+#define _BVH_HPP
+
+#pragma once
+
+#include <KlayGE/PreDeclare.hpp>
+#include <KlayGE/SceneManager.hpp>
+#include <KlayGE/BVH/AABBTree.hpp>
+
+#include <vector>
+#include <unordered_map>
+
+namespace KlayGE
+{
+	// Scene manager with two AABB trees. The static objects are in a SAH tree rebuilt when they change. The
+	// moveable objects, which OCTree tests one by one, are in a tree updated incrementally as they move.
+	class BVH : public SceneManager
+	{
+	public:
+		BVH();
+
+		virtual void ClipScene() override;
+
+		virtual void ClearObject() override;
+
+	private:
+		virtual void OnAddSceneObject(SceneObjectPtr const & obj) override;
+		virtual void OnDelSceneObject(std::vector<SceneObjectPtr>::iterator iter) override;
+		virtual void DoSuspend() override;
+		virtual void DoResume() override;
+		virtual void ClipViewBounds(std::vector<Frustum> const & frusta,
+			std::vector<std::vector<BoundOverlap>>& overlaps) override;
+
+		void RebuildStaticTree();
+		void UpdateDynamicTree();
+		void RefineFatLeaves(Frustum const & frustum);
+		void MarkLeaves(bool exact_leaves);
+		BoundOverlap SmallObjectTest(SceneObject* obj, BoundOverlap bo) const;
+
+	private:
+		AABBTree static_tree_;
+		AABBTree dynamic_tree_;
+		std::unordered_map<SceneObject*, int> dynamic_proxies_;
+
+		bool rebuild_tree_;
+
+		float3 eye_pos_;
+		float4x4 view_proj_;
+
+		// Scratch of ClipScene
+		std::vector<SceneObject*> leaf_objs_;
+		std::vector<BoundOverlap> leaf_overlaps_;
+		std::vector<uint8_t> leaf_plane_masks_;
+		std::vector<size_t> partial_leaves_;
+		std::vector<uint8_t> partial_plane_masks_;
+		std::vector<float> soa_;
+		std::vector<uint32_t> visible_bits_;
+		std::vector<BoundOverlap> overlaps_;
+	};
+}
+
+#endif		// _BVH_HPP
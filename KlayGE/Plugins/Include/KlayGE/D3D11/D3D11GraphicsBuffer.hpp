@@ -59,6 +59,8 @@ namespace KlayGE
 	private:
 		ID3D11Device* d3d_device_;
 		ID3D11DeviceContext* d3d_imm_ctx_;
+		// Only set for constant buffers, when a part of them can be updated
+		ID3D11DeviceContext1* d3d_imm_ctx_1_;
 		ID3D11BufferPtr buffer_;
 		ID3D11ShaderResourceViewPtr d3d_sr_view_;
 		mutable ID3D11RenderTargetViewPtr d3d_rt_view_;
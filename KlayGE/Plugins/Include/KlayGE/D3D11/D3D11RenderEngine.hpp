@@ -220,12 +220,6 @@ namespace KlayGE
 		ID3D11BlendState* blend_state_cache_;
 		Color blend_factor_cache_;
 		uint32_t sample_mask_cache_;
-		ID3D11VertexShader* vertex_shader_cache_;
-		ID3D11PixelShader* pixel_shader_cache_;
-		ID3D11GeometryShader* geometry_shader_cache_;
-		ID3D11ComputeShader* compute_shader_cache_;
-		ID3D11HullShader* hull_shader_cache_;
-		ID3D11DomainShader* domain_shader_cache_;
 		RenderLayout::topology_type topology_type_cache_;
 		ID3D11InputLayout* input_layout_cache_;
 		D3D11_VIEWPORT viewport_cache_;
@@ -237,8 +231,10 @@ namespace KlayGE
 
 		std::array<std::vector<std::tuple<void*, uint32_t, uint32_t>>, ShaderObject::ST_NumShaderTypes> shader_srvsrc_cache_;
 		std::array<std::vector<ID3D11ShaderResourceView*>, ShaderObject::ST_NumShaderTypes> shader_srv_ptr_cache_;
-		std::array<std::vector<ID3D11SamplerState*>, ShaderObject::ST_NumShaderTypes> shader_sampler_ptr_cache_;
-		std::array<std::vector<ID3D11Buffer*>, ShaderObject::ST_NumShaderTypes> shader_cb_ptr_cache_;
+		// The samplers and the constant buffers are filtered by the cache of RenderEngine. These are the numbers of
+		// slots bound since the last reset, to unbind them.
+		std::array<uint32_t, ShaderObject::ST_NumShaderTypes> num_bound_samplers_;
+		std::array<uint32_t, ShaderObject::ST_NumShaderTypes> num_bound_cbs_;
 		std::vector<ID3D11UnorderedAccessView*> render_uav_ptr_cache_;
 		std::vector<uint32_t> render_uav_init_count_cache_;
 		std::vector<ID3D11UnorderedAccessView*> compute_uav_ptr_cache_;
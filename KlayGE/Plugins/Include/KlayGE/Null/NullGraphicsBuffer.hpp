@@ -0,0 +1,65 @@
+/**
+ * @file NullGraphicsBuffer.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef _NULLGRAPHICSBUFFER_HPP
+#define _NULLGRAPHICSBUFFER_HPP
+
+#pragma once
+
+#include <vector>
+
+#include <KlayGE/GraphicsBuffer.hpp>
+
+namespace KlayGE
+{
+	// The content lives in system memory, so mapping and updating behave as with a real buffer. Buffer to
+	// buffer copies run on the GPU with the real backends, they are recorded only.
+	class NullGraphicsBuffer : public GraphicsBuffer
+	{
+	public:
+		NullGraphicsBuffer(BufferUsage usage, uint32_t access_hint, uint32_t size_in_byte);
+
+		virtual void CopyToBuffer(GraphicsBuffer& target) override;
+
+		virtual void CreateHWResource(void const * init_data) override;
+		virtual void DeleteHWResource() override;
+
+		virtual void UpdateSubresource(uint32_t offset, uint32_t size, void const * data) override;
+
+	private:
+		virtual void* Map(BufferAccess ba) override;
+		virtual void Unmap() override;
+
+	private:
+		std::vector<uint8_t> data_;
+	};
+}
+
+#endif			// _NULLGRAPHICSBUFFER_HPP
@@ -0,0 +1,184 @@
+/**
+ * @file NullRenderEngine.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef _NULLRENDERENGINE_HPP
+#define _NULLRENDERENGINE_HPP
+
+#pragma once
+
+#include <array>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <KlayGE/RenderEngine.hpp>
+
+namespace KlayGE
+{
+	enum NullCommandType
+	{
+		NCT_Draw = 0,
+		NCT_Dispatch,
+		NCT_DispatchIndirect,
+		NCT_BindFrameBuffer,
+		NCT_BindSOBuffers,
+		NCT_SetRasterizerState,
+		NCT_SetDepthStencilState,
+		NCT_SetBlendState,
+		NCT_BindShader,
+		NCT_Clear,
+		NCT_Discard,
+		NCT_ScissorRect,
+		NCT_UpdateBuffer,
+		NCT_MapBuffer,
+		NCT_CopyBuffer,
+		NCT_UpdateTexture,
+		NCT_MapTexture,
+		NCT_CopyTexture,
+		NCT_BuildMipSubLevels,
+
+		NCT_NumCommandTypes
+	};
+
+	// One API call that would have reached the GPU. id identifies the effect and technique of draws, dispatches
+	// and shader binds, stable from run to run. object is the resource or state the call works on.
+	struct NullCommand
+	{
+		NullCommandType type;
+		void const * object;
+		uint64_t id;
+		uint32_t args[4];
+	};
+
+	// Executes nothing. Every call is counted, and logged unless RECORD_COMMANDS is turned off. The log and the
+	// per-frame counters are swapped at EndFrame, so queries between frames see the last complete frame.
+	//
+	// Custom attributes:
+	//   GetCustomAttrib("NUM_COMMANDS", uint32_t*): Number of commands in the last frame.
+	//   GetCustomAttrib("NUM_<NAME>_COMMANDS", uint32_t*): Number of commands of a type in the last frame.
+	//   GetCustomAttrib("TOTAL_<NAME>_COMMANDS", uint64_t*): Number of commands of a type since the last reset.
+	//   GetCustomAttrib("COMMAND_LOG", std::string*): The last frame, one command per line.
+	//   SetCustomAttrib("RECORD_COMMANDS", bool*): Turns the log on or off. The counters are always on.
+	//   SetCustomAttrib("RESET_COMMAND_COUNTERS", nullptr): Clears the totals.
+	// <NAME> is the upper case name of the type, DRAW, DISPATCH, BIND_SHADER, UPDATE_BUFFER, and so on.
+	class NullRenderEngine : public RenderEngine
+	{
+	public:
+		NullRenderEngine();
+		virtual ~NullRenderEngine() override;
+
+		virtual std::wstring const & Name() const override;
+
+		virtual bool RequiresFlipping() const override
+		{
+			return false;
+		}
+
+		virtual void BeginFrame() override;
+		virtual void EndFrame() override;
+
+		virtual void ForceFlush() override;
+
+		virtual TexturePtr const & ScreenDepthStencilTexture() const override;
+
+		virtual void ScissorRect(uint32_t x, uint32_t y, uint32_t width, uint32_t height) override;
+
+		virtual void GetCustomAttrib(std::string const & name, void* value) override;
+		virtual void SetCustomAttrib(std::string const & name, void* value) override;
+
+		virtual bool FullScreen() const override;
+		virtual void FullScreen(bool fs) override;
+
+		void Record(NullCommandType type, void const * object, uint64_t id = 0,
+			uint32_t arg0 = 0, uint32_t arg1 = 0, uint32_t arg2 = 0, uint32_t arg3 = 0);
+		// Records a NCT_BindShader only if the shader isn't already bound
+		void BindShader(ShaderObject const * so);
+
+		std::vector<NullCommand> const & LastFrameCommands() const
+		{
+			return last_frame_commands_;
+		}
+		uint32_t NumLastFrameCommands(NullCommandType type) const
+		{
+			return last_frame_counts_[type];
+		}
+		uint64_t NumTotalCommands(NullCommandType type) const
+		{
+			return total_counts_[type];
+		}
+		void ResetCommandCounters();
+
+		bool RecordCommands() const
+		{
+			return record_commands_;
+		}
+		void RecordCommands(bool record)
+		{
+			record_commands_ = record;
+		}
+
+		static char const * CommandName(NullCommandType type);
+		static std::string CommandLog(std::vector<NullCommand> const & commands);
+
+	private:
+		virtual void DoCreateRenderWindow(std::string const & name, RenderSettings const & settings) override;
+		virtual void DoBindFrameBuffer(FrameBufferPtr const & fb) override;
+		virtual void DoBindSOBuffers(RenderLayoutPtr const & rl) override;
+		virtual void DoRender(RenderEffect const & effect, RenderTechnique const & tech, RenderLayout const & rl) override;
+		virtual void DoDispatch(RenderEffect const & effect, RenderTechnique const & tech, uint32_t tgx, uint32_t tgy, uint32_t tgz) override;
+		virtual void DoDispatchIndirect(RenderEffect const & effect, RenderTechnique const & tech,
+			GraphicsBufferPtr const & buff_args, uint32_t offset) override;
+		virtual void DoResize(uint32_t width, uint32_t height) override;
+		virtual void DoDestroy() override;
+
+		virtual void DoSuspend() override;
+		virtual void DoResume() override;
+
+		void FillRenderDeviceCaps();
+		void CreateScreenBuffers(uint32_t width, uint32_t height);
+
+	private:
+		RenderSettings settings_;
+		bool full_screen_;
+
+		TexturePtr screen_color_tex_;
+		TexturePtr screen_ds_tex_;
+
+		std::mutex commands_mutex_;
+		bool record_commands_;
+		std::vector<NullCommand> cur_frame_commands_;
+		std::vector<NullCommand> last_frame_commands_;
+		std::array<uint32_t, NCT_NumCommandTypes> cur_frame_counts_;
+		std::array<uint32_t, NCT_NumCommandTypes> last_frame_counts_;
+		std::array<uint64_t, NCT_NumCommandTypes> total_counts_;
+	};
+}
+
+#endif			// _NULLRENDERENGINE_HPP
@@ -0,0 +1,72 @@
+/**
+ * @file NullRenderView.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef _NULLRENDERVIEW_HPP
+#define _NULLRENDERVIEW_HPP
+
+#pragma once
+
+#include <KlayGE/RenderView.hpp>
+
+namespace KlayGE
+{
+	// Views of textures and buffers. Clears and discards are recorded, the contents are left untouched.
+	class NullRenderView : public RenderView
+	{
+	public:
+		NullRenderView(uint32_t width, uint32_t height, ElementFormat pf);
+
+		virtual void ClearColor(Color const & clr) override;
+		virtual void ClearDepth(float depth) override;
+		virtual void ClearStencil(int32_t stencil) override;
+		virtual void ClearDepthStencil(float depth, int32_t stencil) override;
+
+		virtual void Discard() override;
+
+		virtual void OnAttached(FrameBuffer& fb, uint32_t att) override;
+		virtual void OnDetached(FrameBuffer& fb, uint32_t att) override;
+	};
+
+	class NullUnorderedAccessView : public UnorderedAccessView
+	{
+	public:
+		NullUnorderedAccessView(uint32_t width, uint32_t height, ElementFormat pf);
+
+		virtual void Clear(float4 const & val) override;
+		virtual void Clear(uint4 const & val) override;
+
+		virtual void Discard() override;
+
+		virtual void OnAttached(FrameBuffer& fb, uint32_t att) override;
+		virtual void OnDetached(FrameBuffer& fb, uint32_t att) override;
+	};
+}
+
+#endif			// _NULLRENDERVIEW_HPP
@@ -0,0 +1,77 @@
+/**
+ * @file NullShaderObject.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef _NULLSHADEROBJECT_HPP
+#define _NULLSHADEROBJECT_HPP
+
+#pragma once
+
+#include <vector>
+
+#include <KlayGE/ShaderObject.hpp>
+
+namespace KlayGE
+{
+	// Shaders are not compiled, every stage is accepted. The constant buffers of the effect are laid out with
+	// the HLSL packing rules, so parameters are written to the same offsets as with D3D11, and the buffer updates
+	// cost the same. The only thing kept from the shader code is the thread group size of compute shaders, which
+	// is needed to compute the number of groups to dispatch.
+	class NullShaderObject : public ShaderObject
+	{
+	public:
+		NullShaderObject();
+
+		virtual bool AttachNativeShader(ShaderType type, RenderEffect const & effect,
+			std::array<uint32_t, ST_NumShaderTypes> const & shader_desc_ids, std::vector<uint8_t> const & native_shader_block) override;
+
+		virtual bool StreamIn(ResIdentifierPtr const & res, ShaderType type, RenderEffect const & effect,
+			std::array<uint32_t, ST_NumShaderTypes> const & shader_desc_ids) override;
+		virtual void StreamOut(std::ostream& os, ShaderType type) override;
+
+		virtual void AttachShader(ShaderType type, RenderEffect const & effect,
+			RenderTechnique const & tech, RenderPass const & pass, std::array<uint32_t, ST_NumShaderTypes> const & shader_desc_ids) override;
+		virtual void AttachShader(ShaderType type, RenderEffect const & effect,
+			RenderTechnique const & tech, RenderPass const & pass, ShaderObjectPtr const & shared_so) override;
+		virtual void LinkShaders(RenderEffect const & effect) override;
+		virtual ShaderObjectPtr Clone(RenderEffect const & effect) override;
+
+		virtual void Bind() override;
+		virtual void Unbind() override;
+
+	private:
+		void LayoutCBuffers(RenderEffect const & effect);
+
+	private:
+		std::vector<uint32_t> cbuff_indices_;
+		std::vector<RenderEffectConstantBuffer*> cbuffs_;
+	};
+}
+
+#endif			// _NULLSHADEROBJECT_HPP
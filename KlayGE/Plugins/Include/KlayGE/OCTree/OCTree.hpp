@@ -30,6 +30,7 @@
 #include <KFL/AABBox.hpp>
 
 #include <vector>
+#include <unordered_map>
 
 namespace KlayGE
 {
@@ -49,15 +50,36 @@ namespace KlayGE
 
 		virtual void ClearObject() override;
 
+		// For the tests. Checks the links, the object counts and the pools, that every object is in the loose
+		// bound of its node and in no loose bound of its children, and that no subtree should have been merged.
+		// A tree waiting to be rebuilt isn't checked.
+		bool Validate() const;
+		// The sizes of the node and the object pools, including the free entries
+		size_t NumNodeEntries() const;
+		size_t NumObjectEntries() const;
+
 	private:
 		virtual void OnAddSceneObject(SceneObjectPtr const & obj) override;
 		virtual void OnDelSceneObject(std::vector<SceneObjectPtr>::iterator iter) override;
 		virtual void DoSuspend() override;
 		virtual void DoResume() override;
-
-		void DivideNode(size_t index, uint32_t curr_depth);
-		void NodeVisible(size_t index);
+		virtual void ClipViewBounds(std::vector<Frustum> const & frusta,
+			std::vector<std::vector<BoundOverlap>>& overlaps) override;
+
+		void RebuildTree();
+		void InsertObject(SceneObject* obj);
+		void RemoveObject(SceneObject* obj);
+		int ChildContaining(size_t index, AABBox const & aabb) const;
+		void LinkObject(int obj_index, int node_index);
+		void UnlinkObject(int obj_index);
+		void SplitNode(size_t index);
+		void MergeNode(size_t index);
+		void FreeChildren(size_t index);
+		// The subtrees of the node are visited in parallel if parallel is true
+		void NodeVisible(size_t index, bool parallel);
 		void MarkNodeObjs(size_t index, bool force);
+		// Writes the overlaps of the objects in the subtree with the frustum. inside skips the tests of the nodes.
+		void NodeViewBounds(size_t index, Frustum const & frustum, bool inside, std::vector<BoundOverlap>& overlaps);
 
 		BoundOverlap BoundVisible(size_t index, AABBox const & aabb) const;
 		BoundOverlap BoundVisible(size_t index, OBBox const & obb) const;
@@ -69,16 +91,34 @@ namespace KlayGE
 		OCTree& operator=(OCTree const & rhs);
 
 	private:
+		// Loose octree. An object is kept in the deepest node whose loose bound, the node bound enlarged
+		// by half its size on each side, contains it. So every object is in exactly one node.
 		struct octree_node_t
 		{
 			AABBox bb;
 			int first_child_index;
+			int parent_index;
+			int first_obj_index;
+			uint32_t num_objs;
+			uint32_t num_subtree_objs;
+			uint32_t depth;
 			BoundOverlap visible;
+		};
 
-			std::vector<SceneObject*> obj_ptrs;
+		// Objects of a node form a doubly linked list in a pool
+		struct octree_obj_t
+		{
+			SceneObject* obj;
+			int node_index;
+			int prev_index;		// Next free entry in the free list
+			int next_index;
 		};
 
 		std::vector<octree_node_t> octree_;
+		std::vector<int> free_children_;
+		std::vector<octree_obj_t> octree_objs_;
+		int free_obj_index_;
+		std::unordered_map<SceneObject*, int> obj_indices_;
 
 		uint32_t max_tree_depth_;
 
@@ -42,6 +42,16 @@ namespace KlayGE
 		D3D11RenderEngine const & renderEngine(*checked_cast<D3D11RenderEngine const *>(&Context::Instance().RenderFactoryInstance().RenderEngineInstance()));
 		d3d_device_ = renderEngine.D3DDevice();
 		d3d_imm_ctx_ = renderEngine.D3DDeviceImmContext();
+		// A part of a constant buffer can only be updated through UpdateSubresource1, with
+		// RenderDeviceCaps::cbuffer_partial_update_support set. The caps are filled when the device is created.
+		if ((bind_flags_ & D3D11_BIND_CONSTANT_BUFFER) && renderEngine.DeviceCaps().cbuffer_partial_update_support)
+		{
+			d3d_imm_ctx_1_ = renderEngine.D3DDeviceImmContext1();
+		}
+		else
+		{
+			d3d_imm_ctx_1_ = nullptr;
+		}
 	}
 
 	ID3D11RenderTargetViewPtr const & D3D11GraphicsBuffer::D3DRenderTargetView() const
@@ -288,9 +298,15 @@ namespace KlayGE
 
 	void D3D11GraphicsBuffer::UpdateSubresource(uint32_t offset, uint32_t size, void const * data)
 	{
+		ID3D11DeviceContext1* d3d_imm_ctx_1 = nullptr;
+		if ((bind_flags_ & D3D11_BIND_CONSTANT_BUFFER) && ((offset != 0) || (size != this->Size())))
+		{
+			d3d_imm_ctx_1 = d3d_imm_ctx_1_;
+		}
+
 		D3D11_BOX* p = nullptr;
 		D3D11_BOX box;
-		if (!(bind_flags_ & D3D11_BIND_CONSTANT_BUFFER))
+		if (!(bind_flags_ & D3D11_BIND_CONSTANT_BUFFER) || d3d_imm_ctx_1)
 		{
 			p = &box;
 			box.left = offset;
@@ -300,6 +316,13 @@ namespace KlayGE
 			box.bottom = 1;
 			box.back = 1;
 		}
-		d3d_imm_ctx_->UpdateSubresource(buffer_.get(), 0, p, data, size, size);
+		if (d3d_imm_ctx_1)
+		{
+			d3d_imm_ctx_1->UpdateSubresource1(buffer_.get(), 0, p, data, size, size, 0);
+		}
+		else
+		{
+			d3d_imm_ctx_->UpdateSubresource(buffer_.get(), 0, p, data, size, size);
+		}
 	}
 }
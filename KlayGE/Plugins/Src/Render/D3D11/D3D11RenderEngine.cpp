@@ -93,6 +93,9 @@ namespace KlayGE
 		native_shader_fourcc_ = MakeFourCC<'D', 'X', 'B', 'C'>::value;
 		native_shader_version_ = 5;
 
+		num_bound_samplers_.fill(0);
+		num_bound_cbs_.fill(0);
+
 #ifdef KLAYGE_PLATFORM_WINDOWS_DESKTOP
 		// Dynamic loading because these dlls can't be loaded on WinXP
 		mod_dxgi_ = ::LoadLibraryEx(TEXT("dxgi.dll"), nullptr, 0);
@@ -464,12 +467,7 @@ namespace KlayGE
 		DepthStencilStateDesc default_dss_desc;
 		BlendStateDesc default_bs_desc;
 
-		vertex_shader_cache_ = nullptr;
-		pixel_shader_cache_ = nullptr;
-		geometry_shader_cache_ = nullptr;
-		compute_shader_cache_ = nullptr;
-		hull_shader_cache_ = nullptr;
-		domain_shader_cache_ = nullptr;
+		this->InvalidateStateCache(RST_Shader);
 
 		RenderFactory& rf = Context::Instance().RenderFactoryInstance();
 		cur_rs_obj_ = rf.MakeRasterizerStateObject(default_rs_desc);
@@ -520,20 +518,22 @@ namespace KlayGE
 				shader_srv_ptr_cache_[i].clear();
 			}
 
-			if (!shader_sampler_ptr_cache_[i].empty())
+			if (num_bound_samplers_[i] > 0)
 			{
-				std::fill(shader_sampler_ptr_cache_[i].begin(), shader_sampler_ptr_cache_[i].end(), static_cast<ID3D11SamplerState*>(nullptr));
-				ShaderSetSamplers[i](d3d_imm_ctx_.get(), 0, static_cast<UINT>(shader_sampler_ptr_cache_[i].size()), &shader_sampler_ptr_cache_[i][0]);
-				shader_sampler_ptr_cache_[i].clear();
+				ID3D11SamplerState* const null_samplers[D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT] = {};
+				ShaderSetSamplers[i](d3d_imm_ctx_.get(), 0, num_bound_samplers_[i], null_samplers);
+				num_bound_samplers_[i] = 0;
 			}
 
-			if (!shader_cb_ptr_cache_[i].empty())
+			if (num_bound_cbs_[i] > 0)
 			{
-				std::fill(shader_cb_ptr_cache_[i].begin(), shader_cb_ptr_cache_[i].end(), static_cast<ID3D11Buffer*>(nullptr));
-				ShaderSetConstantBuffers[i](d3d_imm_ctx_.get(), 0, static_cast<UINT>(shader_cb_ptr_cache_[i].size()), &shader_cb_ptr_cache_[i][0]);
-				shader_cb_ptr_cache_[i].clear();
+				ID3D11Buffer* const null_cbs[D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT] = {};
+				ShaderSetConstantBuffers[i](d3d_imm_ctx_.get(), 0, num_bound_cbs_[i], null_cbs);
+				num_bound_cbs_[i] = 0;
 			}
 		}
+		this->InvalidateStateCache(RST_Sampler);
+		this->InvalidateStateCache(RST_Buffer);
 	}
 
 	ID3D11InputLayoutPtr const & D3D11RenderEngine::CreateD3D11InputLayout(std::vector<D3D11_INPUT_ELEMENT_DESC> const & elems, size_t signature, std::vector<uint8_t> const & vs_code)
@@ -634,8 +634,10 @@ namespace KlayGE
 		auto const & offsets = d3d_rl.Offsets();
 		if (all_num_vertex_stream != 0)
 		{
-			if ((vb_cache_.size() != all_num_vertex_stream) || (vb_cache_ != vbs)
-				|| (vb_stride_cache_ != strides) || (vb_offset_cache_ != offsets))
+			bool const vb_changed = (vb_cache_.size() != all_num_vertex_stream) || (vb_cache_ != vbs)
+				|| (vb_stride_cache_ != strides) || (vb_offset_cache_ != offsets);
+			this->CountStateChange(RST_Buffer, vb_changed);
+			if (vb_changed)
 			{
 				d3d_imm_ctx_->IASetVertexBuffers(0, all_num_vertex_stream, &vbs[0], &strides[0], &offsets[0]);
 				vb_cache_ = vbs;
@@ -746,6 +748,7 @@ namespace KlayGE
 		if (rl.UseIndices())
 		{
 			ID3D11Buffer* d3dib = checked_cast<D3D11GraphicsBuffer*>(rl.GetIndexStream().get())->D3DBuffer();
+			this->CountStateChange(RST_Buffer, ib_cache_ != d3dib);
 			if (ib_cache_ != d3dib)
 			{
 				d3d_imm_ctx_->IASetIndexBuffer(d3dib, D3D11Mapping::MappingFormat(rl.IndexStreamFormat()), 0);
@@ -936,12 +939,9 @@ namespace KlayGE
 		rasterizer_state_cache_ = nullptr;
 		depth_stencil_state_cache_ = nullptr;
 		blend_state_cache_ = nullptr;
-		vertex_shader_cache_ = nullptr;
-		pixel_shader_cache_ = nullptr;
-		geometry_shader_cache_ = nullptr;
-		compute_shader_cache_ = nullptr;
-		hull_shader_cache_ = nullptr;
-		domain_shader_cache_ = nullptr;
+		this->InvalidateStateCache(RST_Shader);
+		this->InvalidateStateCache(RST_Sampler);
+		this->InvalidateStateCache(RST_Buffer);
 		input_layout_cache_ = nullptr;
 		vb_cache_.clear();
 		ib_cache_ = nullptr;
@@ -950,9 +950,9 @@ namespace KlayGE
 		{
 			shader_srvsrc_cache_[i].clear();
 			shader_srv_ptr_cache_[i].clear();
-			shader_sampler_ptr_cache_[i].clear();
-			shader_cb_ptr_cache_[i].clear();
 		}
+		num_bound_samplers_.fill(0);
+		num_bound_cbs_.fill(0);
 		render_uav_ptr_cache_.clear();
 		render_uav_init_count_cache_.clear();
 		compute_uav_ptr_cache_.clear();
@@ -1226,10 +1226,12 @@ namespace KlayGE
 			D3D11_FEATURE_DATA_D3D11_OPTIONS d3d11_feature;
 			d3d_device_->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &d3d11_feature, sizeof(d3d11_feature));
 			caps_.logic_op_support = d3d11_feature.OutputMergerLogicOp ? true : false;
+			caps_.cbuffer_partial_update_support = d3d11_feature.ConstantBufferPartialUpdate ? true : false;
 		}
 		else
 		{
 			caps_.logic_op_support = false;
+			caps_.cbuffer_partial_update_support = false;
 		}
 		caps_.independent_blend_support = (d3d_feature_level_ >= D3D_FEATURE_LEVEL_10_0);
 		caps_.draw_indirect_support = (d3d_feature_level_ >= D3D_FEATURE_LEVEL_11_0);
@@ -1615,55 +1617,49 @@ namespace KlayGE
 
 	void D3D11RenderEngine::VSSetShader(ID3D11VertexShader* shader)
 	{
-		if (vertex_shader_cache_ != shader)
+		if (this->UpdateStateCache(RST_Shader, ShaderObject::ST_VertexShader, shader))
 		{
 			d3d_imm_ctx_->VSSetShader(shader, nullptr, 0);
-			vertex_shader_cache_ = shader;
 		}
 	}
 
 	void D3D11RenderEngine::PSSetShader(ID3D11PixelShader* shader)
 	{
-		if (pixel_shader_cache_ != shader)
+		if (this->UpdateStateCache(RST_Shader, ShaderObject::ST_PixelShader, shader))
 		{
 			d3d_imm_ctx_->PSSetShader(shader, nullptr, 0);
-			pixel_shader_cache_ = shader;
 		}
 	}
 
 	void D3D11RenderEngine::GSSetShader(ID3D11GeometryShader* shader)
 	{
-		if (geometry_shader_cache_ != shader)
+		if (this->UpdateStateCache(RST_Shader, ShaderObject::ST_GeometryShader, shader))
 		{
 			d3d_imm_ctx_->GSSetShader(shader, nullptr, 0);
-			geometry_shader_cache_ = shader;
 		}
 	}
 
 	void D3D11RenderEngine::CSSetShader(ID3D11ComputeShader* shader)
 	{
-		if (compute_shader_cache_ != shader)
+		if (this->UpdateStateCache(RST_Shader, ShaderObject::ST_ComputeShader, shader))
 		{
 			d3d_imm_ctx_->CSSetShader(shader, nullptr, 0);
-			compute_shader_cache_ = shader;
 		}
 	}
 
 	void D3D11RenderEngine::HSSetShader(ID3D11HullShader* shader)
 	{
-		if (hull_shader_cache_ != shader)
+		if (this->UpdateStateCache(RST_Shader, ShaderObject::ST_HullShader, shader))
 		{
 			d3d_imm_ctx_->HSSetShader(shader, nullptr, 0);
-			hull_shader_cache_ = shader;
 		}
 	}
 
 	void D3D11RenderEngine::DSSetShader(ID3D11DomainShader* shader)
 	{
-		if (domain_shader_cache_ != shader)
+		if (this->UpdateStateCache(RST_Shader, ShaderObject::ST_DomainShader, shader))
 		{
 			d3d_imm_ctx_->DSSetShader(shader, nullptr, 0);
-			domain_shader_cache_ = shader;
 		}
 	}
 
@@ -1749,7 +1745,9 @@ namespace KlayGE
 			std::vector<std::tuple<void*, uint32_t, uint32_t>> const & srvsrcs,
 			std::vector<ID3D11ShaderResourceView*> const & srvs)
 	{
-		if (shader_srv_ptr_cache_[st] != srvs)
+		bool const changed = (shader_srv_ptr_cache_[st] != srvs);
+		this->CountStateChange(RST_Texture, changed);
+		if (changed)
 		{
 			size_t const old_size = shader_srv_ptr_cache_[st].size();
 			shader_srv_ptr_cache_[st] = srvs;
@@ -1768,21 +1766,24 @@ namespace KlayGE
 
 	void D3D11RenderEngine::SetSamplers(ShaderObject::ShaderType st, std::vector<ID3D11SamplerState*> const & samplers)
 	{
-		if (shader_sampler_ptr_cache_[st] != samplers)
+		// Each stage has its own range of slots in the cache
+		BOOST_ASSERT(samplers.size() <= D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT);
+		if (this->UpdateStateCache(RST_Sampler, st * D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT,
+			static_cast<uint32_t>(samplers.size()), samplers.data()))
 		{
 			ShaderSetSamplers[st](d3d_imm_ctx_.get(), 0, static_cast<UINT>(samplers.size()), &samplers[0]);
-
-			shader_sampler_ptr_cache_[st] = samplers;
+			num_bound_samplers_[st] = std::max(num_bound_samplers_[st], static_cast<uint32_t>(samplers.size()));
 		}
 	}
 
 	void D3D11RenderEngine::SetConstantBuffers(ShaderObject::ShaderType st, std::vector<ID3D11Buffer*> const & cbs)
 	{
-		if (shader_cb_ptr_cache_[st] != cbs)
+		BOOST_ASSERT(cbs.size() <= D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT);
+		if (this->UpdateStateCache(RST_Buffer, st * D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT,
+			static_cast<uint32_t>(cbs.size()), cbs.data()))
 		{
 			ShaderSetConstantBuffers[st](d3d_imm_ctx_.get(), 0, static_cast<UINT>(cbs.size()), &cbs[0]);
-
-			shader_cb_ptr_cache_[st] = cbs;
+			num_bound_cbs_[st] = std::max(num_bound_cbs_[st], static_cast<uint32_t>(cbs.size()));
 		}
 	}
 
@@ -1534,6 +1534,8 @@ namespace KlayGE
 		caps_.independent_blend_support = true;
 		caps_.draw_indirect_support = true;
 		caps_.no_overwrite_support = true;
+		// Map renames the constant buffer, so partial updates would lose the rest of it
+		caps_.cbuffer_partial_update_support = false;
 		caps_.full_npot_texture_support = true;
 		caps_.render_to_texture_array_support = true;
 		caps_.load_from_buffer_support = true;
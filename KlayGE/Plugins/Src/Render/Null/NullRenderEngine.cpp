@@ -0,0 +1,491 @@
+/**
+ * @file NullRenderEngine.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Util.hpp>
+#include <KFL/Math.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/RenderFactory.hpp>
+#include <KlayGE/RenderEffect.hpp>
+#include <KlayGE/RenderLayout.hpp>
+#include <KlayGE/FrameBuffer.hpp>
+#include <KlayGE/Texture.hpp>
+
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+#include <boost/functional/hash.hpp>
+
+#include <KlayGE/Null/NullFrameBuffer.hpp>
+#include <KlayGE/Null/NullRenderEngine.hpp>
+
+namespace
+{
+	using namespace KlayGE;
+
+	char const * const command_names[] =
+	{
+		"DRAW",
+		"DISPATCH",
+		"DISPATCH_INDIRECT",
+		"BIND_FRAME_BUFFER",
+		"BIND_SO_BUFFERS",
+		"SET_RASTERIZER_STATE",
+		"SET_DEPTH_STENCIL_STATE",
+		"SET_BLEND_STATE",
+		"BIND_SHADER",
+		"CLEAR",
+		"DISCARD",
+		"SCISSOR_RECT",
+		"UPDATE_BUFFER",
+		"MAP_BUFFER",
+		"COPY_BUFFER",
+		"UPDATE_TEXTURE",
+		"MAP_TEXTURE",
+		"COPY_TEXTURE",
+		"BUILD_MIP_SUB_LEVELS"
+	};
+	static_assert(sizeof(command_names) / sizeof(command_names[0]) == NCT_NumCommandTypes, "Missing command names");
+
+	uint64_t TechniqueID(RenderEffect const & effect, RenderTechnique const & tech)
+	{
+		size_t seed = effect.ResNameHash();
+		boost::hash_combine(seed, tech.NameHash());
+		return seed;
+	}
+
+	// Matches "<prefix><NAME>_COMMANDS"
+	bool MatchCommandAttrib(std::string const & name, char const * prefix, NullCommandType& type)
+	{
+		size_t const prefix_len = strlen(prefix);
+		static char const suffix[] = "_COMMANDS";
+		size_t const suffix_len = sizeof(suffix) - 1;
+		if ((name.size() > prefix_len + suffix_len) && (0 == name.compare(0, prefix_len, prefix))
+			&& (0 == name.compare(name.size() - suffix_len, suffix_len, suffix)))
+		{
+			std::string const cmd_name = name.substr(prefix_len, name.size() - prefix_len - suffix_len);
+			for (uint32_t i = 0; i < NCT_NumCommandTypes; ++ i)
+			{
+				if (cmd_name == command_names[i])
+				{
+					type = static_cast<NullCommandType>(i);
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+}
+
+namespace KlayGE
+{
+	NullRenderEngine::NullRenderEngine()
+		: full_screen_(false), record_commands_(true)
+	{
+		native_shader_fourcc_ = MakeFourCC<'N', 'U', 'L', 'L'>::value;
+		native_shader_version_ = 1;
+		native_shader_platform_name_ = "null";
+
+		cur_frame_counts_.fill(0);
+		last_frame_counts_.fill(0);
+		total_counts_.fill(0);
+	}
+
+	NullRenderEngine::~NullRenderEngine()
+	{
+		this->Destroy();
+	}
+
+	std::wstring const & NullRenderEngine::Name() const
+	{
+		static std::wstring const name(L"Null Render Engine");
+		return name;
+	}
+
+	void NullRenderEngine::BeginFrame()
+	{
+		{
+			std::lock_guard<std::mutex> lock(commands_mutex_);
+			cur_frame_commands_.clear();
+			cur_frame_counts_.fill(0);
+		}
+
+		RenderEngine::BeginFrame();
+	}
+
+	void NullRenderEngine::EndFrame()
+	{
+		RenderEngine::EndFrame();
+
+		std::lock_guard<std::mutex> lock(commands_mutex_);
+		last_frame_commands_.swap(cur_frame_commands_);
+		last_frame_counts_ = cur_frame_counts_;
+		cur_frame_commands_.clear();
+		cur_frame_counts_.fill(0);
+	}
+
+	void NullRenderEngine::ForceFlush()
+	{
+	}
+
+	TexturePtr const & NullRenderEngine::ScreenDepthStencilTexture() const
+	{
+		return screen_ds_tex_;
+	}
+
+	void NullRenderEngine::ScissorRect(uint32_t x, uint32_t y, uint32_t width, uint32_t height)
+	{
+		this->Record(NCT_ScissorRect, nullptr, 0, x, y, width, height);
+	}
+
+	void NullRenderEngine::GetCustomAttrib(std::string const & name, void* value)
+	{
+		std::lock_guard<std::mutex> lock(commands_mutex_);
+
+		size_t const name_hash = RT_HASH(name.c_str());
+		NullCommandType type;
+		if (CT_HASH("NUM_COMMANDS") == name_hash)
+		{
+			*static_cast<uint32_t*>(value) = static_cast<uint32_t>(last_frame_commands_.size());
+		}
+		else if (CT_HASH("COMMAND_LOG") == name_hash)
+		{
+			*static_cast<std::string*>(value) = CommandLog(last_frame_commands_);
+		}
+		else if (MatchCommandAttrib(name, "NUM_", type))
+		{
+			*static_cast<uint32_t*>(value) = last_frame_counts_[type];
+		}
+		else if (MatchCommandAttrib(name, "TOTAL_", type))
+		{
+			*static_cast<uint64_t*>(value) = total_counts_[type];
+		}
+	}
+
+	void NullRenderEngine::SetCustomAttrib(std::string const & name, void* value)
+	{
+		size_t const name_hash = RT_HASH(name.c_str());
+		if (CT_HASH("RECORD_COMMANDS") == name_hash)
+		{
+			this->RecordCommands(*static_cast<bool*>(value));
+		}
+		else if (CT_HASH("RESET_COMMAND_COUNTERS") == name_hash)
+		{
+			this->ResetCommandCounters();
+		}
+	}
+
+	bool NullRenderEngine::FullScreen() const
+	{
+		return full_screen_;
+	}
+
+	void NullRenderEngine::FullScreen(bool fs)
+	{
+		full_screen_ = fs;
+	}
+
+	void NullRenderEngine::Record(NullCommandType type, void const * object, uint64_t id,
+		uint32_t arg0, uint32_t arg1, uint32_t arg2, uint32_t arg3)
+	{
+		std::lock_guard<std::mutex> lock(commands_mutex_);
+
+		++ cur_frame_counts_[type];
+		++ total_counts_[type];
+
+		if (record_commands_)
+		{
+			NullCommand cmd;
+			cmd.type = type;
+			cmd.object = object;
+			cmd.id = id;
+			cmd.args[0] = arg0;
+			cmd.args[1] = arg1;
+			cmd.args[2] = arg2;
+			cmd.args[3] = arg3;
+			cur_frame_commands_.push_back(cmd);
+		}
+	}
+
+	void NullRenderEngine::BindShader(ShaderObject const * so)
+	{
+		if (this->UpdateStateCache(RST_Shader, 0, so))
+		{
+			this->Record(NCT_BindShader, so);
+		}
+	}
+
+	void NullRenderEngine::ResetCommandCounters()
+	{
+		std::lock_guard<std::mutex> lock(commands_mutex_);
+		total_counts_.fill(0);
+	}
+
+	char const * NullRenderEngine::CommandName(NullCommandType type)
+	{
+		BOOST_ASSERT(type < NCT_NumCommandTypes);
+		return command_names[type];
+	}
+
+	std::string NullRenderEngine::CommandLog(std::vector<NullCommand> const & commands)
+	{
+		std::ostringstream oss;
+		for (auto const & cmd : commands)
+		{
+			oss << CommandName(cmd.type) << ' ' << std::hex << std::setw(16) << std::setfill('0') << cmd.id << std::dec;
+			for (uint32_t i = 0; i < 4; ++ i)
+			{
+				oss << ' ' << cmd.args[i];
+			}
+			oss << '\n';
+		}
+		return oss.str();
+	}
+
+	void NullRenderEngine::DoCreateRenderWindow(std::string const & name, RenderSettings const & settings)
+	{
+		KFL_UNUSED(name);
+
+		settings_ = settings;
+		full_screen_ = settings.full_screen;
+
+		this->FillRenderDeviceCaps();
+
+		FrameBufferPtr win = MakeSharedPtr<NullFrameBuffer>(L"Null Render Window");
+		screen_frame_buffer_ = win;
+		this->CreateScreenBuffers(settings.width, settings.height);
+
+		this->BindFrameBuffer(win);
+	}
+
+	void NullRenderEngine::CreateScreenBuffers(uint32_t width, uint32_t height)
+	{
+		RenderFactory& rf = Context::Instance().RenderFactoryInstance();
+
+		screen_color_tex_ = rf.MakeTexture2D(width, height, 1, 1, settings_.color_fmt,
+			settings_.sample_count, settings_.sample_quality, EAH_GPU_Read | EAH_GPU_Write, nullptr);
+		screen_frame_buffer_->Attach(FrameBuffer::ATT_Color0, rf.Make2DRenderView(*screen_color_tex_, 0, 1, 0));
+
+		ElementFormat const ds_fmt = (settings_.depth_stencil_fmt != EF_Unknown) ? settings_.depth_stencil_fmt : EF_D24S8;
+		screen_ds_tex_ = rf.MakeTexture2D(width, height, 1, 1, ds_fmt,
+			settings_.sample_count, settings_.sample_quality, EAH_GPU_Read | EAH_GPU_Write, nullptr);
+		screen_frame_buffer_->Attach(FrameBuffer::ATT_DepthStencil, rf.Make2DDepthStencilRenderView(*screen_ds_tex_, 0, 1, 0));
+	}
+
+	void NullRenderEngine::DoBindFrameBuffer(FrameBufferPtr const & fb)
+	{
+		this->Record(NCT_BindFrameBuffer, fb.get(), 0, fb->Width(), fb->Height());
+	}
+
+	void NullRenderEngine::DoBindSOBuffers(RenderLayoutPtr const & rl)
+	{
+		this->Record(NCT_BindSOBuffers, rl.get(), 0, rl ? rl->NumVertexStreams() : 0);
+	}
+
+	void NullRenderEngine::DoRender(RenderEffect const & effect, RenderTechnique const & tech, RenderLayout const & rl)
+	{
+		uint32_t const num_instances = rl.NumInstances();
+		BOOST_ASSERT(num_instances != 0);
+
+		uint32_t const vertex_count = rl.UseIndices() ? rl.NumIndices() : rl.NumVertices();
+		RenderLayout::topology_type const tt = rl.TopologyType();
+		uint32_t prim_count;
+		switch (tt)
+		{
+		case RenderLayout::TT_PointList:
+			prim_count = vertex_count;
+			break;
+
+		case RenderLayout::TT_LineList:
+		case RenderLayout::TT_LineList_Adj:
+			prim_count = vertex_count / 2;
+			break;
+
+		case RenderLayout::TT_LineStrip:
+		case RenderLayout::TT_LineStrip_Adj:
+			prim_count = vertex_count - 1;
+			break;
+
+		case RenderLayout::TT_TriangleList:
+		case RenderLayout::TT_TriangleList_Adj:
+			prim_count = vertex_count / 3;
+			break;
+
+		case RenderLayout::TT_TriangleStrip:
+		case RenderLayout::TT_TriangleStrip_Adj:
+			prim_count = vertex_count - 2;
+			break;
+
+		default:
+			if ((tt >= RenderLayout::TT_1_Ctrl_Pt_PatchList)
+				&& (tt <= RenderLayout::TT_32_Ctrl_Pt_PatchList))
+			{
+				prim_count = vertex_count / (tt - RenderLayout::TT_1_Ctrl_Pt_PatchList + 1);
+			}
+			else
+			{
+				BOOST_ASSERT(false);
+				prim_count = 0;
+			}
+			break;
+		}
+
+		num_primitives_just_rendered_ += num_instances * prim_count;
+		num_vertices_just_rendered_ += num_instances * vertex_count;
+
+		uint64_t const id = TechniqueID(effect, tech);
+		uint32_t const num_passes = tech.NumPasses();
+		for (uint32_t i = 0; i < num_passes; ++ i)
+		{
+			auto& pass = tech.Pass(i);
+
+			pass.Bind(effect);
+			this->Record(NCT_Draw, &rl, id, i, vertex_count, num_instances, tt);
+			pass.Unbind(effect);
+		}
+
+		num_draws_just_called_ += num_passes;
+	}
+
+	void NullRenderEngine::DoDispatch(RenderEffect const & effect, RenderTechnique const & tech, uint32_t tgx, uint32_t tgy, uint32_t tgz)
+	{
+		uint64_t const id = TechniqueID(effect, tech);
+		uint32_t const num_passes = tech.NumPasses();
+		for (uint32_t i = 0; i < num_passes; ++ i)
+		{
+			auto& pass = tech.Pass(i);
+
+			pass.Bind(effect);
+			this->Record(NCT_Dispatch, nullptr, id, i, tgx, tgy, tgz);
+			pass.Unbind(effect);
+		}
+
+		num_dispatches_just_called_ += num_passes;
+	}
+
+	void NullRenderEngine::DoDispatchIndirect(RenderEffect const & effect, RenderTechnique const & tech,
+		GraphicsBufferPtr const & buff_args, uint32_t offset)
+	{
+		uint64_t const id = TechniqueID(effect, tech);
+		uint32_t const num_passes = tech.NumPasses();
+		for (uint32_t i = 0; i < num_passes; ++ i)
+		{
+			auto& pass = tech.Pass(i);
+
+			pass.Bind(effect);
+			this->Record(NCT_DispatchIndirect, buff_args.get(), id, i, offset);
+			pass.Unbind(effect);
+		}
+
+		num_dispatches_just_called_ += num_passes;
+	}
+
+	void NullRenderEngine::DoResize(uint32_t width, uint32_t height)
+	{
+		settings_.width = width;
+		settings_.height = height;
+		this->CreateScreenBuffers(width, height);
+	}
+
+	void NullRenderEngine::DoDestroy()
+	{
+		screen_color_tex_.reset();
+		screen_ds_tex_.reset();
+	}
+
+	void NullRenderEngine::DoSuspend()
+	{
+	}
+
+	void NullRenderEngine::DoResume()
+	{
+	}
+
+	void NullRenderEngine::FillRenderDeviceCaps()
+	{
+		caps_.max_shader_model = ShaderModel(5, 0);
+
+		caps_.max_texture_width = caps_.max_texture_height = 16384;
+		caps_.max_texture_depth = 2048;
+		caps_.max_texture_cube_size = 16384;
+		caps_.max_texture_array_length = 2048;
+		caps_.max_vertex_texture_units = 16;
+		caps_.max_pixel_texture_units = 16;
+		caps_.max_geometry_texture_units = 16;
+		caps_.max_simultaneous_rts = 8;
+		caps_.max_simultaneous_uavs = 8;
+		caps_.max_vertex_streams = 32;
+		caps_.max_texture_anisotropy = 16;
+
+		caps_.is_tbdr = false;
+
+		caps_.hw_instancing_support = true;
+		caps_.instance_id_support = true;
+		caps_.stream_output_support = true;
+		caps_.alpha_to_coverage_support = true;
+		caps_.primitive_restart_support = true;
+		caps_.multithread_rendering_support = false;
+		caps_.multithread_res_creating_support = true;
+		caps_.mrt_independent_bit_depths_support = true;
+		caps_.standard_derivatives_support = true;
+		caps_.shader_texture_lod_support = true;
+		caps_.logic_op_support = false;
+		caps_.independent_blend_support = true;
+		caps_.depth_texture_support = true;
+		caps_.fp_color_support = true;
+		caps_.pack_to_rgba_required = false;
+		caps_.draw_indirect_support = true;
+		caps_.no_overwrite_support = true;
+		caps_.cbuffer_partial_update_support = true;
+		caps_.full_npot_texture_support = true;
+		caps_.render_to_texture_array_support = true;
+		caps_.load_from_buffer_support = true;
+
+		caps_.gs_support = true;
+		caps_.cs_support = true;
+		caps_.hs_support = true;
+		caps_.ds_support = true;
+		caps_.tess_method = TM_Hardware;
+
+		caps_.vertex_format_support = [](ElementFormat elem_fmt)
+			{
+				return !IsCompressedFormat(elem_fmt) && !IsDepthFormat(elem_fmt);
+			};
+		caps_.texture_format_support = [](ElementFormat elem_fmt)
+			{
+				return elem_fmt != EF_Unknown;
+			};
+		caps_.rendertarget_format_support = [](ElementFormat elem_fmt, uint32_t sample_count, uint32_t /*sample_quality*/)
+			{
+				return (elem_fmt != EF_Unknown) && !IsCompressedFormat(elem_fmt) && (sample_count <= 8);
+			};
+	}
+}
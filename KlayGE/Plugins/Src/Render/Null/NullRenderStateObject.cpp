@@ -0,0 +1,88 @@
+/**
+ * @file NullRenderStateObject.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Util.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/RenderFactory.hpp>
+
+#include <KlayGE/Null/NullRenderEngine.hpp>
+#include <KlayGE/Null/NullRenderStateObject.hpp>
+
+namespace
+{
+	using namespace KlayGE;
+
+	NullRenderEngine& NullRE()
+	{
+		return *checked_cast<NullRenderEngine*>(&Context::Instance().RenderFactoryInstance().RenderEngineInstance());
+	}
+}
+
+namespace KlayGE
+{
+	NullRasterizerStateObject::NullRasterizerStateObject(RasterizerStateDesc const & desc)
+		: RasterizerStateObject(desc)
+	{
+	}
+
+	void NullRasterizerStateObject::Active()
+	{
+		NullRE().Record(NCT_SetRasterizerState, this);
+	}
+
+
+	NullDepthStencilStateObject::NullDepthStencilStateObject(DepthStencilStateDesc const & desc)
+		: DepthStencilStateObject(desc)
+	{
+	}
+
+	void NullDepthStencilStateObject::Active(uint16_t front_stencil_ref, uint16_t back_stencil_ref)
+	{
+		NullRE().Record(NCT_SetDepthStencilState, this, 0, front_stencil_ref, back_stencil_ref);
+	}
+
+
+	NullBlendStateObject::NullBlendStateObject(BlendStateDesc const & desc)
+		: BlendStateObject(desc)
+	{
+	}
+
+	void NullBlendStateObject::Active(Color const & blend_factor, uint32_t sample_mask)
+	{
+		NullRE().Record(NCT_SetBlendState, this, 0, blend_factor.ARGB(), sample_mask);
+	}
+
+
+	NullSamplerStateObject::NullSamplerStateObject(SamplerStateDesc const & desc)
+		: SamplerStateObject(desc)
+	{
+	}
+}
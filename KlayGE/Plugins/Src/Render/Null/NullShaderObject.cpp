@@ -0,0 +1,488 @@
+/**
+ * @file NullShaderObject.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Util.hpp>
+#include <KFL/ResIdentifier.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/RenderFactory.hpp>
+#include <KlayGE/RenderEffect.hpp>
+
+#include <cctype>
+#include <cstring>
+#include <string>
+
+#include <KlayGE/Null/NullRenderEngine.hpp>
+#include <KlayGE/Null/NullShaderObject.hpp>
+
+namespace
+{
+	using namespace KlayGE;
+
+	NullRenderEngine& NullRE()
+	{
+		return *checked_cast<NullRenderEngine*>(&Context::Instance().RenderFactoryInstance().RenderEngineInstance());
+	}
+
+	bool ParseUInt(std::string const & str, uint32_t& value)
+	{
+		if (str.empty())
+		{
+			return false;
+		}
+
+		uint32_t ret = 0;
+		for (auto const ch : str)
+		{
+			if (!std::isdigit(static_cast<unsigned char>(ch)))
+			{
+				return false;
+			}
+			ret = ret * 10 + (ch - '0');
+		}
+		value = ret;
+		return true;
+	}
+
+	std::string Trim(std::string const & str)
+	{
+		size_t const first = str.find_first_not_of(" \t\r\n");
+		if (first == std::string::npos)
+		{
+			return std::string();
+		}
+		size_t const last = str.find_last_not_of(" \t\r\n");
+		return str.substr(first, last - first + 1);
+	}
+
+	template <typename T>
+	bool ResolveMacro(T const & macros_owner, std::string const & name, uint32_t& value)
+	{
+		for (uint32_t i = 0; i < macros_owner.NumMacros(); ++ i)
+		{
+			auto const & macro = macros_owner.MacroByIndex(i);
+			if (macro.first == name)
+			{
+				return ParseUInt(Trim(macro.second), value);
+			}
+		}
+		return false;
+	}
+
+	// A literal, or a macro of the pass, the technique or the effect, in the order the HLSL text defines them
+	bool ResolveUInt(RenderEffect const & effect, RenderTechnique const * tech, RenderPass const * pass,
+		std::string const & token, uint32_t& value)
+	{
+		std::string const name = Trim(token);
+		if (ParseUInt(name, value))
+		{
+			return true;
+		}
+		if ((pass != nullptr) && ResolveMacro(*pass, name, value))
+		{
+			return true;
+		}
+		if ((tech != nullptr) && ResolveMacro(*tech, name, value))
+		{
+			return true;
+		}
+		return ResolveMacro(effect, name, value);
+	}
+
+#if KLAYGE_IS_DEV_PLATFORM
+	// Finds "[numthreads(x, y, z)] void func_name(" in the HLSL text of the effect
+	bool ParseNumThreads(RenderEffect const & effect, RenderTechnique const & tech, RenderPass const & pass,
+		std::string const & func_name, uint32_t& x, uint32_t& y, uint32_t& z)
+	{
+		std::string const & text = effect.HLSLShaderText();
+		static char const NUM_THREADS[] = "numthreads";
+
+		for (size_t pos = text.find(NUM_THREADS); pos != std::string::npos; pos = text.find(NUM_THREADS, pos + 1))
+		{
+			size_t const open = text.find('(', pos);
+			size_t const close = text.find(')', pos);
+			size_t const bracket = text.find(']', pos);
+			if ((open == std::string::npos) || (close == std::string::npos) || (bracket == std::string::npos)
+				|| (open > close) || (close > bracket))
+			{
+				continue;
+			}
+
+			size_t const ret_type = text.find_first_not_of(" \t\r\n", bracket + 1);
+			if ((ret_type == std::string::npos) || (text.compare(ret_type, 4, "void") != 0))
+			{
+				continue;
+			}
+			size_t const name = text.find_first_not_of(" \t\r\n", ret_type + 4);
+			if ((name == std::string::npos) || (text.compare(name, func_name.size(), func_name) != 0))
+			{
+				continue;
+			}
+			size_t const after_name = text.find_first_not_of(" \t\r\n", name + func_name.size());
+			if ((after_name == std::string::npos) || (text[after_name] != '('))
+			{
+				continue;
+			}
+
+			std::string const args = text.substr(open + 1, close - open - 1);
+			size_t const comma0 = args.find(',');
+			size_t const comma1 = (comma0 == std::string::npos) ? std::string::npos : args.find(',', comma0 + 1);
+			if (comma1 == std::string::npos)
+			{
+				return false;
+			}
+
+			bool ret = ResolveUInt(effect, &tech, &pass, args.substr(0, comma0), x);
+			ret &= ResolveUInt(effect, &tech, &pass, args.substr(comma0 + 1, comma1 - comma0 - 1), y);
+			ret &= ResolveUInt(effect, &tech, &pass, args.substr(comma1 + 1), z);
+			return ret;
+		}
+
+		return false;
+	}
+#endif
+
+	// Size and alignment of a variable in a constant buffer, with the HLSL packing rules
+	bool CBufferVariableSize(uint32_t type, uint32_t& size)
+	{
+		switch (type)
+		{
+		case REDT_bool:
+		case REDT_uint:
+		case REDT_int:
+		case REDT_float:
+			size = 4;
+			return true;
+
+		case REDT_uint2:
+		case REDT_int2:
+		case REDT_float2:
+			size = 8;
+			return true;
+
+		case REDT_uint3:
+		case REDT_int3:
+		case REDT_float3:
+			size = 12;
+			return true;
+
+		case REDT_uint4:
+		case REDT_int4:
+		case REDT_float4:
+			size = 16;
+			return true;
+
+		case REDT_float4x4:
+			size = 64;
+			return true;
+
+		default:
+			return false;
+		}
+	}
+}
+
+namespace KlayGE
+{
+	NullShaderObject::NullShaderObject()
+	{
+		is_shader_validate_.fill(true);
+		is_validate_ = false;
+	}
+
+	bool NullShaderObject::AttachNativeShader(ShaderType type, RenderEffect const & effect,
+		std::array<uint32_t, ST_NumShaderTypes> const & shader_desc_ids, std::vector<uint8_t> const & native_shader_block)
+	{
+		KFL_UNUSED(effect);
+		KFL_UNUSED(shader_desc_ids);
+
+		bool ret;
+		if (ST_ComputeShader == type)
+		{
+			if (native_shader_block.size() == 3 * sizeof(uint32_t))
+			{
+				uint32_t block_size[3];
+				memcpy(block_size, native_shader_block.data(), sizeof(block_size));
+				cs_block_size_x_ = LE2Native(block_size[0]);
+				cs_block_size_y_ = LE2Native(block_size[1]);
+				cs_block_size_z_ = LE2Native(block_size[2]);
+				ret = true;
+			}
+			else
+			{
+				ret = false;
+			}
+		}
+		else
+		{
+			if ((ST_HullShader == type) || (ST_DomainShader == type))
+			{
+				has_tessellation_ = true;
+			}
+			ret = true;
+		}
+
+		is_shader_validate_[type] = ret;
+		return ret;
+	}
+
+	bool NullShaderObject::StreamIn(ResIdentifierPtr const & res, ShaderType type, RenderEffect const & effect,
+		std::array<uint32_t, ST_NumShaderTypes> const & shader_desc_ids)
+	{
+		uint32_t len;
+		res->read(&len, sizeof(len));
+		len = LE2Native(len);
+		std::vector<uint8_t> native_shader_block(len);
+		if (len > 0)
+		{
+			res->read(&native_shader_block[0], len * sizeof(native_shader_block[0]));
+		}
+
+		return this->AttachNativeShader(type, effect, shader_desc_ids, native_shader_block);
+	}
+
+	void NullShaderObject::StreamOut(std::ostream& os, ShaderType type)
+	{
+		if (ST_ComputeShader == type)
+		{
+			uint32_t const len = Native2LE(static_cast<uint32_t>(3 * sizeof(uint32_t)));
+			os.write(reinterpret_cast<char const *>(&len), sizeof(len));
+
+			uint32_t const block_size[] = { Native2LE(cs_block_size_x_), Native2LE(cs_block_size_y_), Native2LE(cs_block_size_z_) };
+			os.write(reinterpret_cast<char const *>(block_size), sizeof(block_size));
+		}
+		else
+		{
+			uint32_t const len = 0;
+			os.write(reinterpret_cast<char const *>(&len), sizeof(len));
+		}
+	}
+
+	void NullShaderObject::AttachShader(ShaderType type, RenderEffect const & effect,
+			RenderTechnique const & tech, RenderPass const & pass, std::array<uint32_t, ST_NumShaderTypes> const & shader_desc_ids)
+	{
+		if (ST_ComputeShader == type)
+		{
+#if KLAYGE_IS_DEV_PLATFORM
+			ShaderDesc const & sd = effect.GetShaderDesc(shader_desc_ids[type]);
+			if (!ParseNumThreads(effect, tech, pass, sd.func_name, cs_block_size_x_, cs_block_size_y_, cs_block_size_z_))
+			{
+				LogWarn("Could not find the thread group size of %s, assuming 1x1x1.", sd.func_name.c_str());
+				cs_block_size_x_ = cs_block_size_y_ = cs_block_size_z_ = 1;
+			}
+#else
+			KFL_UNUSED(effect);
+			KFL_UNUSED(tech);
+			KFL_UNUSED(pass);
+			KFL_UNUSED(shader_desc_ids);
+
+			cs_block_size_x_ = cs_block_size_y_ = cs_block_size_z_ = 1;
+#endif
+		}
+		else
+		{
+			KFL_UNUSED(effect);
+			KFL_UNUSED(tech);
+			KFL_UNUSED(pass);
+			KFL_UNUSED(shader_desc_ids);
+
+			if ((ST_HullShader == type) || (ST_DomainShader == type))
+			{
+				has_tessellation_ = true;
+			}
+		}
+
+		is_shader_validate_[type] = true;
+	}
+
+	void NullShaderObject::AttachShader(ShaderType type, RenderEffect const & effect,
+			RenderTechnique const & tech, RenderPass const & pass, ShaderObjectPtr const & shared_so)
+	{
+		KFL_UNUSED(effect);
+		KFL_UNUSED(tech);
+		KFL_UNUSED(pass);
+
+		if (shared_so)
+		{
+			NullShaderObject const & so = *checked_cast<NullShaderObject*>(shared_so.get());
+
+			is_shader_validate_[type] = so.is_shader_validate_[type];
+			switch (type)
+			{
+			case ST_ComputeShader:
+				cs_block_size_x_ = so.cs_block_size_x_;
+				cs_block_size_y_ = so.cs_block_size_y_;
+				cs_block_size_z_ = so.cs_block_size_z_;
+				break;
+
+			case ST_HullShader:
+			case ST_DomainShader:
+				has_tessellation_ = true;
+				break;
+
+			default:
+				break;
+			}
+		}
+	}
+
+	void NullShaderObject::LinkShaders(RenderEffect const & effect)
+	{
+		is_validate_ = true;
+		for (size_t type = 0; type < ST_NumShaderTypes; ++ type)
+		{
+			is_validate_ &= is_shader_validate_[type];
+		}
+
+		this->LayoutCBuffers(effect);
+	}
+
+	// The reflection of the real backends only binds the constant buffers a shader uses. Without compiled code
+	// the usage is unknown, so every constant buffer of the effect is laid out once and bound to every pass.
+	void NullShaderObject::LayoutCBuffers(RenderEffect const & effect)
+	{
+		cbuff_indices_.clear();
+		cbuffs_.clear();
+
+		for (uint32_t i = 0; i < effect.NumCBuffers(); ++ i)
+		{
+			auto cbuff = effect.CBufferByIndex(i);
+			if (!cbuff->HWBuff())
+			{
+				std::vector<uint32_t> offsets(cbuff->NumParameters());
+				std::vector<bool> is_array(cbuff->NumParameters());
+
+				bool supported = true;
+				uint32_t offset = 0;
+				for (uint32_t j = 0; (j < cbuff->NumParameters()) && supported; ++ j)
+				{
+					RenderEffectParameter const * param = effect.ParameterByIndex(cbuff->ParameterIndex(j));
+
+					uint32_t size;
+					supported = CBufferVariableSize(param->Type(), size);
+					if (supported)
+					{
+						if (param->ArraySize())
+						{
+							uint32_t array_size;
+							supported = ResolveUInt(effect, nullptr, nullptr, *param->ArraySize(), array_size) && (array_size > 0);
+							if (supported)
+							{
+								// Every element starts a new register
+								uint32_t const stride = (REDT_float4x4 == param->Type()) ? 64 : 16;
+								offset = (offset + 15) & ~15U;
+								offsets[j] = offset;
+								is_array[j] = true;
+								offset += stride * array_size;
+							}
+						}
+						else
+						{
+							// Aligned to 16 if it doesn't fit in the rest of the register
+							if ((REDT_float4x4 == param->Type()) || ((offset & 15) + size > 16))
+							{
+								offset = (offset + 15) & ~15U;
+							}
+							offsets[j] = offset;
+							is_array[j] = false;
+							offset += size;
+						}
+					}
+				}
+
+				if (!supported || (0 == offset))
+				{
+					if (!supported)
+					{
+						LogWarn("Could not lay out the constant buffer %s.", cbuff->Name().c_str());
+					}
+					continue;
+				}
+
+				cbuff->Resize((offset + 15) & ~15U);
+				for (uint32_t j = 0; j < cbuff->NumParameters(); ++ j)
+				{
+					RenderEffectParameter* param = effect.ParameterByIndex(cbuff->ParameterIndex(j));
+					uint32_t stride;
+					if (is_array[j])
+					{
+						stride = (param->Type() != REDT_float4x4) ? 16 : 64;
+					}
+					else
+					{
+						stride = (param->Type() != REDT_float4x4) ? 4 : 16;
+					}
+					param->BindToCBuffer(*cbuff, offsets[j], stride);
+				}
+			}
+
+			if (cbuff->HWBuff())
+			{
+				cbuff_indices_.push_back(i);
+				cbuffs_.push_back(cbuff);
+			}
+		}
+	}
+
+	ShaderObjectPtr NullShaderObject::Clone(RenderEffect const & effect)
+	{
+		auto ret = MakeSharedPtr<NullShaderObject>();
+		ret->has_discard_ = has_discard_;
+		ret->has_tessellation_ = has_tessellation_;
+		ret->is_validate_ = is_validate_;
+		ret->is_shader_validate_ = is_shader_validate_;
+		ret->cs_block_size_x_ = cs_block_size_x_;
+		ret->cs_block_size_y_ = cs_block_size_y_;
+		ret->cs_block_size_z_ = cs_block_size_z_;
+
+		ret->cbuff_indices_ = cbuff_indices_;
+		ret->cbuffs_.resize(cbuff_indices_.size());
+		for (size_t i = 0; i < cbuff_indices_.size(); ++ i)
+		{
+			ret->cbuffs_[i] = effect.CBufferByIndex(cbuff_indices_[i]);
+		}
+
+		return ret;
+	}
+
+	void NullShaderObject::Bind()
+	{
+		for (auto cbuff : cbuffs_)
+		{
+			cbuff->Update();
+		}
+
+		NullRE().BindShader(this);
+	}
+
+	void NullShaderObject::Unbind()
+	{
+	}
+}
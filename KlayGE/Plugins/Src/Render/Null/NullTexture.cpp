@@ -0,0 +1,456 @@
+/**
+ * @file NullTexture.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Util.hpp>
+#include <KFL/Math.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/RenderFactory.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+#include <KlayGE/Null/NullRenderEngine.hpp>
+#include <KlayGE/Null/NullTexture.hpp>
+
+namespace
+{
+	using namespace KlayGE;
+
+	NullRenderEngine& NullRE()
+	{
+		return *checked_cast<NullRenderEngine*>(&Context::Instance().RenderFactoryInstance().RenderEngineInstance());
+	}
+}
+
+namespace KlayGE
+{
+	NullTexture::NullTexture(TextureType type, uint32_t width, uint32_t height, uint32_t depth, uint32_t num_mip_maps, uint32_t array_size,
+				ElementFormat format, uint32_t sample_count, uint32_t sample_quality, uint32_t access_hint)
+		: Texture(type, sample_count, sample_quality, access_hint),
+			width_(width), height_(height), depth_(depth), hw_res_ready_(false)
+	{
+		format_ = format;
+		array_size_ = array_size;
+
+		if (0 == num_mip_maps)
+		{
+			num_mip_maps_ = 1;
+			uint32_t w = width;
+			uint32_t h = height;
+			uint32_t d = depth;
+			while ((w != 1) || (h != 1) || (d != 1))
+			{
+				++ num_mip_maps_;
+
+				w = std::max<uint32_t>(1U, w / 2);
+				h = std::max<uint32_t>(1U, h / 2);
+				d = std::max<uint32_t>(1U, d / 2);
+			}
+		}
+		else
+		{
+			num_mip_maps_ = num_mip_maps;
+		}
+
+		subres_data_.resize(array_size_ * this->NumFaces() * num_mip_maps_);
+	}
+
+	std::wstring const & NullTexture::Name() const
+	{
+		static std::wstring const name(L"Null Texture");
+		return name;
+	}
+
+	uint32_t NullTexture::Width(uint32_t level) const
+	{
+		BOOST_ASSERT(level < num_mip_maps_);
+		return std::max<uint32_t>(1U, width_ >> level);
+	}
+
+	uint32_t NullTexture::Height(uint32_t level) const
+	{
+		BOOST_ASSERT(level < num_mip_maps_);
+		return std::max<uint32_t>(1U, height_ >> level);
+	}
+
+	uint32_t NullTexture::Depth(uint32_t level) const
+	{
+		BOOST_ASSERT(level < num_mip_maps_);
+		return std::max<uint32_t>(1U, depth_ >> level);
+	}
+
+	uint32_t NullTexture::RowPitch(uint32_t level) const
+	{
+		uint32_t const w = this->Width(level);
+		if (IsCompressedFormat(format_))
+		{
+			uint32_t const block_size = NumFormatBytes(format_) * 4;
+			return ((w + 3) / 4) * block_size;
+		}
+		else
+		{
+			return w * NumFormatBytes(format_);
+		}
+	}
+
+	uint32_t NullTexture::NumRows(uint32_t level) const
+	{
+		uint32_t const h = this->Height(level);
+		return IsCompressedFormat(format_) ? (h + 3) / 4 : h;
+	}
+
+	uint32_t NullTexture::SlicePitch(uint32_t level) const
+	{
+		return this->RowPitch(level) * this->NumRows(level);
+	}
+
+	uint8_t* NullTexture::Subresource(uint32_t array_index, uint32_t face, uint32_t level)
+	{
+		BOOST_ASSERT(array_index < array_size_);
+		BOOST_ASSERT(level < num_mip_maps_);
+
+		auto& data = subres_data_[(array_index * this->NumFaces() + face) * num_mip_maps_ + level];
+		if (data.empty())
+		{
+			data.resize(this->SlicePitch(level) * this->Depth(level), 0);
+		}
+		return data.data();
+	}
+
+	uint8_t* NullTexture::Texel(uint32_t array_index, uint32_t face, uint32_t level, uint32_t x_offset, uint32_t y_offset, uint32_t z_offset)
+	{
+		uint32_t offset = z_offset * this->SlicePitch(level);
+		if (IsCompressedFormat(format_))
+		{
+			offset += (y_offset / 4) * this->RowPitch(level) + (x_offset / 4) * NumFormatBytes(format_) * 4;
+		}
+		else
+		{
+			offset += y_offset * this->RowPitch(level) + x_offset * NumFormatBytes(format_);
+		}
+		return this->Subresource(array_index, face, level) + offset;
+	}
+
+	void NullTexture::RecordCopy(Texture& target)
+	{
+		NullRE().Record(NCT_CopyTexture, &target, 0, this->Width(0), this->Height(0), this->Depth(0));
+	}
+
+	void NullTexture::CopyToTexture(Texture& target)
+	{
+		this->RecordCopy(target);
+	}
+
+	void NullTexture::CopyToSubTexture1D(Texture& target,
+			uint32_t dst_array_index, uint32_t dst_level, uint32_t dst_x_offset, uint32_t dst_width,
+			uint32_t src_array_index, uint32_t src_level, uint32_t src_x_offset, uint32_t src_width)
+	{
+		KFL_UNUSED(dst_array_index);
+		KFL_UNUSED(dst_level);
+		KFL_UNUSED(dst_x_offset);
+		KFL_UNUSED(dst_width);
+		KFL_UNUSED(src_array_index);
+		KFL_UNUSED(src_level);
+		KFL_UNUSED(src_x_offset);
+		KFL_UNUSED(src_width);
+
+		this->RecordCopy(target);
+	}
+
+	void NullTexture::CopyToSubTexture2D(Texture& target,
+			uint32_t dst_array_index, uint32_t dst_level, uint32_t dst_x_offset, uint32_t dst_y_offset, uint32_t dst_width, uint32_t dst_height,
+			uint32_t src_array_index, uint32_t src_level, uint32_t src_x_offset, uint32_t src_y_offset, uint32_t src_width, uint32_t src_height)
+	{
+		KFL_UNUSED(dst_array_index);
+		KFL_UNUSED(dst_level);
+		KFL_UNUSED(dst_x_offset);
+		KFL_UNUSED(dst_y_offset);
+		KFL_UNUSED(dst_width);
+		KFL_UNUSED(dst_height);
+		KFL_UNUSED(src_array_index);
+		KFL_UNUSED(src_level);
+		KFL_UNUSED(src_x_offset);
+		KFL_UNUSED(src_y_offset);
+		KFL_UNUSED(src_width);
+		KFL_UNUSED(src_height);
+
+		this->RecordCopy(target);
+	}
+
+	void NullTexture::CopyToSubTexture3D(Texture& target,
+			uint32_t dst_array_index, uint32_t dst_level, uint32_t dst_x_offset, uint32_t dst_y_offset, uint32_t dst_z_offset, uint32_t dst_width, uint32_t dst_height, uint32_t dst_depth,
+			uint32_t src_array_index, uint32_t src_level, uint32_t src_x_offset, uint32_t src_y_offset, uint32_t src_z_offset, uint32_t src_width, uint32_t src_height, uint32_t src_depth)
+	{
+		KFL_UNUSED(dst_array_index);
+		KFL_UNUSED(dst_level);
+		KFL_UNUSED(dst_x_offset);
+		KFL_UNUSED(dst_y_offset);
+		KFL_UNUSED(dst_z_offset);
+		KFL_UNUSED(dst_width);
+		KFL_UNUSED(dst_height);
+		KFL_UNUSED(dst_depth);
+		KFL_UNUSED(src_array_index);
+		KFL_UNUSED(src_level);
+		KFL_UNUSED(src_x_offset);
+		KFL_UNUSED(src_y_offset);
+		KFL_UNUSED(src_z_offset);
+		KFL_UNUSED(src_width);
+		KFL_UNUSED(src_height);
+		KFL_UNUSED(src_depth);
+
+		this->RecordCopy(target);
+	}
+
+	void NullTexture::CopyToSubTextureCube(Texture& target,
+			uint32_t dst_array_index, CubeFaces dst_face, uint32_t dst_level, uint32_t dst_x_offset, uint32_t dst_y_offset, uint32_t dst_width, uint32_t dst_height,
+			uint32_t src_array_index, CubeFaces src_face, uint32_t src_level, uint32_t src_x_offset, uint32_t src_y_offset, uint32_t src_width, uint32_t src_height)
+	{
+		KFL_UNUSED(dst_array_index);
+		KFL_UNUSED(dst_face);
+		KFL_UNUSED(dst_level);
+		KFL_UNUSED(dst_x_offset);
+		KFL_UNUSED(dst_y_offset);
+		KFL_UNUSED(dst_width);
+		KFL_UNUSED(dst_height);
+		KFL_UNUSED(src_array_index);
+		KFL_UNUSED(src_face);
+		KFL_UNUSED(src_level);
+		KFL_UNUSED(src_x_offset);
+		KFL_UNUSED(src_y_offset);
+		KFL_UNUSED(src_width);
+		KFL_UNUSED(src_height);
+
+		this->RecordCopy(target);
+	}
+
+	void NullTexture::BuildMipSubLevels()
+	{
+		NullRE().Record(NCT_BuildMipSubLevels, this, 0, num_mip_maps_);
+	}
+
+	void NullTexture::Map(uint32_t array_index, uint32_t face, uint32_t level,
+			uint32_t x_offset, uint32_t y_offset, uint32_t z_offset,
+			void*& data, uint32_t& row_pitch, uint32_t& slice_pitch)
+	{
+		data = this->Texel(array_index, face, level, x_offset, y_offset, z_offset);
+		row_pitch = this->RowPitch(level);
+		slice_pitch = this->SlicePitch(level);
+
+		NullRE().Record(NCT_MapTexture, this, 0, array_index, face, level);
+	}
+
+	void NullTexture::Map1D(uint32_t array_index, uint32_t level, TextureMapAccess tma,
+			uint32_t x_offset, uint32_t width,
+			void*& data)
+	{
+		KFL_UNUSED(tma);
+		KFL_UNUSED(width);
+
+		uint32_t row_pitch, slice_pitch;
+		this->Map(array_index, 0, level, x_offset, 0, 0, data, row_pitch, slice_pitch);
+	}
+
+	void NullTexture::Map2D(uint32_t array_index, uint32_t level, TextureMapAccess tma,
+			uint32_t x_offset, uint32_t y_offset, uint32_t width, uint32_t height,
+			void*& data, uint32_t& row_pitch)
+	{
+		KFL_UNUSED(tma);
+		KFL_UNUSED(width);
+		KFL_UNUSED(height);
+
+		uint32_t slice_pitch;
+		this->Map(array_index, 0, level, x_offset, y_offset, 0, data, row_pitch, slice_pitch);
+	}
+
+	void NullTexture::Map3D(uint32_t array_index, uint32_t level, TextureMapAccess tma,
+			uint32_t x_offset, uint32_t y_offset, uint32_t z_offset,
+			uint32_t width, uint32_t height, uint32_t depth,
+			void*& data, uint32_t& row_pitch, uint32_t& slice_pitch)
+	{
+		KFL_UNUSED(tma);
+		KFL_UNUSED(width);
+		KFL_UNUSED(height);
+		KFL_UNUSED(depth);
+
+		this->Map(array_index, 0, level, x_offset, y_offset, z_offset, data, row_pitch, slice_pitch);
+	}
+
+	void NullTexture::MapCube(uint32_t array_index, CubeFaces face, uint32_t level, TextureMapAccess tma,
+			uint32_t x_offset, uint32_t y_offset, uint32_t width, uint32_t height,
+			void*& data, uint32_t& row_pitch)
+	{
+		KFL_UNUSED(tma);
+		KFL_UNUSED(width);
+		KFL_UNUSED(height);
+
+		uint32_t slice_pitch;
+		this->Map(array_index, face, level, x_offset, y_offset, 0, data, row_pitch, slice_pitch);
+	}
+
+	void NullTexture::Unmap1D(uint32_t array_index, uint32_t level)
+	{
+		KFL_UNUSED(array_index);
+		KFL_UNUSED(level);
+	}
+
+	void NullTexture::Unmap2D(uint32_t array_index, uint32_t level)
+	{
+		KFL_UNUSED(array_index);
+		KFL_UNUSED(level);
+	}
+
+	void NullTexture::Unmap3D(uint32_t array_index, uint32_t level)
+	{
+		KFL_UNUSED(array_index);
+		KFL_UNUSED(level);
+	}
+
+	void NullTexture::UnmapCube(uint32_t array_index, CubeFaces face, uint32_t level)
+	{
+		KFL_UNUSED(array_index);
+		KFL_UNUSED(face);
+		KFL_UNUSED(level);
+	}
+
+	void NullTexture::CreateHWResource(ElementInitData const * init_data)
+	{
+		if (init_data != nullptr)
+		{
+			uint32_t const num_faces = this->NumFaces();
+			for (uint32_t array_index = 0; array_index < array_size_; ++ array_index)
+			{
+				for (uint32_t face = 0; face < num_faces; ++ face)
+				{
+					for (uint32_t level = 0; level < num_mip_maps_; ++ level)
+					{
+						ElementInitData const & init = init_data[(array_index * num_faces + face) * num_mip_maps_ + level];
+						if (init.data != nullptr)
+						{
+							uint32_t const row_pitch = (init.row_pitch > 0) ? init.row_pitch : this->RowPitch(level);
+							uint32_t const slice_pitch = (init.slice_pitch > 0) ? init.slice_pitch : row_pitch * this->NumRows(level);
+
+							uint8_t* dst = this->Subresource(array_index, face, level);
+							uint8_t const * src = static_cast<uint8_t const *>(init.data);
+							uint32_t const dst_row_pitch = this->RowPitch(level);
+							uint32_t const copy_size = std::min(row_pitch, dst_row_pitch);
+							for (uint32_t z = 0; z < this->Depth(level); ++ z)
+							{
+								for (uint32_t y = 0; y < this->NumRows(level); ++ y)
+								{
+									memcpy(dst + (z * this->NumRows(level) + y) * dst_row_pitch, src + z * slice_pitch + y * row_pitch,
+										copy_size);
+								}
+							}
+						}
+					}
+				}
+			}
+		}
+
+		hw_res_ready_ = true;
+	}
+
+	void NullTexture::DeleteHWResource()
+	{
+		for (auto& data : subres_data_)
+		{
+			std::vector<uint8_t>().swap(data);
+		}
+		hw_res_ready_ = false;
+	}
+
+	bool NullTexture::HWResourceReady() const
+	{
+		return hw_res_ready_;
+	}
+
+	void NullTexture::Update(uint32_t array_index, uint32_t face, uint32_t level,
+			uint32_t x_offset, uint32_t y_offset, uint32_t z_offset,
+			uint32_t width, uint32_t height, uint32_t depth,
+			void const * data, uint32_t row_pitch, uint32_t slice_pitch)
+	{
+		uint32_t copy_size;
+		uint32_t num_rows;
+		if (IsCompressedFormat(format_))
+		{
+			copy_size = ((width + 3) / 4) * NumFormatBytes(format_) * 4;
+			num_rows = (height + 3) / 4;
+		}
+		else
+		{
+			copy_size = width * NumFormatBytes(format_);
+			num_rows = height;
+		}
+
+		uint32_t const dst_row_pitch = this->RowPitch(level);
+		uint32_t const dst_slice_pitch = this->SlicePitch(level);
+		uint8_t* dst = this->Texel(array_index, face, level, x_offset, y_offset, z_offset);
+		uint8_t const * src = static_cast<uint8_t const *>(data);
+		for (uint32_t z = 0; z < depth; ++ z)
+		{
+			for (uint32_t y = 0; y < num_rows; ++ y)
+			{
+				memcpy(dst + z * dst_slice_pitch + y * dst_row_pitch, src + z * slice_pitch + y * row_pitch, copy_size);
+			}
+		}
+
+		NullRE().Record(NCT_UpdateTexture, this, 0, array_index, face, level);
+	}
+
+	void NullTexture::UpdateSubresource1D(uint32_t array_index, uint32_t level,
+			uint32_t x_offset, uint32_t width,
+			void const * data)
+	{
+		this->Update(array_index, 0, level, x_offset, 0, 0, width, 1, 1, data, 0, 0);
+	}
+
+	void NullTexture::UpdateSubresource2D(uint32_t array_index, uint32_t level,
+			uint32_t x_offset, uint32_t y_offset, uint32_t width, uint32_t height,
+			void const * data, uint32_t row_pitch)
+	{
+		this->Update(array_index, 0, level, x_offset, y_offset, 0, width, height, 1, data, row_pitch, 0);
+	}
+
+	void NullTexture::UpdateSubresource3D(uint32_t array_index, uint32_t level,
+			uint32_t x_offset, uint32_t y_offset, uint32_t z_offset,
+			uint32_t width, uint32_t height, uint32_t depth,
+			void const * data, uint32_t row_pitch, uint32_t slice_pitch)
+	{
+		this->Update(array_index, 0, level, x_offset, y_offset, z_offset, width, height, depth, data, row_pitch, slice_pitch);
+	}
+
+	void NullTexture::UpdateSubresourceCube(uint32_t array_index, CubeFaces face, uint32_t level,
+			uint32_t x_offset, uint32_t y_offset, uint32_t width, uint32_t height,
+			void const * data, uint32_t row_pitch)
+	{
+		this->Update(array_index, face, level, x_offset, y_offset, 0, width, height, 1, data, row_pitch, 0);
+	}
+}
@@ -416,6 +416,7 @@ namespace KlayGE
 			dirty = (count > 0);
 		}
 
+		this->CountStateChange(RST_Texture, dirty);
 		if (dirty)
 		{
 			if (glloader_GL_VERSION_4_4() || glloader_GL_ARB_multi_bind())
@@ -439,7 +440,9 @@ namespace KlayGE
 	void OGLRenderEngine::BindBuffer(GLenum target, GLuint buffer, bool force)
 	{
 		auto iter = binded_buffers_.find(target);
-		if (force || (iter == binded_buffers_.end()) || (iter->second != buffer))
+		bool const dirty = force || (iter == binded_buffers_.end()) || (iter->second != buffer);
+		this->CountStateChange(RST_Buffer, dirty);
+		if (dirty)
 		{
 			glBindBuffer(target, buffer);
 			binded_buffers_[target] = buffer;
@@ -460,6 +463,7 @@ namespace KlayGE
 			dirty = (memcmp(&binded[first], buffers, count * sizeof(buffers[0])) != 0);
 		}
 
+		this->CountStateChange(RST_Buffer, dirty);
 		if (dirty)
 		{
 			if (glloader_GL_VERSION_4_4() || glloader_GL_ARB_multi_bind())
@@ -560,6 +564,7 @@ namespace KlayGE
 
 	void OGLRenderEngine::UseProgram(GLuint program)
 	{
+		this->CountStateChange(RST_Shader, program != cur_program_);
 		if (program != cur_program_)
 		{
 			glUseProgram(program);
@@ -1734,6 +1739,7 @@ namespace KlayGE
 			caps_.draw_indirect_support = false;
 		}
 		caps_.no_overwrite_support = false;
+		caps_.cbuffer_partial_update_support = true;
 		caps_.full_npot_texture_support = true;
 		if ((caps_.max_texture_array_length > 1)
 			&& (glloader_GL_VERSION_3_2() || glloader_GL_ARB_geometry_shader4() || glloader_GL_EXT_geometry_shader4()))
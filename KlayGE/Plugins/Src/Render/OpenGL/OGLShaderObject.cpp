@@ -1021,7 +1021,6 @@ namespace KlayGE
 			}
 
 			this->FillTFBVaryings(sd);
-			this->AttachGLSL(type);
 
 			ret = is_shader_validate_[type];
 		}
@@ -1571,7 +1570,6 @@ namespace KlayGE
 		if (is_shader_validate_[type])
 		{
 			this->FillTFBVaryings(sd);
-			this->AttachGLSL(type);
 		}
 	}
 
@@ -1635,8 +1633,6 @@ namespace KlayGE
 					}
 				}
 			}
-
-			this->AttachGLSL(type);
 		}
 	}
 
@@ -1647,6 +1643,12 @@ namespace KlayGE
 		{
 			if (!(*shader_func_names_)[type].empty())
 			{
+				// GLSL is compiled here rather than in AttachShader, which could be called outside the GL thread
+				if (is_shader_validate_[type] && (*glsl_srcs_)[type] && !(*glsl_srcs_)[type]->empty())
+				{
+					this->AttachGLSL(static_cast<uint32_t>(type));
+				}
+
 				is_validate_ &= is_shader_validate_[type];
 			}
 		}
@@ -368,6 +368,7 @@ namespace KlayGE
 			dirty = (count > 0);
 		}
 
+		this->CountStateChange(RST_Texture, dirty);
 		if (dirty)
 		{
 			for (uint32_t i = first; i < first + count; ++ i)
@@ -384,7 +385,9 @@ namespace KlayGE
 	void OGLESRenderEngine::BindBuffer(GLenum target, GLuint buffer, bool force)
 	{
 		auto iter = binded_buffers_.find(target);
-		if (force || (iter == binded_buffers_.end()) || (iter->second != buffer))
+		bool const dirty = force || (iter == binded_buffers_.end()) || (iter->second != buffer);
+		this->CountStateChange(RST_Buffer, dirty);
+		if (dirty)
 		{
 			glBindBuffer(target, buffer);
 			binded_buffers_[target] = buffer;
@@ -405,6 +408,7 @@ namespace KlayGE
 			dirty = (memcmp(&binded[first], buffers, count * sizeof(buffers[0])) != 0);
 		}
 
+		this->CountStateChange(RST_Buffer, dirty);
 		if (dirty)
 		{
 			for (uint32_t i = first; i < first + count; ++ i)
@@ -498,6 +502,7 @@ namespace KlayGE
 
 	void OGLESRenderEngine::UseProgram(GLuint program)
 	{
+		this->CountStateChange(RST_Shader, program != cur_program_);
 		if (program != cur_program_)
 		{
 			glUseProgram(program);
@@ -1659,6 +1664,7 @@ namespace KlayGE
 			caps_.draw_indirect_support = false;
 		}
 		caps_.no_overwrite_support = false;
+		caps_.cbuffer_partial_update_support = true;
 		if (this->HackForAndroidEmulator())
 		{
 			caps_.full_npot_texture_support = false;
@@ -1009,7 +1009,6 @@ namespace KlayGE
 			}
 
 			this->FillTFBVaryings(sd);
-			this->AttachGLSL(type);
 
 			ret = is_shader_validate_[type];
 		}
@@ -1491,7 +1490,6 @@ namespace KlayGE
 		if (is_shader_validate_[type])
 		{
 			this->FillTFBVaryings(sd);
-			this->AttachGLSL(type);
 		}
 	}
 
@@ -1550,8 +1548,6 @@ namespace KlayGE
 					}
 				}
 			}
-
-			this->AttachGLSL(type);
 		}
 	}
 
@@ -1562,6 +1558,12 @@ namespace KlayGE
 		{
 			if (!(*shader_func_names_)[type].empty())
 			{
+				// GLSL is compiled here rather than in AttachShader, which could be called outside the GL thread
+				if (is_shader_validate_[type] && (*glsl_srcs_)[type] && !(*glsl_srcs_)[type]->empty())
+				{
+					this->AttachGLSL(static_cast<uint32_t>(type));
+				}
+
 				is_validate_ &= is_shader_validate_[type];
 			}
 		}
@@ -0,0 +1,668 @@
+/**
+ * @file AABBTree.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Math.hpp>
+#include <KFL/SIMDBatch.hpp>
+
+#include <algorithm>
+#include <boost/assert.hpp>
+
+#include <KlayGE/BVH/AABBTree.hpp>
+
+namespace
+{
+	using namespace KlayGE;
+
+	// Leaves inserted incrementally are enlarged by this ratio of their longest half size
+	float const FAT_MARGIN_RATIO = 0.1f;
+	int const NUM_SAH_BINS = 16;
+
+	// Half of the surface area, enough to compare the SAH costs
+	float HalfArea(float3 const & extent)
+	{
+		return 4 * (extent.x() * extent.y() + extent.y() * extent.z() + extent.z() * extent.x());
+	}
+
+	void Union(float3& center, float3& extent, float3 const & c0, float3 const & e0, float3 const & c1, float3 const & e1)
+	{
+		float3 const min_pt = MathLib::minimize(c0 - e0, c1 - e1);
+		float3 const max_pt = MathLib::maximize(c0 + e0, c1 + e1);
+		center = (min_pt + max_pt) * 0.5f;
+		extent = (max_pt - min_pt) * 0.5f;
+	}
+
+	float UnionHalfArea(float3 const & c0, float3 const & e0, float3 const & c1, float3 const & e1)
+	{
+		float3 const min_pt = MathLib::minimize(c0 - e0, c1 - e1);
+		float3 const max_pt = MathLib::maximize(c0 + e0, c1 + e1);
+		return HalfArea((max_pt - min_pt) * 0.5f);
+	}
+}
+
+namespace KlayGE
+{
+	AABBTree::AABBTree()
+		: root_(-1), free_list_(-1), num_leaves_(0)
+	{
+	}
+
+	void AABBTree::Clear()
+	{
+		nodes_.clear();
+		root_ = -1;
+		free_list_ = -1;
+		num_leaves_ = 0;
+	}
+
+	void AABBTree::Build(std::vector<SceneObject*> const & objs, std::vector<AABBox> const & bounds)
+	{
+		BOOST_ASSERT(objs.size() == bounds.size());
+
+		this->Clear();
+		if (objs.empty())
+		{
+			return;
+		}
+
+		nodes_.reserve(objs.size() * 2 - 1);
+		std::vector<int> leaves(objs.size());
+		for (size_t i = 0; i < objs.size(); ++ i)
+		{
+			int const leaf = this->AllocateNode();
+			aabb_tree_node_t& node = nodes_[leaf];
+			node.center = bounds[i].Center();
+			node.extent = bounds[i].HalfSize();
+			node.obj = objs[i];
+			leaves[i] = leaf;
+		}
+		num_leaves_ = static_cast<uint32_t>(objs.size());
+
+		root_ = this->BuildRange(leaves, 0, leaves.size());
+		nodes_[root_].parent = -1;
+	}
+
+	int AABBTree::Insert(SceneObject* obj, AABBox const & aabb)
+	{
+		int const leaf = this->AllocateNode();
+		aabb_tree_node_t& node = nodes_[leaf];
+		node.center = aabb.Center();
+		node.extent = aabb.HalfSize();
+		float const margin = std::max(std::max(node.extent.x(), node.extent.y()), node.extent.z()) * FAT_MARGIN_RATIO;
+		node.extent += float3(margin, margin, margin);
+		node.obj = obj;
+
+		this->InsertLeaf(leaf);
+		++ num_leaves_;
+
+		return leaf;
+	}
+
+	void AABBTree::Remove(int proxy)
+	{
+		BOOST_ASSERT((proxy >= 0) && (proxy < static_cast<int>(nodes_.size())));
+		BOOST_ASSERT(nodes_[proxy].IsLeaf());
+
+		this->RemoveLeaf(proxy);
+		this->FreeNode(proxy);
+		-- num_leaves_;
+	}
+
+	bool AABBTree::Move(int proxy, AABBox const & aabb)
+	{
+		BOOST_ASSERT((proxy >= 0) && (proxy < static_cast<int>(nodes_.size())));
+		BOOST_ASSERT(nodes_[proxy].IsLeaf());
+
+		aabb_tree_node_t& node = nodes_[proxy];
+		float3 const fat_min = node.center - node.extent;
+		float3 const fat_max = node.center + node.extent;
+		if ((aabb.Min().x() >= fat_min.x()) && (aabb.Min().y() >= fat_min.y()) && (aabb.Min().z() >= fat_min.z())
+			&& (aabb.Max().x() <= fat_max.x()) && (aabb.Max().y() <= fat_max.y()) && (aabb.Max().z() <= fat_max.z()))
+		{
+			return false;
+		}
+
+		this->RemoveLeaf(proxy);
+
+		node.center = aabb.Center();
+		node.extent = aabb.HalfSize();
+		float const margin = std::max(std::max(node.extent.x(), node.extent.y()), node.extent.z()) * FAT_MARGIN_RATIO;
+		node.extent += float3(margin, margin, margin);
+
+		this->InsertLeaf(proxy);
+
+		return true;
+	}
+
+	void AABBTree::Cull(std::vector<SceneObject*>& objs, std::vector<BoundOverlap>& overlaps,
+		std::vector<uint8_t>& plane_masks, Frustum const & frustum)
+	{
+		objs.clear();
+		overlaps.clear();
+		plane_masks.clear();
+
+		if (-1 == root_)
+		{
+			return;
+		}
+
+		curr_level_.assign(1, root_);
+		curr_masks_.assign(1, SIMDBatchLib::ALL_FRUSTUM_PLANES);
+		while (!curr_level_.empty())
+		{
+			size_t const num = curr_level_.size();
+			soa_.resize(num * 6);
+			SIMDBatchLib::AABBoxSoA boxes;
+			boxes.center_x = &soa_[num * 0];
+			boxes.center_y = &soa_[num * 1];
+			boxes.center_z = &soa_[num * 2];
+			boxes.extent_x = &soa_[num * 3];
+			boxes.extent_y = &soa_[num * 4];
+			boxes.extent_z = &soa_[num * 5];
+			for (size_t i = 0; i < num; ++ i)
+			{
+				aabb_tree_node_t const & node = nodes_[curr_level_[i]];
+				soa_[num * 0 + i] = node.center.x();
+				soa_[num * 1 + i] = node.center.y();
+				soa_[num * 2 + i] = node.center.z();
+				soa_[num * 3 + i] = node.extent.x();
+				soa_[num * 4 + i] = node.extent.y();
+				soa_[num * 5 + i] = node.extent.z();
+			}
+
+			visible_bits_.assign((num + 31) / 32, 0);
+			level_overlaps_.resize(num);
+			SIMDBatchLib::IntersectAABBFrustum(&visible_bits_[0], &level_overlaps_[0], &curr_masks_[0], nullptr,
+				boxes, num, frustum);
+
+			next_level_.clear();
+			next_masks_.clear();
+			for (size_t i = 0; i < num; ++ i)
+			{
+				BoundOverlap const bo = level_overlaps_[i];
+				if (bo != BO_No)
+				{
+					int const index = curr_level_[i];
+					aabb_tree_node_t const & node = nodes_[index];
+					if (node.IsLeaf())
+					{
+						objs.push_back(node.obj);
+						overlaps.push_back(bo);
+						plane_masks.push_back(curr_masks_[i]);
+					}
+					else if (BO_Yes == bo)
+					{
+						this->CollectLeaves(index, objs, overlaps, plane_masks);
+					}
+					else
+					{
+						// The children only need to be tested against the planes their parent crosses
+						for (int c = 0; c < 2; ++ c)
+						{
+							next_level_.push_back(node.children[c]);
+							next_masks_.push_back(curr_masks_[i]);
+						}
+					}
+				}
+			}
+
+			curr_level_.swap(next_level_);
+			curr_masks_.swap(next_masks_);
+		}
+	}
+
+	uint32_t AABBTree::NumLeaves() const
+	{
+		return num_leaves_;
+	}
+
+	uint32_t AABBTree::Height() const
+	{
+		return (-1 == root_) ? 0 : static_cast<uint32_t>(nodes_[root_].height + 1);
+	}
+
+	bool AABBTree::Validate() const
+	{
+		if (-1 == root_)
+		{
+			return (0 == num_leaves_);
+		}
+		if (nodes_[root_].parent != -1)
+		{
+			return false;
+		}
+
+		uint32_t num_leaves = 0;
+		size_t num_nodes = 0;
+		std::vector<int> stack(1, root_);
+		while (!stack.empty())
+		{
+			int const index = stack.back();
+			stack.pop_back();
+			++ num_nodes;
+
+			aabb_tree_node_t const & node = nodes_[index];
+			if (node.IsLeaf())
+			{
+				if ((node.height != 0) || (nullptr == node.obj))
+				{
+					return false;
+				}
+				++ num_leaves;
+			}
+			else
+			{
+				float3 const min_pt = node.center - node.extent;
+				float3 const max_pt = node.center + node.extent;
+				float const tolerance = 1e-5f * (1 + MathLib::length(node.center) + MathLib::length(node.extent));
+				int height = 0;
+				for (int c = 0; c < 2; ++ c)
+				{
+					int const child_index = node.children[c];
+					if ((child_index < 0) || (child_index >= static_cast<int>(nodes_.size())))
+					{
+						return false;
+					}
+
+					aabb_tree_node_t const & child = nodes_[child_index];
+					if ((child.parent != index) || (child.height < 0))
+					{
+						return false;
+					}
+					float3 const child_min = child.center - child.extent;
+					float3 const child_max = child.center + child.extent;
+					for (int i = 0; i < 3; ++ i)
+					{
+						if ((child_min[i] < min_pt[i] - tolerance) || (child_max[i] > max_pt[i] + tolerance))
+						{
+							return false;
+						}
+					}
+
+					height = std::max(height, child.height + 1);
+					stack.push_back(child_index);
+				}
+				if (node.height != height)
+				{
+					return false;
+				}
+			}
+		}
+
+		// The nodes not in the tree are all in the free list
+		size_t num_free = 0;
+		for (int index = free_list_; index != -1; index = nodes_[index].parent)
+		{
+			if (nodes_[index].height != -1)
+			{
+				return false;
+			}
+			++ num_free;
+		}
+
+		return (num_leaves == num_leaves_) && (num_nodes + num_free == nodes_.size());
+	}
+
+	int AABBTree::AllocateNode()
+	{
+		int index;
+		if (free_list_ != -1)
+		{
+			index = free_list_;
+			free_list_ = nodes_[index].parent;
+		}
+		else
+		{
+			index = static_cast<int>(nodes_.size());
+			nodes_.resize(nodes_.size() + 1);
+		}
+
+		aabb_tree_node_t& node = nodes_[index];
+		node.parent = -1;
+		node.children[0] = -1;
+		node.children[1] = -1;
+		node.height = 0;
+		node.obj = nullptr;
+		return index;
+	}
+
+	void AABBTree::FreeNode(int index)
+	{
+		nodes_[index].parent = free_list_;
+		nodes_[index].height = -1;
+		nodes_[index].obj = nullptr;
+		free_list_ = index;
+	}
+
+	void AABBTree::InsertLeaf(int leaf)
+	{
+		if (-1 == root_)
+		{
+			root_ = leaf;
+			nodes_[leaf].parent = -1;
+			return;
+		}
+
+		// Descends to the sibling with the lowest SAH cost. The cost of a subtree includes the growth of its
+		// ancestors, the inheritance cost. Stops when making a new parent here is cheaper than going down.
+		float3 const leaf_center = nodes_[leaf].center;
+		float3 const leaf_extent = nodes_[leaf].extent;
+		int index = root_;
+		while (!nodes_[index].IsLeaf())
+		{
+			aabb_tree_node_t const & node = nodes_[index];
+			float const area = HalfArea(node.extent);
+			float const combined_area = UnionHalfArea(node.center, node.extent, leaf_center, leaf_extent);
+			float const cost = 2 * combined_area;
+			float const inheritance_cost = 2 * (combined_area - area);
+
+			float child_costs[2];
+			for (int c = 0; c < 2; ++ c)
+			{
+				aabb_tree_node_t const & child = nodes_[node.children[c]];
+				child_costs[c] = UnionHalfArea(child.center, child.extent, leaf_center, leaf_extent) + inheritance_cost;
+				if (!child.IsLeaf())
+				{
+					child_costs[c] -= HalfArea(child.extent);
+				}
+			}
+
+			if ((cost < child_costs[0]) && (cost < child_costs[1]))
+			{
+				break;
+			}
+
+			index = (child_costs[0] < child_costs[1]) ? node.children[0] : node.children[1];
+		}
+
+		int const sibling = index;
+		int const old_parent = nodes_[sibling].parent;
+		int const new_parent = this->AllocateNode();
+		nodes_[new_parent].parent = old_parent;
+		nodes_[new_parent].children[0] = sibling;
+		nodes_[new_parent].children[1] = leaf;
+		nodes_[sibling].parent = new_parent;
+		nodes_[leaf].parent = new_parent;
+		if (old_parent != -1)
+		{
+			int& slot = (nodes_[old_parent].children[0] == sibling) ? nodes_[old_parent].children[0]
+				: nodes_[old_parent].children[1];
+			slot = new_parent;
+		}
+		else
+		{
+			root_ = new_parent;
+		}
+
+		for (index = new_parent; index != -1; index = nodes_[index].parent)
+		{
+			this->UpdateNode(index);
+			index = this->Balance(index);
+		}
+	}
+
+	void AABBTree::RemoveLeaf(int leaf)
+	{
+		if (leaf == root_)
+		{
+			root_ = -1;
+			return;
+		}
+
+		int const parent = nodes_[leaf].parent;
+		int const grand_parent = nodes_[parent].parent;
+		int const sibling = (nodes_[parent].children[0] == leaf) ? nodes_[parent].children[1] : nodes_[parent].children[0];
+
+		nodes_[sibling].parent = grand_parent;
+		if (grand_parent != -1)
+		{
+			int& slot = (nodes_[grand_parent].children[0] == parent) ? nodes_[grand_parent].children[0]
+				: nodes_[grand_parent].children[1];
+			slot = sibling;
+
+			for (int index = grand_parent; index != -1; index = nodes_[index].parent)
+			{
+				this->UpdateNode(index);
+				index = this->Balance(index);
+			}
+		}
+		else
+		{
+			root_ = sibling;
+		}
+
+		this->FreeNode(parent);
+	}
+
+	// Rotates the taller grandchild up if the node is unbalanced. Returns the node now at the place of index.
+	int AABBTree::Balance(int index)
+	{
+		aabb_tree_node_t& a = nodes_[index];
+		if (a.IsLeaf() || (a.height < 2))
+		{
+			return index;
+		}
+
+		int const balance = nodes_[a.children[1]].height - nodes_[a.children[0]].height;
+		if ((balance >= -1) && (balance <= 1))
+		{
+			return index;
+		}
+
+		// The taller child goes up, and its shorter child goes down to a
+		int const up_slot = (balance > 1) ? 1 : 0;
+		int const up = a.children[up_slot];
+		aabb_tree_node_t& b = nodes_[up];
+		int const b_taller = (nodes_[b.children[0]].height > nodes_[b.children[1]].height) ? 0 : 1;
+		int const down = b.children[1 - b_taller];
+
+		b.parent = a.parent;
+		if (b.parent != -1)
+		{
+			int& slot = (nodes_[b.parent].children[0] == index) ? nodes_[b.parent].children[0]
+				: nodes_[b.parent].children[1];
+			slot = up;
+		}
+		else
+		{
+			root_ = up;
+		}
+
+		b.children[1 - b_taller] = index;
+		a.parent = up;
+		a.children[up_slot] = down;
+		nodes_[down].parent = index;
+
+		this->UpdateNode(index);
+		this->UpdateNode(up);
+
+		return up;
+	}
+
+	void AABBTree::UpdateNode(int index)
+	{
+		aabb_tree_node_t& node = nodes_[index];
+		aabb_tree_node_t const & c0 = nodes_[node.children[0]];
+		aabb_tree_node_t const & c1 = nodes_[node.children[1]];
+		Union(node.center, node.extent, c0.center, c0.extent, c1.center, c1.extent);
+		node.height = std::max(c0.height, c1.height) + 1;
+	}
+
+	int AABBTree::BuildRange(std::vector<int>& leaves, size_t begin, size_t end)
+	{
+		BOOST_ASSERT(begin < end);
+
+		if (end - begin == 1)
+		{
+			return leaves[begin];
+		}
+
+		float3 centroid_min = nodes_[leaves[begin]].center;
+		float3 centroid_max = centroid_min;
+		for (size_t i = begin + 1; i < end; ++ i)
+		{
+			centroid_min = MathLib::minimize(centroid_min, nodes_[leaves[i]].center);
+			centroid_max = MathLib::maximize(centroid_max, nodes_[leaves[i]].center);
+		}
+		float3 const span = centroid_max - centroid_min;
+		int axis = (span.x() > span.y()) ? 0 : 1;
+		if (span.z() > span[axis])
+		{
+			axis = 2;
+		}
+
+		size_t mid = begin;
+		if (span[axis] > 0)
+		{
+			// Binned SAH over the centroids on the longest axis
+			float const bin_scale = NUM_SAH_BINS / span[axis];
+			auto bin_of = [this, axis, bin_scale, &centroid_min](int leaf)
+			{
+				int const bin = static_cast<int>((nodes_[leaf].center[axis] - centroid_min[axis]) * bin_scale);
+				return std::min(bin, NUM_SAH_BINS - 1);
+			};
+
+			uint32_t bin_counts[NUM_SAH_BINS] = { 0 };
+			float3 bin_mins[NUM_SAH_BINS];
+			float3 bin_maxs[NUM_SAH_BINS];
+			for (size_t i = begin; i < end; ++ i)
+			{
+				aabb_tree_node_t const & node = nodes_[leaves[i]];
+				int const bin = bin_of(leaves[i]);
+				if (0 == bin_counts[bin])
+				{
+					bin_mins[bin] = node.center - node.extent;
+					bin_maxs[bin] = node.center + node.extent;
+				}
+				else
+				{
+					bin_mins[bin] = MathLib::minimize(bin_mins[bin], node.center - node.extent);
+					bin_maxs[bin] = MathLib::maximize(bin_maxs[bin], node.center + node.extent);
+				}
+				++ bin_counts[bin];
+			}
+
+			// right_costs[i] is the cost of the bins [i, NUM_SAH_BINS)
+			float right_costs[NUM_SAH_BINS];
+			{
+				uint32_t count = 0;
+				float3 min_pt, max_pt;
+				for (int i = NUM_SAH_BINS - 1; i > 0; -- i)
+				{
+					if (bin_counts[i] > 0)
+					{
+						min_pt = (0 == count) ? bin_mins[i] : MathLib::minimize(min_pt, bin_mins[i]);
+						max_pt = (0 == count) ? bin_maxs[i] : MathLib::maximize(max_pt, bin_maxs[i]);
+						count += bin_counts[i];
+					}
+					right_costs[i] = (count > 0) ? HalfArea((max_pt - min_pt) * 0.5f) * count : -1;
+				}
+			}
+
+			int best_split = -1;
+			float best_cost = 0;
+			{
+				uint32_t count = 0;
+				float3 min_pt, max_pt;
+				for (int i = 0; i < NUM_SAH_BINS - 1; ++ i)
+				{
+					if (bin_counts[i] > 0)
+					{
+						min_pt = (0 == count) ? bin_mins[i] : MathLib::minimize(min_pt, bin_mins[i]);
+						max_pt = (0 == count) ? bin_maxs[i] : MathLib::maximize(max_pt, bin_maxs[i]);
+						count += bin_counts[i];
+					}
+					if ((count > 0) && (right_costs[i + 1] >= 0))
+					{
+						float const cost = HalfArea((max_pt - min_pt) * 0.5f) * count + right_costs[i + 1];
+						if ((best_split < 0) || (cost < best_cost))
+						{
+							best_split = i + 1;
+							best_cost = cost;
+						}
+					}
+				}
+			}
+
+			if (best_split > 0)
+			{
+				mid = std::partition(leaves.begin() + begin, leaves.begin() + end,
+					[&bin_of, best_split](int leaf)
+					{
+						return bin_of(leaf) < best_split;
+					}) - leaves.begin();
+			}
+		}
+		if ((mid == begin) || (mid == end))
+		{
+			// All centroids in one bin, falls back to the median
+			mid = (begin + end) / 2;
+			std::nth_element(leaves.begin() + begin, leaves.begin() + mid, leaves.begin() + end,
+				[this, axis](int lhs, int rhs)
+				{
+					return nodes_[lhs].center[axis] < nodes_[rhs].center[axis];
+				});
+		}
+
+		int const left = this->BuildRange(leaves, begin, mid);
+		int const right = this->BuildRange(leaves, mid, end);
+		int const index = this->AllocateNode();
+		nodes_[index].children[0] = left;
+		nodes_[index].children[1] = right;
+		nodes_[left].parent = index;
+		nodes_[right].parent = index;
+		this->UpdateNode(index);
+		return index;
+	}
+
+	void AABBTree::CollectLeaves(int index, std::vector<SceneObject*>& objs, std::vector<BoundOverlap>& overlaps,
+		std::vector<uint8_t>& plane_masks)
+	{
+		stack_.assign(1, index);
+		while (!stack_.empty())
+		{
+			int const i = stack_.back();
+			stack_.pop_back();
+
+			aabb_tree_node_t const & node = nodes_[i];
+			if (node.IsLeaf())
+			{
+				objs.push_back(node.obj);
+				overlaps.push_back(BO_Yes);
+				plane_masks.push_back(0);
+			}
+			else
+			{
+				stack_.push_back(node.children[0]);
+				stack_.push_back(node.children[1]);
+			}
+		}
+	}
+}
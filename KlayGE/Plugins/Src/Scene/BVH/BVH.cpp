@@ -0,0 +1,340 @@
+/**
+ * @file BVH.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Util.hpp>
+#include <KFL/Math.hpp>
+#include <KFL/SIMDBatch.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/SceneObject.hpp>
+#include <KlayGE/Camera.hpp>
+#include <KlayGE/App3D.hpp>
+#include <KlayGE/DeferredRenderingLayer.hpp>
+
+#include <algorithm>
+#include <boost/assert.hpp>
+
+#include <KlayGE/BVH/BVH.hpp>
+
+namespace KlayGE
+{
+	BVH::BVH()
+		: rebuild_tree_(false)
+	{
+	}
+
+	void BVH::ClipScene()
+	{
+		if (rebuild_tree_)
+		{
+			this->RebuildStaticTree();
+			rebuild_tree_ = false;
+		}
+
+		App3DFramework& app = Context::Instance().AppInstance();
+		Camera& camera = app.ActiveCamera();
+
+		view_proj_ = camera.ViewProjMatrix();
+		auto drl = Context::Instance().DeferredRenderingLayerInstance();
+		if (drl)
+		{
+			int32_t cas_index = drl->CurrCascadeIndex();
+			if (cas_index >= 0)
+			{
+				view_proj_ *= drl->GetCascadedShadowLayer()->CascadeCropMatrix(cas_index);
+			}
+		}
+		eye_pos_ = camera.EyePos();
+
+		bool const omni = camera.OmniDirectionalMode();
+		if (!omni)
+		{
+			this->UpdateDynamicTree();
+
+			std::fill(visible_marks_->begin(), visible_marks_->end(), BO_No);
+
+			static_tree_.Cull(leaf_objs_, leaf_overlaps_, leaf_plane_masks_, *frustum_);
+			this->MarkLeaves(true);
+			dynamic_tree_.Cull(leaf_objs_, leaf_overlaps_, leaf_plane_masks_, *frustum_);
+			this->MarkLeaves(false);
+		}
+
+		for (auto const & obj : scene_objs_)
+		{
+			auto so = obj.get();
+			BoundOverlap visible = BO_No;
+			if (so->Visible())
+			{
+				visible = this->VisibleTestFromParent(so, eye_pos_, view_proj_);
+				if (BO_Partial == visible)
+				{
+					uint32_t const attr = so->Attrib();
+					if (attr & SceneObject::SOA_Cullable)
+					{
+						if (omni)
+						{
+							if (attr & SceneObject::SOA_Moveable)
+							{
+								so->UpdateAbsModelMatrix();
+							}
+							visible = this->SmallObjectTest(so, BO_Yes);
+						}
+						else
+						{
+							// Marked by the trees
+							visible = this->VisibleMark(so);
+						}
+					}
+					else
+					{
+						if (attr & SceneObject::SOA_Moveable)
+						{
+							so->UpdateAbsModelMatrix();
+						}
+						visible = BO_Yes;
+					}
+				}
+			}
+			this->VisibleMark(so, visible);
+		}
+
+		this->OcclusionCull(camera, view_proj_);
+	}
+
+	// Each view walks the trees, so only the objects near the frusta are tested
+	void BVH::ClipViewBounds(std::vector<Frustum> const & frusta, std::vector<std::vector<BoundOverlap>>& overlaps)
+	{
+		if (rebuild_tree_)
+		{
+			this->RebuildStaticTree();
+			rebuild_tree_ = false;
+		}
+		this->UpdateDynamicTree();
+
+		for (size_t v = 0; v < frusta.size(); ++ v)
+		{
+			std::vector<BoundOverlap>& view_overlaps = overlaps[v];
+
+			static_tree_.Cull(leaf_objs_, leaf_overlaps_, leaf_plane_masks_, frusta[v]);
+			for (size_t i = 0; i < leaf_objs_.size(); ++ i)
+			{
+				view_overlaps[leaf_objs_[i]->SceneIndex()] = leaf_overlaps_[i];
+			}
+
+			dynamic_tree_.Cull(leaf_objs_, leaf_overlaps_, leaf_plane_masks_, frusta[v]);
+			this->RefineFatLeaves(frusta[v]);
+			for (size_t i = 0; i < leaf_objs_.size(); ++ i)
+			{
+				view_overlaps[leaf_objs_[i]->SceneIndex()] = leaf_overlaps_[i];
+			}
+		}
+	}
+
+	void BVH::ClearObject()
+	{
+		SceneManager::ClearObject();
+
+		static_tree_.Clear();
+		dynamic_tree_.Clear();
+		dynamic_proxies_.clear();
+		rebuild_tree_ = true;
+	}
+
+	void BVH::OnAddSceneObject(SceneObjectPtr const & obj)
+	{
+		uint32_t const attr = obj->Attrib();
+		if (attr & SceneObject::SOA_Cullable)
+		{
+			if (attr & SceneObject::SOA_Moveable)
+			{
+				// Added again when the renderable is attached, with a new bound
+				auto iter = dynamic_proxies_.find(obj.get());
+				if (iter != dynamic_proxies_.end())
+				{
+					dynamic_tree_.Remove(iter->second);
+					iter->second = dynamic_tree_.Insert(obj.get(), obj->PosBoundWS());
+				}
+				else
+				{
+					dynamic_proxies_.emplace(obj.get(), dynamic_tree_.Insert(obj.get(), obj->PosBoundWS()));
+				}
+			}
+			else
+			{
+				rebuild_tree_ = true;
+			}
+		}
+	}
+
+	void BVH::OnDelSceneObject(std::vector<SceneObjectPtr>::iterator iter)
+	{
+		BOOST_ASSERT(iter != scene_objs_.end());
+
+		uint32_t const attr = (*iter)->Attrib();
+		if (attr & SceneObject::SOA_Cullable)
+		{
+			if (attr & SceneObject::SOA_Moveable)
+			{
+				auto proxy_iter = dynamic_proxies_.find(iter->get());
+				if (proxy_iter != dynamic_proxies_.end())
+				{
+					dynamic_tree_.Remove(proxy_iter->second);
+					dynamic_proxies_.erase(proxy_iter);
+				}
+			}
+			else
+			{
+				rebuild_tree_ = true;
+			}
+		}
+	}
+
+	void BVH::DoSuspend()
+	{
+	}
+
+	void BVH::DoResume()
+	{
+	}
+
+	void BVH::RebuildStaticTree()
+	{
+		std::vector<SceneObject*> objs;
+		std::vector<AABBox> bounds;
+		for (auto const & obj : scene_objs_)
+		{
+			uint32_t const attr = obj->Attrib();
+			if ((attr & SceneObject::SOA_Cullable)
+				&& !(attr & SceneObject::SOA_Moveable))
+			{
+				objs.push_back(obj.get());
+				bounds.push_back(obj->PosBoundWS());
+			}
+		}
+		static_tree_.Build(objs, bounds);
+	}
+
+	// Refits the moving objects. Most of them stay in their fat leaves and don't change the tree.
+	void BVH::UpdateDynamicTree()
+	{
+		for (auto const & obj : scene_objs_)
+		{
+			uint32_t const attr = obj->Attrib();
+			if ((attr & SceneObject::SOA_Cullable) && (attr & SceneObject::SOA_Moveable) && obj->Visible())
+			{
+				auto iter = dynamic_proxies_.find(obj.get());
+				if (iter != dynamic_proxies_.end())
+				{
+					obj->UpdateAbsModelMatrix();
+					dynamic_tree_.Move(iter->second, obj->PosBoundWS());
+				}
+			}
+		}
+	}
+
+	// The leaves of the dynamic tree are fat. The objects partially inside are tested again with their own
+	// bounds, from the planes their leaves cross.
+	void BVH::RefineFatLeaves(Frustum const & frustum)
+	{
+		partial_leaves_.clear();
+		partial_plane_masks_.clear();
+		for (size_t i = 0; i < leaf_objs_.size(); ++ i)
+		{
+			if (BO_Partial == leaf_overlaps_[i])
+			{
+				partial_leaves_.push_back(i);
+				partial_plane_masks_.push_back(leaf_plane_masks_[i]);
+			}
+		}
+
+		size_t const num = partial_leaves_.size();
+		if (num > 0)
+		{
+			soa_.resize(num * 6);
+			SIMDBatchLib::AABBoxSoA boxes;
+			boxes.center_x = &soa_[num * 0];
+			boxes.center_y = &soa_[num * 1];
+			boxes.center_z = &soa_[num * 2];
+			boxes.extent_x = &soa_[num * 3];
+			boxes.extent_y = &soa_[num * 4];
+			boxes.extent_z = &soa_[num * 5];
+			for (size_t i = 0; i < num; ++ i)
+			{
+				AABBox const & aabb = leaf_objs_[partial_leaves_[i]]->PosBoundWS();
+				float3 const center = aabb.Center();
+				float3 const extent = aabb.HalfSize();
+				soa_[num * 0 + i] = center.x();
+				soa_[num * 1 + i] = center.y();
+				soa_[num * 2 + i] = center.z();
+				soa_[num * 3 + i] = extent.x();
+				soa_[num * 4 + i] = extent.y();
+				soa_[num * 5 + i] = extent.z();
+			}
+
+			visible_bits_.assign((num + 31) / 32, 0);
+			overlaps_.resize(num);
+			SIMDBatchLib::IntersectAABBFrustum(&visible_bits_[0], &overlaps_[0], &partial_plane_masks_[0], nullptr,
+				boxes, num, frustum);
+			for (size_t i = 0; i < num; ++ i)
+			{
+				leaf_overlaps_[partial_leaves_[i]] = overlaps_[i];
+			}
+		}
+	}
+
+	void BVH::MarkLeaves(bool exact_leaves)
+	{
+		if (!exact_leaves)
+		{
+			this->RefineFatLeaves(*frustum_);
+		}
+
+		for (size_t i = 0; i < leaf_objs_.size(); ++ i)
+		{
+			if (leaf_overlaps_[i] != BO_No)
+			{
+				this->VisibleMark(leaf_objs_[i], this->SmallObjectTest(leaf_objs_[i], leaf_overlaps_[i]));
+			}
+		}
+	}
+
+	BoundOverlap BVH::SmallObjectTest(SceneObject* obj, BoundOverlap bo) const
+	{
+		if (obj->Parent() || (small_obj_threshold_ <= 0)
+			|| (MathLib::perspective_area(eye_pos_, view_proj_, obj->PosBoundWS()) > small_obj_threshold_))
+		{
+			return bo;
+		}
+		else
+		{
+			return BO_No;
+		}
+	}
+}
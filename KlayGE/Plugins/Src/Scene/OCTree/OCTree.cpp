@@ -96,10 +96,18 @@ namespace
 }
 #endif
 
+namespace
+{
+	// A leaf is split when it has more objects than this, and a subtree is merged back when it has no more
+	// than MERGE_THRESHOLD. The gap keeps a node from splitting and merging every frame.
+	uint32_t const SPLIT_THRESHOLD = 8;
+	uint32_t const MERGE_THRESHOLD = 4;
+}
+
 namespace KlayGE
 {
 	OCTree::OCTree()
-		: max_tree_depth_(4), rebuild_tree_(false)
+		: free_obj_index_(-1), max_tree_depth_(4), rebuild_tree_(false)
 	{
 	}
 
@@ -117,28 +125,7 @@ namespace KlayGE
 	{
 		if (rebuild_tree_)
 		{
-			octree_.resize(1);
-			AABBox bb_root(float3(0, 0, 0), float3(0, 0, 0));
-			octree_[0].first_child_index = -1;
-			octree_[0].visible = BO_No;
-			for (auto const & obj : scene_objs_)
-			{
-				uint32_t const attr = obj->Attrib();
-				if ((attr & SceneObject::SOA_Cullable)
-					&& !(attr & SceneObject::SOA_Moveable))
-				{
-					bb_root |= obj->PosBoundWS();
-					octree_[0].obj_ptrs.push_back(obj.get());
-				}
-			}
-			float3 const & center = bb_root.Center();
-			float3 const & extent = bb_root.HalfSize();
-			float longest_dim = std::max(std::max(extent.x(), extent.y()), extent.z());
-			float3 new_extent(longest_dim, longest_dim, longest_dim);
-			octree_[0].bb = AABBox(center - new_extent, center + new_extent);
-
-			this->DivideNode(0, 1);
-
+			this->RebuildTree();
 			rebuild_tree_ = false;
 		}
 
@@ -152,7 +139,7 @@ namespace KlayGE
 
 		if (!octree_.empty())
 		{
-			this->NodeVisible(0);
+			this->NodeVisible(0, true);
 		}
 
 		App3DFramework& app = Context::Instance().AppInstance();
@@ -193,12 +180,12 @@ namespace KlayGE
 						{
 							bo = BO_Yes;
 						}
-						obj->VisibleMark(bo);
+						this->VisibleMark(obj.get(), bo);
 					}
 				}
 				else
 				{
-					obj->VisibleMark(BO_No);
+					this->VisibleMark(obj.get(), BO_No);
 				}
 			}
 		}
@@ -222,50 +209,228 @@ namespace KlayGE
 							obj->UpdateAbsModelMatrix();
 						}
 
+						// The static ones are in the tree, and already marked by MarkNodeObjs
 						if (attr & SceneObject::SOA_Cullable)
 						{
 							if (attr & SceneObject::SOA_Moveable)
 							{
-								obj->VisibleMark(this->AABBVisible(obj->PosBoundWS()));
-							}
-							else
-							{
-								obj->VisibleMark(visible);
+								this->VisibleMark(obj.get(), this->AABBVisible(obj->PosBoundWS()));
 							}
 						}
 						else
 						{
-							obj->VisibleMark(BO_Yes);
+							this->VisibleMark(obj.get(), BO_Yes);
 						}
 					}
 					else
 					{
-						obj->VisibleMark(visible);
+						this->VisibleMark(obj.get(), visible);
 					}
 				}
 			}
 		}
 
+		this->OcclusionCull(camera, view_proj);
+
 #ifdef KLAYGE_DRAW_NODES
 		node_renderable_->Render();
 #endif
 	}
 
+	// The static objects are reached through the tree per view, the moveable ones are tested one by one
+	void OCTree::ClipViewBounds(std::vector<Frustum> const & frusta, std::vector<std::vector<BoundOverlap>>& overlaps)
+	{
+		if (rebuild_tree_)
+		{
+			this->RebuildTree();
+			rebuild_tree_ = false;
+		}
+
+		if (!octree_.empty())
+		{
+			for (size_t v = 0; v < frusta.size(); ++ v)
+			{
+				this->NodeViewBounds(0, frusta[v], false, overlaps[v]);
+			}
+		}
+
+		for (size_t i = 0; i < scene_objs_.size(); ++ i)
+		{
+			SceneObject const * so = scene_objs_[i].get();
+			uint32_t const attr = so->Attrib();
+			if ((attr & SceneObject::SOA_Cullable) && (attr & SceneObject::SOA_Moveable) && so->Visible())
+			{
+				AABBox const & aabb_ws = so->PosBoundWS();
+				for (size_t v = 0; v < frusta.size(); ++ v)
+				{
+					overlaps[v][i] = frusta[v].Intersect(aabb_ws);
+				}
+			}
+		}
+	}
+
 	void OCTree::ClearObject()
 	{
 		SceneManager::ClearObject();
 
 		octree_.clear();
+		free_children_.clear();
+		octree_objs_.clear();
+		free_obj_index_ = -1;
+		obj_indices_.clear();
 		rebuild_tree_ = true;
 	}
 
+	bool OCTree::Validate() const
+	{
+		if (rebuild_tree_)
+		{
+			return true;
+		}
+		if (octree_.empty())
+		{
+			return obj_indices_.empty();
+		}
+		if (octree_[0].parent_index != -1)
+		{
+			return false;
+		}
+
+		size_t num_internal_nodes = 0;
+		size_t num_listed_objs = 0;
+		std::vector<int> stack(1, 0);
+		std::vector<int> post_order;
+		while (!stack.empty())
+		{
+			int const index = stack.back();
+			stack.pop_back();
+			post_order.push_back(index);
+
+			octree_node_t const & node = octree_[index];
+			float3 const half_size = node.bb.HalfSize();
+			AABBox const loose_bb(node.bb.Min() - half_size, node.bb.Max() + half_size);
+
+			uint32_t num_objs = 0;
+			int prev_index = -1;
+			for (int obj_index = node.first_obj_index; obj_index != -1; obj_index = octree_objs_[obj_index].next_index)
+			{
+				octree_obj_t const & entry = octree_objs_[obj_index];
+				if ((nullptr == entry.obj) || (entry.node_index != index) || (entry.prev_index != prev_index))
+				{
+					return false;
+				}
+				auto iter = obj_indices_.find(entry.obj);
+				if ((iter == obj_indices_.end()) || (iter->second != obj_index))
+				{
+					return false;
+				}
+
+				AABBox const & aabb = entry.obj->PosBoundWS();
+				if (!loose_bb.VecInBound(aabb.Min()) || !loose_bb.VecInBound(aabb.Max()))
+				{
+					return false;
+				}
+				if ((node.first_child_index != -1) && (this->ChildContaining(index, aabb) != -1))
+				{
+					return false;
+				}
+
+				prev_index = obj_index;
+				++ num_objs;
+			}
+			if (num_objs != node.num_objs)
+			{
+				return false;
+			}
+			num_listed_objs += num_objs;
+
+			if (node.first_child_index != -1)
+			{
+				if (node.num_subtree_objs <= MERGE_THRESHOLD)
+				{
+					return false;
+				}
+
+				++ num_internal_nodes;
+				for (int j = 0; j < 8; ++ j)
+				{
+					int const child_index = node.first_child_index + j;
+					if ((child_index <= 0) || (child_index >= static_cast<int>(octree_.size()))
+						|| (octree_[child_index].parent_index != index) || (octree_[child_index].depth != node.depth + 1))
+					{
+						return false;
+					}
+					stack.push_back(child_index);
+				}
+			}
+		}
+
+		// The children are checked before their parents
+		for (auto iter = post_order.rbegin(); iter != post_order.rend(); ++ iter)
+		{
+			octree_node_t const & node = octree_[*iter];
+			uint32_t num_subtree_objs = node.num_objs;
+			if (node.first_child_index != -1)
+			{
+				for (int j = 0; j < 8; ++ j)
+				{
+					num_subtree_objs += octree_[node.first_child_index + j].num_subtree_objs;
+				}
+			}
+			if (num_subtree_objs != node.num_subtree_objs)
+			{
+				return false;
+			}
+		}
+
+		size_t num_free_objs = 0;
+		for (int obj_index = free_obj_index_; obj_index != -1; obj_index = octree_objs_[obj_index].prev_index)
+		{
+			if (octree_objs_[obj_index].obj != nullptr)
+			{
+				return false;
+			}
+			++ num_free_objs;
+		}
+
+		return (num_listed_objs == obj_indices_.size())
+			&& (num_listed_objs + num_free_objs == octree_objs_.size())
+			&& (1 + (num_internal_nodes + free_children_.size()) * 8 == octree_.size());
+	}
+
+	size_t OCTree::NumNodeEntries() const
+	{
+		return octree_.size();
+	}
+
+	size_t OCTree::NumObjectEntries() const
+	{
+		return octree_objs_.size();
+	}
+
 	void OCTree::OnAddSceneObject(SceneObjectPtr const & obj)
 	{
 		uint32_t const attr = obj->Attrib();
 		if ((attr & SceneObject::SOA_Cullable)
-			&& !(attr & SceneObject::SOA_Moveable))
+			&& !(attr & SceneObject::SOA_Moveable)
+			&& !rebuild_tree_)
 		{
-			rebuild_tree_ = true;
+			// Added again when the renderable is attached, with a new bound
+			if (obj_indices_.find(obj.get()) != obj_indices_.end())
+			{
+				this->RemoveObject(obj.get());
+			}
+
+			// Only an object out of the root needs the tree to be rebuilt, with a larger root
+			AABBox const & aabb = obj->PosBoundWS();
+			if (octree_.empty() || !octree_[0].bb.VecInBound(aabb.Min()) || !octree_[0].bb.VecInBound(aabb.Max()))
+			{
+				rebuild_tree_ = true;
+			}
+			else
+			{
+				this->InsertObject(obj.get());
+			}
 		}
 	}
 
@@ -275,9 +440,10 @@ namespace KlayGE
 
 		uint32_t const attr = (*iter)->Attrib();
 		if ((attr & SceneObject::SOA_Cullable)
-			&& !(attr & SceneObject::SOA_Moveable))
+			&& !(attr & SceneObject::SOA_Moveable)
+			&& !rebuild_tree_)
 		{
-			rebuild_tree_ = true;
+			this->RemoveObject(iter->get());
 		}
 	}
 
@@ -291,61 +457,275 @@ namespace KlayGE
 		// TODO
 	}
 
-	void OCTree::DivideNode(size_t index, uint32_t curr_depth)
+	void OCTree::RebuildTree()
 	{
-		if (octree_[index].obj_ptrs.size() > 1)
+		octree_.resize(1);
+		free_children_.clear();
+		octree_objs_.clear();
+		free_obj_index_ = -1;
+		obj_indices_.clear();
+
+		AABBox bb_root(float3(0, 0, 0), float3(0, 0, 0));
+		for (auto const & obj : scene_objs_)
+		{
+			uint32_t const attr = obj->Attrib();
+			if ((attr & SceneObject::SOA_Cullable)
+				&& !(attr & SceneObject::SOA_Moveable))
+			{
+				bb_root |= obj->PosBoundWS();
+			}
+		}
+		float3 const & center = bb_root.Center();
+		float3 const & extent = bb_root.HalfSize();
+		float longest_dim = std::max(std::max(extent.x(), extent.y()), extent.z());
+		float3 new_extent(longest_dim, longest_dim, longest_dim);
+
+		octree_node_t& root = octree_[0];
+		root.bb = AABBox(center - new_extent, center + new_extent);
+		root.first_child_index = -1;
+		root.parent_index = -1;
+		root.first_obj_index = -1;
+		root.num_objs = 0;
+		root.num_subtree_objs = 0;
+		root.depth = 1;
+		root.visible = BO_No;
+
+		for (auto const & obj : scene_objs_)
 		{
-			size_t const this_size = octree_.size();
-			AABBox const parent_bb = octree_[index].bb;
-			float3 const parent_center = parent_bb.Center();
-			octree_[index].first_child_index = static_cast<int>(this_size);
-			octree_[index].visible = BO_No;
+			uint32_t const attr = obj->Attrib();
+			if ((attr & SceneObject::SOA_Cullable)
+				&& !(attr & SceneObject::SOA_Moveable))
+			{
+				this->InsertObject(obj.get());
+			}
+		}
+	}
 
-			octree_.resize(this_size + 8);
-			for (auto so : octree_[index].obj_ptrs)
+	void OCTree::InsertObject(SceneObject* obj)
+	{
+		BOOST_ASSERT(!octree_.empty());
+		BOOST_ASSERT(obj_indices_.find(obj) == obj_indices_.end());
+
+		AABBox const & aabb = obj->PosBoundWS();
+		size_t index = 0;
+		while (octree_[index].first_child_index != -1)
+		{
+			int const child = this->ChildContaining(index, aabb);
+			if (-1 == child)
 			{
-				AABBox const & aabb = so->PosBoundWS();
-				int mark[6];
-				mark[0] = aabb.Min().x() >= parent_center.x() ? 1 : 0;
-				mark[1] = aabb.Min().y() >= parent_center.y() ? 2 : 0;
-				mark[2] = aabb.Min().z() >= parent_center.z() ? 4 : 0;
-				mark[3] = aabb.Max().x() >= parent_center.x() ? 1 : 0;
-				mark[4] = aabb.Max().y() >= parent_center.y() ? 2 : 0;
-				mark[5] = aabb.Max().z() >= parent_center.z() ? 4 : 0;
-				for (int j = 0; j < 8; ++ j)
-				{
-					if (j == ((j & 1) ? mark[3] : mark[0])
-						+ ((j & 2) ? mark[4] : mark[1])
-						+ ((j & 4) ? mark[5] : mark[2]))
-					{
-						octree_[this_size + j].obj_ptrs.push_back(so);
-					}
-				}
+				break;
 			}
+			index = child;
+		}
 
-			for (size_t j = 0; j < 8; ++ j)
+		int obj_index;
+		if (free_obj_index_ != -1)
+		{
+			obj_index = free_obj_index_;
+			free_obj_index_ = octree_objs_[obj_index].prev_index;
+		}
+		else
+		{
+			obj_index = static_cast<int>(octree_objs_.size());
+			octree_objs_.resize(octree_objs_.size() + 1);
+		}
+		octree_objs_[obj_index].obj = obj;
+		obj_indices_.emplace(obj, obj_index);
+
+		this->LinkObject(obj_index, static_cast<int>(index));
+		for (int i = static_cast<int>(index); i != -1; i = octree_[i].parent_index)
+		{
+			++ octree_[i].num_subtree_objs;
+		}
+
+		if ((-1 == octree_[index].first_child_index) && (octree_[index].num_objs > SPLIT_THRESHOLD)
+			&& (octree_[index].depth < max_tree_depth_))
+		{
+			this->SplitNode(index);
+		}
+	}
+
+	void OCTree::RemoveObject(SceneObject* obj)
+	{
+		auto iter = obj_indices_.find(obj);
+		if (iter == obj_indices_.end())
+		{
+			return;
+		}
+
+		int const obj_index = iter->second;
+		obj_indices_.erase(iter);
+
+		int const node_index = octree_objs_[obj_index].node_index;
+		this->UnlinkObject(obj_index);
+		octree_objs_[obj_index].obj = nullptr;
+		octree_objs_[obj_index].prev_index = free_obj_index_;
+		free_obj_index_ = obj_index;
+
+		// Merges the highest ancestor that has too few objects left
+		int merge_index = -1;
+		for (int i = node_index; i != -1; i = octree_[i].parent_index)
+		{
+			-- octree_[i].num_subtree_objs;
+			if ((octree_[i].first_child_index != -1) && (octree_[i].num_subtree_objs <= MERGE_THRESHOLD))
 			{
-				octree_node_t& new_node = octree_[this_size + j];
-				new_node.first_child_index = -1;
-				new_node.bb = AABBox(float3((j & 1) ? parent_center.x() : parent_bb.Min().x(),
-						(j & 2) ? parent_center.y() : parent_bb.Min().y(),
-						(j & 4) ? parent_center.z() : parent_bb.Min().z()),
-					float3((j & 1) ? parent_bb.Max().x() : parent_center.x(),
-						(j & 2) ? parent_bb.Max().y() : parent_center.y(),
-						(j & 4) ? parent_bb.Max().z() : parent_center.z()));
+				merge_index = i;
+			}
+		}
+		if (merge_index != -1)
+		{
+			this->MergeNode(merge_index);
+		}
+	}
 
-				if (curr_depth < max_tree_depth_)
-				{
-					this->DivideNode(this_size + j, curr_depth + 1);
-				}
+	// Returns the child whose loose bound contains aabb, or -1. Only the child containing the center
+	// could be the one.
+	int OCTree::ChildContaining(size_t index, AABBox const & aabb) const
+	{
+		octree_node_t const & node = octree_[index];
+		BOOST_ASSERT(node.first_child_index != -1);
+
+		float3 const node_center = node.bb.Center();
+		float3 const center = aabb.Center();
+		int const child_index = node.first_child_index
+			+ ((center.x() >= node_center.x()) ? 1 : 0)
+			+ ((center.y() >= node_center.y()) ? 2 : 0)
+			+ ((center.z() >= node_center.z()) ? 4 : 0);
+
+		AABBox const & child_bb = octree_[child_index].bb;
+		float3 const child_half_size = child_bb.HalfSize();
+		AABBox const loose_bb(child_bb.Min() - child_half_size, child_bb.Max() + child_half_size);
+		return (loose_bb.VecInBound(aabb.Min()) && loose_bb.VecInBound(aabb.Max())) ? child_index : -1;
+	}
+
+	void OCTree::LinkObject(int obj_index, int node_index)
+	{
+		octree_obj_t& entry = octree_objs_[obj_index];
+		octree_node_t& node = octree_[node_index];
+		entry.node_index = node_index;
+		entry.prev_index = -1;
+		entry.next_index = node.first_obj_index;
+		if (node.first_obj_index != -1)
+		{
+			octree_objs_[node.first_obj_index].prev_index = obj_index;
+		}
+		node.first_obj_index = obj_index;
+		++ node.num_objs;
+	}
+
+	void OCTree::UnlinkObject(int obj_index)
+	{
+		octree_obj_t& entry = octree_objs_[obj_index];
+		octree_node_t& node = octree_[entry.node_index];
+		if (entry.prev_index != -1)
+		{
+			octree_objs_[entry.prev_index].next_index = entry.next_index;
+		}
+		else
+		{
+			node.first_obj_index = entry.next_index;
+		}
+		if (entry.next_index != -1)
+		{
+			octree_objs_[entry.next_index].prev_index = entry.prev_index;
+		}
+		-- node.num_objs;
+	}
+
+	// Creates the 8 children of a leaf, and moves down the objects that fit in them
+	void OCTree::SplitNode(size_t index)
+	{
+		BOOST_ASSERT(-1 == octree_[index].first_child_index);
+
+		int first_child_index;
+		if (!free_children_.empty())
+		{
+			first_child_index = free_children_.back();
+			free_children_.pop_back();
+		}
+		else
+		{
+			first_child_index = static_cast<int>(octree_.size());
+			octree_.resize(octree_.size() + 8);
+		}
+
+		AABBox const parent_bb = octree_[index].bb;
+		float3 const parent_center = parent_bb.Center();
+		uint32_t const child_depth = octree_[index].depth + 1;
+		octree_[index].first_child_index = first_child_index;
+		for (int j = 0; j < 8; ++ j)
+		{
+			octree_node_t& new_node = octree_[first_child_index + j];
+			new_node.bb = AABBox(float3((j & 1) ? parent_center.x() : parent_bb.Min().x(),
+					(j & 2) ? parent_center.y() : parent_bb.Min().y(),
+					(j & 4) ? parent_center.z() : parent_bb.Min().z()),
+				float3((j & 1) ? parent_bb.Max().x() : parent_center.x(),
+					(j & 2) ? parent_bb.Max().y() : parent_center.y(),
+					(j & 4) ? parent_bb.Max().z() : parent_center.z()));
+			new_node.first_child_index = -1;
+			new_node.parent_index = static_cast<int>(index);
+			new_node.first_obj_index = -1;
+			new_node.num_objs = 0;
+			new_node.num_subtree_objs = 0;
+			new_node.depth = child_depth;
+			new_node.visible = BO_No;
+		}
+
+		for (int obj_index = octree_[index].first_obj_index; obj_index != -1;)
+		{
+			int const next_index = octree_objs_[obj_index].next_index;
+			int const child = this->ChildContaining(index, octree_objs_[obj_index].obj->PosBoundWS());
+			if (child != -1)
+			{
+				this->UnlinkObject(obj_index);
+				this->LinkObject(obj_index, child);
+				++ octree_[child].num_subtree_objs;
 			}
+			obj_index = next_index;
+		}
 
-			octree_[index].obj_ptrs.clear();
-			octree_[index].obj_ptrs.shrink_to_fit();
+		for (int j = 0; j < 8; ++ j)
+		{
+			if ((octree_[first_child_index + j].num_objs > SPLIT_THRESHOLD) && (child_depth < max_tree_depth_))
+			{
+				this->SplitNode(first_child_index + j);
+			}
 		}
 	}
 
-	void OCTree::NodeVisible(size_t index)
+	// Moves all objects of the subtree up to the node, and frees its descendants
+	void OCTree::MergeNode(size_t index)
+	{
+		int const first_child_index = octree_[index].first_child_index;
+		BOOST_ASSERT(first_child_index != -1);
+
+		for (int j = 0; j < 8; ++ j)
+		{
+			size_t const child = first_child_index + j;
+			if (octree_[child].first_child_index != -1)
+			{
+				this->MergeNode(child);
+			}
+
+			for (int obj_index = octree_[child].first_obj_index; obj_index != -1;)
+			{
+				int const next_index = octree_objs_[obj_index].next_index;
+				this->UnlinkObject(obj_index);
+				this->LinkObject(obj_index, static_cast<int>(index));
+				obj_index = next_index;
+			}
+		}
+
+		this->FreeChildren(index);
+	}
+
+	void OCTree::FreeChildren(size_t index)
+	{
+		free_children_.push_back(octree_[index].first_child_index);
+		octree_[index].first_child_index = -1;
+	}
+
+	void OCTree::NodeVisible(size_t index, bool parallel)
 	{
 		BOOST_ASSERT(index < octree_.size());
 
@@ -364,17 +744,39 @@ namespace KlayGE
 		}
 
 		octree_node_t& node = octree_[index];
-		if ((small_obj_threshold_ <= 0) || (MathLib::perspective_area(camera.EyePos(), view_proj, node.bb) > small_obj_threshold_))
+		float3 const half_size = node.bb.HalfSize();
+		AABBox const loose_bb(node.bb.Min() - half_size, node.bb.Max() + half_size);
+		if ((small_obj_threshold_ <= 0) || (MathLib::perspective_area(camera.EyePos(), view_proj, loose_bb) > small_obj_threshold_))
 		{
-			BoundOverlap const vis = frustum_->Intersect(node.bb);
+			BoundOverlap const vis = frustum_->Intersect(loose_bb);
 			node.visible = vis;
 			if (BO_Partial == vis)
 			{
 				if (node.first_child_index != -1)
 				{
-					for (int i = 0; i < 8; ++ i)
+					size_t const first_child_index = node.first_child_index;
+#ifndef KLAYGE_DRAW_NODES
+					if (parallel)
 					{
-						this->NodeVisible(node.first_child_index + i);
+						// Each subtree only writes its own nodes
+						parallel_for_tiles(Context::Instance().ThreadPool(), 8, 1,
+							[this, first_child_index](size_t begin, size_t end)
+							{
+								for (size_t i = begin; i < end; ++ i)
+								{
+									this->NodeVisible(first_child_index + i, false);
+								}
+							});
+					}
+					else
+#else
+					KFL_UNUSED(parallel);
+#endif
+					{
+						for (int i = 0; i < 8; ++ i)
+						{
+							this->NodeVisible(first_child_index + i, false);
+						}
 					}
 				}
 			}
@@ -392,6 +794,38 @@ namespace KlayGE
 #endif
 	}
 
+	void OCTree::NodeViewBounds(size_t index, Frustum const & frustum, bool inside, std::vector<BoundOverlap>& overlaps)
+	{
+		BOOST_ASSERT(index < octree_.size());
+
+		octree_node_t const & node = octree_[index];
+		if (!inside)
+		{
+			float3 const half_size = node.bb.HalfSize();
+			AABBox const loose_bb(node.bb.Min() - half_size, node.bb.Max() + half_size);
+			BoundOverlap const vis = frustum.Intersect(loose_bb);
+			if (BO_No == vis)
+			{
+				return;
+			}
+			inside = (BO_Yes == vis);
+		}
+
+		for (int obj_index = node.first_obj_index; obj_index != -1; obj_index = octree_objs_[obj_index].next_index)
+		{
+			SceneObject const * so = octree_objs_[obj_index].obj;
+			overlaps[so->SceneIndex()] = inside ? BO_Yes : frustum.Intersect(so->PosBoundWS());
+		}
+
+		if ((node.first_child_index != -1) && (node.num_subtree_objs > node.num_objs))
+		{
+			for (int i = 0; i < 8; ++ i)
+			{
+				this->NodeViewBounds(node.first_child_index + i, frustum, inside, overlaps);
+			}
+		}
+	}
+
 	void OCTree::MarkNodeObjs(size_t index, bool force)
 	{
 		BOOST_ASSERT(index < octree_.size());
@@ -413,9 +847,10 @@ namespace KlayGE
 		octree_node_t const & node = octree_[index];
 		if ((node.visible != BO_No) || force)
 		{
-			for (auto so : node.obj_ptrs)
+			for (int obj_index = node.first_obj_index; obj_index != -1; obj_index = octree_objs_[obj_index].next_index)
 			{
-				if ((BO_No == so->VisibleMark()) && so->Visible())
+				SceneObject* so = octree_objs_[obj_index].obj;
+				if ((BO_No == this->VisibleMark(so)) && so->Visible())
 				{
 					BoundOverlap visible = this->VisibleTestFromParent(so, camera.EyePos(), view_proj);
 					if (BO_Partial == visible)
@@ -431,11 +866,12 @@ namespace KlayGE
 							visible = BO_No;
 						}
 					}
-					so->VisibleMark(visible);
+					this->VisibleMark(so, visible);
 				}
 			}
 
-			if (node.first_child_index != -1)
+			// Skips the subtrees without objects
+			if ((node.first_child_index != -1) && (node.num_subtree_objs > node.num_objs))
 			{
 				for (int i = 0; i < 8; ++ i)
 				{
@@ -451,13 +887,13 @@ namespace KlayGE
 		BoundOverlap visible = BO_Yes;
 		if (!octree_.empty())
 		{
-			if (MathLib::intersect_aabb_aabb(octree_[0].bb, aabb))
+			if (octree_[0].bb.VecInBound(aabb.Min()) && octree_[0].bb.VecInBound(aabb.Max()))
 			{
 				visible = this->BoundVisible(0, aabb);
 			}
 			else
 			{
-				// Out of scene
+				// Out of scene, or partially out of it, where no node tells the visibility
 				visible = BO_Yes;
 			}
 		}
@@ -420,7 +420,10 @@ void DeferredRenderingApp::DoUpdateOverlay()
 
 	stream.str(L"");
 	stream << scene_mgr.NumDrawCalls() << " Draws/frame "
-		<< scene_mgr.NumDispatchCalls() << " Dispatches/frame";
+		<< scene_mgr.NumDispatchCalls() << " Dispatches/frame "
+		<< scene_mgr.NumStateChangesIssued() << " State changes/frame ("
+		<< scene_mgr.NumStateChangesFiltered() << " filtered) "
+		<< scene_mgr.NumEffectStringLookups() << " Parameter lookups by string/frame";
 	font_->RenderText(0, 90, Color(1, 1, 1, 1), stream.str(), 16);
 }
 
@@ -206,7 +206,7 @@ namespace
 
 		void Instance(float4x4 const & mat, Color const & clr)
 		{
-			model_ = mat;
+			this->ModelMatrix(mat);
 			inst_.clr = clr.ABGR();
 		}
 
@@ -230,7 +230,7 @@ namespace
 			inst_.last_mat[2] = matT.Row(2);
 
 			float e = elapsed_time * 0.3f * -model_(3, 1);
-			model_ *= MathLib::rotation_y(e);
+			this->ModelMatrix(model_ * MathLib::rotation_y(e));
 
 			matT = MathLib::transpose(model_);
 			inst_.mat[0] = matT.Row(0);
@@ -0,0 +1,238 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Math.hpp>
+#include <KFL/AABBox.hpp>
+#include <KFL/Frustum.hpp>
+#include <KlayGE/BVH/AABBTree.hpp>
+
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunused-parameter" // Ignore unused parameter in boost
+#endif
+#include <boost/test/unit_test.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic pop
+#endif
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	// The tree only stores the pointers, so the objects are stand-ins
+	struct TreeObjects
+	{
+		explicit TreeObjects(size_t num)
+			: storage(num)
+		{
+			for (size_t i = 0; i < num; ++ i)
+			{
+				indices.emplace(Obj(i), i);
+			}
+		}
+
+		SceneObject* Obj(size_t i)
+		{
+			return reinterpret_cast<SceneObject*>(&storage[i]);
+		}
+
+		std::vector<uint32_t> storage;
+		std::unordered_map<SceneObject*, size_t> indices;
+	};
+
+	AABBox RandomBox(std::ranlux24_base& gen)
+	{
+		std::uniform_real_distribution<float> pos_dis(-400, 400);
+		std::uniform_real_distribution<float> size_dis(0.5f, 30);
+		float3 const center(pos_dis(gen), pos_dis(gen) * 0.25f, pos_dis(gen));
+		float3 const extent(size_dis(gen), size_dis(gen), size_dis(gen));
+		return AABBox(center - extent, center + extent);
+	}
+
+	// The leaves inserted or moved are enlarged by 10% of their longest half size
+	AABBox FatBox(AABBox const & aabb)
+	{
+		float3 const extent = aabb.HalfSize();
+		float const margin = std::max(std::max(extent.x(), extent.y()), extent.z()) * 0.1f;
+		float3 const fat_extent = extent + float3(margin, margin, margin);
+		return AABBox(aabb.Center() - fat_extent, aabb.Center() + fat_extent);
+	}
+
+	std::vector<Frustum> TestFrusta()
+	{
+		std::vector<Frustum> frusta;
+		float3 const eyes[] = { float3(0, 0, -500), float3(300, 100, 0), float3(0, 0, 0) };
+		float3 const ats[] = { float3(0, 0, 0), float3(-100, 0, 50), float3(0, -0.5f, 1) };
+		for (int i = 0; i < 3; ++ i)
+		{
+			float4x4 const view_proj = MathLib::look_at_lh(eyes[i], ats[i])
+				* MathLib::perspective_fov_lh(PI / 4, 1.0f, 1.0f, 400.0f);
+			frusta.push_back(Frustum());
+			frusta.back().ClipMatrix(view_proj, MathLib::inverse(view_proj));
+		}
+		return frusta;
+	}
+
+	// The culled leaves are exactly the ones intersecting the frustum, with the same overlaps
+	bool CullMatches(AABBTree& tree, TreeObjects& objs, std::vector<AABBox> const & bounds,
+		std::vector<bool> const & in_tree, Frustum const & frustum)
+	{
+		std::vector<SceneObject*> culled;
+		std::vector<BoundOverlap> overlaps;
+		std::vector<uint8_t> plane_masks;
+		tree.Cull(culled, overlaps, plane_masks, frustum);
+
+		std::vector<BoundOverlap> culled_overlaps(bounds.size(), BO_No);
+		for (size_t i = 0; i < culled.size(); ++ i)
+		{
+			auto iter = objs.indices.find(culled[i]);
+			if ((iter == objs.indices.end()) || !in_tree[iter->second] || (culled_overlaps[iter->second] != BO_No)
+				|| (BO_No == overlaps[i]))
+			{
+				return false;
+			}
+			culled_overlaps[iter->second] = overlaps[i];
+		}
+
+		for (size_t i = 0; i < bounds.size(); ++ i)
+		{
+			BoundOverlap const ref = in_tree[i] ? frustum.Intersect(bounds[i]) : BO_No;
+			if (ref != culled_overlaps[i])
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(AABBTreeBuild)
+{
+	size_t const num = 1000;
+	TreeObjects objs(num);
+	std::ranlux24_base gen;
+	std::vector<SceneObject*> leaves(num);
+	std::vector<AABBox> bounds(num);
+	for (size_t i = 0; i < num; ++ i)
+	{
+		leaves[i] = objs.Obj(i);
+		bounds[i] = RandomBox(gen);
+	}
+
+	AABBTree tree;
+	tree.Build(leaves, bounds);
+	BOOST_CHECK(tree.Validate());
+	BOOST_CHECK_EQUAL(tree.NumLeaves(), num);
+
+	std::vector<bool> const in_tree(num, true);
+	for (auto const & frustum : TestFrusta())
+	{
+		BOOST_CHECK(CullMatches(tree, objs, bounds, in_tree, frustum));
+	}
+
+	tree.Build(std::vector<SceneObject*>(), std::vector<AABBox>());
+	BOOST_CHECK(tree.Validate());
+	BOOST_CHECK_EQUAL(tree.NumLeaves(), 0U);
+	BOOST_CHECK_EQUAL(tree.Height(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(AABBTreeInsertMoveRemove)
+{
+	size_t const num = 600;
+	TreeObjects objs(num);
+	std::ranlux24_base gen;
+	std::uniform_real_distribution<float> offset_dis(-5, 5);
+	std::uniform_int_distribution<size_t> index_dis(0, num - 1);
+	std::vector<Frustum> const frusta = TestFrusta();
+
+	AABBTree tree;
+	std::vector<AABBox> exact_bounds(num);
+	std::vector<AABBox> fat_bounds(num);
+	std::vector<int> proxies(num, -1);
+	std::vector<bool> in_tree(num, false);
+	uint32_t num_leaves = 0;
+
+	for (size_t i = 0; i < num; ++ i)
+	{
+		exact_bounds[i] = RandomBox(gen);
+		fat_bounds[i] = FatBox(exact_bounds[i]);
+		proxies[i] = tree.Insert(objs.Obj(i), exact_bounds[i]);
+		in_tree[i] = true;
+		++ num_leaves;
+	}
+	BOOST_REQUIRE(tree.Validate());
+	BOOST_CHECK_EQUAL(tree.NumLeaves(), num_leaves);
+	// Balanced by the rotations
+	BOOST_CHECK(tree.Height() < 32);
+
+	for (int round = 0; round < 8; ++ round)
+	{
+		// Small moves mostly stay in the fat leaves, the large ones go to another place in the tree
+		for (size_t k = 0; k < num / 2; ++ k)
+		{
+			size_t const i = index_dis(gen);
+			if (!in_tree[i])
+			{
+				continue;
+			}
+
+			float const scale = (k % 4 == 0) ? 40.0f : 1.0f;
+			float3 const offset(offset_dis(gen) * scale, offset_dis(gen) * scale, offset_dis(gen) * scale);
+			AABBox const aabb(exact_bounds[i].Min() + offset, exact_bounds[i].Max() + offset);
+			bool inside_fat = true;
+			for (int c = 0; c < 3; ++ c)
+			{
+				inside_fat &= (aabb.Min()[c] >= fat_bounds[i].Min()[c]) && (aabb.Max()[c] <= fat_bounds[i].Max()[c]);
+			}
+			bool const moved = tree.Move(proxies[i], aabb);
+			BOOST_CHECK_EQUAL(moved, !inside_fat);
+			exact_bounds[i] = aabb;
+			if (moved)
+			{
+				fat_bounds[i] = FatBox(aabb);
+			}
+		}
+		BOOST_REQUIRE(tree.Validate());
+
+		// Removes some, and puts some back, reusing the freed nodes
+		for (size_t k = 0; k < num / 8; ++ k)
+		{
+			size_t const i = index_dis(gen);
+			if (in_tree[i])
+			{
+				tree.Remove(proxies[i]);
+				proxies[i] = -1;
+				in_tree[i] = false;
+				-- num_leaves;
+			}
+			else
+			{
+				exact_bounds[i] = RandomBox(gen);
+				fat_bounds[i] = FatBox(exact_bounds[i]);
+				proxies[i] = tree.Insert(objs.Obj(i), exact_bounds[i]);
+				in_tree[i] = true;
+				++ num_leaves;
+			}
+		}
+		BOOST_REQUIRE(tree.Validate());
+		BOOST_CHECK_EQUAL(tree.NumLeaves(), num_leaves);
+
+		for (auto const & frustum : frusta)
+		{
+			BOOST_CHECK(CullMatches(tree, objs, fat_bounds, in_tree, frustum));
+		}
+	}
+
+	for (size_t i = 0; i < num; ++ i)
+	{
+		if (in_tree[i])
+		{
+			tree.Remove(proxies[i]);
+		}
+	}
+	BOOST_CHECK(tree.Validate());
+	BOOST_CHECK_EQUAL(tree.NumLeaves(), 0U);
+}
@@ -0,0 +1,211 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Math.hpp>
+#include <KFL/AABBox.hpp>
+#include <KFL/Thread.hpp>
+#include <KlayGE/ClusteredLightCulling.hpp>
+
+#include <boost/assert.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunused-parameter" // Ignore unused parameter in boost
+#endif
+#include <boost/test/unit_test.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic pop
+#endif
+
+#include <vector>
+#include <random>
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	uint32_t const WIDTH = 1280;
+	uint32_t const HEIGHT = 720;
+	uint32_t const TILE_SIZE = 64;
+	uint32_t const NUM_SLICES = 16;
+	uint32_t const NUM_LIGHTS = 200;
+
+	struct RefLight
+	{
+		bool spot;
+		float3 pos;
+		float3 dir;
+		float cos_outer;
+		float range;
+	};
+
+	// Signed distance from the nearest point of a box to a sphere
+	float SphereMargin(AABBox const & box, float3 const & pos, float range)
+	{
+		float3 const nearest = MathLib::maximize(box.Min(), MathLib::minimize(pos, box.Max()));
+		return MathLib::length(nearest - pos) - range;
+	}
+
+	// Signed distance from the bounding sphere of a box to a cone
+	float ConeMargin(AABBox const & box, RefLight const & light)
+	{
+		float3 const v = box.Center() - light.pos;
+		float const radius = MathLib::length(box.HalfSize());
+		float const along = MathLib::dot(v, light.dir);
+		float const across = MathLib::length(v - light.dir * along);
+		float const sin_outer = sqrt(1 - light.cos_outer * light.cos_outer);
+		float margin = light.cos_outer * across - sin_outer * along - radius;
+		margin = std::max(margin, along - light.range - radius);
+		margin = std::max(margin, -along - radius);
+		return margin;
+	}
+
+	void AddRandomLights(ClusteredLightCulling& clc, vector<RefLight>& lights, mt19937& gen)
+	{
+		uniform_real_distribution<float> xy_dis(-60, 60);
+		uniform_real_distribution<float> z_dis(-5, 120);
+		uniform_real_distribution<float> range_dis(1, 15);
+		uniform_real_distribution<float> dir_dis(-1, 1);
+		uniform_real_distribution<float> cos_dis(0.5f, 0.95f);
+
+		clc.ClearLights();
+		lights.resize(NUM_LIGHTS);
+		for (uint32_t i = 0; i < NUM_LIGHTS; ++ i)
+		{
+			RefLight& light = lights[i];
+			light.spot = (gen() % 2 != 0);
+			light.pos = float3(xy_dis(gen), xy_dis(gen), z_dis(gen));
+			light.dir = MathLib::normalize(float3(dir_dis(gen), dir_dis(gen), dir_dis(gen) + 0.01f));
+			light.cos_outer = cos_dis(gen);
+			light.range = range_dis(gen);
+			if (light.spot)
+			{
+				clc.AddSpotLight(i, light.pos, light.dir, light.cos_outer, light.range);
+			}
+			else
+			{
+				clc.AddPointLight(i, light.pos, light.range);
+			}
+		}
+	}
+
+	// Lights clearly touching a cluster must be in its list, and lights clearly missing it mustn't
+	bool MatchReference(ClusteredLightCulling const & clc, vector<RefLight> const & lights)
+	{
+		float const tolerance = 1e-2f;
+
+		bool match = true;
+		std::vector<uint2> const & ranges = clc.ClusterRanges();
+		std::vector<uint32_t> const & indices = clc.LightIndices();
+		for (uint32_t c = 0; c < clc.NumClusters(); ++ c)
+		{
+			AABBox const box = clc.ClusterBound(c);
+			std::vector<uint8_t> listed(lights.size(), 0);
+			for (uint32_t i = 0; i < ranges[c].y(); ++ i)
+			{
+				uint32_t const index = indices[ranges[c].x() + i];
+				listed[index] = 1;
+				if (i > 0)
+				{
+					// In the order of adding
+					match &= (indices[ranges[c].x() + i - 1] < index);
+				}
+			}
+
+			for (uint32_t l = 0; l < lights.size(); ++ l)
+			{
+				float margin = SphereMargin(box, lights[l].pos, lights[l].range);
+				if (lights[l].spot)
+				{
+					margin = std::max(margin, ConeMargin(box, lights[l]));
+				}
+				if (margin < -tolerance)
+				{
+					match &= (listed[l] != 0);
+				}
+				else if (margin > tolerance)
+				{
+					match &= (listed[l] == 0);
+				}
+			}
+		}
+		return match;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(ClusteredLightCullingClusters)
+{
+	float4x4 const proj = MathLib::perspective_fov_lh(PI / 3, static_cast<float>(WIDTH) / HEIGHT, 0.5f, 100.0f);
+
+	ClusteredLightCulling clc;
+	clc.Setup(WIDTH, HEIGHT, TILE_SIZE, NUM_SLICES, proj);
+	BOOST_CHECK_EQUAL((WIDTH + TILE_SIZE - 1) / TILE_SIZE, clc.TilesX());
+	BOOST_CHECK_EQUAL((HEIGHT + TILE_SIZE - 1) / TILE_SIZE, clc.TilesY());
+	BOOST_CHECK_EQUAL(clc.TilesX() * clc.TilesY() * NUM_SLICES, clc.NumClusters());
+
+	// Points reconstructed from pixels and depths are inside the bounds of their clusters
+	float4x4 const inv_proj = MathLib::inverse(proj);
+	mt19937 gen;
+	uniform_real_distribution<float> x_dis(0, WIDTH - 1.0f);
+	uniform_real_distribution<float> y_dis(0, HEIGHT - 1.0f);
+	uniform_real_distribution<float> z_dis(0.5f, 100.0f);
+	bool inside = true;
+	for (int i = 0; i < 1000; ++ i)
+	{
+		float const px = x_dis(gen);
+		float const py = y_dis(gen);
+		float const z = z_dis(gen);
+		float3 const dir = MathLib::transform_coord(float3(px * 2 / WIDTH - 1, 1 - py * 2 / HEIGHT, 0.5f), inv_proj);
+		float3 const pos = dir * (z / dir.z());
+
+		uint32_t const slice = clc.Slice(z);
+		BOOST_CHECK(slice < NUM_SLICES);
+		AABBox const box = clc.ClusterBound(clc.ClusterIndex(static_cast<uint32_t>(px) / TILE_SIZE,
+			static_cast<uint32_t>(py) / TILE_SIZE, slice));
+		float3 const eps(1e-3f, 1e-3f, 1e-3f);
+		inside &= MathLib::intersect_point_aabb(pos, AABBox(box.Min() - eps * z, box.Max() + eps * z));
+	}
+	BOOST_CHECK(inside);
+
+	float2 const scale_bias = clc.SliceScaleBias();
+	BOOST_CHECK_EQUAL(0U, static_cast<uint32_t>(log(0.6f) * scale_bias.x() + scale_bias.y()));
+	BOOST_CHECK_EQUAL(NUM_SLICES - 1, static_cast<uint32_t>(log(99.0f) * scale_bias.x() + scale_bias.y()));
+}
+
+BOOST_AUTO_TEST_CASE(ClusteredLightCullingLists)
+{
+	float4x4 const proj = MathLib::perspective_fov_lh(PI / 3, static_cast<float>(WIDTH) / HEIGHT, 0.5f, 100.0f);
+
+	mt19937 gen;
+	ClusteredLightCulling clc;
+	clc.Setup(WIDTH, HEIGHT, TILE_SIZE, NUM_SLICES, proj);
+	vector<RefLight> lights;
+
+	AddRandomLights(clc, lights, gen);
+	clc.Build();
+	BOOST_CHECK(MatchReference(clc, lights));
+	std::vector<uint2> const ranges = clc.ClusterRanges();
+	std::vector<uint32_t> const indices = clc.LightIndices();
+	BOOST_CHECK(!indices.empty());
+
+	// The same lists from the thread pool
+	thread_pool tp(1, 4);
+	clc.Build(tp);
+	BOOST_CHECK(ranges == clc.ClusterRanges());
+	BOOST_CHECK(indices == clc.LightIndices());
+
+	// The ranges are packed one after another
+	uint32_t offset = 0;
+	for (auto const & range : ranges)
+	{
+		BOOST_CHECK_EQUAL(offset, range.x());
+		offset += range.y();
+	}
+	BOOST_CHECK_EQUAL(offset, indices.size());
+
+	AddRandomLights(clc, lights, gen);
+	clc.Build(tp);
+	BOOST_CHECK(MatchReference(clc, lights));
+
+	clc.ClearLights();
+	clc.Build();
+	BOOST_CHECK(clc.LightIndices().empty());
+}
@@ -2,6 +2,8 @@
 #include <KlayGE/App3D.hpp>
 #include <KlayGE/ResLoader.hpp>
 
+#include <cstdlib>
+
 #if defined(KLAYGE_COMPILER_CLANG)
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wunused-parameter" // Ignore unused parameter in boost
@@ -31,7 +33,7 @@ namespace KlayGE
 		virtual uint32_t DoUpdate(uint32_t pass) override
 		{
 			KFL_UNUSED(pass);
-			return URV_Finished;
+			return URV_NeedFlush | URV_Finished;
 		}
 	};
 
@@ -46,6 +48,12 @@ namespace KlayGE
 			context_cfg.graphics_cfg.hdr = false;
 			context_cfg.graphics_cfg.color_grading = false;
 			context_cfg.graphics_cfg.gamma = false;
+			// Such as Null, to run the tests on the machines without a GPU or a display
+			char const * render_factory = std::getenv("KLAYGE_TESTS_RENDER_FACTORY");
+			if (render_factory != nullptr)
+			{
+				context_cfg.render_factory_name = render_factory;
+			}
 			Context::Instance().Config(context_cfg);
 
 			app = MakeSharedPtr<KlayGETestsApp>();
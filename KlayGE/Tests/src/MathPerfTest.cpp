@@ -0,0 +1,361 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Math.hpp>
+#include <KFL/Timer.hpp>
+
+#include <boost/assert.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunused-parameter" // Ignore unused parameter in boost
+#endif
+#include <boost/test/unit_test.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic pop
+#endif
+
+#include <vector>
+#include <random>
+
+using namespace std;
+using namespace KlayGE;
+
+// Compares the float specializations in MathLib with the generic scalar formulas, both for
+// the results and for the speed.
+
+namespace
+{
+	int const NUM_SAMPLES = 256;
+	int const NUM_ITERATIONS = 2000;
+
+	float4x4 RefMul(float4x4 const & lhs, float4x4 const & rhs)
+	{
+		float4x4 ret;
+		for (int i = 0; i < 4; ++ i)
+		{
+			for (int j = 0; j < 4; ++ j)
+			{
+				ret(i, j) = lhs(i, 0) * rhs(0, j) + lhs(i, 1) * rhs(1, j) + lhs(i, 2) * rhs(2, j) + lhs(i, 3) * rhs(3, j);
+			}
+		}
+		return ret;
+	}
+
+	Quaternion RefMul(Quaternion const & lhs, Quaternion const & rhs)
+	{
+		return Quaternion(
+			lhs.x() * rhs.w() - lhs.y() * rhs.z() + lhs.z() * rhs.y() + lhs.w() * rhs.x(),
+			lhs.x() * rhs.z() + lhs.y() * rhs.w() - lhs.z() * rhs.x() + lhs.w() * rhs.y(),
+			lhs.y() * rhs.x() - lhs.x() * rhs.y() + lhs.z() * rhs.w() + lhs.w() * rhs.z(),
+			lhs.w() * rhs.w() - lhs.x() * rhs.x() - lhs.y() * rhs.y() - lhs.z() * rhs.z());
+	}
+
+	Quaternion RefMulDual(Quaternion const & lhs_real, Quaternion const & lhs_dual,
+		Quaternion const & rhs_real, Quaternion const & rhs_dual)
+	{
+		Quaternion const a = RefMul(lhs_real, rhs_dual);
+		Quaternion const b = RefMul(lhs_dual, rhs_real);
+		return Quaternion(a.x() + b.x(), a.y() + b.y(), a.z() + b.z(), a.w() + b.w());
+	}
+
+	float4x4 RefToMatrix(Quaternion const & quat)
+	{
+		float const x2 = quat.x() + quat.x();
+		float const y2 = quat.y() + quat.y();
+		float const z2 = quat.z() + quat.z();
+
+		float const xx2 = quat.x() * x2, xy2 = quat.x() * y2, xz2 = quat.x() * z2;
+		float const yy2 = quat.y() * y2, yz2 = quat.y() * z2, zz2 = quat.z() * z2;
+		float const wx2 = quat.w() * x2, wy2 = quat.w() * y2, wz2 = quat.w() * z2;
+
+		return float4x4(
+			1 - yy2 - zz2,	xy2 + wz2,		xz2 - wy2,		0,
+			xy2 - wz2,		1 - xx2 - zz2,	yz2 + wx2,		0,
+			xz2 + wy2,		yz2 - wx2,		1 - xx2 - yy2,	0,
+			0,				0,				0,				1);
+	}
+
+	void RefDecompose(float3& scale, Quaternion& rot, float3& trans, float4x4 const & rhs)
+	{
+		scale.x() = sqrt(rhs(0, 0) * rhs(0, 0) + rhs(0, 1) * rhs(0, 1) + rhs(0, 2) * rhs(0, 2));
+		scale.y() = sqrt(rhs(1, 0) * rhs(1, 0) + rhs(1, 1) * rhs(1, 1) + rhs(1, 2) * rhs(1, 2));
+		scale.z() = sqrt(rhs(2, 0) * rhs(2, 0) + rhs(2, 1) * rhs(2, 1) + rhs(2, 2) * rhs(2, 2));
+
+		trans = float3(rhs(3, 0), rhs(3, 1), rhs(3, 2));
+
+		float4x4 rot_mat = float4x4::Identity();
+		for (int i = 0; i < 3; ++ i)
+		{
+			for (int j = 0; j < 3; ++ j)
+			{
+				rot_mat(i, j) = rhs(i, j) / scale[i];
+			}
+		}
+		rot = MathLib::to_quaternion(rot_mat);
+	}
+
+	std::pair<Quaternion, Quaternion> RefSclerp(Quaternion const & lhs_real, Quaternion const & lhs_dual,
+		Quaternion const & rhs_real, Quaternion const & rhs_dual, float s)
+	{
+		Quaternion to_real = rhs_real;
+		Quaternion to_dual = rhs_dual;
+		if (MathLib::dot(lhs_real, rhs_real) < 0)
+		{
+			to_real = -to_real;
+			to_dual = -to_dual;
+		}
+
+		std::pair<Quaternion, Quaternion> dif_dq = MathLib::inverse(lhs_real, lhs_dual);
+		dif_dq.second = RefMulDual(dif_dq.first, dif_dq.second, to_real, to_dual);
+		dif_dq.first = RefMul(dif_dq.first, to_real);
+
+		float angle, pitch;
+		float3 direction, moment;
+		MathLib::udq_to_screw(angle, pitch, direction, moment, dif_dq.first, dif_dq.second);
+		dif_dq = MathLib::udq_from_screw(angle * s, pitch * s, direction, moment);
+
+		dif_dq.second = RefMulDual(lhs_real, lhs_dual, dif_dq.first, dif_dq.second);
+		dif_dq.first = RefMul(lhs_real, dif_dq.first);
+		return dif_dq;
+	}
+
+	template <typename T>
+	bool NearlyEqual(T const & lhs, T const & rhs, float tolerance = 1e-4f)
+	{
+		for (size_t i = 0; i < T::elem_num; ++ i)
+		{
+			if (MathLib::abs(lhs[i] - rhs[i]) > tolerance * std::max(1.0f, MathLib::abs(lhs[i])))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	struct Samples
+	{
+		vector<float4x4> mats;
+		vector<Quaternion> reals;
+		vector<Quaternion> duals;
+	};
+
+	Samples const & GenerateSamples()
+	{
+		static Samples samples;
+		if (samples.mats.empty())
+		{
+			mt19937 gen;
+			uniform_real_distribution<float> dis(-1, 1);
+			uniform_real_distribution<float> scale_dis(0.5f, 2);
+			for (int i = 0; i < NUM_SAMPLES; ++ i)
+			{
+				Quaternion const rot = MathLib::normalize(Quaternion(dis(gen), dis(gen), dis(gen), dis(gen)));
+				float3 const trans(dis(gen) * 10, dis(gen) * 10, dis(gen) * 10);
+				float3 const scale(scale_dis(gen), scale_dis(gen), scale_dis(gen));
+				samples.mats.push_back(MathLib::scaling(scale) * MathLib::to_matrix(rot) * MathLib::translation(trans));
+				samples.reals.push_back(rot);
+				samples.duals.push_back(MathLib::quat_trans_to_udq(rot, trans));
+			}
+		}
+		return samples;
+	}
+
+	void ReportSpeedup(char const * name, double ref_time, double simd_time)
+	{
+		BOOST_TEST_MESSAGE(name << ": scalar " << ref_time * 1000 << " ms, SIMD " << simd_time * 1000
+			<< " ms, speedup " << ref_time / simd_time << "x");
+	}
+}
+
+BOOST_AUTO_TEST_CASE(PerfMulMatrix)
+{
+	Samples const & samples = GenerateSamples();
+
+	for (int i = 0; i < NUM_SAMPLES - 1; ++ i)
+	{
+		BOOST_CHECK(NearlyEqual(RefMul(samples.mats[i], samples.mats[i + 1]),
+			MathLib::mul(samples.mats[i], samples.mats[i + 1])));
+	}
+
+	Timer timer;
+	float4x4 ref_acc = float4x4::Zero();
+	for (int it = 0; it < NUM_ITERATIONS; ++ it)
+	{
+		for (int i = 0; i < NUM_SAMPLES - 1; ++ i)
+		{
+			ref_acc += RefMul(samples.mats[i], samples.mats[i + 1]);
+		}
+	}
+	double const ref_time = timer.elapsed();
+
+	timer.restart();
+	float4x4 simd_acc = float4x4::Zero();
+	for (int it = 0; it < NUM_ITERATIONS; ++ it)
+	{
+		for (int i = 0; i < NUM_SAMPLES - 1; ++ i)
+		{
+			simd_acc += MathLib::mul(samples.mats[i], samples.mats[i + 1]);
+		}
+	}
+	double const simd_time = timer.elapsed();
+
+	BOOST_CHECK(NearlyEqual(ref_acc, simd_acc, 1e-2f));
+	ReportSpeedup("mul(float4x4)", ref_time, simd_time);
+}
+
+BOOST_AUTO_TEST_CASE(PerfMulQuaternion)
+{
+	Samples const & samples = GenerateSamples();
+
+	for (int i = 0; i < NUM_SAMPLES - 1; ++ i)
+	{
+		BOOST_CHECK(NearlyEqual(RefMul(samples.reals[i], samples.reals[i + 1]),
+			MathLib::mul_real(samples.reals[i], samples.reals[i + 1])));
+		BOOST_CHECK(NearlyEqual(RefMulDual(samples.reals[i], samples.duals[i], samples.reals[i + 1], samples.duals[i + 1]),
+			MathLib::mul_dual(samples.reals[i], samples.duals[i], samples.reals[i + 1], samples.duals[i + 1])));
+	}
+
+	Timer timer;
+	Quaternion ref_acc(0, 0, 0, 0);
+	for (int it = 0; it < NUM_ITERATIONS; ++ it)
+	{
+		for (int i = 0; i < NUM_SAMPLES - 1; ++ i)
+		{
+			ref_acc += RefMulDual(samples.reals[i], samples.duals[i], samples.reals[i + 1], samples.duals[i + 1]);
+		}
+	}
+	double const ref_time = timer.elapsed();
+
+	timer.restart();
+	Quaternion simd_acc(0, 0, 0, 0);
+	for (int it = 0; it < NUM_ITERATIONS; ++ it)
+	{
+		for (int i = 0; i < NUM_SAMPLES - 1; ++ i)
+		{
+			simd_acc += MathLib::mul_dual(samples.reals[i], samples.duals[i], samples.reals[i + 1], samples.duals[i + 1]);
+		}
+	}
+	double const simd_time = timer.elapsed();
+
+	BOOST_CHECK(NearlyEqual(ref_acc, simd_acc, 1e-2f));
+	ReportSpeedup("mul_dual", ref_time, simd_time);
+}
+
+BOOST_AUTO_TEST_CASE(PerfToMatrix)
+{
+	Samples const & samples = GenerateSamples();
+
+	for (int i = 0; i < NUM_SAMPLES; ++ i)
+	{
+		BOOST_CHECK(NearlyEqual(RefToMatrix(samples.reals[i]), MathLib::to_matrix(samples.reals[i])));
+	}
+
+	Timer timer;
+	float4x4 ref_acc = float4x4::Zero();
+	for (int it = 0; it < NUM_ITERATIONS; ++ it)
+	{
+		for (int i = 0; i < NUM_SAMPLES; ++ i)
+		{
+			ref_acc += RefToMatrix(samples.reals[i]);
+		}
+	}
+	double const ref_time = timer.elapsed();
+
+	timer.restart();
+	float4x4 simd_acc = float4x4::Zero();
+	for (int it = 0; it < NUM_ITERATIONS; ++ it)
+	{
+		for (int i = 0; i < NUM_SAMPLES; ++ i)
+		{
+			simd_acc += MathLib::to_matrix(samples.reals[i]);
+		}
+	}
+	double const simd_time = timer.elapsed();
+
+	BOOST_CHECK(NearlyEqual(ref_acc, simd_acc, 1e-2f));
+	ReportSpeedup("to_matrix", ref_time, simd_time);
+}
+
+BOOST_AUTO_TEST_CASE(PerfDecompose)
+{
+	Samples const & samples = GenerateSamples();
+
+	for (int i = 0; i < NUM_SAMPLES; ++ i)
+	{
+		float3 ref_scale, scale, ref_trans, trans;
+		Quaternion ref_rot, rot;
+		RefDecompose(ref_scale, ref_rot, ref_trans, samples.mats[i]);
+		MathLib::decompose(scale, rot, trans, samples.mats[i]);
+		BOOST_CHECK(NearlyEqual(ref_scale, scale));
+		BOOST_CHECK(NearlyEqual(ref_rot, rot));
+		BOOST_CHECK(NearlyEqual(ref_trans, trans));
+	}
+
+	float3 scale, trans;
+	Quaternion rot;
+
+	Timer timer;
+	float3 ref_acc = float3::Zero();
+	for (int it = 0; it < NUM_ITERATIONS; ++ it)
+	{
+		for (int i = 0; i < NUM_SAMPLES; ++ i)
+		{
+			RefDecompose(scale, rot, trans, samples.mats[i]);
+			ref_acc += scale;
+		}
+	}
+	double const ref_time = timer.elapsed();
+
+	timer.restart();
+	float3 simd_acc = float3::Zero();
+	for (int it = 0; it < NUM_ITERATIONS; ++ it)
+	{
+		for (int i = 0; i < NUM_SAMPLES; ++ i)
+		{
+			MathLib::decompose(scale, rot, trans, samples.mats[i]);
+			simd_acc += scale;
+		}
+	}
+	double const simd_time = timer.elapsed();
+
+	BOOST_CHECK(NearlyEqual(ref_acc, simd_acc, 1e-2f));
+	ReportSpeedup("decompose", ref_time, simd_time);
+}
+
+BOOST_AUTO_TEST_CASE(PerfSclerp)
+{
+	Samples const & samples = GenerateSamples();
+
+	for (int i = 0; i < NUM_SAMPLES - 1; ++ i)
+	{
+		std::pair<Quaternion, Quaternion> const ref = RefSclerp(samples.reals[i], samples.duals[i],
+			samples.reals[i + 1], samples.duals[i + 1], 0.3f);
+		std::pair<Quaternion, Quaternion> const simd = MathLib::sclerp(samples.reals[i], samples.duals[i],
+			samples.reals[i + 1], samples.duals[i + 1], 0.3f);
+		BOOST_CHECK(NearlyEqual(ref.first, simd.first, 1e-3f));
+		BOOST_CHECK(NearlyEqual(ref.second, simd.second, 1e-3f));
+	}
+
+	Timer timer;
+	Quaternion ref_acc(0, 0, 0, 0);
+	for (int it = 0; it < NUM_ITERATIONS; ++ it)
+	{
+		for (int i = 0; i < NUM_SAMPLES - 1; ++ i)
+		{
+			ref_acc += RefSclerp(samples.reals[i], samples.duals[i], samples.reals[i + 1], samples.duals[i + 1], 0.3f).first;
+		}
+	}
+	double const ref_time = timer.elapsed();
+
+	timer.restart();
+	Quaternion simd_acc(0, 0, 0, 0);
+	for (int it = 0; it < NUM_ITERATIONS; ++ it)
+	{
+		for (int i = 0; i < NUM_SAMPLES - 1; ++ i)
+		{
+			simd_acc += MathLib::sclerp(samples.reals[i], samples.duals[i], samples.reals[i + 1], samples.duals[i + 1], 0.3f).first;
+		}
+	}
+	double const simd_time = timer.elapsed();
+
+	BOOST_CHECK(NearlyEqual(ref_acc, simd_acc, 1e-1f));
+	ReportSpeedup("sclerp", ref_time, simd_time);
+}
@@ -0,0 +1,94 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/App3D.hpp>
+#include <KlayGE/Camera.hpp>
+#include <KlayGE/Window.hpp>
+#include <KlayGE/RenderFactory.hpp>
+#include <KlayGE/RenderEngine.hpp>
+#include <KlayGE/RenderableHelper.hpp>
+#include <KlayGE/SceneManager.hpp>
+#include <KlayGE/SceneObjectHelper.hpp>
+
+#include <vector>
+
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunused-parameter" // Ignore unused parameter in boost
+#endif
+#include <boost/test/unit_test.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic pop
+#endif
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	uint32_t NumCommands(RenderEngine& re, std::string const & name)
+	{
+		uint32_t ret = 0;
+		re.GetCustomAttrib("NUM_" + name + "_COMMANDS", &ret);
+		return ret;
+	}
+}
+
+// Runs with KLAYGE_TESTS_RENDER_FACTORY=Null, the commands recorded in a frame match the counters of the scene manager
+BOOST_AUTO_TEST_CASE(NullRenderEngineFrame)
+{
+	RenderEngine& re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
+	if (re.Name() != L"Null Render Engine")
+	{
+		BOOST_TEST_MESSAGE("Skipped, set KLAYGE_TESTS_RENDER_FACTORY to Null to run it.");
+		return;
+	}
+
+	App3DFramework& app = Context::Instance().AppInstance();
+	SceneManager& sm = Context::Instance().SceneManagerInstance();
+	app.MainWnd()->Active(true);
+	app.ActiveCamera().ViewParams(float3(0, 0, 0), float3(0, 0, 1));
+	app.ActiveCamera().ProjParams(PI / 4, 1, 0.1f, 100);
+	sm.ClearObject();
+
+	uint32_t const NUM_BOXES = 5;
+	std::vector<SceneObjectPtr> boxes;
+	for (uint32_t i = 0; i < NUM_BOXES; ++ i)
+	{
+		OBBox const obb(float3(i - 2.0f, 0, 10), Quaternion::Identity(), float3(0.4f, 0.4f, 0.4f));
+		boxes.push_back(MakeSharedPtr<SceneObjectHelper>(MakeSharedPtr<RenderableTriBox>(obb, Color(1, 0, 0, 1)),
+			SceneObject::SOA_Cullable));
+		boxes.back()->AddToSceneManager();
+	}
+
+	bool record = true;
+	re.SetCustomAttrib("RECORD_COMMANDS", &record);
+
+	// The first frame adds the boxes and creates the states
+	sm.Update();
+	sm.Update();
+
+	uint32_t num_commands = 0;
+	re.GetCustomAttrib("NUM_COMMANDS", &num_commands);
+	uint32_t const num_draws = NumCommands(re, "DRAW");
+	BOOST_CHECK(num_draws >= NUM_BOXES);
+	BOOST_CHECK_EQUAL(num_draws, sm.NumDrawCalls());
+	BOOST_CHECK(num_commands >= num_draws);
+
+	RenderStateChanges const & changes = sm.StateChanges();
+	BOOST_CHECK_EQUAL(NumCommands(re, "SET_RASTERIZER_STATE"), changes.issued[RST_Rasterizer]);
+	BOOST_CHECK_EQUAL(NumCommands(re, "SET_DEPTH_STENCIL_STATE"), changes.issued[RST_DepthStencil]);
+	BOOST_CHECK_EQUAL(NumCommands(re, "SET_BLEND_STATE"), changes.issued[RST_Blend]);
+	BOOST_CHECK_EQUAL(NumCommands(re, "BIND_FRAME_BUFFER"), changes.issued[RST_FrameBuffer]);
+
+	// The boxes share a technique, so the states of all but the first are filtered
+	BOOST_CHECK(changes.filtered[RST_Rasterizer] >= NUM_BOXES - 1);
+	BOOST_CHECK(NumCommands(re, "SET_RASTERIZER_STATE") < num_draws);
+
+	record = false;
+	re.SetCustomAttrib("RECORD_COMMANDS", &record);
+	for (auto const & box : boxes)
+	{
+		box->DelFromSceneManager();
+	}
+	sm.Update();
+}
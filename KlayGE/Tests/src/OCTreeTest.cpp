@@ -0,0 +1,180 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Math.hpp>
+#include <KFL/AABBox.hpp>
+#include <KFL/Frustum.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/App3D.hpp>
+#include <KlayGE/Window.hpp>
+#include <KlayGE/SceneObjectHelper.hpp>
+#include <KlayGE/OCTree/OCTree.hpp>
+
+#include <random>
+#include <vector>
+
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunused-parameter" // Ignore unused parameter in boost
+#endif
+#include <boost/test/unit_test.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic pop
+#endif
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	// An object with a bound and without a renderable
+	class BoxObject : public SceneObjectHelper
+	{
+	public:
+		BoxObject(AABBox const & aabb, uint32_t attrib)
+			: SceneObjectHelper(attrib), box(aabb)
+		{
+		}
+
+		virtual AABBox const & PosBoundWS() const override
+		{
+			return box;
+		}
+
+		AABBox box;
+	};
+
+	class OCTreeTester : public OCTree
+	{
+	public:
+		// Clips the scene with a frustum instead of the one of the camera
+		void Clip(Frustum const & frustum)
+		{
+			frustum_ = &frustum;
+			visible_marks_ = MakeSharedPtr<std::vector<BoundOverlap>>(scene_objs_.size(), BO_No);
+			this->ClipScene();
+		}
+
+		BoundOverlap Mark(SceneObject const * obj) const
+		{
+			return this->VisibleMark(obj);
+		}
+	};
+
+	AABBox RandomBox(std::ranlux24_base& gen, float range)
+	{
+		std::uniform_real_distribution<float> pos_dis(-range, range);
+		std::uniform_real_distribution<float> size_dis(0.5f, 20);
+		float3 const center(pos_dis(gen), pos_dis(gen) * 0.25f, pos_dis(gen));
+		float3 const extent(size_dis(gen), size_dis(gen), size_dis(gen));
+		return AABBox(center - extent, center + extent);
+	}
+
+	std::vector<Frustum> TestFrusta()
+	{
+		std::vector<Frustum> frusta;
+		float3 const eyes[] = { float3(0, 0, -500), float3(300, 100, 0), float3(0, 0, 0) };
+		float3 const ats[] = { float3(0, 0, 0), float3(-100, 0, 50), float3(0, -0.5f, 1) };
+		for (int i = 0; i < 3; ++ i)
+		{
+			float4x4 const view_proj = MathLib::look_at_lh(eyes[i], ats[i])
+				* MathLib::perspective_fov_lh(PI / 4, 1.0f, 1.0f, 400.0f);
+			frusta.push_back(Frustum());
+			frusta.back().ClipMatrix(view_proj, MathLib::inverse(view_proj));
+		}
+		return frusta;
+	}
+
+	// Each object is marked with its exact overlap with the frustum
+	bool ClipMatches(OCTreeTester& octree, std::vector<SceneObjectPtr> const & objs, Frustum const & frustum)
+	{
+		octree.Clip(frustum);
+
+		bool match = true;
+		for (auto const & obj : objs)
+		{
+			match &= (octree.Mark(obj.get()) == frustum.Intersect(obj->PosBoundWS()));
+		}
+		return match;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(OCTreeAddDelClip)
+{
+	Context::Instance().AppInstance().MainWnd()->Active(true);
+
+	std::ranlux24_base gen;
+	std::vector<Frustum> const frusta = TestFrusta();
+
+	OCTreeTester octree;
+	std::vector<SceneObjectPtr> static_objs;
+	for (int i = 0; i < 500; ++ i)
+	{
+		static_objs.push_back(MakeSharedPtr<BoxObject>(RandomBox(gen, 400), SceneObject::SOA_Cullable));
+		octree.AddSceneObject(static_objs.back());
+	}
+	// Some of them are partially or fully out of the root
+	std::vector<SceneObjectPtr> moveable_objs;
+	for (int i = 0; i < 50; ++ i)
+	{
+		moveable_objs.push_back(MakeSharedPtr<BoxObject>(RandomBox(gen, 450),
+			SceneObject::SOA_Cullable | SceneObject::SOA_Moveable));
+		octree.AddSceneObject(moveable_objs.back());
+	}
+
+	// Builds the tree
+	octree.Update();
+	BOOST_CHECK_EQUAL(octree.NumSceneObjects(), static_objs.size() + moveable_objs.size());
+	BOOST_REQUIRE(octree.Validate());
+
+	std::vector<SceneObjectPtr> all_objs = static_objs;
+	all_objs.insert(all_objs.end(), moveable_objs.begin(), moveable_objs.end());
+	for (auto const & frustum : frusta)
+	{
+		BOOST_CHECK(ClipMatches(octree, all_objs, frustum));
+	}
+
+	// Deletes most of the objects in some regions, so the nodes there are merged
+	size_t const num_obj_entries = octree.NumObjectEntries();
+	std::vector<SceneObjectPtr> kept_objs;
+	size_t num_deleted = 0;
+	for (auto const & obj : static_objs)
+	{
+		float3 const center = obj->PosBoundWS().Center();
+		if ((center.x() > 0) || (center.z() > 200))
+		{
+			octree.DelSceneObject(obj);
+			++ num_deleted;
+		}
+		else
+		{
+			kept_objs.push_back(obj);
+		}
+	}
+	octree.Update();
+	BOOST_REQUIRE(octree.Validate());
+	BOOST_CHECK_EQUAL(octree.NumObjectEntries(), num_obj_entries);
+
+	// The objects added in the root are inserted without rebuilding, into the freed entries
+	static_objs = kept_objs;
+	for (size_t i = 0; i < num_deleted; ++ i)
+	{
+		static_objs.push_back(MakeSharedPtr<BoxObject>(RandomBox(gen, 300), SceneObject::SOA_Cullable));
+		octree.AddSceneObject(static_objs.back());
+	}
+	for (auto const & obj : moveable_objs)
+	{
+		checked_pointer_cast<BoxObject>(obj)->box = RandomBox(gen, 450);
+	}
+	octree.Update();
+	BOOST_REQUIRE(octree.Validate());
+	BOOST_CHECK_EQUAL(octree.NumObjectEntries(), num_obj_entries);
+
+	all_objs = static_objs;
+	all_objs.insert(all_objs.end(), moveable_objs.begin(), moveable_objs.end());
+	for (auto const & frustum : frusta)
+	{
+		BOOST_CHECK(ClipMatches(octree, all_objs, frustum));
+	}
+
+	octree.ClearObject();
+	BOOST_CHECK(octree.Validate());
+}
@@ -0,0 +1,254 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Math.hpp>
+#include <KFL/AABBox.hpp>
+#include <KFL/Thread.hpp>
+#include <KFL/OcclusionBuffer.hpp>
+
+#include <boost/assert.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunused-parameter" // Ignore unused parameter in boost
+#endif
+#include <boost/test/unit_test.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic pop
+#endif
+
+#include <vector>
+#include <random>
+#include <limits>
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	uint32_t const BUFFER_WIDTH = 125;
+	uint32_t const BUFFER_HEIGHT = 62;
+
+	float4x4 ViewProj()
+	{
+		return MathLib::look_at_lh(float3(0, 0, 0), float3(0, 0, 1))
+			* MathLib::perspective_fov_lh(PI / 4, 2.0f, 1.0f, 1000.0f);
+	}
+
+	vector<AABBox> GenerateOccluders()
+	{
+		mt19937 gen;
+		uniform_real_distribution<float> dis_xy(-60, 60);
+		uniform_real_distribution<float> dis_z(20, 200);
+		uniform_real_distribution<float> dis_size(2, 20);
+		vector<AABBox> boxes;
+		for (int i = 0; i < 30; ++ i)
+		{
+			float3 const center(dis_xy(gen), dis_xy(gen) * 0.5f, dis_z(gen));
+			float3 const half_size(dis_size(gen), dis_size(gen), dis_size(gen) * 0.2f);
+			boxes.push_back(AABBox(center - half_size, center + half_size));
+		}
+		return boxes;
+	}
+
+	// Depth of the nearest box seen through the center of a pixel, by ray casting
+	float RayCastDepth(vector<AABBox> const & boxes, float4x4 const & view_proj, float4x4 const & inv_view_proj,
+		uint32_t x, uint32_t y, uint32_t width, uint32_t height)
+	{
+		float const ndc_x = (x + 0.5f) / width * 2 - 1;
+		float const ndc_y = 1 - (y + 0.5f) / height * 2;
+		float3 const start = MathLib::transform_coord(float3(ndc_x, ndc_y, 0), inv_view_proj);
+		float3 const end = MathLib::transform_coord(float3(ndc_x, ndc_y, 1), inv_view_proj);
+		float3 const dir = end - start;
+
+		float depth = 1;
+		for (auto const & box : boxes)
+		{
+			float t_min = 0;
+			float t_max = 1;
+			for (int axis = 0; axis < 3; ++ axis)
+			{
+				float const inv_d = 1 / dir[axis];
+				float t0 = (box.Min()[axis] - start[axis]) * inv_d;
+				float t1 = (box.Max()[axis] - start[axis]) * inv_d;
+				if (t0 > t1)
+				{
+					std::swap(t0, t1);
+				}
+				t_min = std::max(t_min, t0);
+				t_max = std::min(t_max, t1);
+			}
+			if (t_min <= t_max)
+			{
+				float4 const p = MathLib::transform(start + dir * t_min, view_proj);
+				depth = std::min(depth, p.z() / p.w());
+			}
+		}
+		return depth;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(OcclusionBufferRasterize)
+{
+	float4x4 const view_proj = ViewProj();
+	float4x4 const inv_view_proj = MathLib::inverse(view_proj);
+	vector<AABBox> const occluders = GenerateOccluders();
+
+	OcclusionBuffer ob(BUFFER_WIDTH, BUFFER_HEIGHT);
+	BOOST_CHECK_EQUAL(ob.Width(), 128U);
+	BOOST_CHECK_EQUAL(ob.Height(), 64U);
+	for (auto const & box : occluders)
+	{
+		ob.AddOccluder(box, view_proj);
+	}
+	ob.Rasterize();
+
+	// Pixel centers right on an edge could go either way
+	uint32_t num_mismatches = 0;
+	for (uint32_t y = 0; y < ob.Height(); ++ y)
+	{
+		for (uint32_t x = 0; x < ob.Width(); ++ x)
+		{
+			float const ref = RayCastDepth(occluders, view_proj, inv_view_proj, x, y, ob.Width(), ob.Height());
+			if (MathLib::abs(ref - ob.Depth(x, y)) > 1e-4f)
+			{
+				++ num_mismatches;
+			}
+		}
+	}
+	BOOST_CHECK_LE(num_mismatches, ob.Width() * ob.Height() / 1000);
+
+	OcclusionBuffer ob_mt(BUFFER_WIDTH, BUFFER_HEIGHT);
+	for (auto const & box : occluders)
+	{
+		ob_mt.AddOccluder(box, view_proj);
+	}
+	thread_pool tp(1, 4);
+	ob_mt.Rasterize(tp);
+	for (uint32_t y = 0; y < ob.Height(); ++ y)
+	{
+		for (uint32_t x = 0; x < ob.Width(); ++ x)
+		{
+			BOOST_CHECK_EQUAL(ob.Depth(x, y), ob_mt.Depth(x, y));
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(OcclusionBufferMesh)
+{
+	float4x4 const view_proj = ViewProj();
+
+	// A quad in the plane z = 50, and the front face of a box at the same place
+	float3 const positions[] =
+	{
+		float3(-10, -10, 50), float3(10, -10, 50), float3(-10, 10, 50), float3(10, 10, 50)
+	};
+	uint32_t const indices[] = { 0, 1, 2, 2, 1, 3 };
+	OcclusionBuffer quad(BUFFER_WIDTH, BUFFER_HEIGHT);
+	quad.AddOccluder(positions, indices, 6, view_proj);
+	BOOST_CHECK_EQUAL(quad.NumOccluderTriangles(), 2U);
+	quad.Rasterize();
+
+	OcclusionBuffer box(BUFFER_WIDTH, BUFFER_HEIGHT);
+	box.AddOccluder(AABBox(float3(-10, -10, 50), float3(10, 10, 60)), view_proj);
+	box.Rasterize();
+
+	for (uint32_t y = 0; y < quad.Height(); ++ y)
+	{
+		for (uint32_t x = 0; x < quad.Width(); ++ x)
+		{
+			BOOST_CHECK_CLOSE_FRACTION(quad.Depth(x, y), box.Depth(x, y), 1e-5f);
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(OcclusionBufferVisibility)
+{
+	float4x4 const view_proj = ViewProj();
+
+	OcclusionBuffer ob(BUFFER_WIDTH, BUFFER_HEIGHT);
+	// A wall at z = 50
+	ob.AddOccluder(AABBox(float3(-20, -10, 50), float3(20, 10, 51)), view_proj);
+	// Crossing the near plane, never an occluder
+	float3 const positions[] = { float3(-100, -100, -10), float3(100, -100, -10), float3(0, 100, 30) };
+	uint32_t const indices[] = { 0, 1, 2 };
+	uint32_t const num_wall_tris = ob.NumOccluderTriangles();
+	ob.AddOccluder(positions, indices, 3, view_proj);
+	BOOST_CHECK_EQUAL(ob.NumOccluderTriangles(), num_wall_tris);
+	ob.Rasterize();
+
+	// Behind the wall
+	BOOST_CHECK(!ob.IsVisible(AABBox(float3(-5, -5, 100), float3(5, 5, 110)), view_proj));
+	BOOST_CHECK(!ob.IsVisible(AABBox(float3(-30, -15, 80), float3(30, 15, 90)), view_proj));
+	// In front of the wall
+	BOOST_CHECK(ob.IsVisible(AABBox(float3(-5, -5, 20), float3(5, 5, 30)), view_proj));
+	// Touching the wall
+	BOOST_CHECK(ob.IsVisible(AABBox(float3(-5, -5, 40), float3(5, 5, 50)), view_proj));
+	// Beside the wall
+	BOOST_CHECK(ob.IsVisible(AABBox(float3(120, -5, 200), float3(130, 5, 210)), view_proj));
+	// Partly behind the wall
+	BOOST_CHECK(ob.IsVisible(AABBox(float3(10, -5, 100), float3(60, 5, 110)), view_proj));
+	// Crossing the near plane
+	BOOST_CHECK(ob.IsVisible(AABBox(float3(-5, -5, -5), float3(5, 5, 100)), view_proj));
+
+	ob.Clear();
+	BOOST_CHECK_EQUAL(ob.NumOccluderTriangles(), 0U);
+	ob.Rasterize();
+	BOOST_CHECK(ob.IsVisible(AABBox(float3(-5, -5, 100), float3(5, 5, 110)), view_proj));
+}
+
+BOOST_AUTO_TEST_CASE(OcclusionBufferConservative)
+{
+	float4x4 const view_proj = ViewProj();
+	float4x4 const inv_view_proj = MathLib::inverse(view_proj);
+	vector<AABBox> const occluders = GenerateOccluders();
+
+	OcclusionBuffer ob(BUFFER_WIDTH, BUFFER_HEIGHT);
+	for (auto const & box : occluders)
+	{
+		ob.AddOccluder(box, view_proj);
+	}
+	ob.Rasterize();
+
+	// A box is only hidden if the ray cast depth of every pixel it touches is nearer than it
+	mt19937 gen(7);
+	uniform_real_distribution<float> dis_xy(-100, 100);
+	uniform_real_distribution<float> dis_z(30, 400);
+	uniform_real_distribution<float> dis_size(0.5f, 10);
+	uint32_t num_hidden = 0;
+	for (int i = 0; i < 2000; ++ i)
+	{
+		float3 const center(dis_xy(gen), dis_xy(gen) * 0.5f, dis_z(gen));
+		float3 const half_size(dis_size(gen), dis_size(gen), dis_size(gen));
+		AABBox const box(center - half_size, center + half_size);
+		if (!ob.IsVisible(box, view_proj))
+		{
+			++ num_hidden;
+
+			float min_x = 1e10f, min_y = 1e10f, max_x = -1e10f, max_y = -1e10f, min_z = 1e10f;
+			for (uint32_t j = 0; j < 8; ++ j)
+			{
+				float4 const p = MathLib::transform(box.Corner(j), view_proj);
+				float const sx = (p.x() / p.w() * 0.5f + 0.5f) * ob.Width();
+				float const sy = (0.5f - p.y() / p.w() * 0.5f) * ob.Height();
+				min_x = std::min(min_x, sx);
+				max_x = std::max(max_x, sx);
+				min_y = std::min(min_y, sy);
+				max_y = std::max(max_y, sy);
+				min_z = std::min(min_z, p.z() / p.w());
+			}
+			uint32_t const x_begin = static_cast<uint32_t>(std::max(min_x, 0.0f));
+			uint32_t const x_end = std::min(static_cast<uint32_t>(std::max(max_x, 0.0f)) + 1, ob.Width());
+			uint32_t const y_begin = static_cast<uint32_t>(std::max(min_y, 0.0f));
+			uint32_t const y_end = std::min(static_cast<uint32_t>(std::max(max_y, 0.0f)) + 1, ob.Height());
+			bool hidden = true;
+			for (uint32_t y = y_begin; y < y_end; ++ y)
+			{
+				for (uint32_t x = x_begin; x < x_end; ++ x)
+				{
+					hidden &= RayCastDepth(occluders, view_proj, inv_view_proj, x, y, ob.Width(), ob.Height())
+						< min_z + 1e-4f;
+				}
+			}
+			BOOST_CHECK(hidden);
+		}
+	}
+	BOOST_CHECK_GT(num_hidden, 0U);
+}
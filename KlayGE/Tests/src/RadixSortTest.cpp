@@ -0,0 +1,86 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Thread.hpp>
+#include <KFL/RadixSort.hpp>
+
+#include <boost/assert.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunused-parameter" // Ignore unused parameter in boost
+#endif
+#include <boost/test/unit_test.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic pop
+#endif
+
+#include <vector>
+#include <random>
+#include <algorithm>
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	void CheckRadixSort(vector<uint64_t> const & input, thread_pool* tp)
+	{
+		size_t const num = input.size();
+		vector<uint64_t> keys = input;
+		vector<uint32_t> values(num);
+		for (size_t i = 0; i < num; ++ i)
+		{
+			values[i] = static_cast<uint32_t>(i);
+		}
+		vector<uint64_t> tmp_keys(num);
+		vector<uint32_t> tmp_values(num);
+		if (tp)
+		{
+			RadixSort(keys.data(), values.data(), num, tmp_keys.data(), tmp_values.data(), *tp);
+		}
+		else
+		{
+			RadixSort(keys.data(), values.data(), num, tmp_keys.data(), tmp_values.data());
+		}
+
+		// Stable, so the same as sorting the (key, index) pairs
+		vector<pair<uint64_t, uint32_t>> ref(num);
+		for (size_t i = 0; i < num; ++ i)
+		{
+			ref[i] = make_pair(input[i], static_cast<uint32_t>(i));
+		}
+		sort(ref.begin(), ref.end());
+
+		bool same = true;
+		for (size_t i = 0; i < num; ++ i)
+		{
+			same &= (keys[i] == ref[i].first) && (values[i] == ref[i].second);
+		}
+		BOOST_CHECK(same);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(RadixSortKeys)
+{
+	mt19937_64 gen;
+	thread_pool tp(1, 4);
+
+	for (size_t num : { 0, 1, 2, 37, 1000, 100000 })
+	{
+		vector<uint64_t> keys(num);
+
+		// Full range
+		for (auto& key : keys)
+		{
+			key = gen();
+		}
+		CheckRadixSort(keys, nullptr);
+		CheckRadixSort(keys, &tp);
+
+		// Many duplicates in a few bits, most of the passes are skipped
+		for (auto& key : keys)
+		{
+			key = (gen() & 0xF) << 40;
+		}
+		CheckRadixSort(keys, nullptr);
+		CheckRadixSort(keys, &tp);
+	}
+}
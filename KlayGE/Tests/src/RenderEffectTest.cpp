@@ -0,0 +1,114 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Util.hpp>
+#include <KlayGE/RenderEffect.hpp>
+
+#include <utility>
+#include <vector>
+
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunused-parameter" // Ignore unused parameter in boost
+#endif
+#include <boost/test/unit_test.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic pop
+#endif
+
+using namespace std;
+using namespace KlayGE;
+
+// The names are found both by string and by the hash of CT_HASH and RT_HASH
+BOOST_AUTO_TEST_CASE(RenderEffectNameHash)
+{
+	RenderEffectPtr effect = SyncLoadRenderEffect("Copy.fxml");
+	BOOST_REQUIRE(effect);
+
+	RenderEffectParameter* src_tex = effect->ParameterByName("src_tex");
+	BOOST_REQUIRE(src_tex != nullptr);
+	BOOST_CHECK(src_tex->NameHash() == CT_HASH("src_tex"));
+	BOOST_CHECK(effect->ParameterByNameHash(CT_HASH("src_tex")) == src_tex);
+
+	for (uint32_t i = 0; i < effect->NumParameters(); ++ i)
+	{
+		RenderEffectParameter* param = effect->ParameterByIndex(i);
+		BOOST_CHECK(param->NameHash() == RT_HASH(param->Name().c_str()));
+		BOOST_CHECK(effect->ParameterByName(param->Name()) == param);
+	}
+
+	for (uint32_t i = 0; i < effect->NumCBuffers(); ++ i)
+	{
+		RenderEffectConstantBuffer* cbuff = effect->CBufferByIndex(i);
+		BOOST_CHECK(cbuff->NameHash() == RT_HASH(cbuff->Name().c_str()));
+		BOOST_CHECK(effect->CBufferByName(cbuff->Name()) == cbuff);
+	}
+
+	RenderTechnique* tech = effect->TechniqueByName("Copy");
+	BOOST_REQUIRE(tech != nullptr);
+	BOOST_CHECK(tech->NameHash() == CT_HASH("Copy"));
+	BOOST_REQUIRE(tech->NumPasses() > 0);
+	BOOST_CHECK(tech->Pass(0).NameHash() == CT_HASH("p0"));
+}
+
+namespace
+{
+	bool DirtyRangesAre(RenderEffectConstantBuffer const & cbuff, std::vector<std::pair<uint32_t, uint32_t>> const & ranges)
+	{
+		if (cbuff.NumDirtyRanges() != ranges.size())
+		{
+			return false;
+		}
+		for (uint32_t i = 0; i < cbuff.NumDirtyRanges(); ++ i)
+		{
+			if (cbuff.DirtyRange(i) != ranges[i])
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+// The dirty ranges are widened to float4 registers, merged when they touch, and collapsed into one when too many
+BOOST_AUTO_TEST_CASE(RenderEffectCBufferDirtyRanges)
+{
+	RenderEffectConstantBuffer cbuff;
+	cbuff.Resize(256);
+	BOOST_CHECK(DirtyRangesAre(cbuff, { { 0, 256 } }));
+
+	cbuff.Dirty(false);
+	BOOST_CHECK(!cbuff.Dirty());
+	BOOST_CHECK_EQUAL(cbuff.NumDirtyRanges(), 0U);
+
+	cbuff.Dirty(20, 4);
+	BOOST_CHECK(DirtyRangesAre(cbuff, { { 16, 32 } }));
+
+	// Set in order, extends the last range
+	cbuff.Dirty(32, 8);
+	BOOST_CHECK(DirtyRangesAre(cbuff, { { 16, 48 } }));
+
+	cbuff.Dirty(100, 4);
+	cbuff.Dirty(200, 8);
+	cbuff.Dirty(64, 4);
+	BOOST_CHECK(DirtyRangesAre(cbuff, { { 16, 48 }, { 64, 80 }, { 96, 112 }, { 192, 208 } }));
+
+	// Touches several ranges after it
+	cbuff.Dirty(40, 60);
+	BOOST_CHECK(DirtyRangesAre(cbuff, { { 16, 112 }, { 192, 208 } }));
+
+	cbuff.Dirty(130, 2);
+	cbuff.Dirty(240, 4);
+	BOOST_CHECK(DirtyRangesAre(cbuff, { { 16, 112 }, { 128, 144 }, { 192, 208 }, { 240, 256 } }));
+
+	// One more range than the limit
+	cbuff.Dirty(170, 2);
+	BOOST_CHECK(DirtyRangesAre(cbuff, { { 16, 256 } }));
+
+	// Clamped to the size of the buffer
+	cbuff.Dirty(false);
+	cbuff.Dirty(250, 20);
+	BOOST_CHECK(DirtyRangesAre(cbuff, { { 240, 256 } }));
+
+	cbuff.Dirty(true);
+	BOOST_CHECK(cbuff.Dirty());
+	BOOST_CHECK(DirtyRangesAre(cbuff, { { 0, 256 } }));
+}
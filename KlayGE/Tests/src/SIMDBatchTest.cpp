@@ -0,0 +1,734 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Math.hpp>
+#include <KFL/AABBox.hpp>
+#include <KFL/Frustum.hpp>
+#include <KFL/Sphere.hpp>
+#include <KFL/Timer.hpp>
+#include <KFL/Half.hpp>
+#include <KFL/Noise.hpp>
+#include <KFL/Thread.hpp>
+#include <KFL/SIMDBatch.hpp>
+
+#include <boost/assert.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunused-parameter" // Ignore unused parameter in boost
+#endif
+#include <boost/test/unit_test.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic pop
+#endif
+
+#include <vector>
+#include <random>
+#include <cstring>
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	// 37 is not a multiple of any batch width, so the tails are covered too
+	size_t const NUM_POINTS = 37;
+
+	void GeneratePoints(vector<float>& x, vector<float>& y, vector<float>& z)
+	{
+		mt19937 gen;
+		uniform_real_distribution<float> dis(-100, 100);
+		x.resize(NUM_POINTS);
+		y.resize(NUM_POINTS);
+		z.resize(NUM_POINTS);
+		for (size_t i = 0; i < NUM_POINTS; ++ i)
+		{
+			x[i] = dis(gen);
+			y[i] = dis(gen);
+			z[i] = dis(gen);
+		}
+	}
+
+	bool NearlyEqual(float lhs, float rhs)
+	{
+		return MathLib::abs(lhs - rhs) <= 1e-4f * std::max(1.0f, MathLib::abs(lhs));
+	}
+}
+
+BOOST_AUTO_TEST_CASE(BatchTransformCoords)
+{
+	vector<float> x, y, z;
+	GeneratePoints(x, y, z);
+	float4x4 const mat = MathLib::perspective_fov_lh(PI / 4, 1.0f, 1.0f, 1000.0f)
+		* MathLib::translation(0.0f, 0.0f, 250.0f);
+
+	SIMDInstructionSet const active = SIMDBatchLib::ActiveInstructionSet();
+	for (int is = SIMDIS_Scalar; is <= SIMDBatchLib::MaxInstructionSet(); ++ is)
+	{
+		SIMDBatchLib::ActiveInstructionSet(static_cast<SIMDInstructionSet>(is));
+
+		vector<float> ox(NUM_POINTS), oy(NUM_POINTS), oz(NUM_POINTS);
+		SIMDBatchLib::TransformCoords(&ox[0], &oy[0], &oz[0], &x[0], &y[0], &z[0], NUM_POINTS, mat);
+		for (size_t i = 0; i < NUM_POINTS; ++ i)
+		{
+			float3 const ref = MathLib::transform_coord(float3(x[i], y[i], z[i]), mat);
+			BOOST_CHECK(NearlyEqual(ref.x(), ox[i]) && NearlyEqual(ref.y(), oy[i]) && NearlyEqual(ref.z(), oz[i]));
+		}
+	}
+	SIMDBatchLib::ActiveInstructionSet(active);
+}
+
+BOOST_AUTO_TEST_CASE(BatchTransformNormals)
+{
+	vector<float> x, y, z;
+	GeneratePoints(x, y, z);
+	float4x4 const mat = MathLib::rotation_y(0.7f) * MathLib::scaling(1.0f, 2.0f, 3.0f);
+
+	SIMDInstructionSet const active = SIMDBatchLib::ActiveInstructionSet();
+	for (int is = SIMDIS_Scalar; is <= SIMDBatchLib::MaxInstructionSet(); ++ is)
+	{
+		SIMDBatchLib::ActiveInstructionSet(static_cast<SIMDInstructionSet>(is));
+
+		// In-place
+		vector<float> ox = x, oy = y, oz = z;
+		SIMDBatchLib::TransformNormals(&ox[0], &oy[0], &oz[0], &ox[0], &oy[0], &oz[0], NUM_POINTS, mat);
+		for (size_t i = 0; i < NUM_POINTS; ++ i)
+		{
+			float3 const ref = MathLib::transform_normal(float3(x[i], y[i], z[i]), mat);
+			BOOST_CHECK(NearlyEqual(ref.x(), ox[i]) && NearlyEqual(ref.y(), oy[i]) && NearlyEqual(ref.z(), oz[i]));
+		}
+	}
+	SIMDBatchLib::ActiveInstructionSet(active);
+}
+
+BOOST_AUTO_TEST_CASE(BatchComputeBounds)
+{
+	vector<float> x, y, z;
+	GeneratePoints(x, y, z);
+
+	float3 ref_min(x[0], y[0], z[0]);
+	float3 ref_max = ref_min;
+	for (size_t i = 1; i < NUM_POINTS; ++ i)
+	{
+		ref_min = MathLib::minimize(ref_min, float3(x[i], y[i], z[i]));
+		ref_max = MathLib::maximize(ref_max, float3(x[i], y[i], z[i]));
+	}
+
+	SIMDInstructionSet const active = SIMDBatchLib::ActiveInstructionSet();
+	for (int is = SIMDIS_Scalar; is <= SIMDBatchLib::MaxInstructionSet(); ++ is)
+	{
+		SIMDBatchLib::ActiveInstructionSet(static_cast<SIMDInstructionSet>(is));
+
+		float3 min_pt, max_pt;
+		SIMDBatchLib::ComputeBounds(min_pt, max_pt, &x[0], &y[0], &z[0], NUM_POINTS);
+		BOOST_CHECK(ref_min == min_pt);
+		BOOST_CHECK(ref_max == max_pt);
+	}
+	SIMDBatchLib::ActiveInstructionSet(active);
+}
+
+BOOST_AUTO_TEST_CASE(BatchMultiplyMatrices)
+{
+	mt19937 gen;
+	uniform_real_distribution<float> dis(-2, 2);
+	uniform_int_distribution<uint32_t> index_dis(0, 4);
+
+	vector<float4x4> lhs(5);
+	vector<float4x4> rhs(NUM_POINTS);
+	vector<uint32_t> lhs_indices(NUM_POINTS);
+	for (auto& mat : lhs)
+	{
+		for (int i = 0; i < 16; ++ i)
+		{
+			mat[i] = dis(gen);
+		}
+	}
+	for (size_t i = 0; i < NUM_POINTS; ++ i)
+	{
+		for (int j = 0; j < 16; ++ j)
+		{
+			rhs[i][j] = dis(gen);
+		}
+		lhs_indices[i] = index_dis(gen);
+	}
+
+	SIMDInstructionSet const active = SIMDBatchLib::ActiveInstructionSet();
+	for (int is = SIMDIS_Scalar; is <= SIMDBatchLib::MaxInstructionSet(); ++ is)
+	{
+		SIMDBatchLib::ActiveInstructionSet(static_cast<SIMDInstructionSet>(is));
+
+		vector<float4x4> out(NUM_POINTS);
+		SIMDBatchLib::MultiplyMatrices(&out[0], &lhs[0], &lhs_indices[0], &rhs[0], NUM_POINTS);
+
+		// In-place on rhs
+		vector<float4x4> in_place = rhs;
+		SIMDBatchLib::MultiplyMatrices(&in_place[0], &lhs[0], &lhs_indices[0], &in_place[0], NUM_POINTS);
+
+		bool match = true;
+		for (size_t i = 0; i < NUM_POINTS; ++ i)
+		{
+			float4x4 const ref = lhs[lhs_indices[i]] * rhs[i];
+			for (int j = 0; j < 16; ++ j)
+			{
+				match &= NearlyEqual(ref[j], out[i][j]) && NearlyEqual(ref[j], in_place[i][j]);
+			}
+		}
+		BOOST_CHECK(match);
+	}
+	SIMDBatchLib::ActiveInstructionSet(active);
+}
+
+namespace
+{
+	struct CullingScene
+	{
+		vector<AABBox> aabbs;
+		vector<float> center_x, center_y, center_z;
+		vector<float> extent_x, extent_y, extent_z;
+		Frustum frustum;
+
+		SIMDBatchLib::AABBoxSoA SoA() const
+		{
+			SIMDBatchLib::AABBoxSoA const ret = { &center_x[0], &center_y[0], &center_z[0], &extent_x[0], &extent_y[0], &extent_z[0] };
+			return ret;
+		}
+	};
+
+	void GenerateCullingScene(CullingScene& scene, size_t num)
+	{
+		mt19937 gen;
+		uniform_real_distribution<float> pos_dis(-500, 500);
+		uniform_real_distribution<float> size_dis(0.5f, 20);
+		for (size_t i = 0; i < num; ++ i)
+		{
+			float3 const center(pos_dis(gen), pos_dis(gen), pos_dis(gen));
+			float3 const extent(size_dis(gen), size_dis(gen), size_dis(gen));
+			scene.aabbs.push_back(AABBox(center - extent, center + extent));
+			scene.center_x.push_back(center.x());
+			scene.center_y.push_back(center.y());
+			scene.center_z.push_back(center.z());
+			scene.extent_x.push_back(extent.x());
+			scene.extent_y.push_back(extent.y());
+			scene.extent_z.push_back(extent.z());
+		}
+
+		float4x4 const view = MathLib::look_at_lh(float3(0, 0, -300), float3(100, 50, 0));
+		float4x4 const proj = MathLib::perspective_fov_lh(PI / 4, 1.0f, 1.0f, 600.0f);
+		float4x4 const view_proj = view * proj;
+		scene.frustum.ClipMatrix(view_proj, MathLib::inverse(view_proj));
+	}
+}
+
+BOOST_AUTO_TEST_CASE(BatchFrustumCulling)
+{
+	CullingScene scene;
+	GenerateCullingScene(scene, 1003);
+	size_t const num = scene.aabbs.size();
+
+	SIMDInstructionSet const active = SIMDBatchLib::ActiveInstructionSet();
+	for (int is = SIMDIS_Scalar; is <= SIMDBatchLib::MaxInstructionSet(); ++ is)
+	{
+		SIMDBatchLib::ActiveInstructionSet(static_cast<SIMDInstructionSet>(is));
+
+		vector<uint32_t> visible_bits((num + 31) / 32);
+		vector<BoundOverlap> overlaps(num);
+		vector<uint8_t> plane_masks(num, SIMDBatchLib::ALL_FRUSTUM_PLANES);
+		vector<uint8_t> last_planes(num, 0);
+
+		// The second pass exercises the plane masks and the coherency planes from the first one
+		for (int pass = 0; pass < 2; ++ pass)
+		{
+			uint32_t const num_visible = SIMDBatchLib::IntersectAABBFrustum(&visible_bits[0], &overlaps[0],
+				&plane_masks[0], &last_planes[0], scene.SoA(), num, scene.frustum);
+
+			uint32_t ref_num_visible = 0;
+			bool match = true;
+			for (size_t i = 0; i < num; ++ i)
+			{
+				BoundOverlap const ref = scene.frustum.Intersect(scene.aabbs[i]);
+				bool const visible = (visible_bits[i / 32] & (1UL << (i & 31))) != 0;
+				match &= (ref == overlaps[i]) && ((ref != BO_No) == visible);
+				if (ref != BO_No)
+				{
+					++ ref_num_visible;
+				}
+			}
+			BOOST_CHECK(match);
+			BOOST_CHECK_EQUAL(ref_num_visible, num_visible);
+		}
+	}
+	SIMDBatchLib::ActiveInstructionSet(active);
+}
+
+BOOST_AUTO_TEST_CASE(BatchMultiFrustumCulling)
+{
+	CullingScene scene;
+	GenerateCullingScene(scene, 1003);
+	size_t const num = scene.aabbs.size();
+	size_t const num_words = (num + 31) / 32;
+
+	// Cascade-like slices of one view, a view from elsewhere, and a slice without its near plane
+	vector<Frustum> frusta;
+	float4x4 const view = MathLib::look_at_lh(float3(0, 0, -300), float3(100, 50, 0));
+	float const splits[] = { 1.0f, 100.0f, 250.0f, 600.0f };
+	for (int i = 0; i < 3; ++ i)
+	{
+		float4x4 const view_proj = view * MathLib::perspective_fov_lh(PI / 4, 1.0f, splits[i], splits[i + 1]);
+		frusta.push_back(Frustum());
+		frusta.back().ClipMatrix(view_proj, MathLib::inverse(view_proj));
+	}
+	float4x4 const side_view_proj = MathLib::look_at_lh(float3(400, 0, 0), float3(0, 0, 0))
+		* MathLib::ortho_lh(500.0f, 500.0f, 1.0f, 800.0f);
+	frusta.push_back(Frustum());
+	frusta.back().ClipMatrix(side_view_proj, MathLib::inverse(side_view_proj));
+	frusta.push_back(frusta[1]);
+	for (uint32_t p = 0; p < 6; ++ p)
+	{
+		Plane const & plane = frusta.back().FrustumPlane(p);
+		if (MathLib::dot(float3(plane.a(), plane.b(), plane.c()), float3(view(0, 2), view(1, 2), view(2, 2))) > 0)
+		{
+			frusta.back().FrustumPlane(p, Plane(0, 0, 0, 1));
+		}
+	}
+
+	SIMDInstructionSet const active = SIMDBatchLib::ActiveInstructionSet();
+	for (int is = SIMDIS_Scalar; is <= SIMDBatchLib::MaxInstructionSet(); ++ is)
+	{
+		SIMDBatchLib::ActiveInstructionSet(static_cast<SIMDInstructionSet>(is));
+
+		vector<uint32_t> visible_bits(num_words * frusta.size(), 0xFFFFFFFF);
+		vector<uint32_t> inside_bits(num_words * frusta.size(), 0xFFFFFFFF);
+		uint32_t const num_visible = SIMDBatchLib::IntersectAABBFrusta(&visible_bits[0], &inside_bits[0], scene.SoA(),
+			num, &frusta[0], frusta.size());
+
+		uint32_t ref_num_visible = 0;
+		bool match = true;
+		for (size_t i = 0; i < num; ++ i)
+		{
+			bool any_visible = false;
+			for (size_t f = 0; f < frusta.size(); ++ f)
+			{
+				BoundOverlap const ref_bo = frusta[f].Intersect(scene.aabbs[i]);
+				bool const ref = (ref_bo != BO_No);
+				bool const visible = (visible_bits[f * num_words + i / 32] & (1UL << (i & 31))) != 0;
+				bool const inside = (inside_bits[f * num_words + i / 32] & (1UL << (i & 31))) != 0;
+				match &= (ref == visible);
+				match &= ((BO_Yes == ref_bo) == inside);
+				any_visible |= ref;
+			}
+			if (any_visible)
+			{
+				++ ref_num_visible;
+			}
+		}
+		BOOST_CHECK(match);
+		BOOST_CHECK_EQUAL(ref_num_visible, num_visible);
+	}
+	SIMDBatchLib::ActiveInstructionSet(active);
+}
+
+BOOST_AUTO_TEST_CASE(BatchAABBPlaneDistance)
+{
+	CullingScene scene;
+	GenerateCullingScene(scene, 1003);
+	size_t const num = scene.aabbs.size();
+
+	// The view depth of the nearest corner
+	float4x4 const view = MathLib::look_at_lh(float3(0, 0, -300), float3(100, 50, 0));
+	float4 const view_z = view.Col(2);
+	Plane const plane(view_z.x(), view_z.y(), view_z.z(), view_z.w());
+
+	SIMDInstructionSet const active = SIMDBatchLib::ActiveInstructionSet();
+	for (int is = SIMDIS_Scalar; is <= SIMDBatchLib::MaxInstructionSet(); ++ is)
+	{
+		SIMDBatchLib::ActiveInstructionSet(static_cast<SIMDInstructionSet>(is));
+
+		vector<float> dists(num);
+		SIMDBatchLib::AABBPlaneDistance(&dists[0], scene.SoA(), num, plane);
+
+		bool match = true;
+		for (size_t i = 0; i < num; ++ i)
+		{
+			float ref = 1e10f;
+			for (int k = 0; k < 8; ++ k)
+			{
+				ref = std::min(ref, MathLib::transform_coord(scene.aabbs[i].Corner(k), view).z());
+			}
+			match &= NearlyEqual(ref, dists[i]);
+		}
+		BOOST_CHECK(match);
+	}
+	SIMDBatchLib::ActiveInstructionSet(active);
+}
+
+BOOST_AUTO_TEST_CASE(BatchAABBSphereCone)
+{
+	CullingScene scene;
+	GenerateCullingScene(scene, 1003);
+	size_t const num = scene.aabbs.size();
+	size_t const num_words = (num + 31) / 32;
+
+	Sphere const sphere(float3(50, -20, 10), 200);
+	float3 const apex(-100, 30, -50);
+	float3 const dir = MathLib::normalize(float3(1, 0.2f, 0.5f));
+	float const cos_angle = cos(PI / 6);
+	float const sin_angle = sin(PI / 6);
+	float const height = 400;
+
+	SIMDInstructionSet const active = SIMDBatchLib::ActiveInstructionSet();
+	for (int is = SIMDIS_Scalar; is <= SIMDBatchLib::MaxInstructionSet(); ++ is)
+	{
+		SIMDBatchLib::ActiveInstructionSet(static_cast<SIMDInstructionSet>(is));
+
+		vector<uint32_t> sphere_bits(num_words);
+		uint32_t const num_in_sphere = SIMDBatchLib::IntersectAABBSphere(&sphere_bits[0], scene.SoA(), num, sphere);
+		vector<uint32_t> cone_bits(num_words);
+		uint32_t const num_in_cone = SIMDBatchLib::IntersectAABBCone(&cone_bits[0], scene.SoA(), num,
+			apex, dir, cos_angle, height);
+
+		// The boxes on the boundaries could go either way with FMA
+		bool match = true;
+		uint32_t ref_num_in_sphere = 0;
+		uint32_t ref_num_in_cone = 0;
+		for (size_t i = 0; i < num; ++ i)
+		{
+			AABBox const & box = scene.aabbs[i];
+
+			float3 const nearest = MathLib::maximize(box.Min(), MathLib::minimize(sphere.Center(), box.Max()));
+			float const sphere_margin = MathLib::length(nearest - sphere.Center()) - sphere.Radius();
+			bool const in_sphere = (sphere_bits[i / 32] & (1UL << (i & 31))) != 0;
+			if (MathLib::abs(sphere_margin) > 1e-2f)
+			{
+				match &= (in_sphere == (sphere_margin < 0));
+			}
+			if (in_sphere)
+			{
+				++ ref_num_in_sphere;
+			}
+
+			float3 const v = box.Center() - apex;
+			float const radius = MathLib::length(box.HalfSize());
+			float const along = MathLib::dot(v, dir);
+			float const across = sqrt(std::max(MathLib::length_sq(v) - along * along, 0.0f));
+			float const cone_margin = std::max(std::max(cos_angle * across - sin_angle * along, along - height), -along) - radius;
+			bool const in_cone = (cone_bits[i / 32] & (1UL << (i & 31))) != 0;
+			if (MathLib::abs(cone_margin) > 1e-2f)
+			{
+				match &= (in_cone == (cone_margin < 0));
+			}
+			if (in_cone)
+			{
+				++ ref_num_in_cone;
+			}
+
+			// Conservative, a box with its center in the cone is never rejected
+			float const center_angle = along / std::max(MathLib::length(v), 1e-6f);
+			if ((along > 0) && (along < height) && (center_angle > cos_angle))
+			{
+				match &= in_cone;
+			}
+		}
+		BOOST_CHECK(match);
+		BOOST_CHECK_EQUAL(ref_num_in_sphere, num_in_sphere);
+		BOOST_CHECK_EQUAL(ref_num_in_cone, num_in_cone);
+		BOOST_CHECK(num_in_sphere > 0);
+		BOOST_CHECK(num_in_cone > 0);
+	}
+	SIMDBatchLib::ActiveInstructionSet(active);
+}
+
+BOOST_AUTO_TEST_CASE(BatchFrustumCullingPerf)
+{
+	CullingScene scene;
+	GenerateCullingScene(scene, 16384);
+	size_t const num = scene.aabbs.size();
+	int const NUM_ITERATIONS = 100;
+
+	Timer timer;
+	uint32_t ref_visible = 0;
+	for (int it = 0; it < NUM_ITERATIONS; ++ it)
+	{
+		for (size_t i = 0; i < num; ++ i)
+		{
+			if (scene.frustum.Intersect(scene.aabbs[i]) != BO_No)
+			{
+				++ ref_visible;
+			}
+		}
+	}
+	double const ref_time = timer.elapsed();
+
+	vector<uint32_t> visible_bits((num + 31) / 32);
+	vector<uint8_t> last_planes(num, 0);
+	SIMDInstructionSet const active = SIMDBatchLib::ActiveInstructionSet();
+	for (int is = SIMDIS_Scalar; is <= SIMDBatchLib::MaxInstructionSet(); ++ is)
+	{
+		SIMDBatchLib::ActiveInstructionSet(static_cast<SIMDInstructionSet>(is));
+
+		timer.restart();
+		uint32_t batch_visible = 0;
+		for (int it = 0; it < NUM_ITERATIONS; ++ it)
+		{
+			batch_visible += SIMDBatchLib::IntersectAABBFrustum(&visible_bits[0], nullptr, nullptr, &last_planes[0],
+				scene.SoA(), num, scene.frustum);
+		}
+		double const batch_time = timer.elapsed();
+
+		BOOST_CHECK_EQUAL(ref_visible, batch_visible);
+		BOOST_TEST_MESSAGE("Frustum culling " << num << " boxes: Frustum::Intersect " << ref_time * 1000 / NUM_ITERATIONS
+			<< " ms, " << SIMDBatchLib::InstructionSetName(static_cast<SIMDInstructionSet>(is)) << " batch "
+			<< batch_time * 1000 / NUM_ITERATIONS << " ms, speedup " << ref_time / batch_time << "x");
+	}
+	SIMDBatchLib::ActiveInstructionSet(active);
+}
+
+namespace
+{
+	uint16_t HalfBits(half const & h)
+	{
+		return *reinterpret_cast<uint16_t const *>(&h);
+	}
+
+	float HalfBitsToFloat(uint16_t bits)
+	{
+		return *reinterpret_cast<half const *>(&bits);
+	}
+
+	uint32_t FloatBits(float f)
+	{
+		uint32_t ret;
+		memcpy(&ret, &f, sizeof(ret));
+		return ret;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(HalfRounding)
+{
+	// Ties go to even
+	BOOST_CHECK_EQUAL(HalfBits(half(1.0f + 1.0f / 2048)), 0x3C00);
+	BOOST_CHECK_EQUAL(HalfBits(half(1.0f + 3.0f / 2048)), 0x3C02);
+	BOOST_CHECK_EQUAL(HalfBits(half(1.0f + 1.5f / 2048)), 0x3C01);
+	// Denormals, and ties between them
+	BOOST_CHECK_EQUAL(HalfBits(half(HALF_MIN)), 0x0001);
+	BOOST_CHECK_EQUAL(HalfBits(half(HALF_MIN / 2)), 0x0000);
+	BOOST_CHECK_EQUAL(HalfBits(half(HALF_MIN * 1.5f)), 0x0002);
+	BOOST_CHECK_EQUAL(HalfBits(half(-HALF_MIN * 2.5f)), 0x8002);
+	BOOST_CHECK_EQUAL(HalfBits(half(HALF_NRM_MIN - HALF_MIN)), 0x03FF);
+	BOOST_CHECK_EQUAL(HalfBits(half(HALF_NRM_MIN)), 0x0400);
+	// Overflow
+	BOOST_CHECK_EQUAL(HalfBits(half(HALF_MAX)), 0x7BFF);
+	BOOST_CHECK_EQUAL(HalfBits(half(65519.0f)), 0x7BFF);
+	BOOST_CHECK_EQUAL(HalfBits(half(65520.0f)), 0x7C00);
+	BOOST_CHECK_EQUAL(HalfBits(half(-1e10f)), 0xFC00);
+	BOOST_CHECK_EQUAL(HalfBits(half(numeric_limits<float>::infinity())), 0x7C00);
+	BOOST_CHECK_EQUAL(HalfBits(half(numeric_limits<float>::quiet_NaN())) & 0x7E00, 0x7E00);
+
+	BOOST_CHECK(static_cast<float>(half::pos_inf()) == numeric_limits<float>::infinity());
+	BOOST_CHECK(static_cast<float>(half::neg_inf()) == -numeric_limits<float>::infinity());
+	BOOST_CHECK(HalfBitsToFloat(0x0001) == HALF_MIN);
+	BOOST_CHECK(HalfBitsToFloat(0x8000) == 0);
+}
+
+BOOST_AUTO_TEST_CASE(BatchHalfConversion)
+{
+	// Every half, and its round trip
+	vector<half> all_halves(65536 + 5);
+	for (size_t i = 0; i < all_halves.size(); ++ i)
+	{
+		reinterpret_cast<uint16_t*>(&all_halves[0])[i] = static_cast<uint16_t>(i);
+	}
+
+	// Random floats over the whole half range, with specials at the end for the tails
+	mt19937 gen;
+	uniform_int_distribution<int> exp_dis(127 - 26, 127 + 17);
+	uniform_int_distribution<uint32_t> bits_dis(0, 0xFFFFFFFF);
+	vector<float> floats(10007);
+	for (size_t i = 0; i < floats.size(); ++ i)
+	{
+		uint32_t const bits = bits_dis(gen);
+		uint32_t const u = (bits & 0x807FFFFF) | (static_cast<uint32_t>(exp_dis(gen)) << 23);
+		memcpy(&floats[i], &u, sizeof(u));
+	}
+	floats[floats.size() - 3] = numeric_limits<float>::infinity();
+	floats[floats.size() - 2] = -numeric_limits<float>::quiet_NaN();
+	floats[floats.size() - 1] = numeric_limits<float>::denorm_min();
+
+	SIMDInstructionSet const active = SIMDBatchLib::ActiveInstructionSet();
+	for (int is = SIMDIS_Scalar; is <= SIMDBatchLib::MaxInstructionSet(); ++ is)
+	{
+		SIMDBatchLib::ActiveInstructionSet(static_cast<SIMDInstructionSet>(is));
+
+		vector<float> all_floats(all_halves.size());
+		SIMDBatchLib::HalfToFloat(&all_floats[0], &all_halves[0], all_halves.size());
+		vector<half> round_trip(all_halves.size());
+		SIMDBatchLib::FloatToHalf(&round_trip[0], &all_floats[0], all_floats.size());
+
+		bool match = true;
+		for (size_t i = 0; i < all_halves.size(); ++ i)
+		{
+			uint16_t const h = HalfBits(all_halves[i]);
+			bool const is_nan = ((h & 0x7C00) == 0x7C00) && ((h & 0x03FF) != 0);
+			match &= (FloatBits(all_floats[i]) == FloatBits(static_cast<float>(all_halves[i])));
+			// NaNs come back quiet
+			match &= (HalfBits(round_trip[i]) == (is_nan ? (h | 0x0200) : h));
+		}
+		BOOST_CHECK(match);
+
+		vector<half> halves(floats.size());
+		SIMDBatchLib::FloatToHalf(&halves[0], &floats[0], floats.size());
+		match = true;
+		for (size_t i = 0; i < floats.size(); ++ i)
+		{
+			match &= (HalfBits(halves[i]) == HalfBits(half(floats[i])));
+		}
+		BOOST_CHECK(match);
+	}
+	SIMDBatchLib::ActiveInstructionSet(active);
+}
+
+namespace
+{
+	// Covers negative lattice cells. With on_lattice, every 16th point has integer x and y, on the cell
+	// boundaries. Only for 2D, the 3D kernel is slightly discontinuous across the simplex faces, like the
+	// original one, and a fused multiply-add could put a point exactly on a face to the other side.
+	void GenerateNoiseCoords(vector<float>& x, vector<float>& y, vector<float>& z, size_t num, bool on_lattice)
+	{
+		mt19937 gen;
+		uniform_real_distribution<float> dis(-64, 64);
+		x.resize(num);
+		y.resize(num);
+		z.resize(num);
+		for (size_t i = 0; i < num; ++ i)
+		{
+			x[i] = dis(gen);
+			y[i] = dis(gen);
+			z[i] = dis(gen);
+			if (on_lattice && (0 == i % 16))
+			{
+				x[i] = MathLib::floor(x[i]);
+				y[i] = MathLib::floor(y[i]);
+			}
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(BatchSimplexNoise)
+{
+	size_t const num = 1003;
+	vector<float> x, y, z;
+	GenerateNoiseCoords(x, y, z, num, true);
+	vector<float> x3, y3, z3;
+	GenerateNoiseCoords(x3, y3, z3, num, false);
+
+	SIMDInstructionSet const active = SIMDBatchLib::ActiveInstructionSet();
+	SIMDBatchLib::ActiveInstructionSet(SIMDIS_Scalar);
+	vector<float> ref2(num);
+	vector<float> ref3(num);
+	SIMDBatchLib::SimplexNoise(&ref2[0], &x[0], &y[0], num);
+	SIMDBatchLib::SimplexNoise(&ref3[0], &x3[0], &y3[0], &z3[0], num);
+
+	// Same range as MathLib::SimplexNoise, and not degenerated
+	float sum2 = 0, sum_sq2 = 0, sum3 = 0, sum_sq3 = 0;
+	for (size_t i = 0; i < num; ++ i)
+	{
+		BOOST_CHECK(MathLib::abs(ref2[i]) <= 1.01f);
+		BOOST_CHECK(MathLib::abs(ref3[i]) <= 1.01f);
+		sum2 += ref2[i];
+		sum_sq2 += ref2[i] * ref2[i];
+		sum3 += ref3[i];
+		sum_sq3 += ref3[i] * ref3[i];
+	}
+	BOOST_CHECK(MathLib::abs(sum2 / num) < 0.1f);
+	BOOST_CHECK(MathLib::abs(sum3 / num) < 0.1f);
+	BOOST_CHECK(sum_sq2 / num > 0.02f);
+	BOOST_CHECK(sum_sq3 / num > 0.02f);
+
+	for (int is = SIMDIS_SSE2; is <= SIMDBatchLib::MaxInstructionSet(); ++ is)
+	{
+		SIMDBatchLib::ActiveInstructionSet(static_cast<SIMDInstructionSet>(is));
+
+		vector<float> out2(num);
+		vector<float> out3(num);
+		SIMDBatchLib::SimplexNoise(&out2[0], &x[0], &y[0], num);
+		SIMDBatchLib::SimplexNoise(&out3[0], &x3[0], &y3[0], &z3[0], num);
+		for (size_t i = 0; i < num; ++ i)
+		{
+			BOOST_CHECK(NearlyEqual(ref2[i], out2[i]));
+			BOOST_CHECK(NearlyEqual(ref3[i], out3[i]));
+		}
+	}
+	SIMDBatchLib::ActiveInstructionSet(active);
+}
+
+BOOST_AUTO_TEST_CASE(BatchSimplexFBmImage)
+{
+	uint32_t const WIDTH = 67;
+	uint32_t const HEIGHT = 45;
+	float const FREQ = 4;
+
+	thread_pool tp(1, 4);
+	vector<float> image(WIDTH * HEIGHT);
+	SIMDBatchLib::SimplexFBmImage(&image[0], WIDTH, HEIGHT, 0, 0, FREQ, true, 5, 2, 0.5f, tp);
+
+	vector<float> x(WIDTH);
+	vector<float> y(WIDTH);
+	vector<float> row(WIDTH);
+	bool match = true;
+	for (uint32_t j = 0; j < HEIGHT; ++ j)
+	{
+		for (uint32_t i = 0; i < WIDTH; ++ i)
+		{
+			x[i] = (i + 0.5f) * FREQ / WIDTH;
+			y[i] = (j + 0.5f) * FREQ / HEIGHT;
+		}
+		SIMDBatchLib::SimplexTileableFBm(&row[0], &x[0], &y[0], WIDTH, FREQ, FREQ, 5, 2, 0.5f);
+		for (uint32_t i = 0; i < WIDTH; ++ i)
+		{
+			match &= NearlyEqual(row[i], image[j * WIDTH + i]);
+		}
+	}
+	BOOST_CHECK(match);
+
+	// Wraps around. Sampled at the texel corners, the right edge equals the left edge.
+	vector<float> left(WIDTH * HEIGHT);
+	vector<float> right(WIDTH * HEIGHT);
+	SIMDBatchLib::SimplexFBmImage(&left[0], WIDTH, HEIGHT, -0.5f, 0, FREQ, true, 5, 2, 0.5f, tp);
+	SIMDBatchLib::SimplexFBmImage(&right[0], WIDTH, HEIGHT, 0.5f, 0, FREQ, true, 5, 2, 0.5f, tp);
+	match = true;
+	for (uint32_t j = 0; j < HEIGHT; ++ j)
+	{
+		match &= (MathLib::abs(left[j * WIDTH] - right[j * WIDTH + WIDTH - 1]) < 1e-3f);
+	}
+	BOOST_CHECK(match);
+}
+
+BOOST_AUTO_TEST_CASE(BatchSimplexFBmPerf)
+{
+	size_t const num = 64 * 1024;
+	int const OCTAVES = 5;
+	vector<float> x, y, z;
+	GenerateNoiseCoords(x, y, z, num, false);
+
+	MathLib::SimplexNoise<float>& noiser = MathLib::SimplexNoise<float>::Instance();
+	Timer timer;
+	float ref_sum = 0;
+	for (size_t i = 0; i < num; ++ i)
+	{
+		ref_sum += noiser.fBm(x[i], y[i], OCTAVES);
+	}
+	double const ref_time = timer.elapsed();
+	BOOST_CHECK(ref_sum == ref_sum);
+
+	vector<float> out(num);
+	SIMDInstructionSet const active = SIMDBatchLib::ActiveInstructionSet();
+	for (int is = SIMDIS_Scalar; is <= SIMDBatchLib::MaxInstructionSet(); ++ is)
+	{
+		SIMDBatchLib::ActiveInstructionSet(static_cast<SIMDInstructionSet>(is));
+
+		timer.restart();
+		SIMDBatchLib::SimplexFBm(&out[0], &x[0], &y[0], num, OCTAVES);
+		double const batch_time = timer.elapsed();
+
+		BOOST_TEST_MESSAGE("2D fBm " << num << " points: MathLib::SimplexNoise " << ref_time * 1000
+			<< " ms, " << SIMDBatchLib::InstructionSetName(static_cast<SIMDInstructionSet>(is)) << " batch "
+			<< batch_time * 1000 << " ms, speedup " << ref_time / batch_time << "x");
+	}
+	SIMDBatchLib::ActiveInstructionSet(active);
+}
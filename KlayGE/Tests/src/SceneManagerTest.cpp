@@ -0,0 +1,129 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/App3D.hpp>
+#include <KlayGE/Window.hpp>
+#include <KlayGE/SceneManager.hpp>
+#include <KlayGE/SceneObjectHelper.hpp>
+
+#include <atomic>
+#include <map>
+#include <thread>
+
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunused-parameter" // Ignore unused parameter in boost
+#endif
+#include <boost/test/unit_test.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic pop
+#endif
+
+using namespace std;
+using namespace KlayGE;
+
+BOOST_AUTO_TEST_CASE(SceneManagerDelWhilePipelinedUpdate)
+{
+	SceneManager& sm = Context::Instance().SceneManagerInstance();
+	Context::Instance().AppInstance().MainWnd()->Active(true);
+	sm.ClearObject();
+	sm.SceneUpdateElapse(0);
+	sm.PipelinedUpdate(2);
+
+	std::atomic<bool> release(false);
+	std::atomic<uint32_t> num_updates(0);
+	SceneObjectPtr obj = MakeSharedPtr<SceneObjectHelper>(SceneObject::SOA_Moveable | SceneObject::SOA_PipelinedUpdate);
+	obj->BindSubThreadUpdateFunc([&release, &num_updates](SceneObject& so, float app_time, float elapsed_time)
+		{
+			KFL_UNUSED(app_time);
+			KFL_UNUSED(elapsed_time);
+
+			++ num_updates;
+			while (!release)
+			{
+				std::this_thread::yield();
+			}
+			so.ModelMatrix(MathLib::translation(1.0f, 2.0f, 3.0f));
+		});
+	std::weak_ptr<SceneObject> weak_obj = obj;
+
+	obj->AddToSceneManager();
+	BOOST_CHECK_EQUAL(sm.NumSceneObjects(), 0U);
+
+	// Adds the object, and launches the update on it
+	sm.Update();
+	BOOST_CHECK_EQUAL(sm.NumSceneObjects(), 1U);
+	while (0 == num_updates)
+	{
+		std::this_thread::yield();
+	}
+
+	// Still in flight, the object stays in the scene and alive
+	obj->DelFromSceneManager();
+	obj.reset();
+	sm.Update();
+	BOOST_CHECK_EQUAL(sm.NumSceneObjects(), 1U);
+	BOOST_CHECK(!weak_obj.expired());
+
+	// Published at the latency, then deleted
+	release = true;
+	sm.Update();
+	BOOST_CHECK_EQUAL(sm.NumSceneObjects(), 0U);
+	BOOST_CHECK(weak_obj.expired());
+	BOOST_CHECK_EQUAL(num_updates.load(), 1U);
+
+	sm.PipelinedUpdate(0);
+	sm.SceneUpdateElapse(1.0f / 60);
+}
+
+// The effects shared by renderables sorted apart, such as the GBuffer, the UI and the font ones, are interleaved
+BOOST_AUTO_TEST_CASE(SceneManagerSplitByOwner)
+{
+	int effects[8];
+	std::vector<void const *> owners;
+	for (int i = 0; i < 256; ++ i)
+	{
+		if (i % 3 == 0)
+		{
+			owners.push_back(&effects[0]);
+		}
+		else if (i < 64)
+		{
+			owners.push_back(&effects[1 + i % 2]);
+		}
+		else
+		{
+			owners.push_back(&effects[3 + i / 64]);
+		}
+	}
+
+	// effects[0] spans the whole queue
+	std::vector<size_t> starts;
+	SceneManager::SplitByOwner(owners, 4, starts);
+	BOOST_REQUIRE_EQUAL(starts.size(), 2U);
+	BOOST_CHECK_EQUAL(starts[0], 0U);
+	BOOST_CHECK_EQUAL(starts[1], owners.size());
+
+	// The first quarter shares effects[1] and effects[2] with each other only, and the rest are runs
+	for (int i = 0; i < 256; ++ i)
+	{
+		if (i % 3 == 0)
+		{
+			owners[i] = (i < 64) ? &effects[1] : &effects[3 + i / 64];
+		}
+	}
+	SceneManager::SplitByOwner(owners, 4, starts);
+	BOOST_REQUIRE(starts.size() > 2);
+	BOOST_CHECK_EQUAL(starts.front(), 0U);
+	BOOST_CHECK_EQUAL(starts.back(), owners.size());
+	BOOST_CHECK(starts.size() <= 5);
+	std::map<void const *, size_t> owner_slices;
+	for (size_t s = 0; s + 1 < starts.size(); ++ s)
+	{
+		BOOST_CHECK(starts[s] < starts[s + 1]);
+		for (size_t i = starts[s]; i < starts[s + 1]; ++ i)
+		{
+			auto iter = owner_slices.emplace(owners[i], s).first;
+			BOOST_CHECK_EQUAL(iter->second, s);
+		}
+	}
+}
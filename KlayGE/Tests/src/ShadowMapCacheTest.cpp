@@ -0,0 +1,103 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Math.hpp>
+#include <KFL/AABBox.hpp>
+#include <KlayGE/ShadowMapCache.hpp>
+
+#include <boost/assert.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunused-parameter" // Ignore unused parameter in boost
+#endif
+#include <boost/test/unit_test.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic pop
+#endif
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	// A spot light at eye looking down +z
+	float4x4 SpotViewProj(float3 const & eye)
+	{
+		return MathLib::look_at_lh(eye, eye + float3(0, 0, 1)) * MathLib::perspective_fov_lh(PI / 4, 1.0f, 0.1f, 100.0f);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(ShadowMapCacheAcquire)
+{
+	int const light_a = 0;
+	int const light_b = 0;
+	float4x4 const vp = SpotViewProj(float3(0, 0, 0));
+
+	ShadowMapCache cache;
+	cache.NewFrame();
+	uint32_t const slot_a0 = cache.Acquire(&light_a, 0, vp);
+	uint32_t const slot_a1 = cache.Acquire(&light_a, 1, vp);
+	uint32_t const slot_b0 = cache.Acquire(&light_b, 0, vp);
+	BOOST_CHECK(slot_a0 != slot_a1);
+	BOOST_CHECK(slot_a0 != slot_b0);
+	BOOST_CHECK_EQUAL(3U, cache.NumSlots());
+	BOOST_CHECK_EQUAL(slot_a1, cache.Find(&light_a, 1));
+	BOOST_CHECK_EQUAL(ShadowMapCache::INVALID_SLOT, cache.Find(&light_b, 1));
+
+	// New slots are invalid until the static casters are rendered
+	BOOST_CHECK(!cache.Valid(slot_a0));
+	cache.Validate(slot_a0);
+	cache.Validate(slot_b0);
+
+	// The same view keeps the layer
+	cache.NewFrame();
+	BOOST_CHECK_EQUAL(ShadowMapCache::INVALID_SLOT, cache.Find(&light_a, 0));
+	BOOST_CHECK_EQUAL(slot_a0, cache.Acquire(&light_a, 0, vp));
+	BOOST_CHECK(cache.Valid(slot_a0));
+
+	// The light moves
+	BOOST_CHECK_EQUAL(slot_b0, cache.Acquire(&light_b, 0, SpotViewProj(float3(1, 0, 0))));
+	BOOST_CHECK(!cache.Valid(slot_b0));
+
+	// Face 1 of light_a isn't acquired in this frame, its slot is reused
+	cache.NewFrame();
+	uint32_t const slot_c0 = cache.Acquire(&light_b, 5, vp);
+	BOOST_CHECK_EQUAL(slot_a1, slot_c0);
+	BOOST_CHECK(!cache.Valid(slot_c0));
+	BOOST_CHECK_EQUAL(3U, cache.NumSlots());
+}
+
+BOOST_AUTO_TEST_CASE(ShadowMapCacheInvalidate)
+{
+	int const light_a = 0;
+	int const light_b = 0;
+
+	ShadowMapCache cache;
+	cache.NewFrame();
+	uint32_t const slot_a = cache.Acquire(&light_a, 0, SpotViewProj(float3(0, 0, 0)));
+	uint32_t const slot_b = cache.Acquire(&light_b, 0, SpotViewProj(float3(50, 0, 0)));
+	cache.Validate(slot_a);
+	cache.Validate(slot_b);
+
+	// Behind both lights
+	cache.Invalidate(AABBox(float3(-1, -1, -10), float3(1, 1, -5)));
+	BOOST_CHECK(cache.Valid(slot_a));
+	BOOST_CHECK(cache.Valid(slot_b));
+
+	// In front of light_a only
+	cache.Invalidate(AABBox(float3(-1, -1, 10), float3(1, 1, 12)));
+	BOOST_CHECK(!cache.Valid(slot_a));
+	BOOST_CHECK(cache.Valid(slot_b));
+
+	// Beyond the far plane of light_b
+	cache.Invalidate(AABBox(float3(49, -1, 110), float3(51, 1, 120)));
+	BOOST_CHECK(cache.Valid(slot_b));
+
+	// Crossing the side plane of light_b
+	cache.Invalidate(AABBox(float3(40, -1, 10), float3(48, 1, 12)));
+	BOOST_CHECK(!cache.Valid(slot_b));
+
+	cache.Validate(slot_a);
+	cache.Validate(slot_b);
+	cache.InvalidateAll();
+	BOOST_CHECK(!cache.Valid(slot_a));
+	BOOST_CHECK(!cache.Valid(slot_b));
+}
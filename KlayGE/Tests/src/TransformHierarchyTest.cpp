@@ -0,0 +1,220 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Math.hpp>
+#include <KFL/Thread.hpp>
+#include <KlayGE/TransformHierarchy.hpp>
+
+#include <boost/assert.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunused-parameter" // Ignore unused parameter in boost
+#endif
+#include <boost/test/unit_test.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic pop
+#endif
+
+#include <vector>
+#include <random>
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	uint32_t const NUM_NODES = 3000;
+
+	float4x4 RandomLocal(mt19937& gen)
+	{
+		uniform_real_distribution<float> angle_dis(-PI, PI);
+		uniform_real_distribution<float> pos_dis(-10, 10);
+		return MathLib::rotation_y(angle_dis(gen)) * MathLib::translation(pos_dis(gen), pos_dis(gen), pos_dis(gen));
+	}
+
+	// Builds a forest with random parents, mirrored in locals and parents indexed by handle
+	void BuildForest(TransformHierarchy& th, vector<uint32_t>& nodes, vector<float4x4>& locals, vector<uint32_t>& parents,
+		mt19937& gen)
+	{
+		nodes.resize(NUM_NODES);
+		locals.resize(NUM_NODES);
+		parents.resize(NUM_NODES);
+		for (uint32_t i = 0; i < NUM_NODES; ++ i)
+		{
+			uint32_t parent = TransformHierarchy::INVALID_NODE;
+			if ((i > 0) && (gen() % 8 != 0))
+			{
+				parent = nodes[gen() % i];
+			}
+
+			float4x4 const local = RandomLocal(gen);
+			nodes[i] = th.AddNode(parent, local);
+			BOOST_CHECK_EQUAL(i, nodes[i]);
+			locals[i] = local;
+			parents[i] = parent;
+		}
+	}
+
+	float4x4 ReferenceWorld(vector<float4x4> const & locals, vector<uint32_t> const & parents, uint32_t node)
+	{
+		float4x4 world = locals[node];
+		for (uint32_t p = parents[node]; p != TransformHierarchy::INVALID_NODE; p = parents[p])
+		{
+			world = locals[p] * world;
+		}
+		return world;
+	}
+
+	bool NearlyEqual(float4x4 const & lhs, float4x4 const & rhs)
+	{
+		for (int i = 0; i < 16; ++ i)
+		{
+			if (MathLib::abs(lhs[i] - rhs[i]) > 1e-3f * std::max(1.0f, MathLib::abs(lhs[i])))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool MatchReference(TransformHierarchy const & th, vector<float4x4> const & locals, vector<uint32_t> const & parents,
+		vector<uint8_t> const & alive)
+	{
+		bool match = true;
+		for (uint32_t i = 0; i < locals.size(); ++ i)
+		{
+			if (alive[i])
+			{
+				match &= NearlyEqual(ReferenceWorld(locals, parents, i), th.WorldMatrix(i));
+			}
+		}
+		return match;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(TransformHierarchyAdd)
+{
+	mt19937 gen;
+	TransformHierarchy th;
+	vector<uint32_t> nodes;
+	vector<float4x4> locals;
+	vector<uint32_t> parents;
+	BuildForest(th, nodes, locals, parents, gen);
+	vector<uint8_t> const alive(NUM_NODES, 1);
+
+	// Computed when added
+	BOOST_CHECK(MatchReference(th, locals, parents, alive));
+
+	// Nothing is dirty, only the layout is sorted
+	BOOST_CHECK(!th.Update());
+	BOOST_CHECK(MatchReference(th, locals, parents, alive));
+	BOOST_CHECK_EQUAL(NUM_NODES, th.NumNodes());
+}
+
+BOOST_AUTO_TEST_CASE(TransformHierarchyDirtySubtrees)
+{
+	mt19937 gen;
+	TransformHierarchy th;
+	vector<uint32_t> nodes;
+	vector<float4x4> locals;
+	vector<uint32_t> parents;
+	BuildForest(th, nodes, locals, parents, gen);
+	vector<uint8_t> const alive(NUM_NODES, 1);
+
+	thread_pool tp(1, 4);
+	for (int pass = 0; pass < 2; ++ pass)
+	{
+		vector<uint8_t> moved(NUM_NODES, 0);
+		for (int i = 0; i < 50; ++ i)
+		{
+			uint32_t const node = gen() % NUM_NODES;
+			locals[node] = RandomLocal(gen);
+			th.LocalMatrix(node, locals[node]);
+			moved[node] = 1;
+		}
+
+		bool const updated = pass ? th.Update(tp) : th.Update();
+		BOOST_CHECK(updated);
+		BOOST_CHECK(MatchReference(th, locals, parents, alive));
+
+		// Only the moved nodes and their descendants are recomputed
+		bool changed_match = true;
+		for (uint32_t i = 0; i < NUM_NODES; ++ i)
+		{
+			bool in_moved_subtree = false;
+			for (uint32_t n = i; n != TransformHierarchy::INVALID_NODE; n = parents[n])
+			{
+				in_moved_subtree |= (moved[n] != 0);
+			}
+			changed_match &= (in_moved_subtree == th.WorldChanged(i));
+		}
+		BOOST_CHECK(changed_match);
+	}
+
+	BOOST_CHECK(!th.Update(tp));
+	bool any_changed = false;
+	for (uint32_t i = 0; i < NUM_NODES; ++ i)
+	{
+		any_changed |= th.WorldChanged(i);
+	}
+	BOOST_CHECK(!any_changed);
+}
+
+BOOST_AUTO_TEST_CASE(TransformHierarchyRestructure)
+{
+	mt19937 gen;
+	TransformHierarchy th;
+	vector<uint32_t> nodes;
+	vector<float4x4> locals;
+	vector<uint32_t> parents;
+	BuildForest(th, nodes, locals, parents, gen);
+	vector<uint8_t> alive(NUM_NODES, 1);
+
+	// Moves some nodes under the roots, or to the roots. The new parent mustn't be in the subtree.
+	for (int i = 0; i < 100; ++ i)
+	{
+		uint32_t const node = gen() % NUM_NODES;
+		uint32_t new_parent = TransformHierarchy::INVALID_NODE;
+		uint32_t const candidate = gen() % NUM_NODES;
+		if ((candidate != node) && (TransformHierarchy::INVALID_NODE == parents[candidate]))
+		{
+			new_parent = candidate;
+		}
+		parents[node] = new_parent;
+		th.Parent(node, new_parent);
+	}
+
+	// Deletes the leaves, then reuses their handles
+	vector<uint8_t> has_children(NUM_NODES, 0);
+	for (uint32_t i = 0; i < NUM_NODES; ++ i)
+	{
+		if (parents[i] != TransformHierarchy::INVALID_NODE)
+		{
+			has_children[parents[i]] = 1;
+		}
+	}
+	uint32_t num_deleted = 0;
+	for (uint32_t i = 0; i < NUM_NODES; i += 3)
+	{
+		if (!has_children[i])
+		{
+			th.DelNode(i);
+			alive[i] = 0;
+			++ num_deleted;
+		}
+	}
+	BOOST_CHECK_EQUAL(NUM_NODES - num_deleted, th.NumNodes());
+
+	for (uint32_t i = 0; i < 10; ++ i)
+	{
+		float4x4 const local = RandomLocal(gen);
+		uint32_t const parent = (parents[i * 7] == TransformHierarchy::INVALID_NODE) && alive[i * 7] ? i * 7 : TransformHierarchy::INVALID_NODE;
+		uint32_t const node = th.AddNode(parent, local);
+		BOOST_CHECK(!alive[node]);
+		alive[node] = 1;
+		locals[node] = local;
+		parents[node] = parent;
+	}
+
+	thread_pool tp(1, 4);
+	BOOST_CHECK(th.Update(tp));
+	BOOST_CHECK(MatchReference(th, locals, parents, alive));
+}
@@ -0,0 +1,283 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Timer.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/RenderFactory.hpp>
+#include <KlayGE/RenderEngine.hpp>
+#include <KlayGE/GraphicsBuffer.hpp>
+#include <KlayGE/TransientBuffer.hpp>
+
+#include <boost/assert.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunused-parameter" // Ignore unused parameter in boost
+#endif
+#include <boost/test/unit_test.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic pop
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <list>
+#include <random>
+#include <vector>
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	struct FrameAllocs
+	{
+		GraphicsBuffer const * buffer;
+		vector<SubAlloc> allocs;
+	};
+
+	// The first fit free list TransientBuffer used before the ring, as the baseline of the benchmark
+	class FreeListTransientBuffer
+	{
+		struct RetiredFrame
+		{
+			std::list<SubAlloc> pending_frees;
+			uint32_t frame_id;
+		};
+
+	public:
+		explicit FreeListTransientBuffer(uint32_t size_in_byte)
+		{
+			RenderFactory& rf = Context::Instance().RenderFactoryInstance();
+			use_no_overwrite_ = rf.RenderEngineInstance().DeviceCaps().no_overwrite_support;
+			num_pre_frames_ = use_no_overwrite_ ? 3 : 1;
+			buffer_ = rf.MakeVertexBuffer(BU_Dynamic, EAH_CPU_Write | EAH_GPU_Read, size_in_byte, nullptr);
+			simulate_buffer_.resize(size_in_byte);
+			free_list_.push_back(SubAlloc(0, size_in_byte));
+			retired_frames_.push_back(RetiredFrame{ {}, 1 });
+		}
+
+		SubAlloc Alloc(uint32_t size_in_byte, void const * data)
+		{
+			auto iter = free_list_.begin();
+			while ((iter != free_list_.end()) && (iter->length_ < size_in_byte))
+			{
+				++ iter;
+			}
+			if (iter == free_list_.end())
+			{
+				RenderFactory& rf = Context::Instance().RenderFactoryInstance();
+				uint32_t const old_size = buffer_->Size();
+				uint32_t const new_size = std::max(old_size * 2, old_size + size_in_byte);
+				GraphicsBufferPtr larger_buffer = rf.MakeVertexBuffer(BU_Dynamic, EAH_CPU_Write | EAH_GPU_Read, new_size, nullptr);
+				if (use_no_overwrite_)
+				{
+					buffer_->CopyToBuffer(*larger_buffer);
+				}
+				simulate_buffer_.resize(new_size);
+				buffer_ = larger_buffer;
+				this->DoFree(SubAlloc(old_size, new_size - old_size));
+				iter = free_list_.end();
+				-- iter;
+			}
+
+			SubAlloc const ret(iter->offset_, size_in_byte);
+			iter->offset_ += size_in_byte;
+			iter->length_ -= size_in_byte;
+			if (0 == iter->length_)
+			{
+				free_list_.erase(iter);
+			}
+
+			if (use_no_overwrite_)
+			{
+				GraphicsBuffer::Mapper mapper(*buffer_, BA_Write_No_Overwrite);
+				memcpy(mapper.Pointer<uint8_t>() + ret.offset_, data, ret.length_);
+			}
+			else
+			{
+				memcpy(&simulate_buffer_[ret.offset_], data, ret.length_);
+			}
+			return ret;
+		}
+
+		void Dealloc(SubAlloc const & alloc)
+		{
+			retired_frames_.back().pending_frees.push_back(alloc);
+		}
+
+		void OnPresent(uint32_t frame_id)
+		{
+			if (!retired_frames_.back().pending_frees.empty())
+			{
+				retired_frames_.push_back(RetiredFrame{ {}, frame_id + 1 });
+			}
+			for (auto iter = retired_frames_.begin(); iter != retired_frames_.end();)
+			{
+				if (iter->frame_id + num_pre_frames_ <= frame_id)
+				{
+					for (auto const & alloc : iter->pending_frees)
+					{
+						this->DoFree(alloc);
+					}
+					iter = retired_frames_.erase(iter);
+				}
+				else
+				{
+					++ iter;
+				}
+			}
+		}
+
+	private:
+		void DoFree(SubAlloc const & alloc)
+		{
+			auto next = free_list_.begin();
+			while ((next != free_list_.end()) && (next->offset_ < alloc.offset_))
+			{
+				++ next;
+			}
+			auto iter = free_list_.insert(next, alloc);
+			if ((next != free_list_.end()) && (iter->offset_ + iter->length_ == next->offset_))
+			{
+				iter->length_ += next->length_;
+				free_list_.erase(next);
+			}
+			if (iter != free_list_.begin())
+			{
+				auto prev = iter;
+				-- prev;
+				if (prev->offset_ + prev->length_ == iter->offset_)
+				{
+					prev->length_ += iter->length_;
+					free_list_.erase(iter);
+				}
+			}
+		}
+
+	private:
+		bool use_no_overwrite_;
+		uint32_t num_pre_frames_;
+		GraphicsBufferPtr buffer_;
+		std::list<SubAlloc> free_list_;
+		std::list<RetiredFrame> retired_frames_;
+		std::vector<uint8_t> simulate_buffer_;
+	};
+}
+
+BOOST_AUTO_TEST_CASE(TransientBufferRing)
+{
+	mt19937 gen;
+	vector<uint8_t> data(1024);
+
+	// The frames in flight plus the current one. Without no-overwrite mapping, the buffer is discarded every frame.
+	RenderEngine const & re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
+	size_t const num_live_frames = re.DeviceCaps().no_overwrite_support ? 4 : 2;
+
+	TransientBuffer tb(1024, TransientBuffer::BF_Vertex);
+	vector<FrameAllocs> frames;
+	for (uint32_t frame = 0; frame < 200; ++ frame)
+	{
+		// A heavy frame now and then makes the ring wrap around and grow
+		uint32_t const num_allocs = (frame % 37 == 0) ? 60 : gen() % 20;
+		FrameAllocs cur;
+		for (uint32_t i = 0; i < num_allocs; ++ i)
+		{
+			uint32_t const size = 16 + gen() % 256;
+			SubAlloc const alloc = tb.Alloc(size, &data[0]);
+			BOOST_CHECK_EQUAL(size, alloc.length_);
+			cur.allocs.push_back(alloc);
+		}
+		// All the allocations of this frame are in the current buffer, even if it grew in the middle
+		cur.buffer = tb.GetBuffer().get();
+		for (auto const & alloc : cur.allocs)
+		{
+			BOOST_CHECK(alloc.offset_ + alloc.length_ <= cur.buffer->Size());
+			tb.Dealloc(alloc);
+		}
+		frames.push_back(cur);
+
+		// The frames that could still be read by the GPU mustn't overlap in the same buffer
+		vector<SubAlloc> live;
+		for (size_t i = frames.size() - std::min(frames.size(), num_live_frames); i < frames.size(); ++ i)
+		{
+			if (frames[i].buffer == cur.buffer)
+			{
+				live.insert(live.end(), frames[i].allocs.begin(), frames[i].allocs.end());
+			}
+		}
+		std::sort(live.begin(), live.end(),
+			[](SubAlloc const & lhs, SubAlloc const & rhs)
+			{
+				return lhs.offset_ < rhs.offset_;
+			});
+		bool overlapped = false;
+		for (size_t i = 1; i < live.size(); ++ i)
+		{
+			overlapped |= (live[i - 1].offset_ + live[i - 1].length_ > live[i].offset_);
+		}
+		BOOST_CHECK(!overlapped);
+
+		tb.OnPresent(frame);
+	}
+
+	// A steady load reaches a steady size
+	uint32_t steady_size = 0;
+	for (uint32_t frame = 200; frame < 400; ++ frame)
+	{
+		for (uint32_t i = 0; i < 20; ++ i)
+		{
+			tb.Alloc(200, &data[0]);
+		}
+		tb.OnPresent(frame);
+
+		if (250 == frame)
+		{
+			steady_size = tb.GetBuffer()->Size();
+		}
+	}
+	BOOST_CHECK_EQUAL(steady_size, tb.GetBuffer()->Size());
+}
+
+BOOST_AUTO_TEST_CASE(TransientBufferAllocPerf)
+{
+	uint32_t const NUM_FRAMES = 200;
+	uint32_t const NUM_ALLOCS = 2000;
+	// A quad of UI vertices
+	uint32_t const ALLOC_SIZE = 4 * 24;
+	vector<uint8_t> data(ALLOC_SIZE);
+	vector<SubAlloc> allocs(NUM_ALLOCS);
+
+	FreeListTransientBuffer ref_tb(NUM_ALLOCS * ALLOC_SIZE);
+	Timer timer;
+	for (uint32_t frame = 0; frame < NUM_FRAMES; ++ frame)
+	{
+		for (uint32_t i = 0; i < NUM_ALLOCS; ++ i)
+		{
+			allocs[i] = ref_tb.Alloc(ALLOC_SIZE, &data[0]);
+		}
+		for (uint32_t i = 0; i < NUM_ALLOCS; ++ i)
+		{
+			ref_tb.Dealloc(allocs[i]);
+		}
+		ref_tb.OnPresent(frame);
+	}
+	double const ref_time = timer.elapsed();
+
+	TransientBuffer tb(NUM_ALLOCS * ALLOC_SIZE, TransientBuffer::BF_Vertex);
+	timer.restart();
+	for (uint32_t frame = 0; frame < NUM_FRAMES; ++ frame)
+	{
+		for (uint32_t i = 0; i < NUM_ALLOCS; ++ i)
+		{
+			allocs[i] = tb.Alloc(ALLOC_SIZE, &data[0]);
+		}
+		for (uint32_t i = 0; i < NUM_ALLOCS; ++ i)
+		{
+			tb.Dealloc(allocs[i]);
+		}
+		tb.OnPresent(frame);
+	}
+	double const ring_time = timer.elapsed();
+
+	double const num_allocs = static_cast<double>(NUM_FRAMES) * NUM_ALLOCS;
+	BOOST_TEST_MESSAGE("TransientBuffer " << ALLOC_SIZE << " bytes: free list " << num_allocs / ref_time / 1e6
+		<< " M allocs/s, ring " << num_allocs / ring_time / 1e6 << " M allocs/s, speedup " << ref_time / ring_time << "x");
+}
@@ -1,6 +1,7 @@
 #include <KlayGE/KlayGE.hpp>
 #include <KFL/Half.hpp>
 #include <KFL/Math.hpp>
+#include <KFL/SIMDBatch.hpp>
 #include <KlayGE/Texture.hpp>
 #include <KlayGE/TexCompressionBC.hpp>
 #include <KlayGE/ResLoader.hpp>
@@ -99,8 +100,7 @@ namespace
 		}
 		else
 		{
-			half* y_dst = reinterpret_cast<half*>(&y_data_block[0]);
-
+			std::vector<float> y_f32(width * height);
 			for (uint32_t y = 0; y < height; ++ y)
 			{
 				for (uint32_t x = 0; x < width; ++ x)
@@ -112,9 +112,11 @@ namespace
 
 					float log_y = log(Y) / log2 + 16;
 
-					y_dst[y * width + x] = half(log_y * 2048 / 65535);
+					y_f32[y * width + x] = log_y * 2048 / 65535;
 				}
 			}
+
+			SIMDBatchLib::FloatToHalf(reinterpret_cast<half*>(&y_data_block[0]), &y_f32[0], y_f32.size());
 		}
 
 		uint32_t c_width = std::max(width / 2, 1U);
@@ -291,7 +293,9 @@ namespace
 		}
 		else
 		{
-			half const * y_src = static_cast<half const *>(y_data.data);
+			std::vector<float> y_src(width * height);
+			SIMDBatchLib::HalfToFloat(&y_src[0], static_cast<half const *>(y_data.data), y_src.size());
+
 			float* hdr = reinterpret_cast<float*>(&hdr_data_block[0]);
 			for (uint32_t y = 0; y < height; ++ y)
 			{
@@ -1,6 +1,7 @@
 #include <KlayGE/KlayGE.hpp>
 #include <KlayGE/Texture.hpp>
-#include <KFL/Noise.hpp>
+#include <KFL/SIMDBatch.hpp>
+#include <KlayGE/Context.hpp>
 
 #include <iostream>
 #include <fstream>
@@ -223,20 +224,16 @@ void GenfBmTexs()
 	uint32_t const TEX_SIZE = 512;
 	float const STRIDE = 8;
 
-	MathLib::SimplexNoise<float> noiser = MathLib::SimplexNoise<float>::Instance();
+	thread_pool& tp = Context::Instance().ThreadPool();
 
 	std::vector<float> fdata(TEX_SIZE * TEX_SIZE);
+	SIMDBatchLib::SimplexFBmImage(&fdata[0], TEX_SIZE, TEX_SIZE, 0, 0, STRIDE, true, 5, 2, 0.5f, tp);
 	float min_v = +1e10f;
 	float max_v = -1e10f;
-	for (uint32_t y = 0; y < TEX_SIZE; ++ y)
+	for (uint32_t i = 0; i < fdata.size(); ++ i)
 	{
-		for (uint32_t x = 0; x < TEX_SIZE; ++ x)
-		{
-			float v = noiser.tileable_fBm((x + 0.5f) / TEX_SIZE * STRIDE, (y + 0.5f) / TEX_SIZE * STRIDE, STRIDE, STRIDE, 5, 2, 0.5f);
-			fdata[y * TEX_SIZE + x] = v;
-			min_v = std::min(min_v, v);
-			max_v = std::max(max_v, v);
-		}
+		min_v = std::min(min_v, fdata[i]);
+		max_v = std::max(max_v, fdata[i]);
 	}
 	float inv_range = 1 / (max_v - min_v);
 	std::vector<uint8_t> data(TEX_SIZE * TEX_SIZE);
@@ -255,17 +252,19 @@ void GenfBmTexs()
 	system("Mipmapper " OUTPUT_PATH "fBm5_tex.dds");
 	system("TexCompressor BC4 " OUTPUT_PATH "fBm5_tex.dds");
 
+	float const d = 2;
+	std::vector<float> fdata_dx(TEX_SIZE * TEX_SIZE);
+	std::vector<float> fdata_dy(TEX_SIZE * TEX_SIZE);
+	SIMDBatchLib::SimplexFBmImage(&fdata_dx[0], TEX_SIZE, TEX_SIZE, d, 0, STRIDE, true, 5, 2, 0.5f, tp);
+	SIMDBatchLib::SimplexFBmImage(&fdata_dy[0], TEX_SIZE, TEX_SIZE, 0, d, STRIDE, true, 5, 2, 0.5f, tp);
+
 	std::vector<float3> fdata3(TEX_SIZE * TEX_SIZE);
-	for (uint32_t y = 0; y < TEX_SIZE; ++ y)
+	for (uint32_t i = 0; i < fdata3.size(); ++ i)
 	{
-		for (uint32_t x = 0; x < TEX_SIZE; ++ x)
-		{
-			float f0 = fdata[y * TEX_SIZE + x];
-			float d = 2;
-			float fx = noiser.tileable_fBm((x + d + 0.5f) / TEX_SIZE * STRIDE, (y + 0.5f) / TEX_SIZE * STRIDE, STRIDE, STRIDE, 5, 2, 0.5f);
-			float fy = noiser.tileable_fBm((x + 0.5f) / TEX_SIZE * STRIDE, (y + d + 0.5f) / TEX_SIZE * STRIDE, STRIDE, STRIDE, 5, 2, 0.5f);
-			fdata3[y * TEX_SIZE + x] = MathLib::normalize(float3(fx - f0, fy - f0, STRIDE * 16 / TEX_SIZE)) * 0.5f + 0.5f;
-		}
+		float f0 = fdata[i];
+		float fx = fdata_dx[i];
+		float fy = fdata_dy[i];
+		fdata3[i] = MathLib::normalize(float3(fx - f0, fy - f0, STRIDE * 16 / TEX_SIZE)) * 0.5f + 0.5f;
 	}
 	std::vector<uint32_t> data3(TEX_SIZE * TEX_SIZE);
 	for (uint32_t i = 0; i < fdata3.size(); ++ i)